@@ -0,0 +1,211 @@
+/** @file       advqueue.c
+ *  @brief      Advertising report queue, moves report processing from SoftDevice interrupt to main loop
+ *  @author     Evren Kenanoglu
+ *  @date       3/29/2021
+ */
+#define FILE_ADVQUEUE_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "advqueue.h"
+#include "cpumon.h"
+#include "recpool.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+static tsAdvQueueParams advQueueParams;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void advQueueDrain(void *p_event_data, uint16_t event_size);
+static void advRecordParse(tsAdvRecord *record);
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize the advertising report queue
+ *
+ * @param handler Record handler, called from main loop (app_sched_execute) for every queued record
+ */
+void advQueueInit(tpfAdvRecordHandler handler)
+{
+    memset(&advQueueParams, 0, sizeof(advQueueParams));
+    advQueueParams.handler = handler;
+}
+
+/**
+ * @brief Function to copy an advertising report into a record
+ *
+ * @param record    Record to be filled
+ * @param advReport Advertising report from the SoftDevice event
+ */
+void advRecordFill(tsAdvRecord *record, ble_gap_evt_adv_report_t const *advReport)
+{
+    uint8_t len = MIN(advReport->data.len, CAPS_REPORT_SIZE);
+
+    record->timestamp   = app_timer_cnt_get();
+    record->addrType    = advReport->peer_addr.addr_type;
+    record->rssi        = advReport->rssi;
+    record->primaryPhy  = advReport->primary_phy;
+    record->chIndex     = advReport->ch_index;
+    record->connectable = advReport->type.connectable;
+    record->len         = len;
+    memcpy(record->addr, advReport->peer_addr.addr, BLE_GAP_ADDR_LEN);
+    memcpy(record->data, advReport->data.p_data, len);
+    record->data[len] = 0;
+
+    advRecordParse(record);
+}
+
+/**
+ * @brief Function to queue an advertising report, called from the SoftDevice observer (interrupt)
+ *
+ * @param advReport Advertising report
+ * @return true     report is queued
+ * @return false    queue is full, report is dropped
+ */
+bool advQueuePut(ble_gap_evt_adv_report_t const *advReport)
+{
+    uint32_t head  = advQueueParams.head;
+    uint32_t depth = head - advQueueParams.tail;
+
+    advQueueParams.received++;
+
+    tsAdvRecord *record;
+
+    if (depth >= ADV_QUEUE_DEPTH)
+    {
+        advQueueParams.overflowQueue++;
+        return false;
+    }
+    record = recPoolAlloc();
+    if (record == NULL)
+    {
+        advQueueParams.overflowPool++; // A record was not released
+        return false;
+    }
+
+    advRecordFill(record, advReport);
+    advQueueParams.records[head & (ADV_QUEUE_DEPTH - 1)] = record;
+    __DMB(); // Record has to be written before it is published
+    advQueueParams.head = head + 1;
+
+    if (depth + 1 > advQueueParams.highWater)
+    {
+        advQueueParams.highWater = depth + 1;
+    }
+
+    if (!advQueueParams.drainPending)
+    {
+        advQueueParams.drainPending = 1;
+        if (app_sched_event_put(NULL, 0, advQueueDrain) != NRF_SUCCESS)
+        {
+            advQueueParams.overflowSched++;
+            advQueueParams.drainPending = 0; // Next report retries
+        }
+    }
+    return true;
+}
+
+/**@brief Function to get queue counters */
+tsAdvQueueParams const *advQueueStatsGet(void)
+{
+    return &advQueueParams;
+}
+
+/**@brief Function to print queue counters */
+void advQueueReport(void)
+{
+    printf("ADVQ received=%lu processed=%lu dropped=%lu poolEmpty=%lu schedFull=%lu highWater=%lu/%u\n\r",
+           advQueueParams.received,
+           advQueueParams.processed,
+           advQueueParams.overflowQueue,
+           advQueueParams.overflowPool,
+           advQueueParams.overflowSched,
+           advQueueParams.highWater,
+           ADV_QUEUE_DEPTH);
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**
+ * @brief Scheduler handler, processes all queued records in main loop context
+ */
+static void advQueueDrain(void *p_event_data, uint16_t event_size)
+{
+    UNUSED_PARAMETER(p_event_data);
+    UNUSED_PARAMETER(event_size);
+
+    advQueueParams.drainPending = 0; // Reports arriving from now on schedule a new drain
+
+    while (advQueueParams.tail != advQueueParams.head)
+    {
+        tsAdvRecord *record = advQueueParams.records[advQueueParams.tail & (ADV_QUEUE_DEPTH - 1)];
+
+        CPU_MON_START();
+        advQueueParams.handler(record);
+        CPU_MON_STOP(eCpuSiteAdvProcess);
+        recPoolRelease(record); // Stages copy what they keep (stream, capture)
+
+        __DMB(); // Record has to be consumed before the slot is released
+        advQueueParams.tail++;
+        advQueueParams.processed++;
+    }
+}
+
+/**
+ * @brief Single pass over the AD structures of a record
+ *
+ * @details Malformed structures (length running past the data) end the walk, the fields found up to
+ *          there stay valid.
+ */
+static void advRecordParse(tsAdvRecord *record)
+{
+    uint8_t offset = 0;
+
+    record->nameOffset   = 0;
+    record->nameLength   = 0;
+    record->nameComplete = 0;
+    record->manufOffset  = 0;
+    record->manufLength  = 0;
+
+    while (offset + 1 < record->len)
+    {
+        uint8_t length = record->data[offset]; // Type and data
+        uint8_t type   = record->data[offset + 1];
+
+        if (length == 0 || offset + 1 + length > record->len)
+        {
+            break;
+        }
+
+        switch (type)
+        {
+            case BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME:
+                record->nameComplete = 1;
+                // fall through
+            case BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME:
+                if (record->nameLength == 0 || type == BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME)
+                {
+                    record->nameOffset = offset + 2;
+                    record->nameLength = length - 1;
+                }
+                break;
+
+            case BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA:
+                record->manufOffset = offset + 2;
+                record->manufLength = length - 1;
+                break;
+
+            default:
+                break;
+        }
+        offset += 1 + length;
+    }
+}
@@ -0,0 +1,91 @@
+/** @file       advqueue.h
+ *  @brief      Advertising report queue, moves report processing from SoftDevice interrupt to main loop
+ *  @author     Evren Kenanoglu
+ *  @date       3/29/2021
+ */
+#ifndef FILE_ADVQUEUE_H
+#define FILE_ADVQUEUE_H
+
+/** INCLUDES ******************************************************************/
+#include "parameters.h"
+#include "ble_gap.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define ADV_QUEUE_DEPTH 16 // Records, has to be power of 2
+
+STATIC_ASSERT((ADV_QUEUE_DEPTH & (ADV_QUEUE_DEPTH - 1)) == 0);
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Minimal copy of an advertising report, a block of the record pool (recpool.c)
+ *
+ * @details The AD structures are walked once when the record is filled, the stages use the offsets
+ *          below instead of searching the data again. Length 0: the AD type is not in the report.
+ */
+typedef struct
+{
+    uint32_t timestamp; /**< app_timer ticks at reception */
+    uint8_t addr[BLE_GAP_ADDR_LEN];
+    uint8_t addrType;
+    int8_t rssi;
+    uint8_t primaryPhy;
+    uint8_t chIndex;
+    uint8_t connectable;
+    uint8_t nameOffset;   /**< Complete local name, short name if there is none */
+    uint8_t nameLength;
+    uint8_t nameComplete;
+    uint8_t manufOffset;  /**< Manufacturer specific data, company identifier first */
+    uint8_t manufLength;
+    uint8_t len;
+    uint8_t data[CAPS_REPORT_SIZE + 1]; /**< Scan buffer size (caps.h), +1 keeps local name strings terminated */
+} tsAdvRecord;
+
+typedef void (*tpfAdvRecordHandler)(tsAdvRecord const *record);
+
+/**
+ * @brief Queue state and counters
+ *
+ */
+typedef struct
+{
+    tsAdvRecord *records[ADV_QUEUE_DEPTH]; /**< Pool blocks, released after the handler */
+    volatile uint32_t head; /**< Written by the SoftDevice interrupt only */
+    volatile uint32_t tail; /**< Written by the main loop only */
+    volatile uint8_t drainPending;
+    tpfAdvRecordHandler handler;
+    uint32_t received;
+    uint32_t processed;
+    uint32_t overflowQueue; /**< Report dropped, queue full */
+    uint32_t overflowPool;  /**< Report dropped, record pool empty */
+    uint32_t overflowSched; /**< Scheduler queue full, drain delayed to next report */
+    uint32_t highWater;
+} tsAdvQueueParams;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_ADVQUEUE_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void advQueueInit(tpfAdvRecordHandler handler);
+#if SCANNING_ENABLE
+INTERFACE void advRecordFill(tsAdvRecord *record, ble_gap_evt_adv_report_t const *advReport);
+INTERFACE bool advQueuePut(ble_gap_evt_adv_report_t const *advReport);
+#endif
+INTERFACE tsAdvQueueParams const *advQueueStatsGet(void);
+INTERFACE void advQueueReport(void);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_ADVQUEUE_H
@@ -0,0 +1,94 @@
+# @file       app.mk
+# @brief      Program sources of the armgcc targets, picked by the capabilities of the target (caps.h)
+# @author     Evren Kenanoglu
+# @date       4/26/2021
+#
+# Included by every <board>/<softdevice>/armgcc/Makefile after its CFLAGS, before Makefile.common.
+# Sources of features a SoftDevice cannot run are left out, the S112 targets get a broadcaster image.
+# "make footprint" prints the flash/RAM use of the image and of every program module,
+# host/footprint.sh runs it for all targets.
+
+APP_CAPS_OBSERVER := $(if $(filter -DS112 -DS113,$(CFLAGS)),0,1)
+APP_CAPS_USB      := $(if $(filter -DNRF52840_XXAA -DNRF52833_XXAA,$(CFLAGS)),1,0)
+
+# Program modules of every target, main.c is in the target source list
+APP_SRC_FILES += \
+  $(PROJ_DIR)/bleall.c \
+  $(PROJ_DIR)/boardinit.c \
+  $(PROJ_DIR)/bootprof.c \
+  $(PROJ_DIR)/cli.c \
+  $(PROJ_DIR)/configstore.c \
+  $(PROJ_DIR)/cpumon.c \
+  $(PROJ_DIR)/deepsleep.c \
+  $(PROJ_DIR)/energy.c \
+  $(PROJ_DIR)/metrics.c \
+  $(PROJ_DIR)/parameters.c \
+  $(PROJ_DIR)/phaseengine.c \
+  $(PROJ_DIR)/proto.c \
+  $(PROJ_DIR)/sensor.c \
+
+# Program modules fed by the scan
+ifeq ($(APP_CAPS_OBSERVER),1)
+APP_SRC_FILES += \
+  $(PROJ_DIR)/advqueue.c \
+  $(PROJ_DIR)/backoff.c \
+  $(PROJ_DIR)/bench.c \
+  $(PROJ_DIR)/capture.c \
+  $(PROJ_DIR)/coc.c \
+  $(PROJ_DIR)/harvest.c \
+  $(PROJ_DIR)/latency.c \
+  $(PROJ_DIR)/recpool.c \
+  $(PROJ_DIR)/rendezvous.c \
+  $(PROJ_DIR)/slot.c \
+  $(PROJ_DIR)/stream.c \
+  $(PROJ_DIR)/tune.c \
+
+endif
+
+SRC_FILES += $(APP_SRC_FILES)
+
+# SDK modules of the program
+SRC_FILES += \
+  $(SDK_ROOT)/components/libraries/bsp/bsp.c \
+  $(SDK_ROOT)/components/libraries/crc32/crc32.c \
+  $(SDK_ROOT)/components/libraries/fstorage/nrf_fstorage.c \
+  $(SDK_ROOT)/components/libraries/fstorage/nrf_fstorage_sd.c \
+  $(SDK_ROOT)/components/libraries/queue/nrf_queue.c \
+  $(SDK_ROOT)/components/libraries/cli/nrf_cli.c \
+  $(SDK_ROOT)/components/libraries/cli/rtt/nrf_cli_rtt.c \
+
+ifeq ($(APP_CAPS_OBSERVER),1)
+SRC_FILES += \
+  $(SDK_ROOT)/components/ble/nrf_ble_scan/nrf_ble_scan.c \
+
+endif
+
+ifeq ($(APP_CAPS_USB),1)
+SRC_FILES += \
+  $(SDK_ROOT)/components/libraries/usbd/app_usbd.c \
+  $(SDK_ROOT)/components/libraries/usbd/class/cdc/acm/app_usbd_cdc_acm.c \
+  $(SDK_ROOT)/components/libraries/usbd/app_usbd_core.c \
+  $(SDK_ROOT)/components/libraries/usbd/app_usbd_serial_num.c \
+  $(SDK_ROOT)/components/libraries/usbd/app_usbd_string_desc.c \
+  $(SDK_ROOT)/components/libraries/cli/cdc_acm/nrf_cli_cdc_acm.c \
+  $(SDK_ROOT)/integration/nrfx/legacy/nrf_drv_power.c \
+  $(SDK_ROOT)/modules/nrfx/drivers/src/nrfx_power.c \
+  $(SDK_ROOT)/modules/nrfx/drivers/src/nrfx_usbd.c \
+
+endif
+
+INC_FOLDERS += \
+  $(PROJ_DIR) \
+  $(SDK_ROOT)/components/libraries/bsp \
+  $(SDK_ROOT)/components/libraries/cli/rtt \
+  $(SDK_ROOT)/components/libraries/cli/cdc_acm \
+  $(SDK_ROOT)/components/ble/nrf_ble_scan \
+
+.PHONY: footprint
+
+# Flash (text + data) and RAM (data + bss) of the image, then of every program module
+footprint: default
+	@echo Footprint: $(PROJECT_NAME), observer $(APP_CAPS_OBSERVER), USB $(APP_CAPS_USB)
+	@$(SIZE) $(foreach target, $(TARGETS), $(OUTPUT_DIRECTORY)/$(target).out)
+	@$(SIZE) -t $(foreach target, $(TARGETS), $(foreach src, $(PROJ_DIR)/main.c $(APP_SRC_FILES), \
+	  $(OUTPUT_DIRECTORY)/$(target)/$(notdir $(src)).o))
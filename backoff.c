@@ -0,0 +1,133 @@
+/** @file       backoff.c
+ *  @brief      Slave sleep backoff while the master is absent
+ *  @author     Evren Kenanoglu
+ *  @date       4/12/2021
+ */
+#define FILE_BACKOFF_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "backoff.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+
+/** VARIABLES *****************************************************************/
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize a backoff instance
+ *
+ * @param backoff   Backoff instance
+ * @param config    Curve and ceiling, copied
+ */
+void backoffInit(tsBackoff *backoff, tsBackoffConfig const *config)
+{
+    memset(backoff, 0, sizeof(*backoff));
+    backoff->config   = *config;
+    backoff->sleep    = config->baseSleep;
+    backoff->maxSleep = config->baseSleep;
+}
+
+/**
+ * @brief Function to be called at the end of every scan
+ *
+ * @param detected Master was detected in the scan
+ *
+ * @details A detection snaps the sleep back to the base and ends a re-acquire window.
+ */
+void backoffScanEnd(tsBackoff *backoff, bool detected)
+{
+    uint64_t sleep;
+
+    if (detected)
+    {
+        if (backoff->sleep != backoff->config.baseSleep)
+        {
+            backoff->snapBacks++;
+        }
+        backoff->misses = 0;
+        backoff->sleep  = backoff->config.baseSleep;
+        backoff->kick   = 0;
+        return;
+    }
+
+    if (backoff->kick > 0)
+    {
+        backoff->kick--;
+    }
+
+    backoff->misses++;
+    if (backoff->misses <= backoff->config.threshold)
+    {
+        return;
+    }
+
+    sleep          = (uint64_t)backoff->sleep * backoff->config.multiplier / 256 + backoff->config.step;
+    backoff->sleep = (sleep > backoff->config.ceiling) ? backoff->config.ceiling : (uint32_t)sleep;
+    if (backoff->sleep > backoff->maxSleep)
+    {
+        backoff->maxSleep = backoff->sleep;
+    }
+}
+
+/**
+ * @brief Function to change the base sleep, a grown sleep is kept until the next detection
+ *
+ * @param sleep ms
+ */
+void backoffBaseSleepSet(tsBackoff *backoff, uint32_t sleep)
+{
+    if (backoff->sleep == backoff->config.baseSleep)
+    {
+        backoff->sleep = sleep;
+    }
+    backoff->config.baseSleep = sleep;
+}
+
+/**
+ * @brief Function to start a fast re-acquire window, for external events (button, sensor, host)
+ *
+ * @details The next kickCycles sleeps are kickSleep long. The backed off sleep is kept and used
+ *          again if the master is not found in the window.
+ */
+void backoffKick(tsBackoff *backoff)
+{
+    backoff->kick = backoff->config.kickCycles;
+    backoff->kicks++;
+}
+
+/**
+ * @brief Function to get the next sleep duration
+ *
+ * @return uint32_t ms
+ */
+uint32_t backoffSleepGet(tsBackoff *backoff)
+{
+    if (backoff->kick > 0)
+    {
+        return backoff->config.kickSleep;
+    }
+    return backoff->sleep;
+}
+
+/**@brief Function to print backoff state */
+void backoffReport(tsBackoff const *backoff)
+{
+    printf("BACKOFF misses=%lu sleep=%lu ms kick=%u max=%lu ms snapBacks=%lu kicks=%lu\n\r",
+           (unsigned long)backoff->misses,
+           (unsigned long)backoff->sleep,
+           backoff->kick,
+           (unsigned long)backoff->maxSleep,
+           (unsigned long)backoff->snapBacks,
+           (unsigned long)backoff->kicks);
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
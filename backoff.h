@@ -0,0 +1,72 @@
+/** @file       backoff.h
+ *  @brief      Slave sleep backoff while the master is absent
+ *  @author     Evren Kenanoglu
+ *  @date       4/12/2021
+ */
+#ifndef FILE_BACKOFF_H
+#define FILE_BACKOFF_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Backoff curve: after threshold misses, sleep = min(ceiling, sleep * multiplier / 256 + step)
+ *
+ * @details multiplier 256 and step > 0 is a linear curve, multiplier > 256 is exponential.
+ */
+typedef struct
+{
+    uint32_t baseSleep;  /**< ms, sleep while the master is around */
+    uint32_t ceiling;    /**< ms */
+    uint16_t multiplier; /**< 1/256 */
+    uint32_t step;       /**< ms */
+    uint8_t threshold;   /**< Misses in a row before the sleep grows */
+    uint32_t kickSleep;  /**< ms, sleep during a fast re-acquire window */
+    uint8_t kickCycles;  /**< Length of a fast re-acquire window in scan cycles */
+} tsBackoffConfig;
+
+/**
+ * @brief Backoff state
+ *
+ */
+typedef struct
+{
+    tsBackoffConfig config;
+    uint32_t misses; /**< Scans without the master in a row */
+    uint32_t sleep;  /**< ms, next sleep outside of a re-acquire window */
+    uint8_t kick;    /**< Remaining cycles of the re-acquire window */
+
+    /** Statistics **/
+    uint32_t snapBacks;  /**< Detections after the sleep had grown */
+    uint32_t kicks;
+    uint32_t maxSleep;
+} tsBackoff;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_BACKOFF_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void backoffInit(tsBackoff *backoff, tsBackoffConfig const *config);
+INTERFACE void backoffScanEnd(tsBackoff *backoff, bool detected);
+INTERFACE void backoffBaseSleepSet(tsBackoff *backoff, uint32_t sleep);
+INTERFACE void backoffKick(tsBackoff *backoff);
+INTERFACE uint32_t backoffSleepGet(tsBackoff *backoff);
+INTERFACE void backoffReport(tsBackoff const *backoff);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_BACKOFF_H
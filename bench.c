@@ -0,0 +1,465 @@
+/** @file       bench.c
+ *  @brief      Hot path benchmarks, DWT cycle counts of kernels with canned inputs, CSV summary and histograms
+ *  @author     Evren Kenanoglu
+ *  @date       4/24/2021
+ *
+ *  Every kernel runs BENCH_ITERATIONS samples per parameter. A sample is one call (batch 1, target) or
+ *  a batch of calls divided by the batch (host, where the clock is coarser than a kernel). The cost of
+ *  reading the clock is measured with an empty kernel first and taken off every sample.
+ *
+ *  Output, one CSV line each, clock counts per call:
+ *      BENCHINFO,<unit>,<batch>,<iterations>,<overhead>
+ *      BENCH,<kernel>,<param>,<samples>,<fails>,<min>,<mean>,<p50>,<p90>,<p99>,<max>
+ *      BENCHHIST,<kernel>,<param>,<bucket upper bound>,<count>     non-empty buckets only
+ *
+ *  The core kernels below have no SoftDevice calls and are built on target and on host
+ *  (host/benchhost.c), kernels bound to the SoftDevice are in main.c (BENCH_ENABLE).
+ *  Application interrupts are not held off, they show up in p99 and max, min and p50 are the stable figures.
+ */
+#define FILE_BENCH_C
+
+/** INCLUDES ******************************************************************/
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "nrf.h"
+#include "advqueue.h"
+#include "recpool.h"
+#include "phaseengine.h"
+#include "rendezvous.h"
+#include "proto.h"
+#include "slot.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define BENCH_RV_PERIOD_US ((SCAN_TIMEOUT + ADVERTISEMENT_TIMEOUT) * 1000) // Master cycle of the rendezvous kernel
+#define BENCH_RV_OFFSET_US (BENCH_RV_PERIOD_US / 4)                        // Master advertising event in its cycle
+
+#ifndef BENCH_CLOCK_UNIT
+#define BENCH_CLOCK_UNIT "cycles" // DWT->CYCCNT, the host stub nrf.h counts ns
+#endif
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+#define BENCH_CLOCK() (DWT->CYCCNT)
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void benchMeasure(tsBenchKernel const *kernel, uint8_t param, tsBenchResult *result);
+static void benchPrint(tsBenchKernel const *kernel, uint8_t param, tsBenchResult const *result);
+static uint32_t benchBucketIndex(uint32_t count);
+static uint32_t benchBucketUpper(uint32_t index);
+
+static bool benchNullRun(void *context, uint8_t param);
+static bool benchAdvRecordFillRun(void *context, uint8_t param);
+#if ADV_QUEUE_ENABLE
+static void benchAdvQueuePrepare(void *context, uint8_t param);
+static bool benchAdvQueuePutRun(void *context, uint8_t param);
+#endif
+static bool benchProtoEncodeRun(void *context, uint8_t param);
+static bool benchProtoDecodeRun(void *context, uint8_t param);
+static bool benchSlotDelayRun(void *context, uint8_t param);
+static bool benchPhaseStepRun(void *context, uint8_t param);
+static bool benchRendezvousRun(void *context, uint8_t param);
+
+static void benchHookTimer(void *context, uint32_t duration);
+static void benchHookRadio(void *context);
+
+/** VARIABLES *****************************************************************/
+
+static uint16_t benchBatch = 1;
+static uint32_t benchOverhead;
+static uint32_t benchSamples[BENCH_ITERATIONS];
+static uint32_t benchHistogram[BENCH_HIST_BUCKETS];
+
+/**< Recorded slave advertising data, flags, complete local name, manufacturer data (company, 4 bytes) */
+static uint8_t const benchAdvRecorded[BENCH_ADV_SIZE_MAX] =
+    {
+        0x02, 0x01, 0x06,
+        0x13, 0x09, 'N', 'O', 'R', 'D', 'I', 'C', '_', 'E', 'V', 'R', 'E', 'N', '_', 'S', 'L', 'A', 'V', 'E',
+        0x07, 0xFF, 0x59, 0x00, 0x2A, 0x00, 0x10, 0x27,
+};
+static uint8_t const benchAdvAddr[BLE_GAP_ADDR_LEN] = {0x3C, 0x71, 0xBF, 0x0A, 0x62, 0xD4};
+
+static uint8_t benchAdvData[BENCH_ADV_SIZE_MAX];
+static ble_gap_evt_adv_report_t benchAdvReport;
+static tsAdvRecord benchRecord;
+
+static tsProtoSchedule const benchSchedule =
+    {
+        .command  = eProtoCmdReport,
+        .sequence = 0x1234,
+        .period   = BENCH_RV_PERIOD_US,
+        .slots    = {.seed = 0xBEEF, .offset = SLOT_OFFSET_MS, .count = SLOT_COUNT, .length = SLOT_LENGTH_MS, .frameCycles = SLOT_FRAME_CYCLES},
+};
+static uint8_t benchScheduleBuffer[PROTO_SCHEDULE_SIZE];
+
+static tsPhaseHooks const benchHooks =
+    {
+        .timerStart = benchHookTimer,
+        .scanStart  = benchHookRadio,
+        .scanStop   = benchHookRadio,
+        .advStart   = benchHookRadio,
+        .advStop    = benchHookRadio,
+};
+static tsProgramParams benchPhaseParams[eRoleCount];
+static tsPhaseEngine benchEngines[eRoleCount];
+
+static tsRendezvous benchRendezvous;
+static uint32_t benchRendezvousNow;   /**< Slave scan start, us */
+static uint32_t benchRendezvousEvent; /**< Master advertising event, us */
+
+/**< Kernels without SoftDevice calls, same on target and host */
+static tsBenchKernel const benchCoreKernels[] =
+    {
+        //  name                  run                    prepare               context                      first                last                 step
+        {"advRecordFill",       benchAdvRecordFillRun, NULL,                 NULL,                        BENCH_ADV_SIZE_MIN,  BENCH_ADV_SIZE_MAX,  BENCH_ADV_SIZE_STEP},
+#if ADV_QUEUE_ENABLE
+        {"advQueuePut",         benchAdvQueuePutRun,   benchAdvQueuePrepare, NULL,                        BENCH_ADV_SIZE_MIN,  BENCH_ADV_SIZE_MAX,  BENCH_ADV_SIZE_STEP},
+#endif
+        {"protoScheduleEncode", benchProtoEncodeRun,   NULL,                 NULL,                        0,                   0,                   0},
+        {"protoScheduleDecode", benchProtoDecodeRun,   NULL,                 NULL,                        PROTO_SCHEDULE_SIZE, PROTO_SCHEDULE_SIZE, 0},
+        {"slotDelayGet",        benchSlotDelayRun,     NULL,                 NULL,                        0,                   0,                   0},
+        {"phaseStepMaster",     benchPhaseStepRun,     NULL,                 &benchEngines[eRoleMaster],  eModeSleep,          eModeAdvertising,    1},
+        {"phaseStepSlave",      benchPhaseStepRun,     NULL,                 &benchEngines[eRoleSlave],   eModeSleep,          eModeAdvertising,    1},
+        {"rendezvousCycle",     benchRendezvousRun,    NULL,                 &benchRendezvous,            0,                   0,                   0},
+};
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to start the clock, calibrate its cost and print the run header
+ *
+ * @param batch Calls per sample of kernels without prepare(), 1 on target
+ */
+void benchInit(uint16_t batch)
+{
+    tsBenchKernel const nullKernel = {.name = "null", .run = benchNullRun};
+    tsBenchResult result;
+    tsRendezvousConfig const rvConfig =
+        {
+            .period          = BENCH_RV_PERIOD_US,
+            .jitter          = RENDEZVOUS_JITTER_MS * 1000,
+            .guard           = RENDEZVOUS_GUARD_MS * 1000,
+            .periodTolerance = RENDEZVOUS_PERIOD_TOLERANCE_US,
+            .syncTolerance   = RENDEZVOUS_SYNC_TOLERANCE_US,
+            .maxMisses       = RENDEZVOUS_MAX_MISSES,
+        };
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Not reset, the CPU monitor may be using it
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (uint8_t role = 0; role < eRoleCount; role++)
+    {
+        memset(&benchPhaseParams[role], 0, sizeof(benchPhaseParams[role]));
+        phaseEngineInit(&benchEngines[role], role, &benchPhaseParams[role], &benchHooks, NULL);
+    }
+    rendezvousInit(&benchRendezvous, &rvConfig);
+    benchRendezvousNow   = 0;
+    benchRendezvousEvent = BENCH_RV_OFFSET_US;
+    protoScheduleEncode(&benchSchedule, benchScheduleBuffer);
+
+    benchBatch    = 1;
+    benchOverhead = 0;
+    benchMeasure(&nullKernel, 0, &result);
+    benchOverhead = result.min; // Clock reads and the kernel call
+    benchBatch    = MAX(batch, 1);
+
+    printf("BENCHINFO,%s,%u,%u,%" PRIu32 "\n\r", BENCH_CLOCK_UNIT, benchBatch, BENCH_ITERATIONS, benchOverhead);
+    printf("BENCH,kernel,param,samples,fails,min,mean,p50,p90,p99,max\n\r");
+}
+
+/**
+ * @brief Function to measure and print kernels
+ *
+ * @param kernels   Kernel table
+ * @param count     Kernels in the table
+ */
+void benchRun(tsBenchKernel const *kernels, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        tsBenchKernel const *kernel = &kernels[i];
+        uint8_t param               = kernel->paramFirst;
+
+        while (1)
+        {
+            tsBenchResult result;
+
+            benchMeasure(kernel, param, &result);
+            benchPrint(kernel, param, &result);
+
+            if (kernel->paramStep == 0 || param + kernel->paramStep > kernel->paramLast)
+            {
+                break;
+            }
+            param += kernel->paramStep;
+        }
+    }
+}
+
+/**
+ * @brief Function to get the kernels without SoftDevice calls
+ *
+ * @param count         Kernels in the table
+ * @return tsBenchKernel const* Kernel table
+ */
+tsBenchKernel const *benchCoreKernelsGet(uint8_t *count)
+{
+    *count = sizeof(benchCoreKernels) / sizeof(benchCoreKernels[0]);
+    return benchCoreKernels;
+}
+
+/**
+ * @brief Function to build a canned advertising report from the recorded slave advertising data
+ *
+ * @param size      Advertising data length, BENCH_ADV_SIZE_MIN to BENCH_ADV_SIZE_MAX
+ * @param report    Report, its data stays valid until the next call
+ *
+ * @details AD structures that fit are copied whole, the one crossing the end is shortened (a
+ *          shortened complete name becomes a short name). A single byte left over is an early end (0).
+ */
+void benchAdvReportGet(uint8_t size, ble_gap_evt_adv_report_t *report)
+{
+    uint8_t offset = 0;
+
+    size = MIN(size, BENCH_ADV_SIZE_MAX);
+    while (offset < size)
+    {
+        uint8_t length = benchAdvRecorded[offset];
+        uint8_t left   = size - offset;
+
+        if (left < 2)
+        {
+            benchAdvData[offset] = 0;
+            break;
+        }
+        if (1 + length <= left)
+        {
+            memcpy(&benchAdvData[offset], &benchAdvRecorded[offset], 1 + length);
+            offset += 1 + length;
+            continue;
+        }
+
+        memcpy(&benchAdvData[offset], &benchAdvRecorded[offset], left);
+        benchAdvData[offset] = left - 1;
+        if (benchAdvData[offset + 1] == BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME)
+        {
+            benchAdvData[offset + 1] = BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME;
+        }
+        break;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->type.scannable      = 1;
+    report->peer_addr.addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+    memcpy(report->peer_addr.addr, benchAdvAddr, BLE_GAP_ADDR_LEN);
+    report->primary_phy = BLE_GAP_PHY_1MBPS;
+    report->rssi        = -70; // Below RSSI_FILTER_VALUE, the program does not act on it
+    report->ch_index    = 37;
+    report->data.p_data = benchAdvData;
+    report->data.len    = size;
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief Samples of one kernel and parameter, kept sorted for the percentiles */
+static void benchMeasure(tsBenchKernel const *kernel, uint8_t param, tsBenchResult *result)
+{
+    uint16_t calls = (kernel->prepare != NULL) ? 1 : benchBatch;
+    uint64_t total = 0;
+
+    memset(result, 0, sizeof(*result));
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        uint32_t start;
+        uint32_t count;
+        uint32_t j;
+
+        if (kernel->prepare != NULL)
+        {
+            kernel->prepare(kernel->context, param);
+        }
+
+        start = BENCH_CLOCK();
+        for (uint16_t c = 0; c < calls; c++)
+        {
+            if (!kernel->run(kernel->context, param))
+            {
+                result->fails++;
+            }
+        }
+        count = BENCH_CLOCK() - start;
+
+        count = (count > benchOverhead) ? count - benchOverhead : 0;
+        count /= calls;
+        total += count;
+
+        for (j = i; j > 0 && benchSamples[j - 1] > count; j--)
+        {
+            benchSamples[j] = benchSamples[j - 1];
+        }
+        benchSamples[j] = count;
+    }
+
+    result->samples = BENCH_ITERATIONS;
+    result->fails /= calls;
+    result->min  = benchSamples[0];
+    result->mean = (uint32_t)(total / BENCH_ITERATIONS);
+    result->p50  = benchSamples[(BENCH_ITERATIONS - 1) * 50 / 100];
+    result->p90  = benchSamples[(BENCH_ITERATIONS - 1) * 90 / 100];
+    result->p99  = benchSamples[(BENCH_ITERATIONS - 1) * 99 / 100];
+    result->max  = benchSamples[BENCH_ITERATIONS - 1];
+}
+
+/**@brief Summary line and the histogram of the samples left by benchMeasure() */
+static void benchPrint(tsBenchKernel const *kernel, uint8_t param, tsBenchResult const *result)
+{
+    printf("BENCH,%s,%u,%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n\r",
+           kernel->name, param, result->samples, result->fails,
+           result->min, result->mean, result->p50, result->p90, result->p99, result->max);
+
+    memset(benchHistogram, 0, sizeof(benchHistogram));
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        benchHistogram[benchBucketIndex(benchSamples[i])]++;
+    }
+    for (uint32_t i = 0; i < BENCH_HIST_BUCKETS; i++)
+    {
+        if (benchHistogram[i] != 0)
+        {
+            printf("BENCHHIST,%s,%u,%" PRIu32 ",%" PRIu32 "\n\r", kernel->name, param, benchBucketUpper(i), benchHistogram[i]);
+        }
+    }
+}
+
+/**
+ * @brief Histogram bucket of a count, log2 octaves split in linear sub-buckets (cpumon.c)
+ */
+static uint32_t benchBucketIndex(uint32_t count)
+{
+    uint32_t msb;
+
+    if (count < (1UL << BENCH_HIST_SUB_BUCKET_BITS))
+    {
+        return count;
+    }
+
+    msb = 31 - __CLZ(count);
+    if (msb > BENCH_HIST_OCTAVES + BENCH_HIST_SUB_BUCKET_BITS - 1)
+    {
+        return BENCH_HIST_BUCKETS - 1;
+    }
+
+    return ((msb - BENCH_HIST_SUB_BUCKET_BITS + 1) << BENCH_HIST_SUB_BUCKET_BITS) + ((count >> (msb - BENCH_HIST_SUB_BUCKET_BITS)) & ((1UL << BENCH_HIST_SUB_BUCKET_BITS) - 1));
+}
+
+/**
+ * @brief Highest count that falls into a histogram bucket
+ */
+static uint32_t benchBucketUpper(uint32_t index)
+{
+    uint32_t octave = index >> BENCH_HIST_SUB_BUCKET_BITS;
+    uint32_t sub    = index & ((1UL << BENCH_HIST_SUB_BUCKET_BITS) - 1);
+
+    if (octave == 0)
+    {
+        return index;
+    }
+    return (((1UL << BENCH_HIST_SUB_BUCKET_BITS) + sub + 1) << (octave - 1)) - 1;
+}
+
+/**@brief Empty kernel, cost of the measurement itself */
+static bool benchNullRun(void *context, uint8_t param)
+{
+    return true;
+}
+
+/**@brief Report copy and single pass AD parse, the work done for every report in SoftDevice interrupt */
+static bool benchAdvRecordFillRun(void *context, uint8_t param)
+{
+    if (benchAdvReport.data.len != param)
+    {
+        benchAdvReportGet(param, &benchAdvReport); // First call with this parameter
+    }
+    advRecordFill(&benchRecord, &benchAdvReport);
+    return benchRecord.len == param;
+}
+
+#if ADV_QUEUE_ENABLE
+/**@brief Records of the last sample are handled first, every sample finds the queue empty */
+static void benchAdvQueuePrepare(void *context, uint8_t param)
+{
+    app_sched_execute();
+    benchAdvReportGet(param, &benchAdvReport);
+}
+
+/**@brief Pool block, record fill and queue slot, bleEventHandler() for an advertising report */
+static bool benchAdvQueuePutRun(void *context, uint8_t param)
+{
+    return advQueuePut(&benchAdvReport);
+}
+#endif
+
+static bool benchProtoEncodeRun(void *context, uint8_t param)
+{
+    return protoScheduleEncode(&benchSchedule, benchScheduleBuffer) == PROTO_SCHEDULE_SIZE;
+}
+
+static bool benchProtoDecodeRun(void *context, uint8_t param)
+{
+    tsProtoSchedule schedule;
+
+    return protoScheduleDecode(benchScheduleBuffer, param, &schedule);
+}
+
+static bool benchSlotDelayRun(void *context, uint8_t param)
+{
+    uint32_t delay;
+
+    return slotDelayGet(&benchSchedule.slots, benchAdvAddr, &delay);
+}
+
+/**@brief One transition from the state of the parameter with empty hooks, the slave has seen the master */
+static bool benchPhaseStepRun(void *context, uint8_t param)
+{
+    tsPhaseEngine *engine = (tsPhaseEngine *)context;
+
+    engine->params->programStatus         = param;
+    engine->params->deviceDetectionStatus = eDeviceDetected;
+    phaseEngineStep(engine);
+    return engine->params->programStatus != param; // Master has no sleep state
+}
+
+/**@brief One slave scan window and the sleep up to the next one, master events on an exact period */
+static bool benchRendezvousRun(void *context, uint8_t param)
+{
+    tsRendezvous *rv = (tsRendezvous *)context;
+    uint32_t now     = benchRendezvousNow;
+    uint32_t end;
+
+    rendezvousScanStart(rv, now);
+    end = now + rendezvousScanDurationGet(rv, SCAN_TIMEOUT) * 1000;
+    while ((int32_t)(benchRendezvousEvent - now) < 0)
+    {
+        benchRendezvousEvent += BENCH_RV_PERIOD_US;
+    }
+    if ((int32_t)(benchRendezvousEvent - end) < 0)
+    {
+        rendezvousDetection(rv, benchRendezvousEvent);
+    }
+    rendezvousScanEnd(rv, end);
+    benchRendezvousNow = end + rendezvousSleepDurationGet(rv, end, SLEEP_DURATION) * 1000;
+    return true;
+}
+
+static void benchHookTimer(void *context, uint32_t duration)
+{
+}
+
+static void benchHookRadio(void *context)
+{
+}
@@ -0,0 +1,82 @@
+/** @file       bench.h
+ *  @brief      Hot path benchmarks, DWT cycle counts of kernels with canned inputs, CSV summary and histograms
+ *  @author     Evren Kenanoglu
+ *  @date       4/24/2021
+ */
+#ifndef FILE_BENCH_H
+#define FILE_BENCH_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+#include "ble_gap.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define BENCH_HIST_SUB_BUCKET_BITS 2 // Same buckets as the CPU monitor histogram
+#define BENCH_HIST_OCTAVES         24
+#define BENCH_HIST_BUCKETS         ((BENCH_HIST_OCTAVES + 1) << BENCH_HIST_SUB_BUCKET_BITS)
+
+#define BENCH_ADV_SIZE_MIN  3  // Canned advertising reports, flags only
+#define BENCH_ADV_SIZE_MAX  31 // BLE_GAP_ADV_SET_DATA_SIZE_MAX, legacy advertising
+#define BENCH_ADV_SIZE_STEP 4
+
+/** TYPEDEFS ******************************************************************/
+
+typedef bool (*tpfBenchRun)(void *context, uint8_t param);      // Timed, false: the call failed
+typedef void (*tpfBenchPrepare)(void *context, uint8_t param);  // Untimed, before every sample
+
+/**
+ * @brief One kernel, run for every parameter from paramFirst to paramLast
+ *
+ */
+typedef struct
+{
+    char const *name;
+    tpfBenchRun run;
+    tpfBenchPrepare prepare; /**< NULL: the kernel needs no state between samples */
+    void *context;
+    uint8_t paramFirst;
+    uint8_t paramLast;
+    uint8_t paramStep; /**< 0: paramFirst only */
+} tsBenchKernel;
+
+/**
+ * @brief Result of one kernel and parameter, clock counts per call
+ *
+ */
+typedef struct
+{
+    uint32_t samples;
+    uint32_t fails;
+    uint32_t min;
+    uint32_t mean;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t max;
+} tsBenchResult;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_BENCH_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void benchInit(uint16_t batch);
+INTERFACE void benchRun(tsBenchKernel const *kernels, uint8_t count);
+INTERFACE tsBenchKernel const *benchCoreKernelsGet(uint8_t *count);
+#if SCANNING_ENABLE
+INTERFACE void benchAdvReportGet(uint8_t size, ble_gap_evt_adv_report_t *report);
+#endif
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_BENCH_H
@@ -49,6 +49,9 @@ void advertising_init(tsBleParams *params)
     memset(&params->m_adv_params, 0, sizeof(params->m_adv_params));
 
     params->m_adv_params.properties.type = BLE_GAP_ADV_TYPE_NONCONNECTABLE_SCANNABLE_UNDIRECTED; //BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED;
+#if STREAM_ENABLE
+    params->m_adv_params.properties.type = BLE_GAP_ADV_TYPE_CONNECTABLE_SCANNABLE_UNDIRECTED; // Streaming peer connects
+#endif
     params->m_adv_params.p_peer_addr     = NULL;                                                 // Undirected advertisement.
     params->m_adv_params.filter_policy   = BLE_GAP_ADV_FP_ANY;
     params->m_adv_params.interval        = NON_CONNECTABLE_ADV_INTERVAL;
@@ -120,10 +123,44 @@ void ble_stack_init(tsBleParams *params)
     err_code           = nrf_sdh_ble_default_cfg_set(APP_BLE_CONN_CFG_TAG, &ram_start);
     APP_ERROR_CHECK(err_code);
 
+#if STREAM_ENABLE
+    // Notifications queued per connection event, the default of 1 leaves most of a long event unused
+    ble_cfg_t bleCfg;
+
+    memset(&bleCfg, 0, sizeof(bleCfg));
+    bleCfg.conn_cfg.conn_cfg_tag                            = APP_BLE_CONN_CFG_TAG;
+    bleCfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = STREAM_HVN_QUEUE_SIZE;
+    err_code = sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &bleCfg, ram_start);
+    APP_ERROR_CHECK(err_code);
+#endif
+
+#if COC_ENABLE
+    // One bulk channel per link, SDU queues of coc.c
+    memset(&bleCfg, 0, sizeof(bleCfg));
+    bleCfg.conn_cfg.conn_cfg_tag                        = APP_BLE_CONN_CFG_TAG;
+    bleCfg.conn_cfg.params.l2cap_conn_cfg.rx_mps        = COC_MPS;
+    bleCfg.conn_cfg.params.l2cap_conn_cfg.tx_mps        = COC_MPS;
+    bleCfg.conn_cfg.params.l2cap_conn_cfg.rx_queue_size = COC_RX_BUFFERS;
+    bleCfg.conn_cfg.params.l2cap_conn_cfg.tx_queue_size = COC_TX_QUEUE;
+    bleCfg.conn_cfg.params.l2cap_conn_cfg.ch_count      = 1;
+    err_code = sd_ble_cfg_set(BLE_CONN_CFG_L2CAP, &bleCfg, ram_start);
+    APP_ERROR_CHECK(err_code);
+#endif
+
     // Enable BLE stack.
     err_code = nrf_sdh_ble_enable(&ram_start);
     APP_ERROR_CHECK(err_code);
 
+#if STREAM_ENABLE
+    // Connection events run on while there is data, up to NRF_SDH_BLE_GAP_EVENT_LENGTH or the next event
+    ble_opt_t bleOpt;
+
+    memset(&bleOpt, 0, sizeof(bleOpt));
+    bleOpt.common_opt.conn_evt_ext.enable = 1;
+    err_code = sd_ble_opt_set(BLE_COMMON_OPT_CONN_EVT_EXT, &bleOpt);
+    APP_ERROR_CHECK(err_code);
+#endif
+
 }
 
 /**
@@ -173,6 +210,11 @@ ret_code_t bleAdvUpdateData(tsBleParams *params, void *updateData, uint32_t upda
     }
     uint8_t flags = BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED;
 
+    if (params->m_adv_params.properties.type == BLE_GAP_ADV_TYPE_CONNECTABLE_SCANNABLE_UNDIRECTED)
+    {
+        flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE; // Listed by phones
+    }
+
     ble_advdata_t newAdvData;
     ble_advdata_manuf_data_t manuf_specific_data;
 
@@ -205,6 +247,65 @@ ret_code_t bleAdvUpdateData(tsBleParams *params, void *updateData, uint32_t upda
     return errCode;
 }
 
+/**
+ * @brief Function to switch between connectable and non-connectable advertising
+ * 
+ * @details Applied by the next bleAdvUpdateData(). Connectable advertising is refused by the SoftDevice
+ *          while the peripheral link is in use.
+ * 
+ * @param params        BLE advertising parameters pointer
+ * @param connectable   true: connectable scannable, false: non-connectable scannable
+ */
+void bleAdvConnectableSet(tsBleParams *params, bool connectable)
+{
+    params->m_adv_params.properties.type = connectable ? BLE_GAP_ADV_TYPE_CONNECTABLE_SCANNABLE_UNDIRECTED
+                                                       : BLE_GAP_ADV_TYPE_NONCONNECTABLE_SCANNABLE_UNDIRECTED;
+}
+
+/**
+ * @brief Function to set the scan response data
+ * 
+ * @details Manufacturer specific data only. Applied by the next bleAdvUpdateData(), has to be called
+ *          while not advertising.
+ * 
+ * @param params            BLE advertising parameters pointer
+ * @param scanRspData       Manufacturer specific data, NULL for no scan response data
+ * @param scanRspDataSize   Data size
+ * 
+ * @return ret_code_t       returns error code
+ */
+ret_code_t bleAdvScanRspSet(tsBleParams *params, void *scanRspData, uint32_t scanRspDataSize)
+{
+    ret_code_t errCode;
+    ble_advdata_t scanRsp;
+    ble_advdata_manuf_data_t manuf_specific_data;
+
+    if (scanRspData == NULL)
+    {
+        params->m_adv_data.scan_rsp_data.p_data = NULL;
+        params->m_adv_data.scan_rsp_data.len    = 0;
+        return NRF_SUCCESS;
+    }
+
+    memset(&scanRsp, 0, sizeof(scanRsp));
+
+    manuf_specific_data.company_identifier = APP_COMPANY_IDENTIFIER;
+    manuf_specific_data.data.p_data        = (uint8_t *)scanRspData;
+    manuf_specific_data.data.size          = scanRspDataSize;
+
+    scanRsp.name_type             = BLE_ADVDATA_NO_NAME;
+    scanRsp.p_manuf_specific_data = &manuf_specific_data;
+
+    params->m_adv_data.scan_rsp_data.p_data = params->m_enc_scanrsp;
+    params->m_adv_data.scan_rsp_data.len    = sizeof(params->m_enc_scanrsp);
+
+    errCode = ble_advdata_encode(&scanRsp, params->m_adv_data.scan_rsp_data.p_data, &params->m_adv_data.scan_rsp_data.len);
+    VERIFY_SUCCESS(errCode);
+
+    return errCode;
+}
+
+#if SCANNING_ENABLE
 /**
  * @brief Function to Initialize BLE Scanning
  * 
@@ -279,6 +380,7 @@ ret_code_t bleScanFiltersDisable(tsBleScanParams *params)
     errCode = nrf_ble_scan_filters_disable(params->scanModule);
     return errCode;
 }
+#endif
 
 /**@brief Function for the GAP initialization.
  *
@@ -298,12 +400,28 @@ void gap_params_init(const char *deviceName)
                                           (const uint8_t *)deviceName,
                                           strlen(deviceName));
     APP_ERROR_CHECK(err_code);
+
+#if STREAM_ENABLE
+    memset(&gap_conn_params, 0, sizeof(gap_conn_params));
+
+    gap_conn_params.min_conn_interval = STREAM_MIN_CONN_INTERVAL;
+    gap_conn_params.max_conn_interval = STREAM_MAX_CONN_INTERVAL;
+    gap_conn_params.slave_latency     = SLAVE_LATENCY;
+    gap_conn_params.conn_sup_timeout  = STREAM_CONN_SUP_TIMEOUT;
+
+    err_code = sd_ble_gap_ppcp_set(&gap_conn_params);
+    APP_ERROR_CHECK(err_code);
+#endif
 }
 
-/**@brief Function for initializing the GATT module. */
+/**@brief Function for initializing the GATT module.
+ *
+ * @details ATT MTU (NRF_SDH_BLE_GATT_MAX_MTU_SIZE) and data length (NRF_SDH_BLE_GAP_DATA_LENGTH) are
+ *          negotiated by nrf_ble_gatt on every connection, results go to params->gattEventHandler.
+ */
 void gattInit(tsBleParams *params)
 {
-    ret_code_t err_code = nrf_ble_gatt_init(params->gatt, NULL);
+    ret_code_t err_code = nrf_ble_gatt_init(params->gatt, params->gattEventHandler);
     APP_ERROR_CHECK(err_code);
 }
 
@@ -15,7 +15,9 @@
 #include "ble_advdata.h"
 #include "boardinit.h"
 #include "nrf_ble_gatt.h"
+#if SCANNING_ENABLE
 #include "nrf_ble_scan.h"
+#endif
 #include "ble_gap.h"
 
 /** CONSTANTS *****************************************************************/
@@ -94,6 +96,7 @@ typedef enum
     eTxPower4Dbm,
 }teBleAdvTxPower;
 
+#if SCANNING_ENABLE
 /**
  * @brief BLE Scan Parameters
  * 
@@ -111,6 +114,7 @@ typedef struct
     uint8_t filterType;
     const void *filter;
 }tsBleScanFilters;
+#endif
 
 
 /**
@@ -122,11 +126,13 @@ typedef struct
     uint8_t bleAdvStatus;
     uint8_t m_adv_handle;
     uint8_t m_enc_advdata[BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+    uint8_t m_enc_scanrsp[BLE_GAP_ADV_SET_DATA_SIZE_MAX];
     ble_gap_adv_params_t m_adv_params;
     ble_gap_adv_data_t m_adv_data;
     ble_advdata_t advdata;
     int8_t txPower;
     nrf_ble_gatt_t *gatt;
+    nrf_ble_gatt_evt_handler_t gattEventHandler; /**< ATT MTU and data length updates, NULL: none */
     void (*bleEventHandler)(void);
 }tsBleParams;
 
@@ -161,7 +167,10 @@ INTERFACE void gap_params_init(const char *deviceName);
 INTERFACE ret_code_t bleAdvertisingStart(tsBleParams *params);
 INTERFACE ret_code_t bleAdvertisingStop(tsBleParams *params);
 INTERFACE ret_code_t bleAdvUpdateData(tsBleParams *params, void *updateData, uint32_t sizeofData);
+INTERFACE ret_code_t bleAdvScanRspSet(tsBleParams *params, void *scanRspData, uint32_t scanRspDataSize);
+INTERFACE void bleAdvConnectableSet(tsBleParams *params, bool connectable);
 
+#if SCANNING_ENABLE
 INTERFACE ret_code_t bleScanInit(tsBleScanParams *params);
 INTERFACE ret_code_t bleScanStart(tsBleScanParams *params);
 INTERFACE void bleScanStop(tsBleScanParams *params);
@@ -170,6 +179,7 @@ INTERFACE void bleScanStop(tsBleScanParams *params);
 INTERFACE ret_code_t bleScanFilterSet(tsBleScanParams *params, tsBleScanFilters *paramsFilter);
 INTERFACE ret_code_t bleScanFiltersEnable(tsBleScanParams *params);
 INTERFACE ret_code_t bleScanFiltersDisable(tsBleScanParams *params);
+#endif
 INTERFACE ret_code_t sdEnable();
 INTERFACE ret_code_t sdDisable();
 
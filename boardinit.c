@@ -27,7 +27,11 @@
 {
     ret_code_t err_code = NRF_LOG_INIT(NULL);
     APP_ERROR_CHECK(err_code);
+}
 
+/**@brief Function for initializing log backends, logs are buffered until then. */
+ void log_backends_init(void)
+{
     NRF_LOG_DEFAULT_BACKENDS_INIT();
 }
 
@@ -39,6 +43,13 @@
 }
 
 
+/**@brief Function for initializing buttons, BSP_EVENT_KEY_x events are passed to the handler. */
+ void buttons_init(bsp_event_callback_t handler)
+{
+    ret_code_t err_code = bsp_init(BSP_INIT_BUTTONS, handler);
+    APP_ERROR_CHECK(err_code);
+}
+
 /**@brief Function for initializing timers. */
  void timers_init(void)
 {
@@ -56,16 +67,36 @@
     APP_ERROR_CHECK(err_code);
 }
 
+/**@brief Function for initializing the event scheduler. */
+void scheduler_init(void)
+{
+    APP_SCHED_INIT(SCHED_MAX_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
+}
+
 /**
- * @brief boardInit initilizes logs, leds, timers and power management
+ * @brief boardInit initilizes logs, leds, timers, power management and scheduler
  * 
+ * @details With BOOT_FAST_START log backends and LEDs are left to boardInitDeferred().
  */
 void boardInit(void)
 {
     log_init();
-    leds_init();
     timers_init();
     power_management_init();
+    scheduler_init();
+#if !BOOT_FAST_START
+    boardInitDeferred();
+#endif
+}
+
+/**
+ * @brief Board init that is not needed for the first scan: log backends and LEDs
+ * 
+ */
+void boardInitDeferred(void)
+{
+    log_backends_init();
+    leds_init();
 }
 
 
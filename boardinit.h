@@ -14,6 +14,8 @@
 #include "bsp.h"
 #include "nrf_pwr_mgmt.h"
 #include "app_timer.h"
+#include "app_scheduler.h"
+#include "parameters.h"
 
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
@@ -35,10 +37,14 @@
 /** FUNCTIONS *****************************************************************/
 
 INTERFACE void log_init();
+INTERFACE void log_backends_init();
 INTERFACE void timers_init();
 INTERFACE void leds_init();
+INTERFACE void buttons_init(bsp_event_callback_t handler);
 INTERFACE void power_management_init();
+INTERFACE void scheduler_init();
 INTERFACE void boardInit();
+INTERFACE void boardInitDeferred();
 
 #undef INTERFACE // Should not let this roam free
 
@@ -0,0 +1,122 @@
+/** @file       bootprof.c
+ *  @brief      Boot time profiling, timestamps of init stages from main to the first scan
+ *  @author     Evren Kenanoglu
+ *  @date       4/7/2021
+ */
+#define FILE_BOOTPROF_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "bootprof.h"
+
+/** CONSTANTS *****************************************************************/
+#define BOOT_PROF_CORE_CLOCK_MHZ  64
+#define BOOT_PROF_TICK_FREQUENCY  (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+static tsBootProfParams bootProfParams;
+
+static const char *const bootProfStageNames[eBootStageCount] =
+    {
+        "main",
+        "config",
+        "board",
+        "engine",
+        "softdevice",
+        "gap",
+        "gatt",
+        "advertising",
+        "scanInit",
+        "engineStart",
+        "firstScan",
+        "deferred",
+};
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to start boot profiling, first call in main
+ *
+ * @details Time from reset to main (startup code, .data/.bss init) is not covered.
+ */
+void bootProfInit(void)
+{
+    memset(&bootProfParams, 0, sizeof(bootProfParams));
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    bootProfMark(eBootStageMain);
+}
+
+/**
+ * @brief Function to mark the end of a boot stage, only the first mark of a stage is kept
+ *
+ * @param stage Boot stage (teBootStages)
+ */
+void bootProfMark(uint8_t stage)
+{
+    if (stage >= eBootStageCount || (bootProfParams.marked & (1UL << stage)))
+    {
+        return;
+    }
+
+    bootProfParams.cycles[stage] = DWT->CYCCNT;
+    bootProfParams.ticks[stage]  = app_timer_cnt_get();
+    bootProfParams.marked |= (1UL << stage);
+}
+
+/**
+ * @brief Function to get time from main to the end of a stage
+ *
+ * @param stage     Boot stage (teBootStages)
+ * @return uint32_t us, 0 if the stage is not marked yet
+ */
+uint32_t bootProfStageGet(uint8_t stage)
+{
+    uint32_t activeUs;
+
+    if (!(bootProfParams.marked & (1UL << stage)))
+    {
+        return 0;
+    }
+
+    if (stage <= eBootStageEngineStart)
+    {
+        return (bootProfParams.cycles[stage] - bootProfParams.cycles[eBootStageMain]) / BOOT_PROF_CORE_CLOCK_MHZ;
+    }
+
+    // CPU sleeps after the engine start, continue on the RTC
+    activeUs = (bootProfParams.cycles[eBootStageEngineStart] - bootProfParams.cycles[eBootStageMain]) / BOOT_PROF_CORE_CLOCK_MHZ;
+    return activeUs + (uint32_t)((uint64_t)app_timer_cnt_diff_compute(bootProfParams.ticks[stage], bootProfParams.ticks[eBootStageEngineStart]) * 1000000 / BOOT_PROF_TICK_FREQUENCY);
+}
+
+/**
+ * @brief Function to print the end of each marked stage (us from main)
+ *
+ * @details Stages are printed as timestamps, not durations, because BOOT_FAST_START moves
+ *          some stages behind the first scan.
+ */
+void bootProfReport(void)
+{
+    printf("BOOT %s:", BOOT_FAST_START ? "fast" : "normal");
+    for (uint8_t i = eBootStageMain + 1; i < eBootStageCount; i++)
+    {
+        if (bootProfParams.marked & (1UL << i))
+        {
+            printf(" %s@%lu", bootProfStageNames[i], bootProfStageGet(i));
+        }
+    }
+    printf(" us\n\r");
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
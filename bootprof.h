@@ -0,0 +1,77 @@
+/** @file       bootprof.h
+ *  @brief      Boot time profiling, timestamps of init stages from main to the first scan
+ *  @author     Evren Kenanoglu
+ *  @date       4/7/2021
+ */
+#ifndef FILE_BOOTPROF_H
+#define FILE_BOOTPROF_H
+
+/** INCLUDES ******************************************************************/
+#include "parameters.h"
+#include "nrf.h"
+#include "app_timer.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Boot stages, marked at the end of each stage
+ *
+ */
+typedef enum
+{
+    eBootStageMain = 0,    // Entry of main, reference of all other stages
+    eBootStageConfig,      // configStoreLoad, deep sleep resume
+    eBootStageBoard,       // boardInit (log, LEDs, timers, power management, scheduler)
+    eBootStageEngine,      // cpu monitor, timers, phase engine, adv queue
+    eBootStageSoftDevice,  // SoftDevice enable and BLE stack configuration
+    eBootStageGap,         // GAP parameters
+    eBootStageGatt,        // GATT module
+    eBootStageAdvertising, // Advertising set configuration
+    eBootStageScanInit,    // Scan module
+    eBootStageEngineStart, // Program timer armed, CPU sleeps from here on
+    eBootStageFirstScan,   // First scan started
+    eBootStageDeferred,    // Deferred init done (BOOT_FAST_START)
+    eBootStageCount,
+} teBootStages;
+
+/**
+ * @brief Boot profile
+ *
+ * @details Stages up to eBootStageEngineStart are timed with the DWT cycle counter, the CPU does
+ *          not sleep before. Later stages are timed with the app_timer RTC from eBootStageEngineStart.
+ */
+typedef struct
+{
+    uint32_t cycles[eBootStageCount]; /**< CYCCNT at the end of a stage */
+    uint32_t ticks[eBootStageCount];  /**< app_timer ticks at the end of a stage */
+    uint32_t marked;                  /**< Bit mask of marked stages, a stage is marked once */
+} tsBootProfParams;
+
+/** MACROS ********************************************************************/
+
+#if BOOT_PROFILE_ENABLE
+#define BOOT_PROF_MARK(stage) bootProfMark(stage)
+#else
+#define BOOT_PROF_MARK(stage)
+#endif
+
+#ifndef FILE_BOOTPROF_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void bootProfInit(void);
+INTERFACE void bootProfMark(uint8_t stage);
+INTERFACE uint32_t bootProfStageGet(uint8_t stage);
+INTERFACE void bootProfReport(void);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_BOOTPROF_H
@@ -0,0 +1,87 @@
+/** @file       caps.h
+ *  @brief      Compile time capabilities of the target SoftDevice and chip
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ *
+ *  Derived from the SoftDevice define of the target project (S112, S113, S132, S140), the chip
+ *  define and the link counts of its sdk_config.h. parameters.h turns off the features a target
+ *  cannot run, so their code is compiled out and the sources are left out of the image (app.mk):
+ *      - S112, S113: peripheral and broadcaster only, no scanning, no central links
+ *      - S132:       all roles, extended advertising, 1M and 2M PHY
+ *      - S140:       all roles, extended advertising, Coded PHY
+ *  Host builds (no SoftDevice define) get the S140 set of the pca10059 target.
+ */
+#ifndef FILE_CAPS_H
+#define FILE_CAPS_H
+
+/** INCLUDES ******************************************************************/
+#include <stdint.h>
+#include "sdk_config.h"
+
+/** CONSTANTS *****************************************************************/
+
+#if defined(S112) || defined(S113)
+#define CAPS_OBSERVER 0 // Scanning, advertising reports
+#define CAPS_CENTRAL  0 // Outgoing connections
+#else
+#define CAPS_OBSERVER 1
+#define CAPS_CENTRAL  1
+#endif
+
+#if defined(S112)
+#define CAPS_EXTENDED_ADV 0 // Advertising extensions, advertising data beyond 31 bytes
+#else
+#define CAPS_EXTENDED_ADV 1
+#endif
+
+#if defined(S140) || !defined(SOFTDEVICE_PRESENT)
+#define CAPS_CODED_PHY 1 // Long range
+#else
+#define CAPS_CODED_PHY 0
+#endif
+
+#if defined(NRF52840_XXAA) || defined(NRF52833_XXAA) || !defined(SOFTDEVICE_PRESENT)
+#define CAPS_USB 1 // USBD peripheral
+#else
+#define CAPS_USB 0
+#endif
+
+#if defined(NRF52832_XXAA) || defined(NRF52833_XXAA) || defined(NRF52840_XXAA) || !defined(SOFTDEVICE_PRESENT)
+#define CAPS_RTC2 1 // Third RTC, RTC0 is the SoftDevice's and RTC1 app_timer's (nRF52810/nRF52811 have two)
+#else
+#define CAPS_RTC2 0
+#endif
+
+//** LINK COUNTS **//
+#define CAPS_PERIPHERAL_LINKS NRF_SDH_BLE_PERIPHERAL_LINK_COUNT
+#if CAPS_CENTRAL
+#define CAPS_CENTRAL_LINKS NRF_SDH_BLE_CENTRAL_LINK_COUNT
+#else
+#define CAPS_CENTRAL_LINKS 0
+#endif
+
+//** REPORT SIZE **//
+#if CAPS_OBSERVER && defined(NRF_BLE_SCAN_BUFFER)
+#define CAPS_REPORT_SIZE NRF_BLE_SCAN_BUFFER // bytes, scan buffer of nrf_ble_scan, largest advertising report data
+#elif CAPS_OBSERVER
+#define CAPS_REPORT_SIZE 31 // bytes, legacy advertising report
+#else
+#define CAPS_REPORT_SIZE 0
+#endif
+
+#if CAPS_OBSERVER && (CAPS_REPORT_SIZE > UINT8_MAX - 1)
+#error "Advertising records keep the report length in a byte, legacy or short extended reports only"
+#endif
+#if CAPS_OBSERVER && !CAPS_EXTENDED_ADV && (CAPS_REPORT_SIZE > 31)
+#error "Scan buffer beyond the legacy report size on a SoftDevice without advertising extensions"
+#endif
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+#endif // FILE_CAPS_H
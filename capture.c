@@ -0,0 +1,228 @@
+/** @file       capture.c
+ *  @brief      Scan capture, raw advertising reports on the debug console and the host capture file format
+ *  @author     Evren Kenanoglu
+ *  @date       4/25/2021
+ *
+ *  Reports are encoded in SoftDevice interrupt, before the queue and the filters, into a byte ring of
+ *  whole records. The ring is printed as hex lines from main loop (app_scheduler). A report that does
+ *  not fit is dropped and counted, the console has to keep up with the scan traffic (RTT, not UART).
+ */
+#define FILE_CAPTURE_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "capture.h"
+#include "nrf.h"
+#include "app_scheduler.h"
+
+/** CONSTANTS *****************************************************************/
+
+STATIC_ASSERT((CAPTURE_BUFFER_SIZE & (CAPTURE_BUFFER_SIZE - 1)) == 0);
+STATIC_ASSERT(CAPTURE_BUFFER_SIZE >= CAPTURE_RECORD_SIZE_MAX);
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+static tsCaptureParams captureParams;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void captureDrain(void *p_event_data, uint16_t event_size);
+static void captureBufferWrite(uint32_t position, void const *data, uint32_t size);
+static void captureBufferRead(uint32_t position, void *data, uint32_t size);
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**@brief Function to initialize the capture, starts a capture session on the console */
+void captureInit(void)
+{
+    memset(&captureParams, 0, sizeof(captureParams));
+    captureStart();
+}
+
+/**@brief Function to start a capture session, the host converter starts a new time line (CAPINFO) */
+void captureStart(void)
+{
+    if (!captureParams.enabled)
+    {
+        printf("CAPINFO,%u,%u\n\r", CAPTURE_VERSION, (unsigned)CAPTURE_TICK_FREQUENCY);
+        captureParams.enabled = 1;
+    }
+}
+
+/**@brief Function to stop capturing, records already in the buffer are still printed */
+void captureStop(void)
+{
+    captureParams.enabled = 0;
+}
+
+/**
+ * @brief Function to capture an advertising report, called from the SoftDevice observer (interrupt)
+ *
+ * @param advReport Advertising report
+ * @return true     report is captured
+ * @return false    buffer is full, report is dropped, or capture is stopped
+ */
+bool capturePut(ble_gap_evt_adv_report_t const *advReport)
+{
+    tsCaptureRecord record;
+    uint32_t head = captureParams.head;
+    uint32_t size;
+
+    if (!captureParams.enabled)
+    {
+        return false;
+    }
+
+    captureRecordEncode(&record, advReport, app_timer_cnt_get());
+    size = sizeof(record) + record.len;
+
+    if (CAPTURE_BUFFER_SIZE - (head - captureParams.tail) < size)
+    {
+        captureParams.dropped++;
+        return false;
+    }
+
+    captureBufferWrite(head, &record, sizeof(record));
+    captureBufferWrite(head + sizeof(record), advReport->data.p_data, record.len);
+    __DMB(); // Record has to be written before it is published
+    captureParams.head = head + size;
+    captureParams.captured++;
+
+    if (!captureParams.drainPending)
+    {
+        captureParams.drainPending = 1;
+        if (app_sched_event_put(NULL, 0, captureDrain) != NRF_SUCCESS)
+        {
+            captureParams.overflowSched++;
+            captureParams.drainPending = 0; // Next report retries
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Function to encode the fixed part of an advertising report
+ *
+ * @param record    Encoded record, the AD bytes are not copied
+ * @param advReport Advertising report
+ * @param ticks     app_timer ticks at reception
+ */
+void captureRecordEncode(tsCaptureRecord *record, ble_gap_evt_adv_report_t const *advReport, uint32_t ticks)
+{
+    record->ticks    = ticks;
+    record->addrType = advReport->peer_addr.addr_type | (advReport->peer_addr.addr_id_peer ? CAPTURE_ADDR_ID_PEER : 0);
+    record->type     = (advReport->type.connectable ? CAPTURE_TYPE_CONNECTABLE : 0) |
+                       (advReport->type.scannable ? CAPTURE_TYPE_SCANNABLE : 0) |
+                       (advReport->type.directed ? CAPTURE_TYPE_DIRECTED : 0) |
+                       (advReport->type.scan_response ? CAPTURE_TYPE_SCAN_RESPONSE : 0) |
+                       (advReport->type.extended_pdu ? CAPTURE_TYPE_EXTENDED_PDU : 0) |
+                       (uint8_t)(advReport->type.status << CAPTURE_TYPE_STATUS_POS);
+    record->phy      = (advReport->primary_phy & 0x0F) | (uint8_t)(advReport->secondary_phy << 4);
+    record->chIndex  = advReport->ch_index;
+    record->rssi     = advReport->rssi;
+    record->len      = (uint8_t)MIN(advReport->data.len, BLE_GAP_ADV_SET_DATA_SIZE_MAX);
+    memcpy(record->addr, advReport->peer_addr.addr, BLE_GAP_ADDR_LEN);
+}
+
+/**
+ * @brief Function to rebuild an advertising report from a captured record
+ *
+ * @param record    Captured record, AD bytes right after it
+ * @param advReport Rebuilt report, data points into the record
+ */
+void captureRecordDecode(tsCaptureRecord const *record, ble_gap_evt_adv_report_t *advReport)
+{
+    memset(advReport, 0, sizeof(*advReport));
+    advReport->type.connectable       = (record->type & CAPTURE_TYPE_CONNECTABLE) ? 1 : 0;
+    advReport->type.scannable         = (record->type & CAPTURE_TYPE_SCANNABLE) ? 1 : 0;
+    advReport->type.directed          = (record->type & CAPTURE_TYPE_DIRECTED) ? 1 : 0;
+    advReport->type.scan_response     = (record->type & CAPTURE_TYPE_SCAN_RESPONSE) ? 1 : 0;
+    advReport->type.extended_pdu      = (record->type & CAPTURE_TYPE_EXTENDED_PDU) ? 1 : 0;
+    advReport->type.status            = (record->type >> CAPTURE_TYPE_STATUS_POS) & 0x03;
+    advReport->peer_addr.addr_type    = record->addrType & ~CAPTURE_ADDR_ID_PEER;
+    advReport->peer_addr.addr_id_peer = (record->addrType & CAPTURE_ADDR_ID_PEER) ? 1 : 0;
+    memcpy(advReport->peer_addr.addr, record->addr, BLE_GAP_ADDR_LEN);
+    advReport->primary_phy            = record->phy & 0x0F;
+    advReport->secondary_phy          = record->phy >> 4;
+    advReport->ch_index               = record->chIndex;
+    advReport->rssi                   = record->rssi;
+    advReport->data.p_data            = (uint8_t *)(record + 1); // Read only by the report path
+    advReport->data.len               = record->len;
+}
+
+/**@brief Function to get capture counters */
+tsCaptureParams const *captureStatsGet(void)
+{
+    return &captureParams;
+}
+
+/**@brief Function to print capture counters */
+void captureReport(void)
+{
+    printf("CAPTURE captured=%lu dropped=%lu schedFull=%lu\n\r",
+           captureParams.captured,
+           captureParams.dropped,
+           captureParams.overflowSched);
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**
+ * @brief Scheduler handler, prints all captured records in main loop context
+ */
+static void captureDrain(void *p_event_data, uint16_t event_size)
+{
+    UNUSED_PARAMETER(p_event_data);
+    UNUSED_PARAMETER(event_size);
+
+    captureParams.drainPending = 0; // Reports arriving from now on schedule a new drain
+
+    while (captureParams.tail != captureParams.head)
+    {
+        struct
+        {
+            tsCaptureRecord record;
+            uint8_t data[BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+        } line;
+        uint8_t const *bytes = (uint8_t const *)&line;
+        uint32_t size;
+
+        captureBufferRead(captureParams.tail, &line.record, sizeof(line.record));
+        size = sizeof(line.record) + line.record.len;
+        captureBufferRead(captureParams.tail + sizeof(line.record), line.data, line.record.len);
+
+        printf("CAP,");
+        for (uint32_t i = 0; i < size; i++)
+        {
+            printf("%02x", bytes[i]);
+        }
+        printf("\n\r");
+
+        __DMB(); // Record has to be consumed before the space is released
+        captureParams.tail += size;
+    }
+}
+
+/**@brief Copy into the ring, position is a free running byte count */
+static void captureBufferWrite(uint32_t position, void const *data, uint32_t size)
+{
+    uint32_t offset = position & (CAPTURE_BUFFER_SIZE - 1);
+    uint32_t first  = MIN(size, CAPTURE_BUFFER_SIZE - offset);
+
+    memcpy(&captureParams.buffer[offset], data, first);
+    memcpy(captureParams.buffer, (uint8_t const *)data + first, size - first);
+}
+
+/**@brief Copy out of the ring, position is a free running byte count */
+static void captureBufferRead(uint32_t position, void *data, uint32_t size)
+{
+    uint32_t offset = position & (CAPTURE_BUFFER_SIZE - 1);
+    uint32_t first  = MIN(size, CAPTURE_BUFFER_SIZE - offset);
+
+    memcpy(data, &captureParams.buffer[offset], first);
+    memcpy((uint8_t *)data + first, captureParams.buffer, size - first);
+}
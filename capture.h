@@ -0,0 +1,134 @@
+/** @file       capture.h
+ *  @brief      Scan capture, raw advertising reports on the debug console and the host capture file format
+ *  @author     Evren Kenanoglu
+ *  @date       4/25/2021
+ *
+ *  Console line of one report: "CAP,<hex of tsCaptureRecord and the AD bytes>". A capture session
+ *  starts with "CAPINFO,<version>,<tick frequency>". host/capconv.c appends the lines to a capture
+ *  file, host/replay.c feeds the file back into the report path.
+ *
+ *  Capture file, little endian, append only:
+ *      tsCaptureFileHeader
+ *      tsCaptureFileRecord, AD bytes, padding up to CAPTURE_FILE_ALIGN   (repeated up to the end of file)
+ *  Records are aligned, the file can be mapped and walked with CAPTURE_FILE_RECORD_SIZE().
+ */
+#ifndef FILE_CAPTURE_H
+#define FILE_CAPTURE_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+#include "ble_gap.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define CAPTURE_VERSION        1
+#define CAPTURE_FILE_MAGIC     0x50414342 // "BCAP"
+#define CAPTURE_FILE_ALIGN     8
+#define CAPTURE_TICK_FREQUENCY (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+#define CAPTURE_TICK_MASK      0x00FFFFFF // RTC counter, 24 bits
+
+#define CAPTURE_TYPE_CONNECTABLE   0x01 // ble_gap_adv_report_type_t bits
+#define CAPTURE_TYPE_SCANNABLE     0x02
+#define CAPTURE_TYPE_DIRECTED      0x04
+#define CAPTURE_TYPE_SCAN_RESPONSE 0x08
+#define CAPTURE_TYPE_EXTENDED_PDU  0x10
+#define CAPTURE_TYPE_STATUS_POS    5    // 2 bits
+
+#define CAPTURE_ADDR_ID_PEER 0x80 // addrType bit, address resolved by the SoftDevice
+
+#define CAPTURE_RECORD_SIZE_MAX (sizeof(tsCaptureRecord) + BLE_GAP_ADV_SET_DATA_SIZE_MAX)
+#define CAPTURE_FILE_RECORD_SIZE(len) \
+    ((sizeof(tsCaptureFileRecord) + (len) + CAPTURE_FILE_ALIGN - 1) & ~(CAPTURE_FILE_ALIGN - 1))
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief One advertising report as received, AD bytes follow
+ *
+ * @details Fields are in size order, no padding, the struct is the wire and the file layout.
+ */
+typedef struct
+{
+    uint32_t ticks;    /**< app_timer ticks at reception */
+    uint8_t addr[BLE_GAP_ADDR_LEN];
+    uint8_t addrType;  /**< BLE_GAP_ADDR_TYPE_*, CAPTURE_ADDR_ID_PEER */
+    uint8_t type;      /**< CAPTURE_TYPE_* */
+    uint8_t phy;       /**< Primary PHY, secondary PHY in the high nibble */
+    uint8_t chIndex;
+    int8_t rssi;
+    uint8_t len;       /**< AD bytes */
+} tsCaptureRecord;
+
+STATIC_ASSERT(sizeof(tsCaptureRecord) == 16);
+
+/**
+ * @brief Capture file header
+ *
+ */
+typedef struct
+{
+    uint32_t magic;         /**< CAPTURE_FILE_MAGIC */
+    uint16_t version;       /**< CAPTURE_VERSION */
+    uint16_t headerSize;    /**< First record offset */
+    uint32_t tickFrequency; /**< Hz, of ticks and time */
+    uint32_t reserved;
+} tsCaptureFileHeader;
+
+/**
+ * @brief Capture file record
+ *
+ */
+typedef struct
+{
+    uint64_t time;          /**< Ticks since the start of the file, wraps of the counter removed */
+    tsCaptureRecord record;
+} tsCaptureFileRecord;
+
+STATIC_ASSERT(sizeof(tsCaptureFileRecord) % CAPTURE_FILE_ALIGN == 0);
+
+/**
+ * @brief Capture state and counters
+ *
+ */
+typedef struct
+{
+    uint8_t buffer[CAPTURE_BUFFER_SIZE]; /**< Whole records, printed from main loop */
+    volatile uint32_t head;              /**< Written by the SoftDevice interrupt only */
+    volatile uint32_t tail;              /**< Written by the main loop only */
+    volatile uint8_t drainPending;
+    volatile uint8_t enabled;            /**< captureStart()/captureStop(), reports are ignored when 0 */
+    uint32_t captured;
+    uint32_t dropped;       /**< Buffer full, console slower than the reports */
+    uint32_t overflowSched; /**< Scheduler queue full, drain delayed to next report */
+} tsCaptureParams;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_CAPTURE_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void captureInit(void);
+INTERFACE void captureStart(void);
+INTERFACE void captureStop(void);
+#if SCANNING_ENABLE
+INTERFACE bool capturePut(ble_gap_evt_adv_report_t const *advReport);
+INTERFACE void captureRecordEncode(tsCaptureRecord *record, ble_gap_evt_adv_report_t const *advReport, uint32_t ticks);
+INTERFACE void captureRecordDecode(tsCaptureRecord const *record, ble_gap_evt_adv_report_t *advReport);
+#endif
+INTERFACE tsCaptureParams const *captureStatsGet(void);
+INTERFACE void captureReport(void);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_CAPTURE_H
@@ -0,0 +1,705 @@
+/** @file       cli.c
+ *  @brief      nrf_cli console, live tuning of the runtime configuration and stats
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ *
+ *  The console is on USB CDC ACM of the dongle, RTT on the boards without USB (CLI_TRANSPORT). Input
+ *  is collected by the transport interrupt and the commands run from main loop (cliProcess()), thread
+ *  mode below every interrupt: the phase engine timers and the SoftDevice preempt a command, a command
+ *  never delays a scan. USBD and POWER interrupts are at the lowest priority (sdk_config.h).
+ *
+ *  Configuration changes go to runtimeConfig and are applied by the program right away, the engine
+ *  picks them up when it arms the next phase. They are lost at reset unless saved ("config save").
+ *  The role is only read at boot, a role change is saved and the dongle is reset once flash is written.
+ */
+#define FILE_CLI_C
+
+/** INCLUDES ******************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "cli.h"
+#include "nrf.h"
+#include "nrf_cli.h"
+#if CLI_TRANSPORT == CLI_TRANSPORT_CDC
+#include "nrf_cli_cdc_acm.h"
+#include "nrf_drv_clock.h"
+#include "nrf_drv_power.h"
+#include "app_usbd.h"
+#include "app_usbd_serial_num.h"
+#else
+#include "nrf_cli_rtt.h"
+#endif
+#include "configstore.h"
+#include "phaseengine.h"
+#include "metrics.h"
+#include "capture.h"
+#include "sensor.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Console state
+ *
+ */
+typedef struct
+{
+    tsCliHooks const *hooks;
+    uint8_t role;      /**< teRoles of the running program */
+    bool resetPending; /**< Role changed, reset when the configuration is written */
+    bool suspended;    /**< Transport powered down for a deep sleep, VBUS events are ignored */
+} tsCliParams;
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+#if CLI_TRANSPORT == CLI_TRANSPORT_CDC
+NRF_CLI_CDC_ACM_DEF(cliTransport);
+NRF_CLI_DEF(cliConsole, CLI_PROMPT, &cliTransport.transport, '\r', CLI_LOG_QUEUE_SIZE);
+#else
+NRF_CLI_RTT_DEF(cliTransport);
+NRF_CLI_DEF(cliConsole, CLI_PROMPT, &cliTransport.transport, '\n', CLI_LOG_QUEUE_SIZE);
+#endif
+
+static tsCliParams cliParams;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+#if CLI_TRANSPORT == CLI_TRANSPORT_CDC
+static void cliUsbdEventHandler(app_usbd_event_type_t event);
+#endif
+static bool cliNumberGet(nrf_cli_t const *cli, size_t argc, char **argv, int32_t min, int32_t max, int32_t *value);
+static void cliConfigChanged(nrf_cli_t const *cli);
+static void cliConfigPrint(nrf_cli_t const *cli);
+static void cmdConfig(nrf_cli_t const *cli, size_t argc, char **argv);
+static void cmdConfigScan(nrf_cli_t const *cli, size_t argc, char **argv);
+static void cmdConfigAdv(nrf_cli_t const *cli, size_t argc, char **argv);
+static void cmdConfigSleep(nrf_cli_t const *cli, size_t argc, char **argv);
+static void cmdConfigInterval(nrf_cli_t const *cli, size_t argc, char **argv);
+static void cmdConfigDuty(nrf_cli_t const *cli, size_t argc, char **argv);
+static void cmdConfigRssi(nrf_cli_t const *cli, size_t argc, char **argv);
+static void cmdConfigName(nrf_cli_t const *cli, size_t argc, char **argv);
+static void cmdConfigSave(nrf_cli_t const *cli, size_t argc, char **argv);
+static void cmdConfigDefaults(nrf_cli_t const *cli, size_t argc, char **argv);
+static void cmdRole(nrf_cli_t const *cli, size_t argc, char **argv);
+#if METRICS_ENABLE
+static void cmdMetrics(nrf_cli_t const *cli, size_t argc, char **argv);
+#endif
+#if CAPTURE_ENABLE
+static void cmdCapture(nrf_cli_t const *cli, size_t argc, char **argv);
+#endif
+#if LATENCY_ENABLE
+static void cmdLatency(nrf_cli_t const *cli, size_t argc, char **argv);
+#endif
+#if TUNE_ENABLE
+static void cmdTune(nrf_cli_t const *cli, size_t argc, char **argv);
+#endif
+#if SENSOR_ENABLE
+static void cmdSensor(nrf_cli_t const *cli, size_t argc, char **argv);
+#endif
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize the console and its transport, after the SoftDevice is enabled
+ *
+ * @param role  teRoles of the running program
+ * @param hooks Program side, has to stay valid
+ * @return ret_code_t returns error code
+ */
+ret_code_t cliInit(uint8_t role, tsCliHooks const *hooks)
+{
+    ret_code_t errCode;
+
+    cliParams.hooks        = hooks;
+    cliParams.role         = role;
+    cliParams.resetPending = false;
+    cliParams.suspended    = false;
+
+#if CLI_TRANSPORT == CLI_TRANSPORT_CDC
+    static const app_usbd_config_t usbdConfig =
+        {
+            .ev_state_proc = cliUsbdEventHandler,
+        };
+
+    errCode = nrf_drv_clock_init(); // USBD requests the HF crystal through the clock driver
+    if (errCode != NRF_ERROR_MODULE_ALREADY_INITIALIZED)
+    {
+        VERIFY_SUCCESS(errCode);
+    }
+
+    app_usbd_serial_num_generate();
+    errCode = app_usbd_init(&usbdConfig);
+    VERIFY_SUCCESS(errCode);
+
+    errCode = app_usbd_class_append(app_usbd_cdc_acm_class_inst_get(&nrf_cli_cdc_acm));
+    VERIFY_SUCCESS(errCode);
+#endif
+
+    errCode = nrf_cli_init(&cliConsole, NULL, true, false, NRF_LOG_SEVERITY_NONE);
+    VERIFY_SUCCESS(errCode);
+
+    errCode = nrf_cli_start(&cliConsole);
+    VERIFY_SUCCESS(errCode);
+
+#if CLI_TRANSPORT == CLI_TRANSPORT_CDC
+    errCode = app_usbd_power_events_enable(); // VBUS events through the SoftDevice, enumerates when plugged
+    VERIFY_SUCCESS(errCode);
+#endif
+
+    return errCode;
+}
+
+/**@brief Function to run the console, called from main loop */
+void cliProcess(void)
+{
+#if CLI_TRANSPORT == CLI_TRANSPORT_CDC
+    while (app_usbd_event_queue_process())
+    {
+        // USB events queued by the interrupt
+    }
+#endif
+    nrf_cli_process(&cliConsole);
+
+    if (cliParams.resetPending && !configStoreBusy())
+    {
+        NVIC_SystemReset(); // New role from the saved configuration
+    }
+}
+
+/**
+ * @brief Function to power the console transport down for a System ON deep sleep, called from main loop
+ *
+ * @details USBD is stopped and disabled, the clock driver releases its HF crystal request and the host
+ *          sees the port go away. The RTT transport has nothing powered.
+ */
+void cliSuspend(void)
+{
+#if CLI_TRANSPORT == CLI_TRANSPORT_CDC
+    cliParams.suspended = true;
+
+    if (nrf_drv_usbd_is_started())
+    {
+        app_usbd_stop(); // Disabled on APP_USBD_EVT_STOPPED
+    }
+    else if (nrf_drv_usbd_is_enabled())
+    {
+        app_usbd_disable();
+    }
+#endif
+}
+
+/**@brief Function to bring the console transport back after a deep sleep, called from main loop */
+void cliResume(void)
+{
+#if CLI_TRANSPORT == CLI_TRANSPORT_CDC
+    nrf_drv_power_usb_state_t usbState = nrf_drv_power_usbstatus_get();
+
+    cliParams.suspended = false;
+
+    if (usbState == NRF_DRV_POWER_USB_STATE_DISCONNECTED) // Enabled by APP_USBD_EVT_POWER_DETECTED when plugged
+    {
+        return;
+    }
+
+    if (!nrf_drv_usbd_is_enabled())
+    {
+        app_usbd_enable();
+    }
+    if (usbState == NRF_DRV_POWER_USB_STATE_READY && !nrf_drv_usbd_is_started())
+    {
+        app_usbd_start();
+    }
+#endif
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+#if CLI_TRANSPORT == CLI_TRANSPORT_CDC
+/**@brief USB device state, the port is enumerated while the dongle is plugged */
+static void cliUsbdEventHandler(app_usbd_event_type_t event)
+{
+    switch (event)
+    {
+        case APP_USBD_EVT_STOPPED:
+            app_usbd_disable();
+            break;
+
+        case APP_USBD_EVT_POWER_DETECTED:
+            if (!cliParams.suspended && !nrf_drv_usbd_is_enabled())
+            {
+                app_usbd_enable();
+            }
+            break;
+
+        case APP_USBD_EVT_POWER_REMOVED:
+            app_usbd_stop();
+            break;
+
+        case APP_USBD_EVT_POWER_READY:
+            if (!cliParams.suspended)
+            {
+                app_usbd_start();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+#endif
+
+/**
+ * @brief Single decimal argument of a command in [min, max], help and errors are printed
+ *
+ * @return true  value is valid
+ * @return false no value, help requested or out of range
+ */
+static bool cliNumberGet(nrf_cli_t const *cli, size_t argc, char **argv, int32_t min, int32_t max, int32_t *value)
+{
+    char *end;
+    long number;
+
+    if (nrf_cli_help_requested(cli) || argc != 2)
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return false;
+    }
+
+    number = strtol(argv[1], &end, 10);
+    if (end == argv[1] || *end != '\0' || number < min || number > max)
+    {
+        nrf_cli_error(cli, "%s: %s is not in %d..%d", argv[0], argv[1], min, max);
+        return false;
+    }
+
+    *value = (int32_t)number;
+    return true;
+}
+
+/**@brief runtimeConfig changed, applied by the program from the next phase */
+static void cliConfigChanged(nrf_cli_t const *cli)
+{
+    cliParams.hooks->configApply();
+    nrf_cli_print(cli, "applied from the next phase, not saved");
+}
+
+static void cliConfigPrint(nrf_cli_t const *cli)
+{
+    tsConfigStoreParams const *store = configStoreStatsGet();
+
+    nrf_cli_print(cli, "role     %s%s", (runtimeConfig.role == eRoleMaster) ? "master" : "slave",
+                  (runtimeConfig.role != cliParams.role) ? " (after reset)" : "");
+    nrf_cli_print(cli, "scan     %u ms", runtimeConfig.scanTimeout);
+    nrf_cli_print(cli, "adv      %u ms", runtimeConfig.advTimeout);
+    nrf_cli_print(cli, "sleep    %u ms", runtimeConfig.sleepDuration);
+    nrf_cli_print(cli, "interval %u ms", runtimeConfig.minAdvInterval);
+    nrf_cli_print(cli, "duty     %u %%", runtimeConfig.scanDuty);
+    nrf_cli_print(cli, "rssi     %d dBm", runtimeConfig.rssiFilter);
+    nrf_cli_print(cli, "name     %s", runtimeConfig.filterName);
+    nrf_cli_print(cli, "source   %s, saves %u, errors %u%s",
+                  (store->source == eConfigSourceFlash) ? "flash" : "defaults",
+                  store->saveCount,
+                  store->errorCount,
+                  configStoreBusy() ? ", writing" : "");
+}
+
+/**@brief "config", prints the runtime configuration */
+static void cmdConfig(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    if (nrf_cli_help_requested(cli) || argc > 1)
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return;
+    }
+    cliConfigPrint(cli);
+}
+
+static void cmdConfigScan(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    int32_t value;
+
+    if (cliNumberGet(cli, argc, argv, CONFIG_TIMING_MIN_MS, MIN(CONFIG_TIMING_MAX_MS, CONFIG_CYCLE_MAX_MS - runtimeConfig.advTimeout), &value))
+    {
+        runtimeConfig.scanTimeout = value;
+        cliConfigChanged(cli);
+    }
+}
+
+static void cmdConfigAdv(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    int32_t value;
+
+    if (cliNumberGet(cli, argc, argv, CONFIG_TIMING_MIN_MS, MIN(CONFIG_TIMING_MAX_MS, CONFIG_CYCLE_MAX_MS - runtimeConfig.scanTimeout), &value))
+    {
+        runtimeConfig.advTimeout = value;
+        cliConfigChanged(cli);
+    }
+}
+
+static void cmdConfigSleep(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    int32_t value;
+
+    if (cliNumberGet(cli, argc, argv, CONFIG_TIMING_MIN_MS, CONFIG_TIMING_MAX_MS, &value))
+    {
+        runtimeConfig.sleepDuration = value;
+        cliConfigChanged(cli);
+    }
+}
+
+static void cmdConfigInterval(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    int32_t value;
+
+    if (cliNumberGet(cli, argc, argv, CONFIG_ADV_INTERVAL_MIN_MS, CONFIG_ADV_INTERVAL_MAX_MS, &value))
+    {
+        runtimeConfig.minAdvInterval = value;
+        cliConfigChanged(cli);
+    }
+}
+
+static void cmdConfigDuty(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    int32_t value;
+
+    if (cliNumberGet(cli, argc, argv, 1, 100, &value))
+    {
+        runtimeConfig.scanDuty = (uint8_t)value;
+        cliConfigChanged(cli);
+    }
+}
+
+static void cmdConfigRssi(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    int32_t value;
+
+    if (cliNumberGet(cli, argc, argv, CLI_RSSI_MIN, CLI_RSSI_MAX, &value))
+    {
+        runtimeConfig.rssiFilter = (int8_t)value;
+        cliConfigChanged(cli);
+    }
+}
+
+static void cmdConfigName(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    if (nrf_cli_help_requested(cli) || argc != 2)
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return;
+    }
+    if (strlen(argv[1]) >= CONFIG_FILTER_NAME_MAX)
+    {
+        nrf_cli_error(cli, "%s: longer than %u characters", argv[0], CONFIG_FILTER_NAME_MAX - 1);
+        return;
+    }
+
+    memset(runtimeConfig.filterName, 0, sizeof(runtimeConfig.filterName));
+    strcpy(runtimeConfig.filterName, argv[1]);
+    cliConfigChanged(cli);
+}
+
+static void cmdConfigSave(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    ret_code_t errCode;
+
+    if (nrf_cli_help_requested(cli) || argc > 1)
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return;
+    }
+
+    errCode = configStoreSave(&runtimeConfig);
+    if (errCode != NRF_SUCCESS)
+    {
+        nrf_cli_error(cli, "save failed: 0x%x", errCode);
+        return;
+    }
+    nrf_cli_print(cli, "saving");
+}
+
+static void cmdConfigDefaults(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    uint8_t role = runtimeConfig.role;
+
+    if (nrf_cli_help_requested(cli) || argc > 1)
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return;
+    }
+
+    configStoreDefaultsGet(&runtimeConfig);
+    runtimeConfig.role = role; // "role" changes it, the running program keeps its role
+    cliConfigChanged(cli);
+}
+
+/**@brief "role [master|slave]", a new role is saved with the configuration and starts after a reset */
+static void cmdRole(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    uint8_t role;
+    ret_code_t errCode;
+
+    if (nrf_cli_help_requested(cli) || argc > 2)
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return;
+    }
+    if (argc == 1)
+    {
+        nrf_cli_print(cli, "%s", (cliParams.role == eRoleMaster) ? "master" : "slave");
+        return;
+    }
+
+    if (strcmp(argv[1], "master") == 0)
+    {
+        role = eRoleMaster;
+    }
+    else if (strcmp(argv[1], "slave") == 0)
+    {
+        role = eRoleSlave;
+    }
+    else
+    {
+        nrf_cli_error(cli, "%s: unknown role %s", argv[0], argv[1]);
+        return;
+    }
+
+    if (role == cliParams.role)
+    {
+        nrf_cli_print(cli, "already %s", argv[1]);
+        return;
+    }
+
+    runtimeConfig.role = role;
+    errCode            = configStoreSave(&runtimeConfig);
+    if (errCode != NRF_SUCCESS)
+    {
+        runtimeConfig.role = cliParams.role;
+        nrf_cli_error(cli, "save failed: 0x%x", errCode);
+        return;
+    }
+    cliParams.resetPending = true;
+    nrf_cli_print(cli, "configuration saved, reset to %s", argv[1]);
+}
+
+#if METRICS_ENABLE
+/**@brief "metrics [raw]", named values, or the snapshot frame as a METRICS line (host/metricsdump.c) */
+static void cmdMetrics(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    tsMetricInfo const *info;
+    uint8_t count;
+
+    if (nrf_cli_help_requested(cli) || argc > 2 || (argc == 2 && strcmp(argv[1], "raw") != 0))
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return;
+    }
+
+    if (argc == 2)
+    {
+        uint8_t frame[METRICS_FRAME_SIZE];
+        uint16_t size = metricsSnapshot(frame, cliParams.hooks->uptimeMs());
+
+        nrf_cli_fprintf(cli, NRF_CLI_NORMAL, "METRICS,");
+        for (uint16_t i = 0; i < size; i++)
+        {
+            nrf_cli_fprintf(cli, NRF_CLI_NORMAL, "%02x", frame[i]);
+        }
+        nrf_cli_fprintf(cli, NRF_CLI_NORMAL, "\n");
+        return;
+    }
+
+    metricsRefresh();
+    info = metricsInfoGet(&count);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        nrf_cli_print(cli, "%-18s %10u %s", info[i].name, metricsValues[i],
+                      (info[i].kind == eMetricKindCounter) ? "c" : "g");
+    }
+}
+#endif
+
+#if CAPTURE_ENABLE
+/**@brief "capture [start|stop]", the capture lines stay on the debug console */
+static void cmdCapture(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    tsCaptureParams const *capture = captureStatsGet();
+
+    if (nrf_cli_help_requested(cli) || argc > 2)
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "start") == 0)
+    {
+        captureStart();
+    }
+    else if (argc == 2 && strcmp(argv[1], "stop") == 0)
+    {
+        captureStop();
+    }
+    else if (argc == 2)
+    {
+        nrf_cli_error(cli, "%s: unknown command %s", argv[0], argv[1]);
+        return;
+    }
+
+    nrf_cli_print(cli, "%s, captured %u, dropped %u", capture->enabled ? "running" : "stopped",
+                  capture->captured, capture->dropped);
+}
+#endif
+
+#if LATENCY_ENABLE
+/**@brief "latency [reset]", master round trips of the latency probes (latency.c) */
+static void cmdLatency(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    tsLatency *latency = cliParams.hooks->latency;
+
+    if (nrf_cli_help_requested(cli) || argc > 2 || (argc == 2 && strcmp(argv[1], "reset") != 0))
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return;
+    }
+
+    if (argc == 2)
+    {
+        latencyReset(latency);
+    }
+
+    nrf_cli_print(cli, "echoes %u, stale %u", latency->count, latency->stale);
+    if (latency->count != 0)
+    {
+        nrf_cli_print(cli, "min %u us, p50 %u us, p90 %u us, p99 %u us, max %u us, mean %u us",
+                      latency->min,
+                      latencyPercentileGet(latency, 50),
+                      latencyPercentileGet(latency, 90),
+                      latencyPercentileGet(latency, 99),
+                      latency->max,
+                      (uint32_t)(latency->sum / latency->count));
+    }
+}
+#endif
+
+#if TUNE_ENABLE
+/**@brief "tune [reset]", slave tuner settings and estimates (tune.c), reset starts again from the configuration */
+static void cmdTune(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    tsTune const *tune = cliParams.hooks->tune;
+
+    if (nrf_cli_help_requested(cli) || argc > 2 || (argc == 2 && strcmp(argv[1], "reset") != 0))
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return;
+    }
+    if (cliParams.role != eRoleSlave)
+    {
+        nrf_cli_error(cli, "slave only");
+        return;
+    }
+
+    if (argc == 2)
+    {
+        cliParams.hooks->configApply();
+    }
+
+    nrf_cli_print(cli, "scan %u ms, duty %u %%, sleep %u ms, adv interval %u ms",
+                  tune->settings.scan, tune->settings.duty, tune->settings.sleep, tune->settings.advInterval);
+    nrf_cli_print(cli, "success %u %%, latency %u ms (target %u), current %u uA (budget %u), load %u reports/s",
+                  (tune->success * 100) >> TUNE_Q,
+                  tuneLatencyGet(tune), tune->config.latency,
+                  tuneCurrentGet(tune, &tune->settings), tune->config.budget,
+                  tune->load >> TUNE_Q);
+    nrf_cli_print(cli, "spends %u, saves %u, holds %u", tune->spends, tune->saves, tune->holds);
+}
+#endif
+
+#if SENSOR_ENABLE
+/**@brief "sensor [ppi|software|reset]", sampling trigger and the cost of a sample with each trigger (sensor.c) */
+static void cmdSensor(nrf_cli_t const *cli, size_t argc, char **argv)
+{
+    tsSensorParams const *sensor = sensorStatsGet();
+    ret_code_t errCode           = NRF_SUCCESS;
+
+    if (nrf_cli_help_requested(cli) || argc > 2)
+    {
+        nrf_cli_help_print(cli, NULL, 0);
+        return;
+    }
+    if (cliParams.role != eRoleSlave)
+    {
+        nrf_cli_error(cli, "slave only");
+        return;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "ppi") == 0)
+    {
+        errCode = sensorTriggerSet(eSensorTriggerPpi);
+    }
+    else if (argc == 2 && strcmp(argv[1], "software") == 0)
+    {
+        errCode = sensorTriggerSet(eSensorTriggerSoftware);
+    }
+    else if (argc == 2 && strcmp(argv[1], "reset") == 0)
+    {
+        sensorStatsReset();
+    }
+    else if (argc == 2)
+    {
+        nrf_cli_error(cli, "%s: unknown command %s", argv[0], argv[1]);
+        return;
+    }
+    if (errCode != NRF_SUCCESS)
+    {
+        nrf_cli_error(cli, "%s: error %u", argv[0], errCode);
+        return;
+    }
+
+    nrf_cli_print(cli, "trigger %s, reading %u, previous %u", sensorTriggerNameGet(sensor->trigger), sensor->readings[0], sensor->readings[1]);
+    for (uint8_t trigger = 0; trigger < eSensorTriggerCount; trigger++)
+    {
+        tsSensorStats const *stats = &sensor->stats[trigger];
+
+        if (stats->samples != 0)
+        {
+            nrf_cli_print(cli, "%-8s samples %u, wakeups %u (%u per 1000 samples), %u cycles and %u pC per sample",
+                          sensorTriggerNameGet(trigger),
+                          stats->samples, stats->wakeups, (uint32_t)(((uint64_t)stats->wakeups * 1000) / stats->samples),
+                          (uint32_t)(stats->cpuCycles / stats->samples), sensorChargeGet(trigger));
+        }
+    }
+}
+#endif
+
+// Command tree, collected by nrf_cli from its section
+NRF_CLI_CREATE_STATIC_SUBCMD_SET(cliConfigCommands)
+{
+    NRF_CLI_CMD(scan,     NULL, "Scan phase, ms",                          cmdConfigScan),
+    NRF_CLI_CMD(adv,      NULL, "Advertising phase, ms",                   cmdConfigAdv),
+    NRF_CLI_CMD(sleep,    NULL, "Sleep phase, ms",                         cmdConfigSleep),
+    NRF_CLI_CMD(interval, NULL, "Advertising interval, ms",                cmdConfigInterval),
+    NRF_CLI_CMD(duty,     NULL, "Scan window of the scan interval, %",     cmdConfigDuty),
+    NRF_CLI_CMD(rssi,     NULL, "RSSI filter, dBm",                        cmdConfigRssi),
+    NRF_CLI_CMD(name,     NULL, "Filter device name",                      cmdConfigName),
+    NRF_CLI_CMD(save,     NULL, "Write the configuration to flash",        cmdConfigSave),
+    NRF_CLI_CMD(defaults, NULL, "Compiled defaults (parameters.h)",        cmdConfigDefaults),
+    NRF_CLI_SUBCMD_SET_END
+};
+NRF_CLI_CMD_REGISTER(config, &cliConfigCommands, "Runtime configuration, changes apply from the next phase", cmdConfig);
+NRF_CLI_CMD_REGISTER(role, NULL, "Role, \"role master|slave\" saves and resets", cmdRole);
+#if METRICS_ENABLE
+NRF_CLI_CMD_REGISTER(metrics, NULL, "Metrics, \"metrics raw\" prints the snapshot frame", cmdMetrics);
+#endif
+#if CAPTURE_ENABLE
+NRF_CLI_CMD_REGISTER(capture, NULL, "Scan capture, \"capture start|stop\"", cmdCapture);
+#endif
+#if LATENCY_ENABLE
+NRF_CLI_CMD_REGISTER(latency, NULL, "Rendezvous round trips, \"latency reset\" clears them", cmdLatency);
+#endif
+#if TUNE_ENABLE
+NRF_CLI_CMD_REGISTER(tune, NULL, "Slave tuner, \"tune reset\" starts again from the configuration", cmdTune);
+#endif
+#if SENSOR_ENABLE
+NRF_CLI_CMD_REGISTER(sensor, NULL, "Sensor sampling, \"sensor ppi|software\" switches the trigger, \"sensor reset\" clears the stats", cmdSensor);
+#endif
@@ -0,0 +1,56 @@
+/** @file       cli.h
+ *  @brief      nrf_cli console, live tuning of the runtime configuration and stats
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ */
+#ifndef FILE_CLI_H
+#define FILE_CLI_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+#include "sdk_errors.h"
+#include "latency.h"
+#include "tune.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define CLI_PROMPT           "beacon:~$ "
+#define CLI_RSSI_MIN         -127    // dBm
+#define CLI_RSSI_MAX         20      // dBm
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Program side of the console, called from main loop
+ *
+ */
+typedef struct
+{
+    void (*configApply)(void);  // runtimeConfig changed, engine timings, scan window and advertising interval
+    uint32_t (*uptimeMs)(void); // Time of the metrics frames
+    tsLatency *latency;         // Round trips of the "latency" command, LATENCY_ENABLE
+    tsTune *tune;               // Slave tuner of the "tune" command, TUNE_ENABLE
+} tsCliHooks;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_CLI_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE ret_code_t cliInit(uint8_t role, tsCliHooks const *hooks);
+INTERFACE void cliProcess(void);
+INTERFACE void cliSuspend(void);
+INTERFACE void cliResume(void);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_CLI_H
@@ -0,0 +1,261 @@
+/** @file       coc.c
+ *  @brief      L2CAP connection-oriented channel, credit based bulk transport next to GATT
+ *  @author     Evren Kenanoglu
+ *  @date       4/22/2021
+ *
+ *  The central opens the channel (cocConnect), the peripheral accepts requests on COC_PSM. SDUs are
+ *  sent from the caller's memory, the SoftDevice segments them into COC_MPS PDUs as the peer's credits
+ *  allow and returns the buffer in BLE_L2CAP_EVT_CH_TX. Received SDUs land in rxBuffers, every buffer
+ *  given back to the SoftDevice lets the peer send further.
+ */
+#define FILE_COC_C
+
+/** INCLUDES ******************************************************************/
+#include <string.h>
+#include "coc.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void cocSetupParamsGet(tsCoc *coc, ble_l2cap_ch_setup_params_t *params);
+static void cocOpened(tsCoc *coc, ble_l2cap_ch_tx_params_t const *txParams);
+static void cocClosed(tsCoc *coc);
+
+/** VARIABLES *****************************************************************/
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize a closed channel
+ *
+ * @param coc       Channel
+ * @param handlers  Callbacks, unused ones can be NULL
+ */
+void cocInit(tsCoc *coc, tsCocHandlers const *handlers)
+{
+    memset(coc, 0, sizeof(*coc));
+    coc->connHandle = BLE_CONN_HANDLE_INVALID;
+    coc->cid        = BLE_L2CAP_CID_INVALID;
+    coc->handlers   = *handlers;
+}
+
+/**
+ * @brief Function to open the channel as central
+ *
+ * @param coc           Channel
+ * @param connHandle    Link
+ * @return ret_code_t   SoftDevice error, stateChanged() follows on success
+ */
+ret_code_t cocConnect(tsCoc *coc, uint16_t connHandle)
+{
+    ble_l2cap_ch_setup_params_t params;
+    uint16_t cid = BLE_L2CAP_CID_INVALID;
+    ret_code_t errCode;
+
+    if (coc->state != eCocClosed)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    cocSetupParamsGet(coc, &params);
+    params.le_psm = COC_PSM;
+    errCode       = sd_ble_l2cap_ch_setup(connHandle, &cid, &params);
+    VERIFY_SUCCESS(errCode);
+
+    coc->state      = eCocConnecting;
+    coc->connHandle = connHandle;
+    coc->cid        = cid;
+    return errCode;
+}
+
+/**
+ * @brief Function to handle the L2CAP events of the channel
+ *
+ * @param coc       Channel
+ * @param bleEvent  SoftDevice event
+ *
+ * @details Runs in SoftDevice interrupt context. Setup requests are accepted while the channel is
+ *          closed, the caller only passes the events of its own link.
+ */
+void cocBleEventHandler(tsCoc *coc, ble_evt_t const *bleEvent)
+{
+    ble_l2cap_evt_t const *event = &bleEvent->evt.l2cap_evt;
+
+    if (bleEvent->header.evt_id == BLE_L2CAP_EVT_CH_SETUP_REQUEST)
+    {
+        ble_l2cap_ch_setup_params_t params;
+        uint16_t cid = event->local_cid;
+
+        cocSetupParamsGet(coc, &params);
+        if (event->params.ch_setup_request.le_psm != COC_PSM)
+        {
+            params.status = BLE_L2CAP_CH_STATUS_CODE_LE_PSM_NOT_SUPPORTED;
+        }
+        else if (coc->state != eCocClosed)
+        {
+            params.status = BLE_L2CAP_CH_STATUS_CODE_NO_RESOURCES;
+        }
+
+        if (sd_ble_l2cap_ch_setup(event->conn_handle, &cid, &params) == NRF_SUCCESS &&
+            params.status == BLE_L2CAP_CH_STATUS_CODE_SUCCESS)
+        {
+            coc->state      = eCocConnecting;
+            coc->connHandle = event->conn_handle;
+            coc->cid        = cid;
+        }
+        return;
+    }
+
+    if (bleEvent->header.evt_id == BLE_GAP_EVT_DISCONNECTED)
+    {
+        if (bleEvent->evt.gap_evt.conn_handle == coc->connHandle)
+        {
+            cocClosed(coc);
+        }
+        return;
+    }
+
+    if (coc->state == eCocClosed || event->conn_handle != coc->connHandle || event->local_cid != coc->cid)
+    {
+        return;
+    }
+
+    switch (bleEvent->header.evt_id)
+    {
+        case BLE_L2CAP_EVT_CH_SETUP:
+            cocOpened(coc, &event->params.ch_setup.tx_params);
+            break;
+
+        case BLE_L2CAP_EVT_CH_SETUP_REFUSED:
+            coc->refused++;
+            cocClosed(coc);
+            break;
+
+        case BLE_L2CAP_EVT_CH_RELEASED:
+            cocClosed(coc);
+            break;
+
+        case BLE_L2CAP_EVT_CH_CREDIT:
+            coc->credits = event->params.credit.credits;
+            coc->creditGrants++;
+            break;
+
+        case BLE_L2CAP_EVT_CH_TX:
+            coc->txQueued--;
+            coc->sdusSent++;
+            if (coc->handlers.txDone != NULL)
+            {
+                coc->handlers.txDone(coc->handlers.context, coc->connHandle, event->params.tx.sdu_buf.len);
+            }
+            break;
+
+        case BLE_L2CAP_EVT_CH_RX:
+            coc->sdusReceived++;
+            if (coc->handlers.rx != NULL)
+            {
+                coc->handlers.rx(coc->handlers.context, coc->connHandle, event->params.rx.sdu_buf.p_data, event->params.rx.sdu_len);
+            }
+            sd_ble_l2cap_ch_rx(coc->connHandle, coc->cid, &event->params.rx.sdu_buf); // Buffer back, credits for the peer
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Function to send an SDU without a copy
+ *
+ * @param coc       Channel
+ * @param data      SDU, has to stay untouched until txDone() of this SDU
+ * @param length    Up to cocSduMaxGet()
+ * @return ret_code_t NRF_ERROR_RESOURCES: COC_TX_QUEUE SDUs are queued already
+ */
+ret_code_t cocSend(tsCoc *coc, uint8_t const *data, uint16_t length)
+{
+    ble_data_t const sdu = {.p_data = (uint8_t *)data, .len = length};
+    ret_code_t errCode;
+
+    if (coc->state != eCocOpen)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (coc->txQueued >= COC_TX_QUEUE)
+    {
+        return NRF_ERROR_RESOURCES;
+    }
+
+    errCode = sd_ble_l2cap_ch_tx(coc->connHandle, coc->cid, &sdu);
+    VERIFY_SUCCESS(errCode);
+
+    coc->txQueued++;
+    return errCode;
+}
+
+/**@brief Function to check if SDUs can be sent */
+bool cocIsOpen(tsCoc const *coc)
+{
+    return coc->state == eCocOpen;
+}
+
+/**@brief Function to get the largest SDU both sides accept */
+uint16_t cocSduMaxGet(tsCoc const *coc)
+{
+    return MIN(coc->txMtu, COC_SDU_SIZE);
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief Receive side of a setup request or reply, first SDU buffer goes with it */
+static void cocSetupParamsGet(tsCoc *coc, ble_l2cap_ch_setup_params_t *params)
+{
+    memset(params, 0, sizeof(*params));
+    params->rx_params.rx_mtu         = COC_SDU_SIZE;
+    params->rx_params.rx_mps         = COC_MPS;
+    params->rx_params.sdu_buf.p_data = coc->rxBuffers[0];
+    params->rx_params.sdu_buf.len    = COC_SDU_SIZE;
+    params->status                   = BLE_L2CAP_CH_STATUS_CODE_SUCCESS;
+}
+
+/**@brief Channel is up, rest of the receive buffers and the credits of the peer */
+static void cocOpened(tsCoc *coc, ble_l2cap_ch_tx_params_t const *txParams)
+{
+    coc->state    = eCocOpen;
+    coc->txMtu    = txParams->tx_mtu;
+    coc->txMps    = txParams->tx_mps;
+    coc->credits  = txParams->credits;
+    coc->txQueued = 0;
+
+    for (uint8_t i = 1; i < COC_RX_BUFFERS; i++)
+    {
+        ble_data_t const buffer = {.p_data = coc->rxBuffers[i], .len = COC_SDU_SIZE};
+
+        sd_ble_l2cap_ch_rx(coc->connHandle, coc->cid, &buffer);
+    }
+    sd_ble_l2cap_ch_flow_control(coc->connHandle, coc->cid, COC_RX_CREDITS, NULL);
+
+    if (coc->handlers.stateChanged != NULL)
+    {
+        coc->handlers.stateChanged(coc->handlers.context, coc->connHandle, true);
+    }
+}
+
+/**@brief Channel is refused, released or the link is gone, queued SDUs are not sent */
+static void cocClosed(tsCoc *coc)
+{
+    uint16_t handle = coc->connHandle;
+
+    coc->state      = eCocClosed;
+    coc->connHandle = BLE_CONN_HANDLE_INVALID;
+    coc->cid        = BLE_L2CAP_CID_INVALID;
+    coc->txQueued   = 0;
+
+    if (coc->handlers.stateChanged != NULL)
+    {
+        coc->handlers.stateChanged(coc->handlers.context, handle, false);
+    }
+}
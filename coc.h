@@ -0,0 +1,90 @@
+/** @file       coc.h
+ *  @brief      L2CAP connection-oriented channel, credit based bulk transport next to GATT
+ *  @author     Evren Kenanoglu
+ *  @date       4/22/2021
+ */
+#ifndef FILE_COC_H
+#define FILE_COC_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+#include "ble.h"
+#include "ble_l2cap.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define COC_SDU_PDUS ((COC_SDU_SIZE + 2 + COC_MPS - 1) / COC_MPS) // SDU length field in the first PDU
+
+STATIC_ASSERT(COC_RX_CREDITS >= COC_SDU_PDUS);
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eCocClosed = 0,
+    eCocConnecting, // Setup request sent or answered
+    eCocOpen,
+} teCocStates;
+
+typedef void (*tpfCocTxDone)(void *context, uint16_t connHandle, uint16_t length);
+typedef void (*tpfCocRx)(void *context, uint16_t connHandle, uint8_t const *data, uint16_t length);
+typedef void (*tpfCocStateChanged)(void *context, uint16_t connHandle, bool open);
+
+/**
+ * @brief Callbacks, called in SoftDevice interrupt context
+ *
+ */
+typedef struct
+{
+    tpfCocTxDone txDone;             /**< SDU is acknowledged, its buffer is free again */
+    tpfCocRx rx;                     /**< SDU received, the buffer goes back to the SoftDevice on return */
+    tpfCocStateChanged stateChanged; /**< Channel is open or released */
+    void *context;
+} tsCocHandlers;
+
+/**
+ * @brief One channel on one link
+ *
+ */
+typedef struct
+{
+    uint8_t state; /**< teCocStates */
+    uint16_t connHandle;
+    uint16_t cid;
+    uint16_t txMtu;   /**< Largest SDU of the peer */
+    uint16_t txMps;
+    uint16_t credits; /**< Last credit grant of the peer */
+    uint8_t txQueued; /**< SDUs owned by the SoftDevice */
+    tsCocHandlers handlers;
+    uint8_t rxBuffers[COC_RX_BUFFERS][COC_SDU_SIZE];
+
+    uint32_t sdusSent;
+    uint32_t sdusReceived;
+    uint32_t creditGrants; /**< Credit events of the peer, TX was waiting for credits */
+    uint32_t refused;
+} tsCoc;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_COC_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void cocInit(tsCoc *coc, tsCocHandlers const *handlers);
+INTERFACE ret_code_t cocConnect(tsCoc *coc, uint16_t connHandle);
+INTERFACE void cocBleEventHandler(tsCoc *coc, ble_evt_t const *bleEvent);
+INTERFACE ret_code_t cocSend(tsCoc *coc, uint8_t const *data, uint16_t length);
+INTERFACE bool cocIsOpen(tsCoc const *coc);
+INTERFACE uint16_t cocSduMaxGet(tsCoc const *coc);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_COC_H
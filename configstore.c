@@ -0,0 +1,266 @@
+/** @file       configstore.c
+ *  @brief      Flash persisted runtime configuration
+ *  @author     Evren Kenanoglu
+ *  @date       4/5/2021
+ */
+#define FILE_CONFIGSTORE_C
+
+/** INCLUDES ******************************************************************/
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "configstore.h"
+#include "phaseengine.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+#define CONFIG_STORE_PAGE_ADDR(page) (CONFIG_STORE_START + (page) * CONFIG_STORE_PAGE_SIZE)
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void configStoreEventHandler(nrf_fstorage_evt_t *p_evt);
+static bool configRecordValid(tsConfigRecord const *record);
+static uint32_t configRecordCrc(tsConfigRecord const *record);
+static void configSanitize(tsRuntimeConfig *config);
+
+/** VARIABLES *****************************************************************/
+
+NRF_FSTORAGE_DEF(nrf_fstorage_t configFstorage) =
+    {
+        .evt_handler = configStoreEventHandler,
+        .start_addr  = CONFIG_STORE_START,
+        .end_addr    = CONFIG_STORE_END - 1,
+};
+
+static tsConfigStoreParams configStoreParams;
+static tsConfigRecord configStoreRecord; /**< Write buffer, has to stay valid until the write is done */
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to load the runtime configuration
+ *
+ * @details Flash is memory mapped, so loading is a validation of the two record slots and a copy of
+ *          the newest valid one. Nothing has to be initialized before, it is called first thing in main.
+ *          runtimeConfig holds the compiled defaults when no valid record is found.
+ */
+void configStoreLoad(void)
+{
+    tsConfigRecord const *pages[CONFIG_STORE_PAGE_COUNT];
+    tsConfigRecord const *newest = NULL;
+
+    configStoreDefaultsGet(&runtimeConfig);
+    configStoreParams.source     = eConfigSourceDefaults;
+    configStoreParams.activePage = CONFIG_STORE_PAGE_COUNT - 1; // First save goes to page 0
+    configStoreParams.sequence   = 0;
+
+    for (uint8_t i = 0; i < CONFIG_STORE_PAGE_COUNT; i++)
+    {
+        pages[i] = (tsConfigRecord const *)CONFIG_STORE_PAGE_ADDR(i);
+        if (!configRecordValid(pages[i]))
+        {
+            continue;
+        }
+        // Sequence compare is wrap safe
+        if (newest == NULL || (int32_t)(pages[i]->sequence - newest->sequence) > 0)
+        {
+            newest                       = pages[i];
+            configStoreParams.activePage = i;
+        }
+    }
+
+    if (newest == NULL)
+    {
+        return;
+    }
+
+    // Older records are shorter, missing fields keep their defaults
+    memcpy(&runtimeConfig, &newest->config, MIN(newest->length, sizeof(tsRuntimeConfig)));
+    configSanitize(&runtimeConfig);
+
+    configStoreParams.source   = eConfigSourceFlash;
+    configStoreParams.sequence = newest->sequence;
+}
+
+/**
+ * @brief Function to initialize flash access for configStoreSave()
+ *
+ * @details SoftDevice backend, has to be called after the SoftDevice is enabled.
+ */
+ret_code_t configStoreInit(void)
+{
+    configStoreParams.state = eConfigStoreIdle;
+
+    return nrf_fstorage_init(&configFstorage, &nrf_fstorage_sd, NULL);
+}
+
+/**
+ * @brief Function to save a configuration
+ *
+ * @param config    Configuration to be saved, copied before return
+ * @return ret_code_t NRF_ERROR_BUSY while a previous save is in progress
+ *
+ * @details The record is written to the page not holding the newest record: erase, then write.
+ *          If power is lost in between, the previous record is still the newest valid one.
+ *          runtimeConfig is not changed, a saved configuration is used from the next boot on.
+ */
+ret_code_t configStoreSave(tsRuntimeConfig const *config)
+{
+    ret_code_t errCode;
+    uint8_t page;
+
+    if (configStoreParams.state != eConfigStoreIdle)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    memset(&configStoreRecord, 0, sizeof(configStoreRecord));
+    configStoreRecord.magic    = CONFIG_STORE_MAGIC;
+    configStoreRecord.version  = CONFIG_STORE_VERSION;
+    configStoreRecord.length   = sizeof(tsRuntimeConfig);
+    configStoreRecord.sequence = configStoreParams.sequence + 1;
+    configStoreRecord.config   = *config;
+    configSanitize(&configStoreRecord.config);
+    configStoreRecord.crc = configRecordCrc(&configStoreRecord);
+
+    page    = (configStoreParams.activePage + 1) % CONFIG_STORE_PAGE_COUNT;
+    errCode = nrf_fstorage_erase(&configFstorage, CONFIG_STORE_PAGE_ADDR(page), 1, NULL);
+    VERIFY_SUCCESS(errCode);
+
+    configStoreParams.state = eConfigStoreErasing;
+    return NRF_SUCCESS;
+}
+
+/**
+ * @brief Function to get the compiled default configuration (parameters.h)
+ *
+ * @param config Configuration to be filled
+ */
+void configStoreDefaultsGet(tsRuntimeConfig *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->scanTimeout    = SCAN_TIMEOUT;
+    config->sleepDuration  = SLEEP_DURATION;
+    config->advTimeout     = ADVERTISEMENT_TIMEOUT;
+    config->minAdvInterval = MIN_ADVERTISEMENT_INTERVAL;
+    config->rssiFilter     = RSSI_FILTER_VALUE;
+    config->role           = PROGRAM_ROLE_DEFAULT;
+    config->scanDuty       = SCAN_DUTY;
+    strncpy(config->filterName, FILTER_DEVICE_NAME, CONFIG_FILTER_NAME_MAX - 1);
+}
+
+/**@brief Function to check if a save is in progress */
+bool configStoreBusy(void)
+{
+    return configStoreParams.state != eConfigStoreIdle;
+}
+
+/**@brief Function to get configuration store state */
+tsConfigStoreParams const *configStoreStatsGet(void)
+{
+    return &configStoreParams;
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**
+ * @brief fstorage event handler, continues a save with the write once the erase is done
+ */
+static void configStoreEventHandler(nrf_fstorage_evt_t *p_evt)
+{
+    uint8_t page = (configStoreParams.activePage + 1) % CONFIG_STORE_PAGE_COUNT;
+
+    if (p_evt->result != NRF_SUCCESS)
+    {
+        configStoreParams.errorCount++;
+        configStoreParams.state = eConfigStoreIdle;
+        return;
+    }
+
+    switch (p_evt->id)
+    {
+        case NRF_FSTORAGE_EVT_ERASE_RESULT:
+            if (nrf_fstorage_write(&configFstorage, CONFIG_STORE_PAGE_ADDR(page), &configStoreRecord, sizeof(configStoreRecord), NULL) != NRF_SUCCESS)
+            {
+                configStoreParams.errorCount++;
+                configStoreParams.state = eConfigStoreIdle;
+                break;
+            }
+            configStoreParams.state = eConfigStoreWriting;
+            break;
+
+        case NRF_FSTORAGE_EVT_WRITE_RESULT:
+            if (!configRecordValid((tsConfigRecord const *)CONFIG_STORE_PAGE_ADDR(page)))
+            {
+                configStoreParams.errorCount++;
+                configStoreParams.state = eConfigStoreIdle;
+                break;
+            }
+            configStoreParams.activePage = page;
+            configStoreParams.sequence   = configStoreRecord.sequence;
+            configStoreParams.saveCount++;
+            configStoreParams.state = eConfigStoreIdle;
+#if JLINK_DEBUG_PRINT_ENABLE
+            printf("CONFIG saved, page %u sequence %lu\n\r", page, configStoreParams.sequence);
+#endif
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Record check: magic, known version, sane length and crc
+ */
+static bool configRecordValid(tsConfigRecord const *record)
+{
+    return record->magic == CONFIG_STORE_MAGIC &&
+           record->version != 0 && record->version <= CONFIG_STORE_VERSION &&
+           record->length != 0 && record->length <= sizeof(tsRuntimeConfig) &&
+           record->crc == configRecordCrc(record);
+}
+
+static uint32_t configRecordCrc(tsConfigRecord const *record)
+{
+    return crc32_compute((uint8_t const *)record, offsetof(tsConfigRecord, crc), NULL);
+}
+
+/**
+ * @brief Values that would stall or break the program are replaced by defaults
+ */
+static void configSanitize(tsRuntimeConfig *config)
+{
+    if (config->role >= eRoleCount)
+    {
+        config->role = PROGRAM_ROLE_DEFAULT;
+    }
+    if (config->scanTimeout < CONFIG_TIMING_MIN_MS || config->scanTimeout > CONFIG_TIMING_MAX_MS)
+    {
+        config->scanTimeout = SCAN_TIMEOUT;
+    }
+    if (config->advTimeout < CONFIG_TIMING_MIN_MS || config->advTimeout > CONFIG_TIMING_MAX_MS)
+    {
+        config->advTimeout = ADVERTISEMENT_TIMEOUT;
+    }
+    if (config->scanTimeout + config->advTimeout > CONFIG_CYCLE_MAX_MS)
+    {
+        config->scanTimeout = SCAN_TIMEOUT;
+        config->advTimeout  = ADVERTISEMENT_TIMEOUT;
+    }
+    if (config->sleepDuration < CONFIG_TIMING_MIN_MS || config->sleepDuration > CONFIG_TIMING_MAX_MS)
+    {
+        config->sleepDuration = SLEEP_DURATION;
+    }
+    if (config->scanDuty == 0 || config->scanDuty > 100)
+    {
+        config->scanDuty = SCAN_DUTY;
+    }
+    if (config->minAdvInterval < CONFIG_ADV_INTERVAL_MIN_MS || config->minAdvInterval > CONFIG_ADV_INTERVAL_MAX_MS)
+    {
+        config->minAdvInterval = MIN_ADVERTISEMENT_INTERVAL;
+    }
+    config->filterName[CONFIG_FILTER_NAME_MAX - 1] = '\0';
+}
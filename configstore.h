@@ -0,0 +1,138 @@
+/** @file       configstore.h
+ *  @brief      Flash persisted runtime configuration
+ *  @author     Evren Kenanoglu
+ *  @date       4/5/2021
+ */
+#ifndef FILE_CONFIGSTORE_H
+#define FILE_CONFIGSTORE_H
+
+/** INCLUDES ******************************************************************/
+#include "parameters.h"
+#include "nrf_fstorage.h"
+#include "nrf_fstorage_sd.h"
+#include "crc32.h"
+#include "app_util.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define CONFIG_STORE_MAGIC   0xC0F16A7E
+#define CONFIG_STORE_VERSION 1 // Increase when fields are added to the end of tsRuntimeConfig
+
+#define CONFIG_FILTER_NAME_MAX 32 // Bytes, including terminator
+
+#define CONFIG_TIMING_MIN_MS       1       // Scan, advertising and sleep phases
+#define CONFIG_TIMING_MAX_MS       3600000 // ms
+#define CONFIG_ADV_INTERVAL_MIN_MS 20      // BLE advertising interval range
+#define CONFIG_ADV_INTERVAL_MAX_MS 10240   // ms
+#if RENDEZVOUS_ENABLE
+#define CONFIG_CYCLE_MAX_MS ((UINT32_MAX >> 8) / 1000) // Scan + advertising, master cycle in 1/256 us (rendezvous.h)
+#else
+#define CONFIG_CYCLE_MAX_MS (UINT32_MAX / 1000) // Scan + advertising, master cycle in us
+#endif
+
+/** Two pages, records are written alternately so the last valid record survives a power loss **/
+/** Linker scripts and SES projects of every target end the application flash at CONFIG_STORE_START **/
+#define CONFIG_STORE_PAGE_SIZE 0x1000
+#if defined(NRF52840_XXAA)
+#define CONFIG_STORE_FLASH_SIZE 0x100000
+#define CONFIG_STORE_START      0xDE000 // Below the dongle bootloader (0xE0000)
+#elif defined(NRF52810_XXAA) || defined(NRF52811_XXAA)
+#define CONFIG_STORE_FLASH_SIZE 0x30000
+#define CONFIG_STORE_START      0x2E000 // Last two pages, no bootloader on these targets
+#else
+#define CONFIG_STORE_FLASH_SIZE 0x80000
+#define CONFIG_STORE_START      0x76000 // Below the bootloader (0x78000)
+#endif
+#define CONFIG_STORE_PAGE_COUNT 2
+#define CONFIG_STORE_END        (CONFIG_STORE_START + CONFIG_STORE_PAGE_COUNT * CONFIG_STORE_PAGE_SIZE)
+
+STATIC_ASSERT(CONFIG_STORE_END <= CONFIG_STORE_FLASH_SIZE);
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Runtime configuration, compiled defaults are taken from parameters.h
+ *
+ * @details New fields are only added to the end, records of an older version keep the defaults
+ *          for fields they do not contain.
+ */
+typedef struct
+{
+    uint32_t scanTimeout;    // ms, SCAN_TIMEOUT
+    uint32_t sleepDuration;  // ms, SLEEP_DURATION
+    uint32_t advTimeout;     // ms, ADVERTISEMENT_TIMEOUT
+    uint32_t minAdvInterval; // ms, MIN_ADVERTISEMENT_INTERVAL
+    int8_t rssiFilter;       // dBm, RSSI_FILTER_VALUE
+    uint8_t role;            // teRoles, PROGRAM_ROLE_DEFAULT
+    uint8_t scanDuty;        // %, SCAN_DUTY, was reserved: 0 in older records
+    uint8_t reserved;
+    char filterName[CONFIG_FILTER_NAME_MAX]; // FILTER_DEVICE_NAME
+} tsRuntimeConfig;
+
+/**
+ * @brief Flash record, header + configuration + crc32 of everything before it
+ *
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length; /**< sizeof(tsRuntimeConfig) of the writer */
+    uint32_t sequence;
+    tsRuntimeConfig config;
+    uint32_t crc;
+} tsConfigRecord;
+
+STATIC_ASSERT((sizeof(tsConfigRecord) % sizeof(uint32_t)) == 0); // fstorage writes words
+
+typedef enum
+{
+    eConfigSourceDefaults = 0,
+    eConfigSourceFlash,
+} teConfigSource;
+
+typedef enum
+{
+    eConfigStoreIdle = 0,
+    eConfigStoreErasing,
+    eConfigStoreWriting,
+} teConfigStoreState;
+
+/**
+ * @brief Configuration store state
+ *
+ */
+typedef struct
+{
+    uint8_t source;     /**< teConfigSource of the loaded configuration */
+    uint8_t state;      /**< teConfigStoreState */
+    uint8_t activePage; /**< Page holding the newest valid record */
+    uint32_t sequence;  /**< Sequence of the newest valid record */
+    uint32_t saveCount;
+    uint32_t errorCount;
+} tsConfigStoreParams;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_CONFIGSTORE_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+INTERFACE tsRuntimeConfig runtimeConfig;
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void configStoreLoad(void);
+INTERFACE ret_code_t configStoreInit(void);
+INTERFACE ret_code_t configStoreSave(tsRuntimeConfig const *config);
+INTERFACE void configStoreDefaultsGet(tsRuntimeConfig *config);
+INTERFACE bool configStoreBusy(void);
+INTERFACE tsConfigStoreParams const *configStoreStatsGet(void);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_CONFIGSTORE_H
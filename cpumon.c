@@ -0,0 +1,240 @@
+/** @file       cpumon.c
+ *  @brief      CPU utilisation and ISR-time monitor based on the DWT cycle counter
+ *  @author     Evren Kenanoglu
+ *  @date       3/24/2021
+ */
+#define FILE_CPUMON_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "cpumon.h"
+
+/** CONSTANTS *****************************************************************/
+#define CPU_MON_CORE_CLOCK     64000000 // Hz
+#define CPU_MON_TICK_FREQUENCY (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+static tsCpuMonParams cpuMonParams;
+
+static const char *const cpuMonSiteNames[eCpuSiteCount] =
+    {
+        "bleEvent",
+        "timerProgram",
+        "mainLoop",
+        "advProcess",
+};
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+#if CPU_MONITOR_LEVEL >= CPU_MONITOR_LEVEL_HISTOGRAM
+static uint32_t cpuMonBucketIndex(uint32_t cycles);
+static uint32_t cpuMonBucketUpper(uint32_t index);
+#endif
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize the CPU monitor
+ *
+ * @details Enables trace and the DWT cycle counter. CYCCNT only runs while the CPU clock runs,
+ *          so phase wall time is taken from the app_timer RTC.
+ */
+void cpuMonInit(void)
+{
+    memset(&cpuMonParams, 0, sizeof(cpuMonParams));
+
+#if CPU_MONITOR_LEVEL >= CPU_MONITOR_LEVEL_HISTOGRAM
+    for (uint8_t i = 0; i < eCpuSiteCount; i++)
+    {
+        cpuMonParams.site[i].minCycles = UINT32_MAX;
+    }
+#endif
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // CYCCNT is not reset, boot profiling may be using it
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    cpuMonParams.currentPhase   = eModeFirstStart;
+    cpuMonParams.phaseStartTick = app_timer_cnt_get();
+}
+
+/**
+ * @brief Function to record one execution of an instrumented site
+ *
+ * @param site      Code site (teCpuSites)
+ * @param cycles    Cycles spent in the site
+ *
+ * @details Use CPU_MON_START()/CPU_MON_STOP() instead of calling this directly.
+ *          Nested sites (an ISR interrupting the main loop) are counted in both sites.
+ */
+void cpuMonRecord(uint8_t site, uint32_t cycles)
+{
+    tsCpuMonSite *p = &cpuMonParams.site[site];
+
+    CRITICAL_REGION_ENTER();
+    p->count++;
+    p->totalCycles += cycles;
+    if (cycles > p->maxCycles)
+    {
+        p->maxCycles = cycles;
+    }
+#if CPU_MONITOR_LEVEL >= CPU_MONITOR_LEVEL_HISTOGRAM
+    if (cycles < p->minCycles)
+    {
+        p->minCycles = cycles;
+    }
+    p->histogram[cpuMonBucketIndex(cycles)]++;
+#endif
+    cpuMonParams.phaseBusyCycles[cpuMonParams.currentPhase] += cycles;
+    CRITICAL_REGION_EXIT();
+}
+
+/**
+ * @brief Function to switch the phase that busy cycles are accounted to
+ *
+ * @param phase New program phase (teModes)
+ */
+void cpuMonPhaseSet(uint8_t phase)
+{
+    uint32_t now;
+
+    if (phase == cpuMonParams.currentPhase || phase >= eModeCount)
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    now = app_timer_cnt_get();
+    cpuMonParams.phaseTicks[cpuMonParams.currentPhase] += app_timer_cnt_diff_compute(now, cpuMonParams.phaseStartTick);
+    cpuMonParams.currentPhase   = phase;
+    cpuMonParams.phaseStartTick = now;
+    CRITICAL_REGION_EXIT();
+
+    if (phase == eModeScanning)
+    {
+        cpuMonParams.cycles++;
+#if JLINK_DEBUG_PRINT_ENABLE
+        if ((cpuMonParams.cycles % CPU_MONITOR_REPORT_INTERVAL_CYCLES) == 0)
+        {
+            cpuMonReport();
+        }
+#endif
+    }
+}
+
+/**
+ * @brief Function to get a cycle percentile of a site
+ *
+ * @param site          Code site (teCpuSites)
+ * @param percentile    Percentile 0-100
+ * @return uint32_t     upper bound of the histogram bucket holding the percentile, max cycles without histogram
+ */
+uint32_t cpuMonPercentileGet(uint8_t site, uint8_t percentile)
+{
+    tsCpuMonSite const *p = &cpuMonParams.site[site];
+
+#if CPU_MONITOR_LEVEL >= CPU_MONITOR_LEVEL_HISTOGRAM
+    uint32_t target = (uint32_t)(((uint64_t)p->count * percentile + 99) / 100);
+    uint32_t sum    = 0;
+
+    for (uint32_t i = 0; i < CPU_MON_BUCKETS; i++)
+    {
+        sum += p->histogram[i];
+        if (sum >= target && sum > 0)
+        {
+            return MIN(cpuMonBucketUpper(i), p->maxCycles);
+        }
+    }
+#endif
+    return p->maxCycles;
+}
+
+/**
+ * @brief Function to get CPU load of a phase
+ *
+ * @param phase     Program phase (teModes)
+ * @return uint32_t load in permille of the wall time spent in the phase
+ */
+uint32_t cpuMonPhaseLoadGet(uint8_t phase)
+{
+    uint64_t wallCycles = (uint64_t)cpuMonParams.phaseTicks[phase] * CPU_MON_CORE_CLOCK / CPU_MON_TICK_FREQUENCY;
+
+    if (wallCycles == 0)
+    {
+        return 0;
+    }
+    return (uint32_t)(cpuMonParams.phaseBusyCycles[phase] * 1000 / wallCycles);
+}
+
+/**@brief Function to print site statistics and per phase load */
+void cpuMonReport(void)
+{
+    for (uint8_t i = 0; i < eCpuSiteCount; i++)
+    {
+        tsCpuMonSite const *p = &cpuMonParams.site[i];
+        uint32_t avg          = p->count ? (uint32_t)(p->totalCycles / p->count) : 0;
+
+#if CPU_MONITOR_LEVEL >= CPU_MONITOR_LEVEL_HISTOGRAM
+        printf("CPU %s n=%lu min=%lu avg=%lu p99=%lu max=%lu cycles\n\r",
+               cpuMonSiteNames[i],
+               p->count,
+               p->count ? p->minCycles : 0,
+               avg,
+               cpuMonPercentileGet(i, 99),
+               p->maxCycles);
+#else
+        printf("CPU %s n=%lu avg=%lu max=%lu cycles\n\r", cpuMonSiteNames[i], p->count, avg, p->maxCycles);
+#endif
+    }
+
+    printf("CPU load permille:");
+    for (uint8_t i = 0; i < eModeCount; i++)
+    {
+        printf(" %lu", cpuMonPhaseLoadGet(i));
+    }
+    printf("\n\r");
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+#if CPU_MONITOR_LEVEL >= CPU_MONITOR_LEVEL_HISTOGRAM
+/**
+ * @brief Histogram bucket of a cycle count, log2 octaves split in linear sub-buckets
+ */
+static uint32_t cpuMonBucketIndex(uint32_t cycles)
+{
+    uint32_t msb;
+
+    if (cycles < (1UL << CPU_MON_SUB_BUCKET_BITS))
+    {
+        return cycles;
+    }
+
+    msb = 31 - __CLZ(cycles);
+    if (msb > CPU_MON_OCTAVES + CPU_MON_SUB_BUCKET_BITS - 1)
+    {
+        return CPU_MON_BUCKETS - 1;
+    }
+
+    return ((msb - CPU_MON_SUB_BUCKET_BITS + 1) << CPU_MON_SUB_BUCKET_BITS) + ((cycles >> (msb - CPU_MON_SUB_BUCKET_BITS)) & ((1UL << CPU_MON_SUB_BUCKET_BITS) - 1));
+}
+
+/**
+ * @brief Highest cycle count that falls into a histogram bucket
+ */
+static uint32_t cpuMonBucketUpper(uint32_t index)
+{
+    uint32_t octave = index >> CPU_MON_SUB_BUCKET_BITS;
+    uint32_t sub    = index & ((1UL << CPU_MON_SUB_BUCKET_BITS) - 1);
+
+    if (octave == 0)
+    {
+        return index;
+    }
+    return (((1UL << CPU_MON_SUB_BUCKET_BITS) + sub + 1) << (octave - 1)) - 1;
+}
+#endif
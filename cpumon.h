@@ -0,0 +1,100 @@
+/** @file       cpumon.h
+ *  @brief      CPU utilisation and ISR-time monitor based on the DWT cycle counter
+ *  @author     Evren Kenanoglu
+ *  @date       3/24/2021
+ */
+#ifndef FILE_CPUMON_H
+#define FILE_CPUMON_H
+
+/** INCLUDES ******************************************************************/
+#include "parameters.h"
+#include "nrf.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** Monitor Levels (CPU_MONITOR_LEVEL in parameters.h) **/
+#define CPU_MONITOR_LEVEL_OFF       0 // No instrumentation at all
+#define CPU_MONITOR_LEVEL_COUNTERS  1 // Count, total and max cycles only (production)
+#define CPU_MONITOR_LEVEL_HISTOGRAM 2 // Adds min and histogram for avg/p99 (development)
+
+/** Histogram: 4 linear sub-buckets for every power of two, up to 2^24 cycles (262 ms @64MHz) **/
+#define CPU_MON_SUB_BUCKET_BITS 2
+#define CPU_MON_OCTAVES         24
+#define CPU_MON_BUCKETS         ((CPU_MON_OCTAVES + 1) << CPU_MON_SUB_BUCKET_BITS)
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Instrumented code sites
+ *
+ */
+typedef enum
+{
+    eCpuSiteBleEvent = 0, // bleEventHandler, SoftDevice observer
+    eCpuSiteTimerProgram, // program handler, app_timer callback
+    eCpuSiteMainLoop,     // idle loop work (log processing)
+    eCpuSiteAdvProcess,   // advertising report processing, main loop (advqueue)
+    eCpuSiteCount,
+} teCpuSites;
+
+/**
+ * @brief Cycle statistics of one site
+ *
+ */
+typedef struct
+{
+    uint32_t count;
+    uint64_t totalCycles;
+    uint32_t maxCycles;
+#if CPU_MONITOR_LEVEL >= CPU_MONITOR_LEVEL_HISTOGRAM
+    uint32_t minCycles;
+    uint32_t histogram[CPU_MON_BUCKETS];
+#endif
+} tsCpuMonSite;
+
+/**
+ * @brief CPU monitor state
+ *
+ */
+typedef struct
+{
+    tsCpuMonSite site[eCpuSiteCount];
+    uint64_t phaseBusyCycles[eModeCount];
+    uint32_t phaseTicks[eModeCount];
+    uint8_t currentPhase;
+    uint32_t phaseStartTick;
+    uint32_t cycles;
+} tsCpuMonParams;
+
+/** MACROS ********************************************************************/
+
+#if CPU_MONITOR_LEVEL
+#define CPU_MON_START()    uint32_t cpuMonStartCycles = DWT->CYCCNT
+#define CPU_MON_STOP(site) cpuMonRecord((site), DWT->CYCCNT - cpuMonStartCycles)
+#else
+#define CPU_MON_START()
+#define CPU_MON_STOP(site)
+#endif
+
+#ifndef FILE_CPUMON_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void cpuMonInit(void);
+INTERFACE void cpuMonRecord(uint8_t site, uint32_t cycles);
+INTERFACE void cpuMonPhaseSet(uint8_t phase);
+INTERFACE uint32_t cpuMonPercentileGet(uint8_t site, uint8_t percentile);
+INTERFACE uint32_t cpuMonPhaseLoadGet(uint8_t phase);
+INTERFACE void cpuMonReport(void);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_CPUMON_H
@@ -0,0 +1,303 @@
+/** @file       deepsleep.c
+ *  @brief      Deep sleep (System OFF / low power System ON) for long sleep periods
+ *  @author     Evren Kenanoglu
+ *  @date       3/26/2021
+ */
+#define FILE_DEEPSLEEP_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include "deepsleep.h"
+#include "nrf_log_ctrl.h"
+#if CLI_ENABLE
+#include "cli.h"
+#endif
+
+/** CONSTANTS *****************************************************************/
+#define DEEP_SLEEP_RAM_BASE          0x20000000
+#define DEEP_SLEEP_RAM_SMALL_END     0x10000 // RAM0..RAM7, 2 x 4KB sections each
+#define DEEP_SLEEP_RAM_SMALL_BLOCK   0x2000
+#define DEEP_SLEEP_RAM_SMALL_SECTION 0x1000
+#define DEEP_SLEEP_RAM_LARGE_BLOCK   8       // RAM8 (nRF52840), 6 x 32KB sections
+#define DEEP_SLEEP_RAM_LARGE_SECTION 0x8000
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+static tsDeepSleepRetained deepSleepRetained __attribute__((section(".non_init")));
+static tsDeepSleepParams deepSleepParams;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static uint32_t deepSleepChecksum(tsDeepSleepRetained const *retained);
+#if DEEP_SLEEP_WAKE_SOURCE == DEEP_SLEEP_WAKE_LPCOMP
+static void deepSleepRamRetain(uint32_t address, uint32_t size);
+static void deepSleepWakeSourceInit(void);
+#else
+static void deepSleepPeripheralsSuspend(void);
+static void deepSleepPeripheralsResume(void);
+#endif
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to resume the program after a System OFF deep sleep (warm boot)
+ *
+ * @details Has to be called at the very beginning of main, before the SoftDevice is enabled,
+ *          because GPREGRET2 and RESETREAS are read directly.
+ *
+ * @param programParams Program parameters to be restored
+ * @return true         program is resumed, programParams holds the retained state
+ * @return false        cold boot, programParams is untouched
+ */
+bool deepSleepResume(tsProgramParams *programParams)
+{
+    deepSleepParams.resetReason = NRF_POWER->RESETREAS;
+    NRF_POWER->RESETREAS        = deepSleepParams.resetReason; // Clear read flags
+
+    if ((NRF_POWER->GPREGRET2 & DEEP_SLEEP_GPREGRET_MASK) == 0)
+    {
+        return false;
+    }
+    NRF_POWER->GPREGRET2 &= ~DEEP_SLEEP_GPREGRET_MASK;
+
+    if ((deepSleepParams.resetReason & (POWER_RESETREAS_OFF_Msk | POWER_RESETREAS_LPCOMP_Msk)) == 0 ||
+        deepSleepRetained.magic != DEEP_SLEEP_RETAINED_MAGIC ||
+        deepSleepRetained.checksum != deepSleepChecksum(&deepSleepRetained))
+    {
+        return false;
+    }
+
+    *programParams           = deepSleepRetained.programParams;
+    deepSleepRetained.magic  = 0; // Consumed, a later reset is a cold boot
+    deepSleepParams.warmBoot = 1;
+
+    return true;
+}
+
+/**
+ * @brief Function to enter deep sleep
+ *
+ * @param programParams Program parameters, retained through System OFF
+ * @param sleepDuration Sleep duration in ms
+ *
+ * @details Called from the program timer interrupt (sleepStart hook).
+ *          DEEP_SLEEP_WAKE_LPCOMP: state is saved to retained RAM, main loop flushes the log and goes to
+ *          System OFF (deepSleepProcess()). The wake up is an LPCOMP crossing, not the end of the sleep,
+ *          sleepDuration is kept for the report only. The program is resumed from reset by deepSleepResume().
+ *          DEEP_SLEEP_WAKE_RTC: the RTC cannot wake the chip from System OFF, the chip stays in System ON.
+ *          Main loop powers the log UART and the USB console down until deepSleepExit(), the RTC timer
+ *          of the sleep phase ends it.
+ */
+void deepSleepEnter(tsProgramParams const *programParams, uint32_t sleepDuration)
+{
+#if DEEP_SLEEP_WAKE_SOURCE == DEEP_SLEEP_WAKE_LPCOMP
+    deepSleepRetained.programParams                       = *programParams;
+    deepSleepRetained.programParams.programStatus         = eModeSleep; // Sleep is over, first step enters scanning
+    deepSleepRetained.programParams.programCounter        = 0;
+    deepSleepRetained.programParams.deviceDetectionStatus = eDeviceNotDetected;
+    deepSleepRetained.sleepDuration                       = sleepDuration;
+    deepSleepRetained.enterCount++;
+    deepSleepRetained.magic    = DEEP_SLEEP_RETAINED_MAGIC;
+    deepSleepRetained.checksum = deepSleepChecksum(&deepSleepRetained);
+    deepSleepParams.offPending = 1;
+#else
+    UNUSED_PARAMETER(programParams);
+
+    deepSleepParams.lowPowerPending = 1;
+#if JLINK_DEBUG_PRINT_ENABLE
+    printf("Deep sleep: System ON for %lu ms, est. %lu nA\n\r", (unsigned long)sleepDuration, DEEP_SLEEP_CURRENT_SYSTEM_ON_NA);
+#endif
+#endif
+}
+
+/**
+ * @brief Function to enter a requested System OFF or System ON deep sleep, called from main loop
+ *
+ * @details Does not return when System OFF is pending. The log is flushed here, out of the timer interrupt.
+ *          A System ON deep sleep is entered and left here, the sleep phase only sets the request.
+ */
+void deepSleepProcess(void)
+{
+#if DEEP_SLEEP_WAKE_SOURCE == DEEP_SLEEP_WAKE_LPCOMP
+    if (!deepSleepParams.offPending)
+    {
+        return;
+    }
+
+    deepSleepRamRetain((uint32_t)&deepSleepRetained, sizeof(deepSleepRetained));
+    deepSleepWakeSourceInit();
+
+    APP_ERROR_CHECK(sd_power_gpregret_set(DEEP_SLEEP_GPREGRET_ID, DEEP_SLEEP_GPREGRET_MASK));
+
+#if JLINK_DEBUG_PRINT_ENABLE
+    printf("Deep sleep: System OFF until LPCOMP wake (%lu ms requested), est. %lu nA\n\r",
+           (unsigned long)deepSleepRetained.sleepDuration,
+           DEEP_SLEEP_CURRENT_SYSTEM_OFF_NA + DEEP_SLEEP_CURRENT_RETENTION_NA * deepSleepParams.retainedSections);
+#endif
+    NRF_LOG_FLUSH();
+
+    APP_ERROR_CHECK(sd_power_system_off());
+    for (;;) // System OFF is emulated in debug interface mode
+    {
+    }
+#else
+    if (deepSleepParams.lowPowerPending == deepSleepParams.lowPower) // Also a sleep that ended before main loop ran
+    {
+        return;
+    }
+
+    if (deepSleepParams.lowPowerPending)
+    {
+        deepSleepPeripheralsSuspend();
+    }
+    else
+    {
+        deepSleepPeripheralsResume();
+    }
+#endif
+}
+
+/**
+ * @brief Function to be called when a deep sleep ends, from the program timer interrupt
+ *
+ * @details System ON: main loop brings the peripherals back before the log is processed again.
+ */
+void deepSleepExit(void)
+{
+    deepSleepParams.lowPowerPending = 0;
+}
+
+/**
+ * @brief Function to check if the log is held, the log UART is off during a System ON deep sleep
+ *
+ * @return true  log processing has to wait, the backend would block on the UART
+ */
+bool deepSleepLogHeld(void)
+{
+    return deepSleepParams.lowPower;
+}
+
+/**
+ * @brief Function to be called when scanning is started, reports resume latency once after a warm boot
+ *
+ * @details Latency is the RTC time since app_timer_init() in boardInit().
+ */
+void deepSleepScanStarted(void)
+{
+    if (!deepSleepParams.warmBoot || deepSleepParams.latencyReported)
+    {
+        return;
+    }
+    deepSleepParams.latencyReported = 1;
+
+#if JLINK_DEBUG_PRINT_ENABLE
+    printf("Deep sleep: warm boot #%lu, resume to scan latency %lu ms\n\r",
+           deepSleepRetained.enterCount,
+           app_timer_cnt_get() * 1000 / ENERGY_TICK_FREQUENCY);
+#endif
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**
+ * @brief Checksum of retained data, magic and checksum fields excluded
+ */
+static uint32_t deepSleepChecksum(tsDeepSleepRetained const *retained)
+{
+    uint8_t const *p = (uint8_t const *)&retained->programParams;
+    uint32_t size    = offsetof(tsDeepSleepRetained, checksum) - offsetof(tsDeepSleepRetained, programParams);
+    uint32_t sum     = DEEP_SLEEP_RETAINED_MAGIC;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        sum = (sum << 5) + sum + p[i];
+    }
+    return sum;
+}
+
+#if DEEP_SLEEP_WAKE_SOURCE == DEEP_SLEEP_WAKE_LPCOMP
+/**
+ * @brief Keeps RAM sections holding the address range powered in System OFF
+ */
+static void deepSleepRamRetain(uint32_t address, uint32_t size)
+{
+    uint32_t offset = address - DEEP_SLEEP_RAM_BASE;
+    uint32_t end    = offset + size;
+    uint8_t block;
+    uint8_t section;
+
+    deepSleepParams.retainedSections = 0;
+    while (offset < end)
+    {
+        if (offset < DEEP_SLEEP_RAM_SMALL_END)
+        {
+            block   = offset / DEEP_SLEEP_RAM_SMALL_BLOCK;
+            section = (offset % DEEP_SLEEP_RAM_SMALL_BLOCK) / DEEP_SLEEP_RAM_SMALL_SECTION;
+            offset  = (offset / DEEP_SLEEP_RAM_SMALL_SECTION + 1) * DEEP_SLEEP_RAM_SMALL_SECTION;
+        }
+        else
+        {
+            block   = DEEP_SLEEP_RAM_LARGE_BLOCK;
+            section = (offset - DEEP_SLEEP_RAM_SMALL_END) / DEEP_SLEEP_RAM_LARGE_SECTION;
+            offset  = DEEP_SLEEP_RAM_SMALL_END + (section + 1) * DEEP_SLEEP_RAM_LARGE_SECTION;
+        }
+
+        APP_ERROR_CHECK(sd_power_ram_power_set(block, (POWER_RAM_POWER_S0POWER_Msk | POWER_RAM_POWER_S0RETENTION_Msk) << section));
+        deepSleepParams.retainedSections++;
+    }
+}
+
+/**
+ * @brief Configures LPCOMP to wake the chip from System OFF on an upward crossing
+ */
+static void deepSleepWakeSourceInit(void)
+{
+    nrf_lpcomp_config_t const config =
+        {
+            .reference = NRF_LPCOMP_REF_SUPPLY_4_8,
+            .detection = NRF_LPCOMP_DETECT_UP,
+#if defined(LPCOMP_FEATURE_HYST_PRESENT)
+            .hyst = NRF_LPCOMP_HYST_50mV,
+#endif
+        };
+
+    nrf_lpcomp_configure(&config);
+    nrf_lpcomp_input_select((nrf_lpcomp_input_t)DEEP_SLEEP_LPCOMP_INPUT);
+    nrf_lpcomp_enable();
+    nrf_lpcomp_task_trigger(NRF_LPCOMP_TASK_START);
+}
+#else
+/**
+ * @brief Powers the log UART and the console transport down for a System ON deep sleep
+ *
+ * @details The log is flushed first and held until the resume. The UARTE keeps its configuration while
+ *          disabled, the log backend driver finds it as it left it. USBD releases the HF crystal, the
+ *          SoftDevice requests it only around radio events.
+ */
+static void deepSleepPeripheralsSuspend(void)
+{
+    NRF_LOG_FLUSH();
+
+    deepSleepParams.uartEnable = NRF_UARTE0->ENABLE; // Log backend, UART or UARTE (UART_EASY_DMA_SUPPORT)
+    NRF_UARTE0->ENABLE         = 0;
+#if CLI_ENABLE
+    cliSuspend();
+#endif
+    deepSleepParams.lowPower = 1;
+}
+
+/**
+ * @brief Brings the peripherals of deepSleepPeripheralsSuspend() back
+ */
+static void deepSleepPeripheralsResume(void)
+{
+    NRF_UARTE0->ENABLE = deepSleepParams.uartEnable;
+#if CLI_ENABLE
+    cliResume();
+#endif
+    deepSleepParams.lowPower = 0;
+}
+#endif
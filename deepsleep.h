@@ -0,0 +1,80 @@
+/** @file       deepsleep.h
+ *  @brief      Deep sleep (System OFF / low power System ON) for long sleep periods
+ *  @author     Evren Kenanoglu
+ *  @date       3/26/2021
+ */
+#ifndef FILE_DEEPSLEEP_H
+#define FILE_DEEPSLEEP_H
+
+/** INCLUDES ******************************************************************/
+#include "parameters.h"
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nrf_lpcomp.h"
+#include "app_timer.h"
+#include "energy.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define DEEP_SLEEP_RETAINED_MAGIC 0x5EE9B007
+#define DEEP_SLEEP_GPREGRET_ID    1    // GPREGRET2, GPREGRET is used by the bootloader
+#define DEEP_SLEEP_GPREGRET_MASK  0x01 // Set while sleeping in System OFF
+
+/** Estimated sleep floor currents (nA) **/
+#define DEEP_SLEEP_CURRENT_SYSTEM_OFF_NA  400UL // System OFF, LPCOMP running
+#define DEEP_SLEEP_CURRENT_RETENTION_NA   30UL  // Per retained 4KB RAM section
+#define DEEP_SLEEP_CURRENT_SYSTEM_ON_NA   (ENERGY_CURRENT_SLEEP_UA * 1000UL) // System ON, RTC running, UART and USB down
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Program state kept in retained RAM through System OFF
+ *
+ */
+typedef struct
+{
+    uint32_t magic;
+    tsProgramParams programParams;
+    uint32_t sleepDuration; // ms, requested, reported only: the LPCOMP wake is not timed
+    uint32_t enterCount;
+    uint32_t checksum;
+} tsDeepSleepRetained;
+
+/**
+ * @brief Deep sleep state
+ *
+ */
+typedef struct
+{
+    uint8_t warmBoot;        /**< Set when the program is resumed from System OFF */
+    uint8_t latencyReported; /**< Resume latency is reported once, at the first scan */
+    uint8_t offPending;      /**< System OFF requested, entered from main loop */
+    uint8_t lowPowerPending; /**< System ON deep sleep requested, set and cleared by the sleep phase */
+    uint8_t lowPower;        /**< Peripherals are down for a System ON deep sleep, log is held */
+    uint32_t uartEnable;     /**< ENABLE of the log UART(E) before the deep sleep */
+    uint32_t resetReason;
+    uint32_t retainedSections;
+} tsDeepSleepParams;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_DEEPSLEEP_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE bool deepSleepResume(tsProgramParams *programParams);
+INTERFACE void deepSleepEnter(tsProgramParams const *programParams, uint32_t sleepDuration);
+INTERFACE void deepSleepExit(void);
+INTERFACE void deepSleepProcess(void);
+INTERFACE bool deepSleepLogHeld(void);
+INTERFACE void deepSleepScanStarted(void);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_DEEPSLEEP_H
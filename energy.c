@@ -0,0 +1,263 @@
+/** @file       energy.c
+ *  @brief      Per-phase energy accounting (radio, cpu and sleep time)
+ *  @author     Evren Kenanoglu
+ *  @date       3/22/2021
+ */
+#define FILE_ENERGY_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "energy.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+static tsEnergyParams energyParams;
+
+static const char *const energyPhaseNames[eModeCount] =
+    {
+        "FirstStart",
+        "Sleep",
+        "InitBle",
+        "Scanning",
+        "Advertising",
+};
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static uint32_t energyRadioCurrentGet(uint8_t phase);
+static uint64_t energyCpuTicksGet(tsEnergyPhase const *p);
+static uint64_t energyChargeCompute(uint8_t phase, tsEnergyPhase const *p);
+static uint32_t energyTicksToMs(uint64_t ticks);
+static void energyPhaseCopy(uint8_t phase, tsEnergyPhase *p);
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize energy accounting
+ *
+ * @details Radio notifications are configured on both active and inactive edges, so the radio
+ *          notification interrupt toggles between radio-on and radio-off timestamps.
+ *          Has to be called after the SoftDevice is enabled.
+ *
+ * @return ret_code_t returns error code
+ */
+ret_code_t energyInit(void)
+{
+    ret_code_t errCode;
+
+    memset(&energyParams, 0, sizeof(energyParams));
+    energyParams.currentPhase   = eModeFirstStart;
+    energyParams.phaseStartTick = app_timer_cnt_get();
+
+    errCode = sd_nvic_ClearPendingIRQ(RADIO_NOTIFICATION_IRQn);
+    VERIFY_SUCCESS(errCode);
+
+    errCode = sd_nvic_SetPriority(RADIO_NOTIFICATION_IRQn, APP_IRQ_PRIORITY_LOW);
+    VERIFY_SUCCESS(errCode);
+
+    errCode = sd_nvic_EnableIRQ(RADIO_NOTIFICATION_IRQn);
+    VERIFY_SUCCESS(errCode);
+
+    errCode = sd_radio_notification_cfg_set(NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH, NRF_RADIO_NOTIFICATION_DISTANCE_NONE);
+    VERIFY_SUCCESS(errCode);
+
+    return errCode;
+}
+
+/**
+ * @brief Function to switch the phase that time is accounted to
+ *
+ * @param phase New program phase (teModes)
+ *
+ * @details Calling it with the current phase does nothing, so it can be called after every program task.
+ */
+void energyPhaseSet(uint8_t phase)
+{
+    uint32_t now;
+
+    if (phase == energyParams.currentPhase || phase >= eModeCount)
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    now = app_timer_cnt_get();
+
+    energyParams.phase[energyParams.currentPhase].totalTicks += app_timer_cnt_diff_compute(now, energyParams.phaseStartTick);
+
+    if (energyParams.radioActive) // Split radio time at the phase boundary
+    {
+        energyParams.phase[energyParams.currentPhase].radioTicks += app_timer_cnt_diff_compute(now, energyParams.radioStartTick);
+        energyParams.radioStartTick = now;
+    }
+
+    if (energyParams.sleeping) // Woken up by the phase change, the sleep so far belongs to the old phase
+    {
+        energyParams.phase[energyParams.currentPhase].sleepTicks += app_timer_cnt_diff_compute(now, energyParams.sleepStartTick);
+        energyParams.sleeping = 0;
+    }
+
+    energyParams.currentPhase   = phase;
+    energyParams.phaseStartTick = now;
+    energyParams.phase[phase].entries++;
+    CRITICAL_REGION_EXIT();
+
+    if (phase == eModeScanning)
+    {
+        energyParams.cycles++;
+#if JLINK_DEBUG_PRINT_ENABLE
+        if ((energyParams.cycles % ENERGY_REPORT_INTERVAL_CYCLES) == 0)
+        {
+            energyReport();
+        }
+#endif
+    }
+}
+
+/**@brief Function to be called just before the CPU goes to sleep */
+void energySleepEnter(void)
+{
+    energyParams.sleepStartTick = app_timer_cnt_get();
+    energyParams.sleeping       = 1;
+}
+
+/**
+ * @brief Function to be called just after the CPU wakes up
+ *
+ * @details Nothing to book when the waking interrupt changed the phase, energyPhaseSet() took the sleep.
+ */
+void energySleepExit(void)
+{
+    CRITICAL_REGION_ENTER();
+    if (energyParams.sleeping)
+    {
+        energyParams.phase[energyParams.currentPhase].sleepTicks += app_timer_cnt_diff_compute(app_timer_cnt_get(), energyParams.sleepStartTick);
+        energyParams.sleeping = 0;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+/**
+ * @brief Function to get estimated charge used in a phase
+ *
+ * @param phase Program phase (teModes)
+ * @return uint64_t estimated charge in uC
+ */
+uint64_t energyPhaseChargeGet(uint8_t phase)
+{
+    tsEnergyPhase p;
+
+    energyPhaseCopy(phase, &p);
+
+    return energyChargeCompute(phase, &p);
+}
+
+/**
+ * @brief Function to get the totals of a phase, time in ms and estimated charge
+ *
+ * @details The time of the phase in progress is booked at its end, totals grow in phase steps.
+ *
+ * @param phase  Program phase (teModes)
+ * @param totals Totals of the phase since boot
+ */
+void energyPhaseTotalsGet(uint8_t phase, tsEnergyTotals *totals)
+{
+    tsEnergyPhase p;
+
+    energyPhaseCopy(phase, &p);
+
+    totals->radioMs  = energyTicksToMs(p.radioTicks);
+    totals->cpuMs    = energyTicksToMs(energyCpuTicksGet(&p));
+    totals->sleepMs  = energyTicksToMs(p.sleepTicks);
+    totals->chargeUc = (uint32_t)energyChargeCompute(phase, &p);
+}
+
+/**@brief Function to print accumulated energy figures for every phase */
+void energyReport(void)
+{
+    uint64_t totalCharge = 0;
+
+    printf("ENERGY cycles=%lu\n\r", energyParams.cycles);
+    for (uint8_t i = 0; i < eModeCount; i++)
+    {
+        tsEnergyPhase p;
+        uint64_t charge;
+
+        energyPhaseCopy(i, &p);
+        charge = energyChargeCompute(i, &p);
+
+        totalCharge += charge;
+        printf("ENERGY %s total=%lu radio=%lu cpu=%lu sleep=%lu ms charge=%lu uC\n\r",
+               energyPhaseNames[i],
+               energyTicksToMs(p.totalTicks),
+               energyTicksToMs(p.radioTicks),
+               energyTicksToMs(energyCpuTicksGet(&p)),
+               energyTicksToMs(p.sleepTicks),
+               (uint32_t)charge);
+    }
+    printf("ENERGY total charge=%lu uC\n\r", (uint32_t)totalCharge);
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief Radio notification interrupt, toggles on every radio active/inactive edge */
+void RADIO_NOTIFICATION_IRQHandler(void)
+{
+    uint32_t now = app_timer_cnt_get();
+
+    energyParams.radioActive = !energyParams.radioActive;
+
+    if (energyParams.radioActive)
+    {
+        energyParams.radioStartTick = now;
+    }
+    else
+    {
+        energyParams.phase[energyParams.currentPhase].radioTicks += app_timer_cnt_diff_compute(now, energyParams.radioStartTick);
+    }
+}
+
+/**
+ * @brief Radio current of a phase, advertising is mostly TX, every other phase is mostly RX
+ */
+static uint32_t energyRadioCurrentGet(uint8_t phase)
+{
+    return (phase == eModeAdvertising) ? ENERGY_CURRENT_RADIO_TX_UA : ENERGY_CURRENT_RADIO_RX_UA;
+}
+
+/**@brief CPU active time of a phase, total - sleep, 0 while a booking is in flight */
+static uint64_t energyCpuTicksGet(tsEnergyPhase const *p)
+{
+    return (p->totalTicks > p->sleepTicks) ? (p->totalTicks - p->sleepTicks) : 0;
+}
+
+/**@brief Estimated charge of a phase in uC, from a copy of its ticks */
+static uint64_t energyChargeCompute(uint8_t phase, tsEnergyPhase const *p)
+{
+    uint64_t charge; // uA * ticks
+
+    charge = energyCpuTicksGet(p) * ENERGY_CURRENT_CPU_UA;
+    charge += p->sleepTicks * ENERGY_CURRENT_SLEEP_UA;
+    charge += p->radioTicks * energyRadioCurrentGet(phase);
+
+    return charge / ENERGY_TICK_FREQUENCY;
+}
+
+static uint32_t energyTicksToMs(uint64_t ticks)
+{
+    return (uint32_t)((ticks * 1000) / ENERGY_TICK_FREQUENCY);
+}
+
+/**@brief Copy of the ticks of a phase, 64 bit fields are not read atomically and the radio interrupt books into them */
+static void energyPhaseCopy(uint8_t phase, tsEnergyPhase *p)
+{
+    CRITICAL_REGION_ENTER();
+    *p = energyParams.phase[phase];
+    CRITICAL_REGION_EXIT();
+}
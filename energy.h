@@ -0,0 +1,110 @@
+/** @file       energy.h
+ *  @brief      Per-phase energy accounting (radio, cpu and sleep time)
+ *  @author     Evren Kenanoglu
+ *  @date       3/22/2021
+ */
+#ifndef FILE_ENERGY_H
+#define FILE_ENERGY_H
+
+/** INCLUDES ******************************************************************/
+#include "parameters.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "nrf_soc.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** RTC tick frequency used for all energy timestamps (app_timer RTC1) **/
+#define ENERGY_TICK_FREQUENCY (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) // Hz
+
+/** Current Model (uA) **/
+#if defined(BOARD_PCA10059) // nRF52840 dongle, internal LDO from USB/VDDH
+#define ENERGY_CURRENT_CPU_UA      6300
+#define ENERGY_CURRENT_RADIO_RX_UA 10100
+#define ENERGY_CURRENT_RADIO_TX_UA 10500
+#define ENERGY_CURRENT_SLEEP_UA    3
+#define ENERGY_CURRENT_SAADC_UA    1500 // Converting, with HFINT
+#elif defined(BOARD_PCA10056) // nRF52840 DK (pca10056 & pca10056e), DC/DC enabled
+#define ENERGY_CURRENT_CPU_UA      3300
+#define ENERGY_CURRENT_RADIO_RX_UA 6260
+#define ENERGY_CURRENT_RADIO_TX_UA 6400
+#define ENERGY_CURRENT_SLEEP_UA    3
+#define ENERGY_CURRENT_SAADC_UA    800
+#else // nRF52832 DK (pca10040 & pca10040e), DC/DC enabled
+#define ENERGY_CURRENT_CPU_UA      3700
+#define ENERGY_CURRENT_RADIO_RX_UA 5400
+#define ENERGY_CURRENT_RADIO_TX_UA 5300
+#define ENERGY_CURRENT_SLEEP_UA    2
+#define ENERGY_CURRENT_SAADC_UA    800
+#endif
+
+/** CPU wake up from System ON idle, clock start, interrupt entry and exit, not seen by the cycle counter **/
+#define ENERGY_WAKEUP_US 15 // us
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Time accumulated in one program phase, in RTC ticks
+ *
+ * @details 64 bit, 32 bit ticks at ENERGY_TICK_FREQUENCY wrap after 72.8 hours of a phase.
+ */
+typedef struct
+{
+    uint64_t radioTicks; /**< Radio active (from radio notifications) */
+    uint64_t sleepTicks; /**< CPU sleeping in nrf_pwr_mgmt_run() */
+    uint64_t totalTicks; /**< Total time spent in the phase, cpu active = total - sleep */
+    uint32_t entries;    /**< Number of times phase is entered */
+} tsEnergyPhase;
+
+/**
+ * @brief Energy accounting state
+ *
+ */
+typedef struct
+{
+    tsEnergyPhase phase[eModeCount];
+    uint8_t currentPhase;
+    uint32_t phaseStartTick;
+    uint32_t sleepStartTick;
+    uint32_t radioStartTick;
+    uint8_t radioActive;
+    uint8_t sleeping; /**< Between energySleepEnter() and the first wake up work */
+    uint32_t cycles;
+} tsEnergyParams;
+
+/**
+ * @brief Totals of one phase since boot, for the metrics gauges
+ *
+ * @details Derived from the 64 bit tick totals, ms wrap after 49.7 days and uC after 4295 C.
+ */
+typedef struct
+{
+    uint32_t radioMs;
+    uint32_t cpuMs;
+    uint32_t sleepMs;
+    uint32_t chargeUc;
+} tsEnergyTotals;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_ENERGY_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE ret_code_t energyInit(void);
+INTERFACE void energyPhaseSet(uint8_t phase);
+INTERFACE void energySleepEnter(void);
+INTERFACE void energySleepExit(void);
+INTERFACE uint64_t energyPhaseChargeGet(uint8_t phase);
+INTERFACE void energyPhaseTotalsGet(uint8_t phase, tsEnergyTotals *totals);
+INTERFACE void energyReport(void);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_ENERGY_H
@@ -0,0 +1,524 @@
+/** @file       harvest.c
+ *  @brief      Multi-link central, master pulls the stream service of several slaves at once
+ *  @author     Evren Kenanoglu
+ *  @date       4/21/2021
+ */
+#define FILE_HARVEST_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "harvest.h"
+#include "stream.h"
+#include "app_timer.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define HARVEST_TICK_FREQUENCY (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static tsHarvestLink *harvestLinkGet(tsHarvest *harvest, uint16_t connHandle);
+static void harvestLinkStart(tsHarvest *harvest, uint16_t connHandle, uint8_t const *addr);
+static void harvestCharsDiscovered(tsHarvest *harvest, tsHarvestLink *link, ble_gattc_evt_char_disc_rsp_t const *response);
+static void harvestWrite(tsHarvestLink *link, uint16_t handle, uint8_t const *data, uint16_t length);
+static void harvestData(tsHarvest *harvest, tsHarvestLink *link, uint16_t length);
+static char const *harvestTransportGet(tsHarvestLink const *link);
+static void harvestConnParamsGet(uint16_t interval, ble_gap_conn_params_t *params);
+static void harvestIntervalTune(tsHarvest *harvest);
+#if COC_ENABLE
+static void harvestSduReceived(void *context, uint16_t connHandle, uint8_t const *data, uint16_t length);
+static void harvestChannelChanged(void *context, uint16_t connHandle, bool open);
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/**< Scan parameters while a connection is initiated */
+static ble_gap_scan_params_t const harvestScanParams =
+    {
+        .active        = 0,
+        .interval      = NRF_BLE_SCAN_SCAN_INTERVAL,
+        .window        = NRF_BLE_SCAN_SCAN_WINDOW,
+        .filter_policy = BLE_GAP_SCAN_FP_ACCEPT_ALL,
+        .timeout       = HARVEST_CONNECT_TIMEOUT_MS / 10,
+        .scan_phys     = BLE_GAP_PHY_1MBPS,
+};
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize the central links
+ *
+ * @param harvest   Harvest instance
+ * @return ret_code_t SoftDevice error
+ *
+ * @details The stream base UUID is added again, the SoftDevice returns the same type when the
+ *          stream service registered it already.
+ */
+ret_code_t harvestInit(tsHarvest *harvest)
+{
+    ble_uuid128_t base = {STREAM_UUID_BASE};
+
+    memset(harvest, 0, sizeof(*harvest));
+    for (uint8_t i = 0; i < HARVEST_LINK_COUNT; i++)
+    {
+        harvest->links[i].connHandle = BLE_CONN_HANDLE_INVALID;
+    }
+    harvest->connInterval = HARVEST_CONN_INTERVAL(1);
+
+    return sd_ble_uuid_vs_add(&base, &harvest->uuidType);
+}
+
+/**
+ * @brief Function to connect to a slave seen in a scan
+ *
+ * @param harvest   Harvest instance
+ * @param record    Advertising record
+ * @return true     connection is initiated, scanning is stopped by the SoftDevice
+ *
+ * @details Connectable slaves with the slave name only, one connection attempt at a time.
+ */
+bool harvestCandidate(tsHarvest *harvest, tsAdvRecord const *record)
+{
+    ble_gap_addr_t peer;
+    ble_gap_conn_params_t params;
+    uint8_t free = HARVEST_LINK_COUNT;
+
+    if (!record->connectable || harvest->connecting || record->rssi < HARVEST_RSSI_MIN)
+    {
+        return false;
+    }
+
+    if (!record->nameComplete || record->nameLength != strlen(DEVICE_NAME_SLAVE) ||
+        memcmp(&record->data[record->nameOffset], DEVICE_NAME_SLAVE, record->nameLength) != 0)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < HARVEST_LINK_COUNT; i++)
+    {
+        if (harvest->links[i].state == eHarvestLinkFree)
+        {
+            free = i;
+        }
+        else if (memcmp(harvest->links[i].addr, record->addr, BLE_GAP_ADDR_LEN) == 0)
+        {
+            return false; // Connected already
+        }
+    }
+    if (free == HARVEST_LINK_COUNT)
+    {
+        return false;
+    }
+
+    memset(&peer, 0, sizeof(peer));
+    peer.addr_type = record->addrType;
+    memcpy(peer.addr, record->addr, BLE_GAP_ADDR_LEN);
+    harvestConnParamsGet(HARVEST_CONN_INTERVAL(harvestLinkCountGet(harvest) + 1), &params); // Interval it shares once connected
+    if (sd_ble_gap_connect(&peer, &harvestScanParams, &params, APP_BLE_CONN_CFG_TAG) != NRF_SUCCESS)
+    {
+        return false;
+    }
+
+    harvest->connecting = 1;
+    memcpy(harvest->connectingAddr, record->addr, BLE_GAP_ADDR_LEN);
+    return true;
+}
+
+/**
+ * @brief Function to handle the BLE events of the central links
+ *
+ * @param harvest   Harvest instance
+ * @param bleEvent  SoftDevice event
+ *
+ * @details Runs in SoftDevice interrupt context. Discovery and subscription are one GATT procedure at
+ *          a time per link, each response starts the next one.
+ */
+void harvestBleEventHandler(tsHarvest *harvest, ble_evt_t const *bleEvent)
+{
+    uint16_t connHandle = bleEvent->evt.gap_evt.conn_handle;
+    tsHarvestLink *link;
+
+    switch (bleEvent->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            if (bleEvent->evt.gap_evt.params.connected.role == BLE_GAP_ROLE_CENTRAL)
+            {
+                harvest->connecting = 0;
+                harvest->connects++;
+                harvestLinkStart(harvest, connHandle, bleEvent->evt.gap_evt.params.connected.peer_addr.addr);
+                harvestIntervalTune(harvest);
+            }
+            return;
+
+        case BLE_GAP_EVT_TIMEOUT:
+            if (bleEvent->evt.gap_evt.params.timeout.src == BLE_GAP_TIMEOUT_SRC_CONN)
+            {
+                harvest->connecting = 0;
+                harvest->connectTimeouts++;
+            }
+            return;
+
+        default:
+            break;
+    }
+
+    // Link events, GATTC events have the connection handle at the same place
+    link = harvestLinkGet(harvest, connHandle);
+    if (link == NULL)
+    {
+        return;
+    }
+#if COC_ENABLE
+    cocBleEventHandler(&link->coc, bleEvent); // L2CAP events have the connection handle at the same place too
+#endif
+
+    switch (bleEvent->header.evt_id)
+    {
+        case BLE_GAP_EVT_DISCONNECTED:
+            harvest->disconnects++;
+            memset(link, 0, sizeof(*link));
+            link->connHandle = BLE_CONN_HANDLE_INVALID;
+            harvestIntervalTune(harvest);
+            break;
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE_REQUEST:
+        {
+            ble_gap_conn_params_t params;
+
+            // Slave stream asks for its own interval, the links keep their places in the shared interval
+            harvestConnParamsGet(harvest->connInterval, &params);
+            sd_ble_gap_conn_param_update(connHandle, &params);
+        }
+        break;
+
+        case BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP:
+        {
+            ble_gattc_evt_prim_srvc_disc_rsp_t const *response = &bleEvent->evt.gattc_evt.params.prim_srvc_disc_rsp;
+            ble_gattc_handle_range_t range;
+
+            if (bleEvent->evt.gattc_evt.gatt_status != BLE_GATT_STATUS_SUCCESS || response->count == 0)
+            {
+                sd_ble_gap_disconnect(connHandle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION); // No stream service
+                break;
+            }
+            link->handleStart  = response->services[0].handle_range.start_handle;
+            link->handleEnd    = response->services[0].handle_range.end_handle;
+            link->state        = eHarvestLinkChars;
+            range.start_handle = link->handleStart;
+            range.end_handle   = link->handleEnd;
+            sd_ble_gattc_characteristics_discover(connHandle, &range);
+        }
+        break;
+
+        case BLE_GATTC_EVT_CHAR_DISC_RSP:
+            if (bleEvent->evt.gattc_evt.gatt_status != BLE_GATT_STATUS_SUCCESS)
+            {
+                sd_ble_gap_disconnect(connHandle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+                break;
+            }
+            harvestCharsDiscovered(harvest, link, &bleEvent->evt.gattc_evt.params.char_disc_rsp);
+            break;
+
+        case BLE_GATTC_EVT_WRITE_RSP:
+            if (link->state == eHarvestLinkSubscribe)
+            {
+                uint8_t mode = HARVEST_BULK_TEST ? eStreamModeBulk : eStreamModeRecords;
+
+                link->state = eHarvestLinkMode;
+                harvestWrite(link, link->controlHandle, &mode, sizeof(mode));
+            }
+            else if (link->state == eHarvestLinkMode)
+            {
+#if COC_ENABLE
+                if (cocConnect(&link->coc, connHandle) == NRF_SUCCESS)
+                {
+                    link->state = eHarvestLinkChannel; // Records move to the channel when it opens
+                    break;
+                }
+#endif
+                link->state = eHarvestLinkStreaming;
+                NRF_LOG_INFO("Harvest: link %d streaming.", link - harvest->links);
+            }
+            break;
+
+        case BLE_GATTC_EVT_HVX:
+            if (bleEvent->evt.gattc_evt.params.hvx.handle == link->recordsHandle)
+            {
+                harvestData(harvest, link, bleEvent->evt.gattc_evt.params.hvx.len);
+            }
+            break;
+
+        case BLE_GATTC_EVT_TIMEOUT:
+            sd_ble_gap_disconnect(connHandle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Function to handle nrf_ble_gatt events of the central links
+ *
+ * @param harvest   Harvest instance
+ * @param gattEvent nrf_ble_gatt event
+ */
+void harvestGattEventHandler(tsHarvest *harvest, nrf_ble_gatt_evt_t const *gattEvent)
+{
+    tsHarvestLink *link = harvestLinkGet(harvest, gattEvent->conn_handle);
+
+    if (link != NULL && gattEvent->evt_id == NRF_BLE_GATT_EVT_ATT_MTU_UPDATED)
+    {
+        link->attMtu = gattEvent->params.att_mtu_effective;
+    }
+}
+
+/**@brief Function to get the number of connected slaves */
+uint8_t harvestLinkCountGet(tsHarvest const *harvest)
+{
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < HARVEST_LINK_COUNT; i++)
+    {
+        count += (harvest->links[i].state != eHarvestLinkFree);
+    }
+    return count;
+}
+
+/**
+ * @brief Function to print the aggregate and per link throughput of the last window
+ *
+ * @param harvest   Harvest instance
+ */
+void harvestReport(tsHarvest const *harvest)
+{
+    printf("HARVEST links=%u %lu kbit/s ci=%u.%02u ms connects=%lu timeouts=%lu disconnects=%lu\n\r",
+           harvestLinkCountGet(harvest), harvest->kbps,
+           harvest->connInterval * 125 / 100, harvest->connInterval * 125 % 100,
+           harvest->connects, harvest->connectTimeouts, harvest->disconnects);
+
+    for (uint8_t i = 0; i < HARVEST_LINK_COUNT; i++)
+    {
+        tsHarvestLink const *link = &harvest->links[i];
+
+        if (link->state != eHarvestLinkFree)
+        {
+            printf("HARVEST link %u %02x:%02x state=%u %s mtu=%u %u kbit/s packets=%lu bytes=%lu\n\r",
+                   i, link->addr[1], link->addr[0], link->state, harvestTransportGet(link), link->attMtu, link->kbps,
+                   link->packets, (uint32_t)link->bytes);
+        }
+    }
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief Link of a connection handle, NULL: not a harvest link */
+static tsHarvestLink *harvestLinkGet(tsHarvest *harvest, uint16_t connHandle)
+{
+    for (uint8_t i = 0; i < HARVEST_LINK_COUNT; i++)
+    {
+        if (harvest->links[i].state != eHarvestLinkFree && harvest->links[i].connHandle == connHandle)
+        {
+            return &harvest->links[i];
+        }
+    }
+    return NULL;
+}
+
+/**@brief Same interval for every link, the SoftDevice places the links back to back in it */
+static void harvestConnParamsGet(uint16_t interval, ble_gap_conn_params_t *params)
+{
+    params->min_conn_interval = interval;
+    params->max_conn_interval = interval;
+    params->slave_latency     = 0;
+    params->conn_sup_timeout  = STREAM_CONN_SUP_TIMEOUT;
+}
+
+/**
+ * @brief Shared interval for the links connected now, one event length each
+ *
+ * @details An interval sized for HARVEST_LINK_COUNT leaves the radio idle while fewer slaves are
+ *          connected, the remaining links are moved to the interval of their count.
+ */
+static void harvestIntervalTune(tsHarvest *harvest)
+{
+    uint16_t interval = HARVEST_CONN_INTERVAL(harvestLinkCountGet(harvest));
+    ble_gap_conn_params_t params;
+
+    if (interval == harvest->connInterval)
+    {
+        return;
+    }
+
+    harvest->connInterval = interval;
+    harvestConnParamsGet(interval, &params);
+    for (uint8_t i = 0; i < HARVEST_LINK_COUNT; i++)
+    {
+        if (harvest->links[i].state != eHarvestLinkFree)
+        {
+            sd_ble_gap_conn_param_update(harvest->links[i].connHandle, &params); // Busy links keep the previous one
+        }
+    }
+}
+
+/**@brief New central link, stream service discovery */
+static void harvestLinkStart(tsHarvest *harvest, uint16_t connHandle, uint8_t const *addr)
+{
+    ble_uuid_t const uuid = {.uuid = STREAM_UUID_SERVICE, .type = harvest->uuidType};
+
+    for (uint8_t i = 0; i < HARVEST_LINK_COUNT; i++)
+    {
+        tsHarvestLink *link = &harvest->links[i];
+
+        if (link->state == eHarvestLinkFree)
+        {
+            memset(link, 0, sizeof(*link));
+            link->state      = eHarvestLinkService;
+            link->connHandle = connHandle;
+            link->attMtu     = BLE_GATT_ATT_MTU_DEFAULT;
+            memcpy(link->addr, addr, BLE_GAP_ADDR_LEN);
+#if COC_ENABLE
+            tsCocHandlers const handlers = {.rx = harvestSduReceived, .stateChanged = harvestChannelChanged, .context = harvest};
+
+            cocInit(&link->coc, &handlers);
+#endif
+            sd_ble_gattc_primary_services_discover(connHandle, 1, &uuid);
+            return;
+        }
+    }
+
+    sd_ble_gap_disconnect(connHandle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION); // No free link, cannot happen with the link count check
+}
+
+/**
+ * @brief Characteristic discovery response, continued until both stream characteristics are found
+ *
+ * @details The records CCCD is the handle after the value, characteristic_add() puts it there when
+ *          there is no user description.
+ */
+static void harvestCharsDiscovered(tsHarvest *harvest, tsHarvestLink *link, ble_gattc_evt_char_disc_rsp_t const *response)
+{
+    uint16_t last = link->handleStart;
+
+    for (uint16_t i = 0; i < response->count; i++)
+    {
+        ble_gattc_char_t const *characteristic = &response->chars[i];
+
+        if (characteristic->uuid.type == harvest->uuidType && characteristic->uuid.uuid == STREAM_UUID_RECORDS)
+        {
+            link->recordsHandle = characteristic->handle_value;
+        }
+        else if (characteristic->uuid.type == harvest->uuidType && characteristic->uuid.uuid == STREAM_UUID_CONTROL)
+        {
+            link->controlHandle = characteristic->handle_value;
+        }
+        last = characteristic->handle_value;
+    }
+
+    if (link->recordsHandle != 0 && link->controlHandle != 0)
+    {
+        uint8_t cccd[2] = {BLE_GATT_HVX_NOTIFICATION, 0};
+
+        link->state = eHarvestLinkSubscribe;
+        harvestWrite(link, link->recordsHandle + 1, cccd, sizeof(cccd));
+    }
+    else if (response->count != 0 && last < link->handleEnd)
+    {
+        ble_gattc_handle_range_t range = {.start_handle = last + 1, .end_handle = link->handleEnd};
+
+        sd_ble_gattc_characteristics_discover(link->connHandle, &range);
+    }
+    else
+    {
+        sd_ble_gap_disconnect(link->connHandle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+    }
+}
+
+/**@brief Write request, the response moves the link to the next state */
+static void harvestWrite(tsHarvestLink *link, uint16_t handle, uint8_t const *data, uint16_t length)
+{
+    ble_gattc_write_params_t const params =
+        {
+            .write_op = BLE_GATT_OP_WRITE_REQ,
+            .flags    = 0,
+            .handle   = handle,
+            .offset   = 0,
+            .len      = length,
+            .p_value  = data,
+        };
+
+    if (sd_ble_gattc_write(link->connHandle, &params) != NRF_SUCCESS)
+    {
+        sd_ble_gap_disconnect(link->connHandle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+    }
+}
+
+/**@brief Notification received, per link and aggregate throughput windows */
+static void harvestData(tsHarvest *harvest, tsHarvestLink *link, uint16_t length)
+{
+    uint32_t elapsed = app_timer_cnt_diff_compute(app_timer_cnt_get(), harvest->windowStart);
+
+    link->packets++;
+    link->bytes += length;
+    link->windowBytes += length;
+    harvest->windowBytes += length;
+
+    if (elapsed >= APP_TIMER_TICKS(HARVEST_REPORT_INTERVAL_MS))
+    {
+        // ATT payload bits per ms
+        harvest->kbps = (uint32_t)((uint64_t)harvest->windowBytes * 8 * HARVEST_TICK_FREQUENCY / 1000 / elapsed);
+        for (uint8_t i = 0; i < HARVEST_LINK_COUNT; i++)
+        {
+            harvest->links[i].kbps        = (uint16_t)((uint64_t)harvest->links[i].windowBytes * 8 * HARVEST_TICK_FREQUENCY / 1000 / elapsed);
+            harvest->links[i].windowBytes = 0;
+        }
+        harvest->windowStart = app_timer_cnt_get();
+        harvest->windowBytes = 0;
+#if JLINK_DEBUG_PRINT_ENABLE
+        harvestReport(harvest);
+#endif
+    }
+}
+
+/**@brief Transport of the records of a link */
+static char const *harvestTransportGet(tsHarvestLink const *link)
+{
+#if COC_ENABLE
+    if (cocIsOpen(&link->coc))
+    {
+        return "l2cap";
+    }
+#endif
+    return "gatt";
+}
+
+#if COC_ENABLE
+/**@brief SDU of the slave record stream */
+static void harvestSduReceived(void *context, uint16_t connHandle, uint8_t const *data, uint16_t length)
+{
+    tsHarvest *harvest  = (tsHarvest *)context;
+    tsHarvestLink *link = harvestLinkGet(harvest, connHandle);
+
+    if (link != NULL)
+    {
+        harvestData(harvest, link, length);
+    }
+}
+
+/**@brief Channel setup is over, refused or released channels leave the records on notifications */
+static void harvestChannelChanged(void *context, uint16_t connHandle, bool open)
+{
+    tsHarvest *harvest  = (tsHarvest *)context;
+    tsHarvestLink *link = harvestLinkGet(harvest, connHandle);
+
+    if (link != NULL && link->state == eHarvestLinkChannel)
+    {
+        link->state = eHarvestLinkStreaming;
+        NRF_LOG_INFO("Harvest: link %d streaming, %s.", link - harvest->links, open ? "l2cap" : "gatt");
+    }
+}
+#endif
@@ -0,0 +1,103 @@
+/** @file       harvest.h
+ *  @brief      Multi-link central, master pulls the stream service of several slaves at once
+ *  @author     Evren Kenanoglu
+ *  @date       4/21/2021
+ */
+#ifndef FILE_HARVEST_H
+#define FILE_HARVEST_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+#include "ble.h"
+#include "ble_gap.h"
+#include "nrf_ble_gatt.h"
+#include "advqueue.h"
+#include "coc.h"
+
+/** CONSTANTS *****************************************************************/
+
+// 1.25 ms units, one event length per connected link, see host/harvestsim.c. A single link ends its event
+// before its own next anchor, one unit less keeps 7 of the 8 queued notifications in every event.
+#define HARVEST_CONN_INTERVAL(links) MAX(((links) > 1) ? (links) * NRF_SDH_BLE_GAP_EVENT_LENGTH : NRF_SDH_BLE_GAP_EVENT_LENGTH - 1, 6)
+
+STATIC_ASSERT(HARVEST_LINK_COUNT <= NRF_SDH_BLE_CENTRAL_LINK_COUNT);
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eHarvestLinkFree = 0,
+    eHarvestLinkService,   // Primary service discovery
+    eHarvestLinkChars,     // Characteristic discovery
+    eHarvestLinkSubscribe, // Records CCCD write
+    eHarvestLinkMode,      // Control write
+    eHarvestLinkChannel,   // L2CAP channel setup (COC_ENABLE)
+    eHarvestLinkStreaming,
+} teHarvestLinkStates;
+
+/**
+ * @brief One slave link
+ *
+ */
+typedef struct
+{
+    uint8_t state; /**< teHarvestLinkStates */
+    uint16_t connHandle;
+    uint8_t addr[BLE_GAP_ADDR_LEN];
+    uint16_t handleStart; /**< Stream service handle range */
+    uint16_t handleEnd;
+    uint16_t recordsHandle;
+    uint16_t controlHandle;
+    uint16_t attMtu;
+    uint16_t kbps;        /**< Last report window */
+    uint32_t windowBytes;
+    uint32_t packets;     /**< Notifications or SDUs */
+    uint64_t bytes;
+#if COC_ENABLE
+    tsCoc coc;
+#endif
+} tsHarvestLink;
+
+/**
+ * @brief Links and aggregate throughput
+ *
+ */
+typedef struct
+{
+    tsHarvestLink links[HARVEST_LINK_COUNT];
+    uint8_t uuidType;
+    uint8_t connecting; /**< One connection is initiated at a time */
+    uint8_t connectingAddr[BLE_GAP_ADDR_LEN];
+    uint16_t connInterval; /**< 1.25 ms units, interval of the connected links */
+    uint32_t windowStart; /**< app_timer ticks */
+    uint32_t windowBytes;
+    uint32_t kbps;        /**< Aggregate of the last report window */
+    uint32_t connects;
+    uint32_t connectTimeouts;
+    uint32_t disconnects;
+} tsHarvest;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_HARVEST_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE ret_code_t harvestInit(tsHarvest *harvest);
+INTERFACE bool harvestCandidate(tsHarvest *harvest, tsAdvRecord const *record);
+INTERFACE void harvestBleEventHandler(tsHarvest *harvest, ble_evt_t const *bleEvent);
+INTERFACE void harvestGattEventHandler(tsHarvest *harvest, nrf_ble_gatt_evt_t const *gattEvent);
+INTERFACE uint8_t harvestLinkCountGet(tsHarvest const *harvest);
+INTERFACE void harvestReport(tsHarvest const *harvest);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_HARVEST_H
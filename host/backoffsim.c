@@ -0,0 +1,322 @@
+/** @file       backoffsim.c
+ *  @brief      Host simulation of slave battery life with sleep backoff, for several master absence patterns
+ *  @author     Evren Kenanoglu
+ *  @date       4/12/2021
+ *
+ *  The firmware phase engine and backoff modules run unchanged against a simulated timer. Current
+ *  draw is taken from the energy.h model of the selected board. Scans are blind SCAN_TIMEOUT scans
+ *  and the slave sleeps after advertising, as with a locked rendezvous; rendezvous windows would
+ *  lower the master-present current further (see rendezvoussim.c).
+ *
+ *  Build and run from the repository root:
+ *      gcc -O2 -Wall -DBOARD_PCA10059 -I. -Ihost/stubs -o backoffsim host/backoffsim.c phaseengine.c backoff.c
+ *      ./backoffsim [days] [battery mAh] [seed]
+ */
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "phaseengine.h"
+#include "backoff.h"
+#include "energy.h"
+
+/** CONSTANTS *****************************************************************/
+#define SIM_DETECT_PERMILLE    966  // Blind scan hit ratio with the master present (rendezvoussim blind+sleep)
+#define SIM_WAKE_CPU_US        1000 // CPU time per transition
+#define SIM_ADV_EVENT_RADIO_US 1500 // Radio time per advertising event, 3 channels + scan response
+#define SIM_NEVER              UINT64_MAX
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Master presence, present while (t - start) mod period < length
+ *
+ */
+typedef struct
+{
+    const char *name;
+    uint64_t period; // us
+    uint64_t start;  // us
+    uint64_t length; // us
+    uint8_t kick;    // An external event (e.g. door sensor) kicks the slave at every arrival
+} tsSimPattern;
+
+typedef struct
+{
+    const char *name;
+    uint8_t enable;
+    tsBackoffConfig config;
+} tsSimPolicy;
+
+typedef struct
+{
+    tsPhaseEngine engine;
+    tsProgramParams params;
+    tsBackoff backoff;
+    uint8_t backoffEnable;
+    uint64_t timerAt;
+    uint8_t phase;
+    uint64_t phaseStart;
+    double charge; // uC
+    uint64_t arrival;
+    uint8_t waiting;
+    double latencySum; // s
+    double latencyMax; // s
+    uint32_t arrivals;
+} tsSimSlave;
+
+/** VARIABLES *****************************************************************/
+
+static const tsSimPattern simPatterns[] =
+    {
+        {"always present", 86400000000ULL, 0, 86400000000ULL, 0},
+        {"absent", 86400000000ULL, 0, 0, 0},
+        {"office 8h/day", 86400000000ULL, 8 * 3600000000ULL, 8 * 3600000000ULL, 0},
+        {"10 min every 2h", 7200000000ULL, 0, 600000000ULL, 0},
+        {"10 min/2h kicked", 7200000000ULL, 0, 600000000ULL, 1},
+};
+
+#define SIM_BACKOFF(mult, step, ceiling) {SLEEP_DURATION, (ceiling), (mult), (step), BACKOFF_THRESHOLD, BACKOFF_KICK_SLEEP_MS, BACKOFF_KICK_CYCLES}
+
+static const tsSimPolicy simPolicies[] =
+    {
+        {"fixed", 0, SIM_BACKOFF(256, 0, SLEEP_DURATION)},
+        {"linear +2s/60s", 1, SIM_BACKOFF(256, 2000, 60000)},
+        {"x2/60s", 1, SIM_BACKOFF(512, 0, 60000)},
+        {"x2/300s", 1, SIM_BACKOFF(512, 0, 300000)},
+        {"default", BACKOFF_ENABLE, SIM_BACKOFF(BACKOFF_MULTIPLIER_Q8, BACKOFF_STEP_MS, BACKOFF_CEILING_MS)},
+};
+
+static tsSimSlave simSlave;
+static tsSimPattern const *simPattern;
+static uint64_t simNow;
+static uint32_t simSeed;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static uint32_t simRandom(void);
+static bool simPresent(uint64_t t);
+static uint64_t simNextArrival(uint64_t t);
+static void simCharge(uint8_t nextPhase);
+static void simTimerStart(void *context, uint32_t duration);
+static void simScanStart(void *context);
+static void simScanStop(void *context);
+static void simAdvStart(void *context);
+static void simAdvStop(void *context);
+static void simPhaseChanged(void *context, uint8_t from, uint8_t to);
+static uint32_t simTimingAdjust(void *context, uint8_t state, uint32_t duration);
+static bool simScanScheduled(void *context);
+static void simRun(tsSimPolicy const *policy, uint64_t end);
+
+static const tsPhaseHooks simHooks =
+    {
+        .timerStart    = simTimerStart,
+        .scanStart     = simScanStart,
+        .scanStop      = simScanStop,
+        .advStart      = simAdvStart,
+        .advStop       = simAdvStop,
+        .phaseChanged  = simPhaseChanged,
+        .timingAdjust  = simTimingAdjust,
+        .scanScheduled = simScanScheduled,
+};
+
+/** FUNCTIONS *****************************************************************/
+
+int main(int argc, char **argv)
+{
+    uint32_t days     = (argc > 1) ? (uint32_t)atoi(argv[1]) : 7;
+    double batteryMah = (argc > 2) ? atof(argv[2]) : 230; // CR2032
+    uint32_t seed     = (argc > 3) ? (uint32_t)atoi(argv[3]) : 1;
+    uint64_t end      = (uint64_t)days * 86400000000ULL;
+
+    printf("%u days, %.0f mAh, seed %u, scan %u ms, base sleep %u ms\n", days, batteryMah, seed, SCAN_TIMEOUT, SLEEP_DURATION);
+    printf("%-18s %-16s %10s %12s %14s %14s\n", "pattern", "policy", "avg uA", "life days", "reacq avg s", "reacq max s");
+
+    for (uint32_t p = 0; p < sizeof(simPatterns) / sizeof(simPatterns[0]); p++)
+    {
+        for (uint32_t i = 0; i < sizeof(simPolicies) / sizeof(simPolicies[0]); i++)
+        {
+            double averageUa;
+
+            simPattern = &simPatterns[p];
+            simSeed    = seed;
+            simRun(&simPolicies[i], end);
+
+            averageUa = simSlave.charge / ((double)end / 1e6);
+            printf("%-18s %-16s %10.1f %12.1f", simPattern->name, simPolicies[i].name, averageUa, batteryMah * 1000 / averageUa / 24);
+            if (simSlave.arrivals > 0)
+            {
+                printf(" %14.2f %14.2f\n", simSlave.latencySum / simSlave.arrivals, simSlave.latencyMax);
+            }
+            else
+            {
+                printf(" %14s %14s\n", "-", "-");
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief One slave, one policy, one pattern
+ */
+static void simRun(tsSimPolicy const *policy, uint64_t end)
+{
+    uint64_t arrival;
+
+    memset(&simSlave, 0, sizeof(simSlave));
+    simNow                        = 0;
+    simSlave.backoffEnable        = policy->enable;
+    simSlave.params.programStatus = eModeFirstStart;
+    simSlave.phase                = eModeFirstStart;
+
+    backoffInit(&simSlave.backoff, &policy->config);
+    phaseEngineInit(&simSlave.engine, eRoleSlave, &simSlave.params, &simHooks, &simSlave);
+    phaseEngineStart(&simSlave.engine);
+
+    arrival = simNextArrival(0);
+    while (simNow < end)
+    {
+        if (arrival <= simSlave.timerAt)
+        {
+            // Master arrives
+            simNow           = arrival;
+            simSlave.arrival = arrival;
+            simSlave.waiting = 1;
+            arrival          = simNextArrival(arrival + 1);
+
+            if (simPattern->kick)
+            {
+                backoffKick(&simSlave.backoff);
+                if (simSlave.params.programStatus == eModeSleep)
+                {
+                    simSlave.timerAt = simNow; // programKick(): sleep ends now
+                }
+            }
+            continue;
+        }
+
+        simNow           = simSlave.timerAt;
+        simSlave.timerAt = SIM_NEVER;
+        phaseEngineStep(&simSlave.engine);
+    }
+    simCharge(simSlave.phase);
+}
+
+/**
+ * @brief Charge of the phase that is left, energy.h current model
+ */
+static void simCharge(uint8_t nextPhase)
+{
+    double duration = (double)(simNow - simSlave.phaseStart); // us
+    double current;
+
+    switch (simSlave.phase)
+    {
+        case eModeScanning:
+            current = ENERGY_CURRENT_RADIO_RX_UA;
+            break;
+        case eModeAdvertising:
+            current = ENERGY_CURRENT_SLEEP_UA + (double)ENERGY_CURRENT_RADIO_TX_UA * SIM_ADV_EVENT_RADIO_US / (MIN_ADVERTISEMENT_INTERVAL * 1000);
+            break;
+        default:
+            current = ENERGY_CURRENT_SLEEP_UA;
+            break;
+    }
+
+    simSlave.charge += current * duration / 1e6 + (double)ENERGY_CURRENT_CPU_UA * SIM_WAKE_CPU_US / 1e6;
+    simSlave.phase      = nextPhase;
+    simSlave.phaseStart = simNow;
+}
+
+static void simTimerStart(void *context, uint32_t duration)
+{
+    simSlave.timerAt = simNow + (uint64_t)duration * 1000;
+}
+
+static void simScanStart(void *context)
+{
+    if (simPresent(simNow) && (simRandom() % 1000) < SIM_DETECT_PERMILLE)
+    {
+        phaseEngineDeviceDetected(&simSlave.engine);
+        if (simSlave.waiting)
+        {
+            double latency = (double)(simNow - simSlave.arrival) / 1e6;
+
+            simSlave.latencySum += latency;
+            simSlave.latencyMax = (latency > simSlave.latencyMax) ? latency : simSlave.latencyMax;
+            simSlave.arrivals++;
+            simSlave.waiting = 0;
+        }
+    }
+}
+
+static void simScanStop(void *context)
+{
+    if (simSlave.backoffEnable)
+    {
+        backoffScanEnd(&simSlave.backoff, simSlave.params.deviceDetectionStatus == eDeviceDetected);
+    }
+}
+
+static void simAdvStart(void *context)
+{
+}
+
+static void simAdvStop(void *context)
+{
+}
+
+static void simPhaseChanged(void *context, uint8_t from, uint8_t to)
+{
+    simCharge(to);
+}
+
+/**@brief Same binding as programTimingAdjust() in main.c, without rendezvous */
+static uint32_t simTimingAdjust(void *context, uint8_t state, uint32_t duration)
+{
+    if (state == eModeSleep && simSlave.backoffEnable)
+    {
+        return backoffSleepGet(&simSlave.backoff);
+    }
+    return duration;
+}
+
+static bool simScanScheduled(void *context)
+{
+    return true;
+}
+
+static bool simPresent(uint64_t t)
+{
+    return t >= simPattern->start && ((t - simPattern->start) % simPattern->period) < simPattern->length;
+}
+
+/**
+ * @brief First arrival of the master at or after t, never for patterns without absence
+ */
+static uint64_t simNextArrival(uint64_t t)
+{
+    uint64_t k;
+
+    if (simPattern->length == 0 || simPattern->length >= simPattern->period)
+    {
+        return SIM_NEVER;
+    }
+    if (t <= simPattern->start)
+    {
+        return simPattern->start;
+    }
+    k = (t - simPattern->start + simPattern->period - 1) / simPattern->period;
+    return simPattern->start + k * simPattern->period;
+}
+
+/**@brief xorshift32 */
+static uint32_t simRandom(void)
+{
+    simSeed ^= simSeed << 13;
+    simSeed ^= simSeed >> 17;
+    simSeed ^= simSeed << 5;
+    return simSeed;
+}
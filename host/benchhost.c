@@ -0,0 +1,189 @@
+/** @file       benchhost.c
+ *  @brief      Host build of the hot path benchmarks (bench.c) and comparison of two benchmark logs
+ *  @author     Evren Kenanoglu
+ *  @date       4/24/2021
+ *
+ *  Runs the core kernels of bench.c on the stub layer (host/stubs), DWT->CYCCNT of the stub nrf.h
+ *  counts ns. The kernels bound to the SoftDevice (bleEventHandler, bleAdvUpdateData, bleScanStart,
+ *  phase hooks) only run on target, build the SES "Benchmark" configuration and capture the log.
+ *
+ *  Records of advQueuePut are drained by a one handler scheduler and dropped by an empty record handler,
+ *  app_timer_cnt_get() returns 0 and the CPU monitor is not built. -Wno-format: the %lu reports of the
+ *  modules are for the 32 bit target.
+ *
+ *  With two log files, the p50 of every kernel and parameter of the second log is compared with the
+ *  first one, the exit code is 1 when one of them is slower by more than the threshold. Logs can be
+ *  from this program or from the target, lines without "BENCH," are skipped.
+ *
+ *  Build and run from the repository root:
+ *      gcc -O2 -Wall -Wno-format -DBOARD_PCA10059 -I. -Ihost/stubs -o benchhost host/benchhost.c bench.c advqueue.c recpool.c phaseengine.c rendezvous.c proto.c slot.c
+ *      ./benchhost [batch] > new.csv
+ *      ./benchhost base.csv new.csv [threshold percent]
+ */
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "advqueue.h"
+#include "recpool.h"
+#include "cpumon.h"
+
+/** CONSTANTS *****************************************************************/
+#define HOST_BATCH_DEFAULT     64 // Calls per sample, the monotonic clock is read in about 20 ns
+#define HOST_SCHED_QUEUE_SIZE  SCHED_QUEUE_SIZE
+#define HOST_LOG_ENTRIES_MAX   128
+#define HOST_THRESHOLD_DEFAULT 10 // percent
+
+/** TYPEDEFS ******************************************************************/
+
+typedef struct
+{
+    char kernel[32];
+    uint32_t param;
+    uint32_t p50;
+} tsHostLogEntry;
+
+typedef struct
+{
+    tsHostLogEntry entries[HOST_LOG_ENTRIES_MAX];
+    uint32_t count;
+} tsHostLog;
+
+/** VARIABLES *****************************************************************/
+
+static app_sched_event_handler_t hostSchedQueue[HOST_SCHED_QUEUE_SIZE];
+static uint32_t hostSchedCount;
+
+static tsHostLog hostLogs[2];
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief Record handler of the queue, records are dropped */
+static void hostRecordHandler(tsAdvRecord const *record)
+{
+}
+
+/**@brief Reads the BENCH lines of a log, the column header line has no numbers and is skipped */
+static int hostLogRead(char const *path, tsHostLog *log)
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    log->count = 0;
+    while (fgets(line, sizeof(line), file) != NULL && log->count < HOST_LOG_ENTRIES_MAX)
+    {
+        char const *bench = strstr(line, "BENCH,");
+        tsHostLogEntry *entry = &log->entries[log->count];
+        uint32_t samples, fails, min, mean;
+
+        if (bench != NULL &&
+            sscanf(bench, "BENCH,%31[^,],%u,%u,%u,%u,%u,%u", entry->kernel, &entry->param, &samples, &fails, &min, &mean, &entry->p50) == 7)
+        {
+            log->count++;
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+/**@brief p50 of the new log against the base log, regressions above threshold percent */
+static int hostLogCompare(tsHostLog const *base, tsHostLog const *current, uint32_t threshold)
+{
+    uint32_t regressions = 0;
+
+    printf("kernel,param,base_p50,p50,change_pct,status\n");
+    for (uint32_t i = 0; i < current->count; i++)
+    {
+        tsHostLogEntry const *entry = &current->entries[i];
+        tsHostLogEntry const *old   = NULL;
+        double change;
+        char const *status;
+
+        for (uint32_t j = 0; j < base->count && old == NULL; j++)
+        {
+            if (base->entries[j].param == entry->param && strcmp(base->entries[j].kernel, entry->kernel) == 0)
+            {
+                old = &base->entries[j];
+            }
+        }
+        if (old == NULL)
+        {
+            printf("%s,%u,,%u,,new\n", entry->kernel, entry->param, entry->p50);
+            continue;
+        }
+
+        change = old->p50 ? 100.0 * ((double)entry->p50 - old->p50) / old->p50 : 0;
+        status = "ok";
+        if (change > threshold)
+        {
+            status = "REGRESSION";
+            regressions++;
+        }
+        printf("%s,%u,%u,%u,%.1f,%s\n", entry->kernel, entry->param, old->p50, entry->p50, change, status);
+    }
+
+    return regressions ? 1 : 0;
+}
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+ret_code_t app_sched_event_put(void const *p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+    if (hostSchedCount >= HOST_SCHED_QUEUE_SIZE)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    hostSchedQueue[hostSchedCount++] = handler;
+    return NRF_SUCCESS;
+}
+
+void app_sched_execute(void)
+{
+    for (uint32_t i = 0; i < hostSchedCount; i++)
+    {
+        hostSchedQueue[i](NULL, 0);
+    }
+    hostSchedCount = 0;
+}
+
+uint32_t app_timer_cnt_get(void)
+{
+    return 0;
+}
+
+void cpuMonRecord(uint8_t site, uint32_t cycles)
+{
+}
+
+int main(int argc, char **argv)
+{
+    tsBenchKernel const *kernels;
+    uint8_t count;
+
+    if (argc >= 3)
+    {
+        uint32_t threshold = (argc > 3) ? (uint32_t)atoi(argv[3]) : HOST_THRESHOLD_DEFAULT;
+
+        if (hostLogRead(argv[1], &hostLogs[0]) != 0 || hostLogRead(argv[2], &hostLogs[1]) != 0)
+        {
+            return 2;
+        }
+        return hostLogCompare(&hostLogs[0], &hostLogs[1], threshold);
+    }
+
+    recPoolInit();
+    advQueueInit(hostRecordHandler);
+    benchInit((argc > 1) ? (uint16_t)atoi(argv[1]) : HOST_BATCH_DEFAULT);
+
+    kernels = benchCoreKernelsGet(&count);
+    benchRun(kernels, count);
+    return 0;
+}
@@ -0,0 +1,222 @@
+/** @file       capconv.c
+ *  @brief      Host converter of the capture console lines (capture.c) into a capture file, append only
+ *  @author     Evren Kenanoglu
+ *  @date       4/25/2021
+ *
+ *  Reads a console log (RTT viewer or terminal log, stdin when no log is given) and appends every
+ *  "CAP," line to the capture file, lines without it are skipped. The file is created with its header
+ *  when it does not exist. A record torn by an interrupted run is cut off before appending.
+ *
+ *  Ticks of the firmware wrap every 2^24 ticks, the file time removes the wraps. Reports have to be
+ *  less than one wrap apart (512 s at 32768 Hz). A "CAPINFO," line starts a new session (reset of the
+ *  dongle): its first record gets the time of the last record of the file, the gap is not known.
+ *
+ *  Build and run from the repository root:
+ *      gcc -O2 -Wall -DBOARD_PCA10059 -I. -Ihost/stubs -o capconv host/capconv.c
+ *      ./capconv capture.bin [console.log]
+ */
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "capture.h"
+
+/** CONSTANTS *****************************************************************/
+#define CONV_LINE_MAX 512
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief One file record with room for the AD bytes and the padding
+ *
+ */
+typedef struct
+{
+    tsCaptureFileRecord file;
+    uint8_t data[CAPTURE_FILE_RECORD_SIZE(BLE_GAP_ADV_SET_DATA_SIZE_MAX) - sizeof(tsCaptureFileRecord)];
+} tsConvRecord;
+
+/**
+ * @brief Time line of the file
+ *
+ */
+typedef struct
+{
+    uint64_t time;      /**< Last record */
+    uint32_t ticks;     /**< Last record, firmware clock */
+    bool sessionStart;  /**< Next record starts a session, its ticks are not related to the last ones */
+    uint32_t records;   /**< In the file before this run */
+    uint32_t appended;
+    uint32_t skipped;   /**< Malformed CAP lines */
+} tsConvState;
+
+/** VARIABLES *****************************************************************/
+
+static tsConvState convState;
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief Header of a new file, or checks of the header of an existing one */
+static int convHeader(FILE *file)
+{
+    tsCaptureFileHeader header;
+
+    if (fread(&header, sizeof(header), 1, file) != 1)
+    {
+        memset(&header, 0, sizeof(header));
+        header.magic         = CAPTURE_FILE_MAGIC;
+        header.version       = CAPTURE_VERSION;
+        header.headerSize    = sizeof(header);
+        header.tickFrequency = CAPTURE_TICK_FREQUENCY;
+        rewind(file);
+        if (fwrite(&header, sizeof(header), 1, file) != 1)
+        {
+            return -1;
+        }
+    }
+    else if (header.magic != CAPTURE_FILE_MAGIC || header.version != CAPTURE_VERSION ||
+             header.tickFrequency != CAPTURE_TICK_FREQUENCY)
+    {
+        fprintf(stderr, "not a capture file of version %u at %u Hz\n", CAPTURE_VERSION, (unsigned)CAPTURE_TICK_FREQUENCY);
+        return -1;
+    }
+    return fseek(file, header.headerSize, SEEK_SET);
+}
+
+/**@brief Walks the records of an existing file, the end of the last whole record is returned */
+static long convEnd(FILE *file)
+{
+    tsConvRecord record;
+    long end = ftell(file);
+
+    while (fread(&record.file, sizeof(record.file), 1, file) == 1)
+    {
+        uint32_t rest = CAPTURE_FILE_RECORD_SIZE(record.file.record.len) - sizeof(record.file);
+
+        if (record.file.record.len > BLE_GAP_ADV_SET_DATA_SIZE_MAX || fread(record.data, rest, 1, file) != 1)
+        {
+            break;
+        }
+        convState.time  = record.file.time;
+        convState.ticks = record.file.record.ticks;
+        convState.records++;
+        end = ftell(file);
+    }
+    return end;
+}
+
+/**@brief Hex digits of a CAP line into a record, false: malformed */
+static bool convDecode(char const *hex, tsConvRecord *record)
+{
+    uint8_t *bytes = (uint8_t *)&record->file.record;
+    uint32_t count = 0;
+    unsigned value;
+
+    while (count < CAPTURE_RECORD_SIZE_MAX && sscanf(hex, "%2x", &value) == 1)
+    {
+        bytes[count++] = (uint8_t)value;
+        hex += 2;
+    }
+    return count >= sizeof(tsCaptureRecord) && count == sizeof(tsCaptureRecord) + record->file.record.len;
+}
+
+/**@brief Time of a record on the file time line */
+static uint64_t convTime(uint32_t ticks)
+{
+    if (convState.sessionStart)
+    {
+        convState.sessionStart = false;
+    }
+    else
+    {
+        convState.time += (ticks - convState.ticks) & CAPTURE_TICK_MASK;
+    }
+    convState.ticks = ticks;
+    return convState.time;
+}
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+int main(int argc, char **argv)
+{
+    FILE *file;
+    FILE *log = stdin;
+    char line[CONV_LINE_MAX];
+    long end;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s capture.bin [console.log]\n", argv[0]);
+        return 2;
+    }
+
+    file = fopen(argv[1], "r+b");
+    if (file == NULL)
+    {
+        file = fopen(argv[1], "w+b");
+    }
+    if (file == NULL || (argc > 2 && (log = fopen(argv[2], "r")) == NULL))
+    {
+        perror((file == NULL) ? argv[1] : argv[2]);
+        return 2;
+    }
+    if (convHeader(file) != 0)
+    {
+        return 2;
+    }
+
+    end = convEnd(file);
+    if (ftruncate(fileno(file), end) != 0 || fseek(file, end, SEEK_SET) != 0)
+    {
+        perror(argv[1]);
+        return 2;
+    }
+    convState.sessionStart = true; // No CAPINFO line at the start of a cut log
+
+    while (fgets(line, sizeof(line), log) != NULL)
+    {
+        char const *cap  = strstr(line, "CAP,");
+        char const *info = strstr(line, "CAPINFO,");
+        unsigned version = 0, frequency = 0;
+        tsConvRecord record;
+
+        if (info != NULL)
+        {
+            if (sscanf(info, "CAPINFO,%u,%u", &version, &frequency) != 2 ||
+                version != CAPTURE_VERSION || frequency != CAPTURE_TICK_FREQUENCY)
+            {
+                fprintf(stderr, "capture session of version %u at %u Hz is not supported\n", version, frequency);
+                return 2;
+            }
+            convState.sessionStart = true;
+            continue;
+        }
+        if (cap == NULL)
+        {
+            continue;
+        }
+
+        memset(&record, 0, sizeof(record));
+        if (!convDecode(cap + 4, &record))
+        {
+            convState.skipped++;
+            continue;
+        }
+        record.file.time = convTime(record.file.record.ticks);
+        if (fwrite(&record, CAPTURE_FILE_RECORD_SIZE(record.file.record.len), 1, file) != 1)
+        {
+            perror(argv[1]);
+            return 2;
+        }
+        convState.appended++;
+    }
+
+    fclose(file);
+    printf("CAPCONV,records=%u,appended=%u,skipped=%u\n",
+           convState.records + convState.appended,
+           convState.appended,
+           convState.skipped);
+    return 0;
+}
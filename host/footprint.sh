@@ -0,0 +1,44 @@
+#!/bin/sh
+# @file       footprint.sh
+# @brief      Flash/RAM footprint of every armgcc target, next to the application region of its SoftDevice
+# @author     Evren Kenanoglu
+# @date       4/26/2021
+#
+# Builds the "footprint" target of every <board>/<softdevice>/armgcc/Makefile (app.mk), the module
+# tables go to footprint_<board>_<softdevice>.txt, one summary line per target on stdout:
+#     target  flash bytes  % of the application flash  RAM bytes  % of the application RAM
+# Flash is text + data, RAM is data + bss (stack and heap are in bss). The application region is the
+# FLASH/RAM memory of the linker script, what the SoftDevice leaves free.
+#
+# Run from the repository root, nRF5 SDK in the place the Makefiles expect:
+#     sh host/footprint.sh [target directory...]
+
+SIZE=${SIZE:-arm-none-eabi-size}
+TARGETS=${*:-"pca10040/s132 pca10040e/s112 pca10056/s140 pca10056e/s112 pca10059/s140"}
+STATUS=0
+
+printf "%-16s %8s %6s %8s %6s\n" target flash "%" ram "%"
+for target in $TARGETS; do
+    dir=$target/armgcc
+    log=footprint_$(echo "$target" | tr / _).txt
+
+    if ! make -C "$dir" footprint > "$log" 2>&1; then
+        printf "%-16s build failed, see %s\n" "$target" "$log"
+        STATUS=1
+        continue
+    fi
+
+    # Region lengths of the linker script, ORIGIN = ..., LENGTH = 0x...
+    flashLength=$(sed -n 's/.*FLASH (rx).*LENGTH *= *\(0x[0-9a-fA-F]*\).*/\1/p' "$dir"/*.ld)
+    ramLength=$(sed -n 's/.*RAM (rwx).*LENGTH *= *\(0x[0-9a-fA-F]*\).*/\1/p' "$dir"/*.ld)
+
+    for image in "$dir"/_build/*.out; do
+        $SIZE "$image" | awk -v name="$target" -v flashLength=$((flashLength)) -v ramLength=$((ramLength)) '
+            NR == 2 {
+                flash = $1 + $2
+                ram   = $2 + $3
+                printf "%-16s %8d %5.1f%% %8d %5.1f%%\n", name, flash, 100 * flash / flashLength, ram, 100 * ram / ramLength
+            }'
+    done
+done
+exit $STATUS
@@ -0,0 +1,288 @@
+/** @file       harvestsim.c
+ *  @brief      Host airtime model of the master harvesting several slave streams, tuned vs fixed interval
+ *  @author     Evren Kenanoglu
+ *  @date       4/21/2021
+ *
+ *  The master is central of every link (harvest.c), the SoftDevice runs one connection event at a
+ *  time. Every link has the same interval, a link event starts at its anchor and sends notifications
+ *  of a full ATT payload (2M PHY, 251 byte LL payload) until one of these runs out:
+ *      - notifications in the SoftDevice queue, refilled by the slave between events (STREAM_HVN_QUEUE_SIZE),
+ *        queue 0: refilled inside the event, the slave always has data
+ *      - event length
+ *      - its own next anchor
+ *  An event is skipped when the radio is still busy at its anchor. Anchors on the same time are served
+ *  by skip count, as the SoftDevice raises the priority of a link that missed events.
+ *
+ *  The event length is the time of one full queue (NRF_SDH_BLE_GAP_EVENT_LENGTH in sdk_config.h).
+ *  Tuned: harvest.c interval (HARVEST_CONN_INTERVAL), one event length per link, anchors back to back,
+ *  one unit less than the event length for a single link.
+ *  Fixed: 7.5 ms for every link (the stream default), anchors at n * event length modulo interval.
+ *  Radio cap: one central is in one link at a time, full notifications back to back are the most the
+ *  radio carries whatever the interval, cap_pct is the share of it.
+ *
+ *  The second table has HARVEST_LINK_COUNT = 8 with fewer slaves connected: the interval of 8 links
+ *  vs the interval of the connected links, which harvest.c moves the links to (harvestIntervalTune()).
+ *
+ *  The third table is the transport of the bulk test (HARVEST_BULK_TEST), notifications vs the L2CAP
+ *  channel of coc.c (COC_ENABLE), same interval and event length. The channel sends COC_TX_QUEUE SDUs
+ *  between two refills, an SDU is COC_SDU_SIZE bytes plus the 2 byte SDU length in PDUs of COC_MPS
+ *  bytes, the last one short unless they add up. Credits (COC_RX_CREDITS) and receive buffers
+ *  (COC_RX_BUFFERS) cover the SDUs of one event, they do not limit. Bulk SDUs are the stream buffer
+ *  itself, always full size.
+ *
+ *  This is a radio time model, no loss, no scanning or advertising of the master in between. The
+ *  firmware prints the measured figures in "HARVEST" lines (HARVEST_REPORT_INTERVAL_MS).
+ *
+ *  Build and run from the repository root:
+ *      gcc -O2 -Wall -o harvestsim host/harvestsim.c
+ *      ./harvestsim [seconds]
+ */
+
+/** INCLUDES ******************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/** CONSTANTS *****************************************************************/
+#define SIM_LINKS_MAX      8
+#define SIM_UNIT_US        1250 // Connection interval and event length unit
+#define SIM_EVENT_LENGTH   12   // Event length with queue 0
+#define SIM_FIXED_INTERVAL 6   // STREAM_MIN_CONN_INTERVAL
+#define SIM_PAYLOAD        244  // ATT MTU 247 - 3
+#define SIM_IFS_US         150
+#define SIM_LL_US(payload) ((2 + 4 + 2 + (payload) + 3) * 8 / 2) // Preamble, access address, header, payload, CRC at 2 Mbps
+#define SIM_DATA_US        SIM_LL_US(251)
+#define SIM_EMPTY_US       ((2 + 4 + 2 + 3) * 8 / 2)       // Central empty packet
+#define SIM_PAIR_US        (SIM_DATA_US + SIM_IFS_US + SIM_EMPTY_US + SIM_IFS_US)
+#define SIM_RADIO_KBPS     ((double)SIM_PAYLOAD * 8 * 1000 / SIM_PAIR_US) // Radio cap
+#define SIM_QUEUE          8 // STREAM_HVN_QUEUE_SIZE
+#define SIM_MPS            247  // COC_MPS
+#define SIM_SDU_SIZE       (5 * SIM_MPS - 2) // COC_SDU_SIZE
+#define SIM_COC_TX_QUEUE   3                 // COC_TX_QUEUE
+
+/** MACROS ********************************************************************/
+#define MIN_U64(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b)     ((a) > (b) ? (a) : (b))
+
+/** TYPEDEFS ******************************************************************/
+
+typedef struct
+{
+    uint64_t anchor; /**< Next anchor, us */
+    uint32_t skips;  /**< In a row */
+    uint64_t events;
+    uint64_t skipped;
+    uint64_t notifications; /**< Notifications or channel PDUs */
+    uint64_t bytes;         /**< ATT or SDU payload */
+    uint32_t sduPdu;        /**< Channel: next PDU of the SDU at the head */
+    uint64_t served;  /**< Last event with radio time, us */
+    uint64_t gapMax;  /**< Longest time between served events, us */
+} tsSimLink;
+
+typedef struct
+{
+    uint8_t links;
+    uint8_t queue;
+    uint8_t tuned;
+    uint8_t intervalLinks; /**< Tuned: link count the interval is sized for, 0: links */
+    uint16_t sduSize;      /**< 0: notifications, L2CAP channel with SDUs of this size */
+    uint8_t txQueue;       /**< Channel: SDUs queued in the SoftDevice */
+} tsSimConfig;
+
+typedef struct
+{
+    uint32_t intervalUs;
+    double linkKbps;  /**< Average of the links */
+    double totalKbps;
+    double skippedPercent;
+    double radioPercent;
+    double gapMs;     /**< Worst link */
+} tsSimResult;
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief Channel event, PDUs of the queued SDUs until the queue or the time runs out, returns radio time */
+static uint32_t simCocEvent(tsSimLink *link, tsSimConfig const *config, uint64_t time)
+{
+    uint32_t pdus = (config->sduSize + 2 + SIM_MPS - 1) / SIM_MPS;
+    uint32_t sdus = config->txQueue; // Refilled between events, the one at the head may be sent in part
+    uint32_t used = 0;
+
+    while (sdus != 0)
+    {
+        uint32_t size = (link->sduPdu + 1 < pdus) ? SIM_MPS : config->sduSize + 2 - SIM_MPS * (pdus - 1);
+        uint32_t pair = SIM_LL_US(4 + size) + SIM_IFS_US + SIM_EMPTY_US + SIM_IFS_US; // L2CAP header
+
+        if (used + pair > time)
+        {
+            break;
+        }
+        used += pair;
+        link->notifications++;
+        link->bytes += size - (link->sduPdu == 0 ? 2 : 0);
+        if (++link->sduPdu == pdus)
+        {
+            link->sduPdu = 0;
+            sdus--;
+        }
+    }
+    return used;
+}
+
+/**@brief Runs the links for the given time */
+static tsSimResult simRun(tsSimConfig const *config, uint32_t seconds)
+{
+    tsSimLink links[SIM_LINKS_MAX] = {0};
+    tsSimResult result             = {0};
+    uint32_t eventLength           = config->queue ? (config->queue * SIM_PAIR_US + SIM_UNIT_US - 1) / SIM_UNIT_US : SIM_EVENT_LENGTH;
+    uint32_t eventLengthUs         = eventLength * SIM_UNIT_US;
+    uint32_t intervalLinks         = config->intervalLinks ? config->intervalLinks : config->links;
+    uint32_t interval              = !config->tuned ? SIM_FIXED_INTERVAL : (intervalLinks > 1) ? intervalLinks * eventLength : eventLength - 1;
+    uint64_t end                   = (uint64_t)seconds * 1000000;
+    uint64_t busyUntil             = 0;
+    uint64_t busyTotal             = 0;
+    uint64_t events                = 0;
+    uint64_t skipped               = 0;
+    uint64_t bytes                 = 0;
+
+    interval          = interval < 6 ? 6 : interval;
+    result.intervalUs = interval * SIM_UNIT_US;
+    for (uint8_t i = 0; i < config->links; i++)
+    {
+        links[i].anchor = (uint64_t)i * eventLengthUs % result.intervalUs; // SoftDevice places new links after the last one
+    }
+
+    while (1)
+    {
+        tsSimLink *link = NULL;
+        uint64_t limit;
+        uint32_t used;
+
+        // Earliest anchor, ties by skips in a row
+        for (uint8_t i = 0; i < config->links; i++)
+        {
+            if (link == NULL || links[i].anchor < link->anchor ||
+                (links[i].anchor == link->anchor && links[i].skips > link->skips))
+            {
+                link = &links[i];
+            }
+        }
+        if (link->anchor >= end)
+        {
+            break;
+        }
+
+        link->events++;
+        if (link->anchor < busyUntil)
+        {
+            link->skipped++;
+            link->skips++;
+            link->anchor += result.intervalUs;
+            continue;
+        }
+
+        // Radio time of this event
+        limit = MIN_U64(link->anchor + eventLengthUs, link->anchor + result.intervalUs - SIM_IFS_US);
+
+        if (config->sduSize)
+        {
+            used = simCocEvent(link, config, limit - link->anchor);
+        }
+        else
+        {
+            uint32_t count = (uint32_t)((limit - link->anchor) / SIM_PAIR_US);
+
+            count = (config->queue && count > config->queue) ? config->queue : count;
+            link->notifications += count;
+            link->bytes += (uint64_t)count * SIM_PAYLOAD;
+            used = count * SIM_PAIR_US;
+        }
+        link->gapMax = MAX(link->gapMax, link->anchor - link->served);
+        link->served = link->anchor;
+        busyUntil = link->anchor + (used ? used : SIM_EMPTY_US + SIM_IFS_US + SIM_EMPTY_US);
+        busyTotal += busyUntil - link->anchor;
+        link->skips = 0;
+        link->anchor += result.intervalUs;
+    }
+
+    for (uint8_t i = 0; i < config->links; i++)
+    {
+        events += links[i].events;
+        skipped += links[i].skipped;
+        bytes += links[i].bytes;
+        result.gapMs = MAX(result.gapMs, links[i].gapMax / 1000.0);
+    }
+    result.totalKbps      = (double)bytes * 8 / 1000 / seconds;
+    result.linkKbps       = result.totalKbps / config->links;
+    result.skippedPercent = events ? 100.0 * skipped / events : 0;
+    result.radioPercent   = 100.0 * busyTotal / end;
+    return result;
+}
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+int main(int argc, char **argv)
+{
+    uint32_t seconds              = argc > 1 ? (uint32_t)atoi(argv[1]) : 10;
+    static uint8_t const counts[] = {1, 4, 8};
+    static uint8_t const queues[] = {1, SIM_QUEUE, 0};
+
+    printf("links,queue,scheme,interval_ms,link_kbps,total_kbps,skipped_pct,radio_pct,gap_ms,cap_pct\n");
+    for (uint8_t c = 0; c < sizeof(counts); c++)
+    {
+        for (uint8_t q = 0; q < sizeof(queues); q++)
+        {
+            for (uint8_t t = 0; t < 2; t++)
+            {
+                tsSimConfig config = {.links = counts[c], .queue = queues[q], .tuned = !t};
+                tsSimResult result = simRun(&config, seconds);
+
+                printf("%u,%u,%s,%.2f,%.0f,%.0f,%.1f,%.1f,%.1f,%.1f\n", config.links, config.queue,
+                       config.tuned ? "tuned" : "fixed", result.intervalUs / 1000.0, result.linkKbps,
+                       result.totalKbps, result.skippedPercent, result.radioPercent, result.gapMs,
+                       100.0 * result.totalKbps / SIM_RADIO_KBPS);
+            }
+        }
+    }
+
+    printf("\nconnected,sized_interval_ms,sized_kbps,tuned_interval_ms,tuned_kbps,cap_kbps\n");
+    for (uint8_t links = 1; links <= SIM_LINKS_MAX; links++)
+    {
+        tsSimConfig sized  = {.links = links, .queue = SIM_QUEUE, .tuned = 1, .intervalLinks = SIM_LINKS_MAX};
+        tsSimConfig tuned  = {.links = links, .queue = SIM_QUEUE, .tuned = 1};
+        tsSimResult before = simRun(&sized, seconds);
+        tsSimResult after  = simRun(&tuned, seconds);
+
+        printf("%u,%.2f,%.0f,%.2f,%.0f,%.0f\n", links, before.intervalUs / 1000.0, before.totalKbps,
+               after.intervalUs / 1000.0, after.totalKbps, SIM_RADIO_KBPS);
+    }
+
+    printf("\ntransport,sdu_size,tx_queue,links,interval_ms,total_kbps,radio_pct,notification_pct\n");
+    for (uint8_t c = 0; c < sizeof(counts); c++)
+    {
+        static tsSimConfig const transports[] =
+            {
+                {.sduSize = 0},
+                {.sduSize = 1024, .txQueue = 2}, // Before the SDU size was fitted to the PDUs
+                {.sduSize = SIM_SDU_SIZE, .txQueue = 2},
+                {.sduSize = SIM_SDU_SIZE, .txQueue = SIM_COC_TX_QUEUE},
+        };
+        tsSimConfig hvn = {.links = counts[c], .queue = SIM_QUEUE, .tuned = 1};
+        double hvnKbps  = simRun(&hvn, seconds).totalKbps;
+
+        for (uint8_t z = 0; z < sizeof(transports) / sizeof(transports[0]); z++)
+        {
+            tsSimConfig config = transports[z];
+            tsSimResult result;
+
+            config.links = counts[c];
+            config.queue = SIM_QUEUE;
+            config.tuned = 1;
+            result       = simRun(&config, seconds);
+            printf("%s,%u,%u,%u,%.2f,%.0f,%.1f,%.1f\n", config.sduSize ? "coc" : "notification", config.sduSize,
+                   config.txQueue, config.links, result.intervalUs / 1000.0, result.totalKbps, result.radioPercent,
+                   100.0 * result.totalKbps / hvnKbps);
+        }
+    }
+    return 0;
+}
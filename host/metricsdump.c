@@ -0,0 +1,153 @@
+/** @file       metricsdump.c
+ *  @brief      Host decoder of the metrics snapshot frames (metrics.c) of one or more console logs
+ *  @author     Evren Kenanoglu
+ *  @date       4/25/2021
+ *
+ *  Every "METRICS," line is checked (magic, version, CRC32) and printed as one CSV row. The columns
+ *  are named from the "METRICSINFO," line of the log, metrics without a name (log cut before it)
+ *  are named by their index. Logs of several dongles can be concatenated, the address column
+ *  separates them.
+ *
+ *  Build and run from the repository root:
+ *      gcc -O2 -Wall -o metricsdump host/metricsdump.c
+ *      ./metricsdump < console.log > metrics.csv
+ */
+
+/** INCLUDES ******************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/** CONSTANTS *****************************************************************/
+#define DUMP_VERSION      1    // METRICS_VERSION
+#define DUMP_FRAME_MAGIC  0x4D // METRICS_FRAME_MAGIC
+#define DUMP_HEADER_SIZE  16   // METRICS_FRAME_HEADER_SIZE
+#define DUMP_METRICS_MAX  64
+#define DUMP_NAME_MAX     32
+#define DUMP_LINE_MAX     1024
+
+/** VARIABLES *****************************************************************/
+
+static char dumpNames[DUMP_METRICS_MAX][DUMP_NAME_MAX];
+static uint8_t dumpNameCount;
+static uint8_t dumpColumns; /**< Metrics in the header row printed last, 0: no header yet */
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief CRC-32 of crc32_compute() (SDK crc32.c), reflected 0xEDB88320 */
+static uint32_t dumpCrc32(uint8_t const *data, uint32_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t dumpGet32(uint8_t const *buffer)
+{
+    return buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+/**@brief Names of a "METRICSINFO,<version>,<name>:<kind>,..." line */
+static void dumpInfo(char const *info)
+{
+    char const *field = strchr(info, ',');
+
+    dumpNameCount = 0;
+    while (field != NULL && (field = strchr(field + 1, ',')) != NULL && dumpNameCount < DUMP_METRICS_MAX)
+    {
+        if (sscanf(field + 1, "%31[^:,\r\n]", dumpNames[dumpNameCount]) == 1)
+        {
+            dumpNameCount++;
+        }
+    }
+    dumpColumns = 0; // New header row with the next frame
+}
+
+/**@brief One frame as a CSV row, the header row first when the metric count changed */
+static int dumpFrame(char const *hex)
+{
+    uint8_t frame[DUMP_HEADER_SIZE + DUMP_METRICS_MAX * 4 + 4];
+    uint32_t size = 0;
+    unsigned value;
+    uint8_t count;
+
+    while (size < sizeof(frame) && sscanf(hex, "%2x", &value) == 1)
+    {
+        frame[size++] = (uint8_t)value;
+        hex += 2;
+    }
+
+    count = (size > 2) ? frame[2] : 0;
+    if (size < DUMP_HEADER_SIZE + 4 || frame[0] != DUMP_FRAME_MAGIC || frame[1] != DUMP_VERSION ||
+        size != DUMP_HEADER_SIZE + count * 4u + 4 || dumpCrc32(frame, size - 4) != dumpGet32(&frame[size - 4]))
+    {
+        return -1;
+    }
+
+    if (dumpColumns != count)
+    {
+        dumpColumns = count;
+        printf("addr,role,sequence,uptime_ms");
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (i < dumpNameCount)
+            {
+                printf(",%s", dumpNames[i]);
+            }
+            else
+            {
+                printf(",m%u", i);
+            }
+        }
+        printf("\n");
+    }
+
+    printf("%02x:%02x:%02x:%02x:%02x:%02x,%u,%u,%u",
+           frame[9], frame[8], frame[7], frame[6], frame[5], frame[4],
+           frame[3],
+           frame[10] | (frame[11] << 8),
+           dumpGet32(&frame[12]));
+    for (uint8_t i = 0; i < count; i++)
+    {
+        printf(",%u", dumpGet32(&frame[DUMP_HEADER_SIZE + i * 4]));
+    }
+    printf("\n");
+    return 0;
+}
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+int main(int argc, char **argv)
+{
+    char line[DUMP_LINE_MAX];
+    uint32_t bad = 0;
+
+    while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+        char const *info  = strstr(line, "METRICSINFO,");
+        char const *frame = strstr(line, "METRICS,");
+
+        if (info != NULL)
+        {
+            dumpInfo(info);
+        }
+        else if (frame != NULL && dumpFrame(frame + 8) != 0)
+        {
+            bad++;
+        }
+    }
+
+    if (bad != 0)
+    {
+        fprintf(stderr, "%u malformed frames skipped\n", bad);
+    }
+    return 0;
+}
@@ -0,0 +1,867 @@
+/** @file       netsim.c
+ *  @brief      Discrete-event simulator of a master and N slaves on a shared virtual radio, parameter sweeps
+ *  @author     Evren Kenanoglu
+ *  @date       4/19/2021
+ *
+ *  Every node runs the firmware phase engine (and rendezvous on slaves) unchanged, bound to simulated
+ *  timers with clock drift. Advertising events are three PDUs on channels 37, 38 and 39 with advDelay.
+ *  Scanners listen to one channel per scan interval. RSSI follows a log-distance path loss with per
+ *  link shadowing and per PDU fading. A PDU is received when it is above sensitivity and every
+ *  overlapping PDU on the same channel is at least NET_CAPTURE_DB weaker at that receiver. Slaves
+ *  detect the master when its PDU passes the RSSI filter, as in advReportProcess().
+ *
+ *  Every option takes a comma separated list, the sweep is the cartesian product and runs on all cores:
+ *      gcc -O2 -Wall -pthread -DBOARD_PCA10059 -I. -Ihost/stubs -o netsim host/netsim.c phaseengine.c rendezvous.c -lm
+ *      ./netsim --scan 100,200,400 --adv 200 --sleep 1000,2000,5000 --interval 20,100 --nodes 10,50
+ *
+ *  Options (defaults from parameters.h): --scan --adv --sleep --interval (ms), --nodes (slaves),
+ *  --rendezvous (0/1), --area (m, side of the square), --rssi (dBm filter), --seed, --seconds,
+ *  --jobs (threads, default all cores). Output is one CSV line per configuration.
+ */
+
+/** INCLUDES ******************************************************************/
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "phaseengine.h"
+#include "rendezvous.h"
+#include "energy.h"
+
+/** CONSTANTS *****************************************************************/
+#define NET_LIST_MAX         16
+#define NET_CONFIGS_MAX      4096
+#define NET_PDU_US           352    // 31 byte payload at 1 Mbps
+#define NET_CHANNEL_STEP_US  500    // PDU start to next channel PDU start in an event
+#define NET_TX_RAMP_US       140    // Radio ramp up per PDU
+#define NET_ADV_START_US     1000   // Advertising start to first event
+#define NET_ADV_DELAY_US     10000  // advDelay 0-10 ms
+#define NET_SCAN_START_US    500    // Scan start to first RX
+#define NET_SCAN_INTERVAL_US 100000 // NRF_BLE_SCAN_SCAN_INTERVAL, window = interval
+#define NET_TIMER_LATENCY_US 200
+#define NET_WAKE_CPU_US      1000 // CPU time per transition
+#define NET_DRIFT_PPM        50
+#define NET_BOOT_SPREAD_US   3000000
+#define NET_TX_POWER_DBM     0
+#define NET_PATH_LOSS_1M_DB  40.0 // 2.4 GHz at 1 m
+#define NET_PATH_LOSS_EXP    2.5  // Indoor
+#define NET_SHADOWING_DB     4.0  // Per link, static
+#define NET_FADING_DB        2.0  // Per PDU and receiver
+#define NET_SENSITIVITY_DBM  (-95.0)
+#define NET_CAPTURE_DB       6.0
+#define NET_RING_SIZE        4096 // PDUs per channel kept for overlap checks, power of 2
+#define NET_NEVER            UINT64_MAX
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eNetParamScan = 0,
+    eNetParamAdv,
+    eNetParamSleep,
+    eNetParamInterval,
+    eNetParamNodes,
+    eNetParamRendezvous,
+    eNetParamArea,
+    eNetParamRssi,
+    eNetParamSeed,
+    eNetParamCount,
+} teNetParams;
+
+typedef enum
+{
+    eNetEvtTimer = 0, // Engine timer of a node
+    eNetEvtAdv,       // Advertising event of a node
+    eNetEvtPduEnd,    // End of a PDU, reception is resolved
+} teNetEvents;
+
+typedef struct
+{
+    double values[eNetParamCount];
+} tsNetConfig;
+
+typedef struct
+{
+    uint64_t time;
+    uint64_t order; // FIFO for equal times
+    uint32_t node;
+    uint32_t tag;   // Generation (timer, advertising) or PDU id
+    uint8_t type;
+} tsNetEvent;
+
+typedef struct
+{
+    uint64_t id;
+    uint64_t start;
+    uint32_t src;
+    uint32_t event; // Advertising event id of the source
+    uint8_t channel;
+} tsNetPdu;
+
+typedef struct tsNetSim tsNetSim;
+
+typedef struct
+{
+    tsNetSim *sim;
+    uint32_t id;
+    uint8_t role;
+    tsPhaseEngine engine;
+    tsProgramParams params;
+    tsRendezvous rv;
+    double x, y;
+    double drift;
+    uint32_t offset;
+    uint32_t timerGen;
+    uint32_t advGen;
+    uint32_t advEvent;
+    uint64_t advEnd;
+    uint8_t scanning;
+    uint8_t scanHit;
+    uint64_t scanStarted;
+    uint8_t phase;
+    uint64_t phaseStart;
+    double charge; // uC
+    uint64_t bootAt;
+    uint64_t firstDetect;
+    uint64_t lastDetect;
+    uint32_t lastHeardEvent; // Master: last slave advertising event heard
+} tsNetNode;
+
+typedef struct
+{
+    double detected;
+    double firstP50, firstP90, firstP99; // ms
+    double gapP50, gapP99;               // ms
+    uint64_t pdus;
+    uint64_t collided;                   // PDUs overlapped by another PDU on the same channel
+    uint64_t receptions;                 // PDU receptions above sensitivity at listening nodes
+    uint64_t lostCollision;              // of them, lost to a collision
+    double responsesPerSecond;           // Slave advertising events heard by the master
+    double slaveUa;
+    double masterUa;
+} tsNetResult;
+
+struct tsNetSim
+{
+    tsNetConfig const *config;
+    uint32_t scan, adv, sleep, interval; // ms
+    uint32_t nodeCount;
+    uint8_t rendezvous;
+    double rssiFilter;
+    uint64_t now;
+    uint64_t end;
+    uint64_t rng;
+    uint64_t order;
+    tsNetNode *nodes;
+    double *shadowing; // nodeCount x nodeCount
+    tsNetEvent *heap;
+    uint32_t heapSize;
+    uint32_t heapCapacity;
+    tsNetPdu ring[3][NET_RING_SIZE];
+    uint64_t ringHead[3];
+    uint64_t pduId;
+    double *firsts;
+    uint32_t firstCount;
+    double *gaps;
+    uint32_t gapCount;
+    uint32_t gapCapacity;
+    tsNetResult result;
+};
+
+/** VARIABLES *****************************************************************/
+
+static const char *const netParamNames[eNetParamCount] = {"scan", "adv", "sleep", "interval", "nodes", "rendezvous", "area", "rssi", "seed"};
+static double netLists[eNetParamCount][NET_LIST_MAX];
+static uint32_t netListSizes[eNetParamCount];
+static tsNetConfig netConfigs[NET_CONFIGS_MAX];
+static tsNetResult netResults[NET_CONFIGS_MAX];
+static uint32_t netConfigCount;
+static uint32_t netNext;
+static uint32_t netSeconds = 3600;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void netRun(tsNetConfig const *config, tsNetResult *result);
+static void *netWorker(void *arg);
+static void netPush(tsNetSim *sim, uint64_t time, uint8_t type, uint32_t node, uint32_t tag);
+static bool netPop(tsNetSim *sim, tsNetEvent *event);
+static void netAdvEvent(tsNetSim *sim, tsNetNode *node);
+static void netPduEnd(tsNetSim *sim, uint8_t channel, uint32_t position);
+static void netReceive(tsNetSim *sim, tsNetNode *rx, tsNetPdu const *pdu, double rssi);
+static double netRssi(tsNetSim *sim, uint32_t tx, uint32_t rx, uint64_t pduId);
+static void netCharge(tsNetNode *node, uint8_t nextPhase);
+static uint32_t netLocal(tsNetNode const *node, uint64_t global);
+static uint64_t netRandom(tsNetSim *sim);
+static double netGauss(uint64_t seed);
+static uint64_t netMix(uint64_t x);
+static double netPercentile(double *values, uint32_t count, double p);
+static int netCompare(void const *a, void const *b);
+
+static void simTimerStart(void *context, uint32_t duration);
+static void simScanStart(void *context);
+static void simScanStop(void *context);
+static void simAdvStart(void *context);
+static void simAdvStop(void *context);
+static void simPhaseChanged(void *context, uint8_t from, uint8_t to);
+static uint32_t simTimingAdjust(void *context, uint8_t state, uint32_t duration);
+static bool simScanScheduled(void *context);
+
+static const tsPhaseHooks netHooks =
+    {
+        .timerStart   = simTimerStart,
+        .scanStart    = simScanStart,
+        .scanStop     = simScanStop,
+        .advStart     = simAdvStart,
+        .advStop      = simAdvStop,
+        .phaseChanged = simPhaseChanged,
+};
+
+static const tsPhaseHooks netHooksRendezvous =
+    {
+        .timerStart    = simTimerStart,
+        .scanStart     = simScanStart,
+        .scanStop      = simScanStop,
+        .advStart      = simAdvStart,
+        .advStop       = simAdvStop,
+        .phaseChanged  = simPhaseChanged,
+        .timingAdjust  = simTimingAdjust,
+        .scanScheduled = simScanScheduled,
+};
+
+/** FUNCTIONS *****************************************************************/
+
+int main(int argc, char **argv)
+{
+    static const double defaults[eNetParamCount] = {SCAN_TIMEOUT, ADVERTISEMENT_TIMEOUT, SLEEP_DURATION, MIN_ADVERTISEMENT_INTERVAL,
+                                                    10, RENDEZVOUS_ENABLE, 2, RSSI_FILTER_VALUE, 1};
+    uint32_t jobs = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t threads[256];
+
+    for (uint8_t p = 0; p < eNetParamCount; p++)
+    {
+        netLists[p][0]  = defaults[p];
+        netListSizes[p] = 1;
+    }
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        uint8_t p;
+
+        if (!strcmp(argv[i], "--seconds"))
+        {
+            netSeconds = (uint32_t)atoi(argv[i + 1]);
+            continue;
+        }
+        if (!strcmp(argv[i], "--jobs"))
+        {
+            jobs = (uint32_t)atoi(argv[i + 1]);
+            continue;
+        }
+        for (p = 0; p < eNetParamCount; p++)
+        {
+            if (!strncmp(argv[i], "--", 2) && !strcmp(argv[i] + 2, netParamNames[p]))
+            {
+                char *list = argv[i + 1];
+
+                netListSizes[p] = 0;
+                while (*list != '\0' && netListSizes[p] < NET_LIST_MAX)
+                {
+                    netLists[p][netListSizes[p]++] = strtod(list, &list);
+                    list += (*list == ',');
+                }
+                break;
+            }
+        }
+        if (p == eNetParamCount)
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // Cartesian product, last parameter changes fastest
+    netConfigCount = 1;
+    for (uint8_t p = 0; p < eNetParamCount; p++)
+    {
+        netConfigCount *= netListSizes[p];
+    }
+    if (netConfigCount > NET_CONFIGS_MAX)
+    {
+        fprintf(stderr, "%u configurations, max %d\n", netConfigCount, NET_CONFIGS_MAX);
+        return 1;
+    }
+    for (uint32_t c = 0; c < netConfigCount; c++)
+    {
+        uint32_t index = c;
+
+        for (int p = eNetParamCount - 1; p >= 0; p--)
+        {
+            netConfigs[c].values[p] = netLists[p][index % netListSizes[p]];
+            index /= netListSizes[p];
+        }
+    }
+
+    jobs = (jobs == 0) ? 1 : (jobs > 256) ? 256 : jobs;
+    jobs = (jobs > netConfigCount) ? netConfigCount : jobs;
+    fprintf(stderr, "%u configurations, %u s each, %u threads\n", netConfigCount, netSeconds, jobs);
+    for (uint32_t j = 0; j < jobs; j++)
+    {
+        pthread_create(&threads[j], NULL, netWorker, NULL);
+    }
+    for (uint32_t j = 0; j < jobs; j++)
+    {
+        pthread_join(threads[j], NULL);
+    }
+
+    for (uint8_t p = 0; p < eNetParamCount; p++)
+    {
+        printf("%s,", netParamNames[p]);
+    }
+    printf("detected,first_p50_ms,first_p90_ms,first_p99_ms,gap_p50_ms,gap_p99_ms,pdus,collided_pct,lost_collision_pct,responses_per_s,slave_ua,master_ua\n");
+    for (uint32_t c = 0; c < netConfigCount; c++)
+    {
+        tsNetResult const *r = &netResults[c];
+
+        for (uint8_t p = 0; p < eNetParamCount; p++)
+        {
+            printf("%g,", netConfigs[c].values[p]);
+        }
+        printf("%.3f,%.0f,%.0f,%.0f,%.0f,%.0f,%llu,%.2f,%.2f,%.2f,%.1f,%.1f\n",
+               r->detected, r->firstP50, r->firstP90, r->firstP99, r->gapP50, r->gapP99,
+               (unsigned long long)r->pdus,
+               r->pdus ? 100.0 * r->collided / r->pdus : 0,
+               r->receptions ? 100.0 * r->lostCollision / r->receptions : 0,
+               r->responsesPerSecond, r->slaveUa, r->masterUa);
+    }
+
+    return 0;
+}
+
+/**@brief Sweep worker, takes configurations until none is left */
+static void *netWorker(void *arg)
+{
+    for (;;)
+    {
+        uint32_t c = __atomic_fetch_add(&netNext, 1, __ATOMIC_RELAXED);
+
+        if (c >= netConfigCount)
+        {
+            return NULL;
+        }
+        netRun(&netConfigs[c], &netResults[c]);
+    }
+}
+
+/**
+ * @brief One configuration, node 0 is the master in the middle of the area
+ */
+static void netRun(tsNetConfig const *config, tsNetResult *result)
+{
+    tsNetSim *sim = calloc(1, sizeof(tsNetSim));
+    double area   = config->values[eNetParamArea];
+    tsRendezvousConfig rvConfig;
+    tsNetEvent event;
+    uint32_t slaves;
+
+    sim->config     = config;
+    sim->scan       = (uint32_t)config->values[eNetParamScan];
+    sim->adv        = (uint32_t)config->values[eNetParamAdv];
+    sim->sleep      = (uint32_t)config->values[eNetParamSleep];
+    sim->interval   = (uint32_t)config->values[eNetParamInterval];
+    sim->rendezvous = (uint8_t)config->values[eNetParamRendezvous];
+    sim->rssiFilter = config->values[eNetParamRssi];
+    sim->rng        = netMix((uint64_t)config->values[eNetParamSeed] + 1);
+    sim->end        = (uint64_t)netSeconds * 1000000;
+    slaves          = (uint32_t)config->values[eNetParamNodes];
+    sim->nodeCount  = slaves + 1;
+    sim->nodes      = calloc(sim->nodeCount, sizeof(tsNetNode));
+    sim->shadowing  = calloc((size_t)sim->nodeCount * sim->nodeCount, sizeof(double));
+    sim->firsts     = calloc(sim->nodeCount, sizeof(double));
+
+    rvConfig.period          = (sim->scan + sim->adv) * 1000;
+    rvConfig.jitter          = RENDEZVOUS_JITTER_MS * 1000;
+    rvConfig.guard           = RENDEZVOUS_GUARD_MS * 1000;
+    rvConfig.periodTolerance = RENDEZVOUS_PERIOD_TOLERANCE_US;
+    rvConfig.syncTolerance   = RENDEZVOUS_SYNC_TOLERANCE_US;
+    rvConfig.maxMisses       = RENDEZVOUS_MAX_MISSES;
+
+    for (uint32_t a = 0; a < sim->nodeCount; a++)
+    {
+        for (uint32_t b = a + 1; b < sim->nodeCount; b++)
+        {
+            double shadow = NET_SHADOWING_DB * netGauss(netRandom(sim));
+
+            sim->shadowing[a * sim->nodeCount + b] = shadow;
+            sim->shadowing[b * sim->nodeCount + a] = shadow;
+        }
+    }
+
+    for (uint32_t i = 0; i < sim->nodeCount; i++)
+    {
+        tsNetNode *node = &sim->nodes[i];
+
+        node->sim                  = sim;
+        node->id                   = i;
+        node->role                 = (i == 0) ? eRoleMaster : eRoleSlave;
+        node->x                    = (i == 0) ? area / 2 : area * (double)(netRandom(sim) % 10000) / 10000;
+        node->y                    = (i == 0) ? area / 2 : area * (double)(netRandom(sim) % 10000) / 10000;
+        node->drift                = ((double)(netRandom(sim) % (2 * NET_DRIFT_PPM + 1)) - NET_DRIFT_PPM) * 1e-6;
+        node->offset               = (uint32_t)netRandom(sim);
+        node->firstDetect          = NET_NEVER;
+        node->lastDetect           = NET_NEVER;
+        node->lastHeardEvent       = UINT32_MAX;
+        node->params.programStatus = eModeFirstStart;
+        node->phase                = eModeFirstStart;
+
+        rendezvousInit(&node->rv, &rvConfig);
+        phaseEngineInit(&node->engine, node->role, &node->params,
+                        (node->role == eRoleSlave && sim->rendezvous) ? &netHooksRendezvous : &netHooks, node);
+        node->engine.timings[ePhaseTimingScan]  = sim->scan;
+        node->engine.timings[ePhaseTimingAdv]   = sim->adv;
+        node->engine.timings[ePhaseTimingSleep] = sim->sleep;
+
+        // Boot spread: the first timer of the engine is armed later
+        sim->now     = netRandom(sim) % NET_BOOT_SPREAD_US;
+        node->bootAt = sim->now;
+        phaseEngineStart(&node->engine);
+    }
+
+    while (netPop(sim, &event) && event.time < sim->end)
+    {
+        tsNetNode *node = &sim->nodes[event.node];
+
+        sim->now = event.time;
+        switch (event.type)
+        {
+            case eNetEvtTimer:
+                if (event.tag == node->timerGen)
+                {
+                    phaseEngineStep(&node->engine);
+                }
+                break;
+
+            case eNetEvtAdv:
+                if (event.tag == node->advGen)
+                {
+                    netAdvEvent(sim, node);
+                }
+                break;
+
+            case eNetEvtPduEnd:
+                netPduEnd(sim, (uint8_t)event.node, event.tag);
+                break;
+
+            default:
+                break;
+        }
+    }
+    sim->now = sim->end;
+
+    // Results
+    *result = sim->result;
+    for (uint32_t i = 0; i < sim->nodeCount; i++)
+    {
+        tsNetNode *node = &sim->nodes[i];
+
+        netCharge(node, node->phase);
+        if (node->role == eRoleMaster)
+        {
+            result->masterUa = node->charge / ((double)(sim->end - node->bootAt) / 1e6);
+        }
+        else
+        {
+            result->slaveUa += node->charge / ((double)(sim->end - node->bootAt) / 1e6) / slaves;
+            if (node->firstDetect != NET_NEVER)
+            {
+                sim->firsts[sim->firstCount++] = (double)(node->firstDetect - node->bootAt) / 1000;
+            }
+        }
+    }
+    result->detected           = slaves ? (double)sim->firstCount / slaves : 0;
+    result->firstP50           = netPercentile(sim->firsts, sim->firstCount, 0.50);
+    result->firstP90           = netPercentile(sim->firsts, sim->firstCount, 0.90);
+    result->firstP99           = netPercentile(sim->firsts, sim->firstCount, 0.99);
+    result->gapP50             = netPercentile(sim->gaps, sim->gapCount, 0.50);
+    result->gapP99             = netPercentile(sim->gaps, sim->gapCount, 0.99);
+    result->responsesPerSecond = result->responsesPerSecond / netSeconds;
+
+    free(sim->firsts);
+    free(sim->gaps);
+    free(sim->heap);
+    free(sim->shadowing);
+    free(sim->nodes);
+    free(sim);
+}
+
+/**
+ * @brief Advertising event: three PDUs, next event after the interval and advDelay
+ */
+static void netAdvEvent(tsNetSim *sim, tsNetNode *node)
+{
+    uint64_t next;
+
+    node->advEvent++;
+    for (uint8_t channel = 0; channel < 3; channel++)
+    {
+        tsNetPdu *pdu = &sim->ring[channel][sim->ringHead[channel] % NET_RING_SIZE];
+
+        pdu->id      = ++sim->pduId;
+        pdu->start   = sim->now + channel * NET_CHANNEL_STEP_US;
+        pdu->src     = node->id;
+        pdu->event   = node->advEvent;
+        pdu->channel = channel;
+        sim->ringHead[channel]++;
+
+        // Channel and ring position are carried in node and tag of the event
+        netPush(sim, pdu->start + NET_PDU_US, eNetEvtPduEnd, channel, (uint32_t)(sim->ringHead[channel] - 1));
+        node->charge += (double)ENERGY_CURRENT_RADIO_TX_UA * (NET_PDU_US + NET_TX_RAMP_US) / 1e6;
+        sim->result.pdus++;
+    }
+
+    next = sim->now + (uint64_t)(sim->interval * 1000.0 / (1 + node->drift)) + netRandom(sim) % NET_ADV_DELAY_US;
+    if (next < node->advEnd)
+    {
+        netPush(sim, next, eNetEvtAdv, node->id, node->advGen);
+    }
+}
+
+/**
+ * @brief PDU is over: collision bookkeeping and reception at every listening node
+ */
+static void netPduEnd(tsNetSim *sim, uint8_t channel, uint32_t position)
+{
+    tsNetPdu const *pdu = &sim->ring[channel][position % NET_RING_SIZE];
+    tsNetPdu const *overlaps[64];
+    uint32_t overlapCount = 0;
+
+    if ((uint32_t)sim->ringHead[channel] - position > NET_RING_SIZE)
+    {
+        return; // Overwritten, ring too small for the load
+    }
+
+    // Same channel PDUs overlapping in time
+    for (uint64_t back = 1; back <= NET_RING_SIZE && back <= sim->ringHead[pdu->channel]; back++)
+    {
+        tsNetPdu const *other = &sim->ring[pdu->channel][(sim->ringHead[pdu->channel] - back) % NET_RING_SIZE];
+
+        if (other->start + NET_PDU_US <= pdu->start)
+        {
+            break;
+        }
+        if (other->id != pdu->id && other->start < pdu->start + NET_PDU_US && overlapCount < 64)
+        {
+            overlaps[overlapCount++] = other;
+        }
+    }
+    sim->result.collided += (overlapCount > 0);
+
+    for (uint32_t r = 0; r < sim->nodeCount; r++)
+    {
+        tsNetNode *rx = &sim->nodes[r];
+        uint64_t listen;
+        double rssi;
+        bool lost = false;
+
+        if (r == pdu->src || !rx->scanning)
+        {
+            continue;
+        }
+        listen = rx->scanStarted + NET_SCAN_START_US;
+        if (pdu->start < listen ||
+            ((pdu->start - rx->scanStarted) / NET_SCAN_INTERVAL_US) % 3 != pdu->channel ||
+            ((pdu->start - rx->scanStarted) / NET_SCAN_INTERVAL_US) != ((sim->now - rx->scanStarted) / NET_SCAN_INTERVAL_US))
+        {
+            continue;
+        }
+
+        rssi = netRssi(sim, pdu->src, r, pdu->id);
+        if (rssi < NET_SENSITIVITY_DBM)
+        {
+            continue;
+        }
+        sim->result.receptions++;
+        for (uint32_t o = 0; o < overlapCount && !lost; o++)
+        {
+            if (overlaps[o]->src != r && rssi - netRssi(sim, overlaps[o]->src, r, overlaps[o]->id) < NET_CAPTURE_DB)
+            {
+                lost = true;
+            }
+        }
+        if (lost)
+        {
+            sim->result.lostCollision++;
+            continue;
+        }
+        netReceive(sim, rx, pdu, rssi);
+    }
+}
+
+/**
+ * @brief PDU received: master detection on slaves, response counting on the master
+ */
+static void netReceive(tsNetSim *sim, tsNetNode *rx, tsNetPdu const *pdu, double rssi)
+{
+    tsNetNode *tx = &sim->nodes[pdu->src];
+
+    if (rx->role == eRoleMaster)
+    {
+        if (tx->role == eRoleSlave && rx->lastHeardEvent != (pdu->src << 20 ^ pdu->event))
+        {
+            rx->lastHeardEvent = pdu->src << 20 ^ pdu->event;
+            sim->result.responsesPerSecond++;
+        }
+        return;
+    }
+    if (tx->role != eRoleMaster || rssi <= sim->rssiFilter)
+    {
+        return;
+    }
+
+    // deviceDetectionHandler()
+    if (!rx->scanHit)
+    {
+        if (rx->firstDetect == NET_NEVER)
+        {
+            rx->firstDetect = sim->now;
+        }
+        else if (rx->lastDetect != NET_NEVER)
+        {
+            if (sim->gapCount == sim->gapCapacity)
+            {
+                sim->gapCapacity = sim->gapCapacity ? 2 * sim->gapCapacity : 1024;
+                sim->gaps        = realloc(sim->gaps, sim->gapCapacity * sizeof(double));
+            }
+            sim->gaps[sim->gapCount++] = (double)(sim->now - rx->lastDetect) / 1000;
+        }
+        rx->lastDetect = sim->now;
+    }
+    rx->scanHit = 1;
+    if (sim->rendezvous)
+    {
+        rendezvousDetection(&rx->rv, netLocal(rx, sim->now));
+    }
+    phaseEngineDeviceDetected(&rx->engine);
+}
+
+/**
+ * @brief RSSI of a PDU at a receiver: path loss, link shadowing and fading
+ */
+static double netRssi(tsNetSim *sim, uint32_t tx, uint32_t rx, uint64_t pduId)
+{
+    tsNetNode const *a = &sim->nodes[tx];
+    tsNetNode const *b = &sim->nodes[rx];
+    double distance    = sqrt((a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y));
+
+    distance = (distance < 0.1) ? 0.1 : distance;
+    return NET_TX_POWER_DBM - NET_PATH_LOSS_1M_DB - 10 * NET_PATH_LOSS_EXP * log10(distance) -
+           sim->shadowing[tx * sim->nodeCount + rx] - NET_FADING_DB * netGauss(pduId * 0x9E3779B97F4A7C15ull ^ rx);
+}
+
+/** Phase engine hooks ********************************************************/
+
+static void simTimerStart(void *context, uint32_t duration)
+{
+    tsNetNode *node = context;
+    tsNetSim *sim   = node->sim;
+
+    node->timerGen++;
+    netPush(sim, sim->now + (uint64_t)(duration * 1000.0 / (1 + node->drift)) + NET_TIMER_LATENCY_US, eNetEvtTimer, node->id, node->timerGen);
+}
+
+static void simScanStart(void *context)
+{
+    tsNetNode *node = context;
+
+    node->scanning    = 1;
+    node->scanHit     = 0;
+    node->scanStarted = node->sim->now;
+    if (node->sim->rendezvous && node->role == eRoleSlave)
+    {
+        rendezvousScanStart(&node->rv, netLocal(node, node->sim->now));
+    }
+}
+
+static void simScanStop(void *context)
+{
+    tsNetNode *node = context;
+
+    node->scanning = 0;
+    if (node->sim->rendezvous && node->role == eRoleSlave)
+    {
+        rendezvousScanEnd(&node->rv, netLocal(node, node->sim->now));
+    }
+}
+
+static void simAdvStart(void *context)
+{
+    tsNetNode *node = context;
+    tsNetSim *sim   = node->sim;
+
+    node->advGen++;
+    node->advEnd = sim->now + (uint64_t)node->engine.timings[ePhaseTimingAdv] * 1000;
+    netPush(sim, sim->now + NET_ADV_START_US + netRandom(sim) % NET_ADV_DELAY_US, eNetEvtAdv, node->id, node->advGen);
+}
+
+static void simAdvStop(void *context)
+{
+    tsNetNode *node = context;
+
+    node->advGen++; // Pending advertising event is dropped
+}
+
+static void simPhaseChanged(void *context, uint8_t from, uint8_t to)
+{
+    netCharge(context, to);
+}
+
+/**@brief Same binding as programTimingAdjust() in main.c, rendezvous only */
+static uint32_t simTimingAdjust(void *context, uint8_t state, uint32_t duration)
+{
+    tsNetNode *node = context;
+
+    switch (state)
+    {
+        case eModeScanning:
+            return rendezvousScanDurationGet(&node->rv, duration);
+        case eModeSleep:
+            return rendezvousSleepDurationGet(&node->rv, netLocal(node, node->sim->now), duration);
+        default:
+            return duration;
+    }
+}
+
+static bool simScanScheduled(void *context)
+{
+    tsNetNode *node = context;
+
+    return rendezvousLocked(&node->rv);
+}
+
+/** Helpers *******************************************************************/
+
+/**@brief Charge of the phase that is left, advertising PDUs are charged when sent */
+static void netCharge(tsNetNode *node, uint8_t nextPhase)
+{
+    double duration = (double)(node->sim->now - node->phaseStart); // us
+    double current  = (node->phase == eModeScanning) ? ENERGY_CURRENT_RADIO_RX_UA : ENERGY_CURRENT_SLEEP_UA;
+
+    node->charge += current * duration / 1e6 + (double)ENERGY_CURRENT_CPU_UA * NET_WAKE_CPU_US / 1e6;
+    node->phase      = nextPhase;
+    node->phaseStart = node->sim->now;
+}
+
+static uint32_t netLocal(tsNetNode const *node, uint64_t global)
+{
+    return (uint32_t)(uint64_t)(global * (1 + node->drift)) + node->offset;
+}
+
+/**@brief Binary heap, earliest event first, FIFO on equal times */
+static void netPush(tsNetSim *sim, uint64_t time, uint8_t type, uint32_t node, uint32_t tag)
+{
+    uint32_t i;
+
+    if (sim->heapSize == sim->heapCapacity)
+    {
+        sim->heapCapacity = sim->heapCapacity ? 2 * sim->heapCapacity : 1024;
+        sim->heap         = realloc(sim->heap, sim->heapCapacity * sizeof(tsNetEvent));
+    }
+
+    i = sim->heapSize++;
+    while (i > 0)
+    {
+        uint32_t parent = (i - 1) / 2;
+
+        if (sim->heap[parent].time < time || (sim->heap[parent].time == time && sim->heap[parent].order < sim->order))
+        {
+            break;
+        }
+        sim->heap[i] = sim->heap[parent];
+        i            = parent;
+    }
+    sim->heap[i] = (tsNetEvent){.time = time, .order = sim->order++, .node = node, .tag = tag, .type = type};
+}
+
+static bool netPop(tsNetSim *sim, tsNetEvent *event)
+{
+    tsNetEvent last;
+    uint32_t i = 0;
+
+    if (sim->heapSize == 0)
+    {
+        return false;
+    }
+    *event = sim->heap[0];
+    last   = sim->heap[--sim->heapSize];
+
+    for (;;)
+    {
+        uint32_t child = 2 * i + 1;
+
+        if (child >= sim->heapSize)
+        {
+            break;
+        }
+        if (child + 1 < sim->heapSize &&
+            (sim->heap[child + 1].time < sim->heap[child].time ||
+             (sim->heap[child + 1].time == sim->heap[child].time && sim->heap[child + 1].order < sim->heap[child].order)))
+        {
+            child++;
+        }
+        if (last.time < sim->heap[child].time || (last.time == sim->heap[child].time && last.order < sim->heap[child].order))
+        {
+            break;
+        }
+        sim->heap[i] = sim->heap[child];
+        i            = child;
+    }
+    sim->heap[i] = last;
+    return true;
+}
+
+/**@brief xorshift64* */
+static uint64_t netRandom(tsNetSim *sim)
+{
+    sim->rng ^= sim->rng >> 12;
+    sim->rng ^= sim->rng << 25;
+    sim->rng ^= sim->rng >> 27;
+    return sim->rng * 0x2545F4914F6CDD1Dull;
+}
+
+/**@brief splitmix64 finalizer */
+static uint64_t netMix(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/**@brief Standard normal from a seed, Box-Muller */
+static double netGauss(uint64_t seed)
+{
+    uint64_t a = netMix(seed);
+    uint64_t b = netMix(a);
+    double u1  = ((double)(a >> 11) + 1) / 9007199254740993.0;
+    double u2  = (double)(b >> 11) / 9007199254740992.0;
+
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static double netPercentile(double *values, uint32_t count, double p)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    qsort(values, count, sizeof(double), netCompare);
+    return values[(uint32_t)(p * (count - 1) + 0.5)];
+}
+
+static int netCompare(void const *a, void const *b)
+{
+    double x = *(double const *)a;
+    double y = *(double const *)b;
+
+    return (x > y) - (x < y);
+}
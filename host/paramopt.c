@@ -0,0 +1,786 @@
+/** @file       paramopt.c
+ *  @brief      Offline optimizer of the scan, advertising and sleep timings, discovery vs energy
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ *
+ *  Discovery is the slave hearing the master: the master scans SCAN_TIMEOUT and advertises
+ *  NUMBER_OF_ADVERTISEMENT_DURING_ADVERTISING events MIN_ADVERTISEMENT_INTERVAL apart (+ advDelay
+ *  0-10 ms each), the slave scans SCAN_TIMEOUT and sleeps SLEEP_DURATION. Both listen SCAN_DUTY % of
+ *  every scan interval (NRF_BLE_SCAN_SCAN_INTERVAL), one channel per scan interval. The two cycles
+ *  are free running, the phase of the slave scan window in the master cycle moves by the slave cycle
+ *  modulo the master cycle and the clock drift every slave cycle. Equal or harmonic cycles keep it
+ *  where it is, a phase without master events in the window is then missed for a very long time.
+ *
+ *  Analytic: hit probability of a window at every phase of the master cycle (Irwin-Hall sums of
+ *  the advDelays, events taken as independent), followed along the phase orbit of every boot phase
+ *  and drift up to the horizon. Monte-Carlo: trials with random boot phase, drift, advDelay and
+ *  scanned channel, event by event. Latency is slave boot to the end of the scan window that hears
+ *  the master, when the slave acts on it. RSSI, collisions and the slave response are left to
+ *  host/netsim.c, rendezvous and slots change the slave windows after the first discovery only.
+ *
+ *  Every configuration of the grid is evaluated analytically, the Pareto front of slave current vs
+ *  p90 latency (discovery probability within the horizon at least --discovery) is checked by
+ *  Monte-Carlo and printed as CSV. --emit writes the front point of the lowest slave current with a
+ *  p90 latency within --target as a header, built in with TUNED_ENABLE 1 in parameters.h.
+ *
+ *  Build and run from the repository root:
+ *      gcc -O2 -Wall -pthread -DBOARD_PCA10059 -I. -Ihost/stubs -o paramopt host/paramopt.c -lm
+ *      ./paramopt --sleep 1000:500:5000 --target 5000 --emit parameters_tuned.h > front.csv
+ *
+ *  Options (lists "a,b,c" or ranges "first:step:last"): --scan --interval (ms), --events,
+ *  --sleep (ms), --duty (%). Single values: --horizon (s, 60), --drift (relative ppm, 40),
+ *  --discovery (0.99), --master (uA, highest master current, 0: any), --trials (2000), --seed,
+ *  --jobs (threads, default all cores), --all (1: every configuration, not only the front),
+ *  --target (ms, 10000), --emit (file).
+ */
+
+/** INCLUDES ******************************************************************/
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "energy.h"
+
+/** CONSTANTS *****************************************************************/
+#define OPT_LIST_MAX         64
+#define OPT_CONFIGS_MAX      65536
+#define OPT_PHASES           512    // Window phases of the master cycle, analytic
+#define OPT_DRIFTS           5      // Drift points from -drift to +drift, analytic
+#define OPT_SURVIVAL_MIN     1e-9   // Orbit is left when it is discovered with this certainty
+#define OPT_PDU_US           352    // 31 byte payload at 1 Mbps
+#define OPT_CHANNEL_STEP_US  500    // PDU start to next channel PDU start in an event
+#define OPT_TX_RAMP_US       140    // Radio ramp up per PDU
+#define OPT_ADV_START_US     1000   // Advertising start to first event
+#define OPT_ADV_DELAY_US     10000  // advDelay 0-10 ms
+#define OPT_SCAN_START_US    500    // Scan start to first RX
+#define OPT_SCAN_INTERVAL_US (NRF_BLE_SCAN_SCAN_INTERVAL_UNITS * 625)
+#define OPT_WAKE_CPU_US      1000   // CPU time per transition
+#define OPT_NEVER            INFINITY
+
+#if defined(BOARD_PCA10059) // Current model of energy.h
+#define OPT_BOARD "pca10059"
+#elif defined(BOARD_PCA10056)
+#define OPT_BOARD "pca10056"
+#else
+#define OPT_BOARD "pca10040"
+#endif
+
+#ifndef NRF_BLE_SCAN_SCAN_INTERVAL_UNITS
+#define NRF_BLE_SCAN_SCAN_INTERVAL_UNITS 160 // NRF_BLE_SCAN_SCAN_INTERVAL of sdk_config.h, 100 ms
+#endif
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eOptParamScan = 0,
+    eOptParamInterval,
+    eOptParamEvents,
+    eOptParamSleep,
+    eOptParamDuty,
+    eOptParamCount,
+} teOptParams;
+
+typedef struct
+{
+    double values[eOptParamCount];
+} tsOptConfig;
+
+typedef struct
+{
+    double slaveUa;
+    double masterUa;
+    double events;                 // Master advertising events per cycle, advDelay can push the last out
+    double cycle;                  // Mean window hit probability over the master cycle
+    double discovered;             // Within the horizon
+    double mean, p50, p90, p99;    // ms, mean of the discovered, OPT_NEVER: beyond the horizon
+    double mcDiscovered;           // Monte-Carlo
+    double mcMean, mcP50, mcP90, mcP99;
+    bool feasible;
+    bool front;
+} tsOptResult;
+
+/** VARIABLES *****************************************************************/
+
+static const char *const optParamNames[eOptParamCount] = {"scan", "interval", "events", "sleep", "duty"};
+static double optLists[eOptParamCount][OPT_LIST_MAX];
+static uint32_t optListSizes[eOptParamCount];
+static tsOptConfig optConfigs[OPT_CONFIGS_MAX];
+static tsOptResult optResults[OPT_CONFIGS_MAX];
+static uint32_t optConfigCount;
+static uint32_t optNext;
+static uint32_t optStage; // 0: analytic, 1: Monte-Carlo of the front
+
+static double optHorizon   = 60;   // s
+static double optDrift     = 40;   // ppm
+static double optDiscovery = 0.99;
+static double optMasterMax = 0;    // uA
+static uint32_t optTrials  = 2000;
+static uint64_t optSeed    = 1;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void optAnalytic(tsOptConfig const *config, tsOptResult *result);
+static void optMonteCarlo(tsOptConfig const *config, tsOptResult *result, uint64_t seed);
+static double optListening(double scan, double duty);
+static double optHeard(double scan, double duty, double base, uint32_t delays, double end);
+static double optDelaySum(double x, uint32_t n);
+static double optPercentile(double const *mass, uint32_t count, double period, double offset, double p);
+static void *optWorker(void *arg);
+static uint32_t optParse(char const *text, double *list, uint32_t max);
+static void optPrintHeader(void);
+static void optPrint(tsOptConfig const *config, tsOptResult const *result);
+static int optEmit(char const *path, tsOptConfig const *config, tsOptResult const *result, int argc, char **argv);
+static uint64_t optRandom(uint64_t *state);
+static double optUniform(uint64_t *state);
+static int optCompare(void const *a, void const *b);
+static int optCompareLatency(void const *a, void const *b);
+
+/** FUNCTIONS *****************************************************************/
+
+int main(int argc, char **argv)
+{
+    static const double defaults[eOptParamCount] = {SCAN_TIMEOUT, MIN_ADVERTISEMENT_INTERVAL, NUMBER_OF_ADVERTISEMENT_DURING_ADVERTISING,
+                                                    SLEEP_DURATION, SCAN_DUTY};
+    static const char *const grids[eOptParamCount] = {"20,50,100,150,200,300,400,600,800,1000", "20,30,50,100,200", "1,2,3,5,10",
+                                                      "0,500,1000,2000,3000,5000", "25,50,100"};
+    uint32_t jobs  = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    double target  = 10000;
+    char const *emit = NULL;
+    bool all       = false;
+    uint32_t skipped = 0;
+    uint32_t pick    = UINT32_MAX;
+    uint64_t total;
+    pthread_t threads[256];
+    tsOptConfig current;
+    tsOptResult currentResult;
+
+    for (uint8_t p = 0; p < eOptParamCount; p++)
+    {
+        optListSizes[p] = optParse(grids[p], optLists[p], OPT_LIST_MAX);
+    }
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        char const *value = argv[i + 1];
+        uint8_t p;
+
+        if (!strcmp(argv[i], "--horizon"))
+        {
+            optHorizon = atof(value);
+        }
+        else if (!strcmp(argv[i], "--drift"))
+        {
+            optDrift = atof(value);
+        }
+        else if (!strcmp(argv[i], "--discovery"))
+        {
+            optDiscovery = atof(value);
+        }
+        else if (!strcmp(argv[i], "--master"))
+        {
+            optMasterMax = atof(value);
+        }
+        else if (!strcmp(argv[i], "--trials"))
+        {
+            optTrials = (uint32_t)atoi(value);
+            optTrials = (optTrials == 0) ? 1 : optTrials;
+        }
+        else if (!strcmp(argv[i], "--seed"))
+        {
+            optSeed = (uint64_t)atoll(value);
+        }
+        else if (!strcmp(argv[i], "--jobs"))
+        {
+            jobs = (uint32_t)atoi(value);
+        }
+        else if (!strcmp(argv[i], "--all"))
+        {
+            all = atoi(value) != 0;
+        }
+        else if (!strcmp(argv[i], "--target"))
+        {
+            target = atof(value);
+        }
+        else if (!strcmp(argv[i], "--emit"))
+        {
+            emit = value;
+        }
+        else
+        {
+            for (p = 0; p < eOptParamCount; p++)
+            {
+                if (!strncmp(argv[i], "--", 2) && !strcmp(argv[i] + 2, optParamNames[p]))
+                {
+                    optListSizes[p] = optParse(value, optLists[p], OPT_LIST_MAX);
+                    break;
+                }
+            }
+            if (p == eOptParamCount)
+            {
+                fprintf(stderr, "unknown option %s\n", argv[i]);
+                return 1;
+            }
+        }
+    }
+
+    // Cartesian product, last parameter changes fastest, configurations the firmware refuses are left out
+    total = 1;
+    for (uint8_t p = 0; p < eOptParamCount; p++)
+    {
+        total *= optListSizes[p];
+    }
+    for (uint64_t c = 0; c < total; c++)
+    {
+        uint64_t index = c;
+        tsOptConfig config;
+
+        for (int p = eOptParamCount - 1; p >= 0; p--)
+        {
+            config.values[p] = optLists[p][index % optListSizes[p]];
+            index /= optListSizes[p];
+        }
+        if (config.values[eOptParamScan] < 1 || config.values[eOptParamInterval] < 20 || config.values[eOptParamInterval] > 10240 ||
+            config.values[eOptParamEvents] < 1 || config.values[eOptParamSleep] < 0 ||
+            config.values[eOptParamDuty] < 1 || config.values[eOptParamDuty] > 100 ||
+            (SLOT_ENABLE && config.values[eOptParamScan] < SLOT_COUNT * SLOT_LENGTH_MS))
+        {
+            skipped++;
+            continue;
+        }
+        if (optConfigCount == OPT_CONFIGS_MAX)
+        {
+            fprintf(stderr, "more than %d configurations\n", OPT_CONFIGS_MAX);
+            return 1;
+        }
+        optConfigs[optConfigCount++] = config;
+    }
+
+    memcpy(current.values, defaults, sizeof(defaults));
+    optAnalytic(&current, &currentResult);
+    optMonteCarlo(&current, &currentResult, optSeed);
+    fprintf(stderr, "parameters.h: scan %g interval %g events %g sleep %g duty %g, slave %.1f uA, master %.1f uA,"
+                    " window hit %.3f, discovered %.4f (mc %.4f) in %g s, p90 %.0f ms (mc %.0f)\n",
+            defaults[eOptParamScan], defaults[eOptParamInterval], defaults[eOptParamEvents], defaults[eOptParamSleep], defaults[eOptParamDuty],
+            currentResult.slaveUa, currentResult.masterUa, currentResult.cycle, currentResult.discovered, currentResult.mcDiscovered,
+            optHorizon, currentResult.p90, currentResult.mcP90);
+    if (optConfigCount == 0)
+    {
+        fprintf(stderr, "no configuration, %u left out\n", skipped);
+        return 1;
+    }
+
+    jobs = (jobs == 0) ? 1 : (jobs > 256) ? 256 : jobs;
+    fprintf(stderr, "%u configurations (%u left out: BLE limits%s), %u threads\n", optConfigCount, skipped,
+            SLOT_ENABLE ? ", slots longer than the scan window" : "", jobs);
+    for (optStage = 0; optStage < 2; optStage++)
+    {
+        optNext = 0;
+        for (uint32_t j = 0; j < jobs; j++)
+        {
+            pthread_create(&threads[j], NULL, optWorker, NULL);
+        }
+        for (uint32_t j = 0; j < jobs; j++)
+        {
+            pthread_join(threads[j], NULL);
+        }
+
+        if (optStage == 0)
+        {
+            // Front: lowest slave current first, a point is kept when its p90 beats every cheaper point
+            uint32_t *order = malloc(optConfigCount * sizeof(uint32_t));
+            double best     = OPT_NEVER;
+
+            for (uint32_t c = 0; c < optConfigCount; c++)
+            {
+                order[c] = c;
+            }
+            qsort(order, optConfigCount, sizeof(uint32_t), optCompare);
+            for (uint32_t c = 0; c < optConfigCount; c++)
+            {
+                tsOptResult *r = &optResults[order[c]];
+
+                if (r->feasible && r->p90 < best)
+                {
+                    r->front = true;
+                    best     = r->p90;
+                }
+            }
+            free(order);
+        }
+    }
+
+    optPrintHeader();
+    for (uint32_t c = 0; c < optConfigCount; c++)
+    {
+        if (all || optResults[c].front)
+        {
+            optPrint(&optConfigs[c], &optResults[c]);
+        }
+        // Cheapest front point meeting the target, by the Monte-Carlo figures
+        if (optResults[c].front && optResults[c].mcP90 <= target && optResults[c].mcDiscovered >= optDiscovery &&
+            (pick == UINT32_MAX || optResults[c].slaveUa < optResults[pick].slaveUa))
+        {
+            pick = c;
+        }
+    }
+
+    if (emit != NULL)
+    {
+        if (pick == UINT32_MAX)
+        {
+            fprintf(stderr, "no front point with p90 within %g ms, %s not written\n", target, emit);
+            return 1;
+        }
+        if (optEmit(emit, &optConfigs[pick], &optResults[pick], argc, argv) != 0)
+        {
+            fprintf(stderr, "cannot write %s\n", emit);
+            return 1;
+        }
+        fprintf(stderr, "%s: scan %g interval %g events %g sleep %g duty %g\n", emit,
+                optConfigs[pick].values[eOptParamScan], optConfigs[pick].values[eOptParamInterval],
+                optConfigs[pick].values[eOptParamEvents], optConfigs[pick].values[eOptParamSleep],
+                optConfigs[pick].values[eOptParamDuty]);
+    }
+    return 0;
+}
+
+/**@brief Worker, analytic of every configuration, then Monte-Carlo of the front */
+static void *optWorker(void *arg)
+{
+    for (;;)
+    {
+        uint32_t c = __atomic_fetch_add(&optNext, 1, __ATOMIC_RELAXED);
+
+        if (c >= optConfigCount)
+        {
+            return NULL;
+        }
+        if (optStage == 0)
+        {
+            optAnalytic(&optConfigs[c], &optResults[c]);
+        }
+        else if (optResults[c].front)
+        {
+            optMonteCarlo(&optConfigs[c], &optResults[c], optSeed + c);
+        }
+    }
+}
+
+/**
+ * @brief Analytic discovery and energy of one configuration, times in us
+ *
+ * @details Event j of an advertising phase is at OPT_ADV_START_US + j * interval + the sum of j + 1
+ *          advDelays. It exists while it is within the advertising phase, so the part of its
+ *          distribution beyond is not counted.
+ */
+static void optAnalytic(tsOptConfig const *config, tsOptResult *result)
+{
+    double scan     = config->values[eOptParamScan] * 1000;
+    double interval = config->values[eOptParamInterval] * 1000;
+    double events   = config->values[eOptParamEvents];
+    double sleep    = config->values[eOptParamSleep] * 1000;
+    double duty     = config->values[eOptParamDuty];
+    double adv      = interval * events;
+    double master   = scan + adv;
+    double slave    = scan + sleep;
+    double listen   = optListening(scan, duty);
+    double hit[OPT_PHASES];
+    double total    = 0;
+    uint32_t cycles = (uint32_t)(optHorizon * 1e6 / slave);
+    double *mass;
+    double weight = 1.0 / (OPT_PHASES * OPT_DRIFTS);
+
+    memset(result, 0, sizeof(*result));
+    cycles = (cycles == 0) ? 1 : cycles;
+    mass   = calloc(cycles, sizeof(double));
+
+    // Mean event count, the last events can fall beyond the advertising phase
+    for (uint32_t j = 0; j < (uint32_t)events; j++)
+    {
+        result->events += optDelaySum((adv - OPT_ADV_START_US - j * interval) / OPT_ADV_DELAY_US, j + 1);
+    }
+
+    // Window hit probability at every phase of the slave scan window in the master cycle
+    for (uint32_t g = 0; g < OPT_PHASES; g++)
+    {
+        double phase = (g + 0.5) * master / OPT_PHASES;
+        double miss  = 1;
+
+        for (uint32_t j = 0; j < (uint32_t)events; j++)
+        {
+            double p = 0;
+
+            // Event j of the master cycles around the window, PDU on the middle channel on average
+            for (int m = -1; m <= (int)(scan / master) + 1; m++)
+            {
+                double base = m * master + scan + OPT_ADV_START_US + j * interval + OPT_CHANNEL_STEP_US - phase;
+
+                p += optHeard(scan, duty, base, j + 1, m * master + master + OPT_CHANNEL_STEP_US - phase);
+            }
+            miss *= 1 - fmin(p, 1);
+        }
+        hit[g] = 1 - miss;
+        total += hit[g];
+    }
+    result->cycle = total / OPT_PHASES;
+
+    // Phase orbit of every boot phase and drift
+    for (uint32_t d = 0; d < OPT_DRIFTS; d++)
+    {
+        double drift = optDrift * 1e-6 * (2.0 * d / (OPT_DRIFTS - 1) - 1);
+        double step  = fmod(slave * (1 + drift), master);
+
+        for (uint32_t g = 0; g < OPT_PHASES; g++)
+        {
+            double phase    = (g + 0.5) * master / OPT_PHASES;
+            double survival = 1;
+
+            for (uint32_t k = 0; k < cycles && survival > OPT_SURVIVAL_MIN; k++)
+            {
+                double h = hit[(uint32_t)(phase / master * OPT_PHASES) % OPT_PHASES];
+
+                mass[k] += weight * survival * h;
+                survival *= 1 - h;
+                phase = fmod(phase + step, master);
+            }
+        }
+    }
+
+    for (uint32_t k = 0; k < cycles; k++)
+    {
+        result->discovered += mass[k];
+        result->mean += mass[k] * (k * slave + scan) / 1000;
+    }
+    result->mean = (result->discovered > 0) ? result->mean / result->discovered : OPT_NEVER;
+    result->p50  = optPercentile(mass, cycles, slave / 1000, scan / 1000, 0.50);
+    result->p90  = optPercentile(mass, cycles, slave / 1000, scan / 1000, 0.90);
+    result->p99  = optPercentile(mass, cycles, slave / 1000, scan / 1000, 0.99);
+    free(mass);
+
+    // Average currents, energy.h model, radio on while listening, sleep current otherwise
+    result->slaveUa = (listen * ENERGY_CURRENT_RADIO_RX_UA + (slave - listen) * ENERGY_CURRENT_SLEEP_UA +
+                       2 * OPT_WAKE_CPU_US * ENERGY_CURRENT_CPU_UA) /
+                      slave;
+    result->masterUa = (listen * ENERGY_CURRENT_RADIO_RX_UA + (master - listen) * ENERGY_CURRENT_SLEEP_UA +
+                        result->events * 3 * (OPT_PDU_US + OPT_TX_RAMP_US) * ENERGY_CURRENT_RADIO_TX_UA +
+                        2 * OPT_WAKE_CPU_US * ENERGY_CURRENT_CPU_UA) /
+                       master;
+    result->feasible = result->discovered >= optDiscovery && result->p90 != OPT_NEVER &&
+                       (optMasterMax == 0 || result->masterUa <= optMasterMax);
+}
+
+/**
+ * @brief Monte-Carlo discovery of one configuration, times in us of the master clock
+ *
+ * @details Master events are generated cycle by cycle, each is looked up in the slave window it
+ *          falls in. The scanner starts every window on channel 37 and moves on every scan interval.
+ */
+static void optMonteCarlo(tsOptConfig const *config, tsOptResult *result, uint64_t seed)
+{
+    double scan     = config->values[eOptParamScan] * 1000;
+    double interval = config->values[eOptParamInterval] * 1000;
+    double sleep    = config->values[eOptParamSleep] * 1000;
+    double duty     = config->values[eOptParamDuty];
+    double master   = scan + interval * config->values[eOptParamEvents];
+    double horizon  = optHorizon * 1e6;
+    double *latencies = malloc(optTrials * sizeof(double));
+    uint64_t rng      = seed * 0x9E3779B97F4A7C15ull + 1;
+    uint32_t found    = 0;
+    double sum        = 0;
+
+    for (uint32_t t = 0; t < optTrials; t++)
+    {
+        double slave  = (scan + sleep) * (1 + optDrift * 1e-6 * (2 * optUniform(&rng) - 1));
+        double cycle  = -optUniform(&rng) * master; // Master cycle start, slave boots at 0
+        double latency = OPT_NEVER;
+
+        for (; cycle < horizon && latency == OPT_NEVER; cycle += master)
+        {
+            double event = cycle + scan + OPT_ADV_START_US + optUniform(&rng) * OPT_ADV_DELAY_US;
+
+            for (; event < cycle + master; event += interval + optUniform(&rng) * OPT_ADV_DELAY_US)
+            {
+                double k, local, sub, channelStart;
+                uint32_t q;
+
+                if (event < 0)
+                {
+                    continue;
+                }
+                k     = floor(event / slave);
+                local = event - k * slave - OPT_SCAN_START_US;
+                if (local < 0 || local >= scan - OPT_SCAN_START_US || k * slave + scan > horizon)
+                {
+                    continue;
+                }
+                q            = (uint32_t)(local / OPT_SCAN_INTERVAL_US);
+                sub          = local - q * (double)OPT_SCAN_INTERVAL_US;
+                channelStart = sub + (q % 3) * OPT_CHANNEL_STEP_US;
+                if (channelStart + OPT_PDU_US <= fmin(OPT_SCAN_INTERVAL_US * duty / 100, scan - OPT_SCAN_START_US - q * (double)OPT_SCAN_INTERVAL_US))
+                {
+                    latency = (k * slave + scan) / 1000;
+                    break;
+                }
+            }
+        }
+
+        latencies[t] = latency;
+        if (latency != OPT_NEVER)
+        {
+            found++;
+            sum += latency;
+        }
+    }
+
+    qsort(latencies, optTrials, sizeof(double), optCompareLatency);
+    result->mcDiscovered = (double)found / optTrials;
+    result->mcMean       = (found != 0) ? sum / found : OPT_NEVER;
+    result->mcP50        = latencies[(uint32_t)ceil(0.50 * optTrials) - 1];
+    result->mcP90        = latencies[(uint32_t)ceil(0.90 * optTrials) - 1];
+    result->mcP99        = latencies[(uint32_t)ceil(0.99 * optTrials) - 1];
+    free(latencies);
+}
+
+/**@brief Radio time of a scan window, us, it listens from OPT_SCAN_START_US duty % of every scan interval */
+static double optListening(double scan, double duty)
+{
+    double total = 0;
+
+    for (double lo = OPT_SCAN_START_US; lo < scan; lo += OPT_SCAN_INTERVAL_US)
+    {
+        total += fmin(lo + OPT_SCAN_INTERVAL_US * duty / 100, scan) - lo;
+    }
+    return total;
+}
+
+/**
+ * @brief Probability of a PDU received in a scan window
+ *
+ * @details The PDU starts at base + the sum of delays advDelays, us from the window start, and
+ *          exists before end (advertising phase over). It is received when it starts OPT_PDU_US
+ *          before the end of a listening interval.
+ */
+static double optHeard(double scan, double duty, double base, uint32_t delays, double end)
+{
+    double total = 0;
+
+    for (double lo = OPT_SCAN_START_US; lo < scan; lo += OPT_SCAN_INTERVAL_US)
+    {
+        double hi = fmin(fmin(lo + OPT_SCAN_INTERVAL_US * duty / 100, scan) - OPT_PDU_US, end);
+
+        if (hi > lo)
+        {
+            total += optDelaySum((hi - base) / OPT_ADV_DELAY_US, delays) - optDelaySum((lo - base) / OPT_ADV_DELAY_US, delays);
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief Distribution function of the sum of n advDelays, in OPT_ADV_DELAY_US (Irwin-Hall)
+ *
+ * @details Closed form up to 12 terms, normal beyond where the alternating sum loses its precision.
+ */
+static double optDelaySum(double x, uint32_t n)
+{
+    double sum = 0;
+    double binomial = 1;
+    double factorial = 1;
+
+    if (x <= 0)
+    {
+        return 0;
+    }
+    if (x >= n)
+    {
+        return 1;
+    }
+    if (n > 12)
+    {
+        return 0.5 * erfc(-(x - n / 2.0) / sqrt(n / 12.0) / M_SQRT2);
+    }
+    for (uint32_t k = 1; k <= n; k++)
+    {
+        factorial *= k;
+    }
+    for (uint32_t k = 0; k <= (uint32_t)x; k++)
+    {
+        sum += ((k & 1) ? -1 : 1) * binomial * pow(x - k, n);
+        binomial = binomial * (n - k) / (k + 1);
+    }
+    return fmin(fmax(sum / factorial, 0), 1);
+}
+
+/**@brief Latency percentile of the discovery mass per slave cycle, OPT_NEVER beyond the horizon */
+static double optPercentile(double const *mass, uint32_t count, double period, double offset, double p)
+{
+    double seen = 0;
+
+    for (uint32_t k = 0; k < count; k++)
+    {
+        seen += mass[k];
+        if (seen >= p)
+        {
+            return k * period + offset;
+        }
+    }
+    return OPT_NEVER;
+}
+
+/**@brief List "a,b,c" with ranges "first:step:last" */
+static uint32_t optParse(char const *text, double *list, uint32_t max)
+{
+    uint32_t size = 0;
+    char *next;
+
+    while (*text != '\0' && size < max)
+    {
+        double first = strtod(text, &next);
+
+        if (*next == ':')
+        {
+            double step = strtod(next + 1, &next);
+            double last = (*next == ':') ? strtod(next + 1, &next) : first;
+
+            for (double v = first; step > 0 && v <= last + 1e-9 && size < max; v += step)
+            {
+                list[size++] = v;
+            }
+        }
+        else
+        {
+            list[size++] = first;
+        }
+        text = next + (*next == ',');
+        if (next == text)
+        {
+            break; // Not a number
+        }
+    }
+    return (size == 0) ? 1 : size; // Empty list keeps the first value
+}
+
+static void optPrintHeader(void)
+{
+    for (uint8_t p = 0; p < eOptParamCount; p++)
+    {
+        printf("%s,", optParamNames[p]);
+    }
+    printf("slave_ua,master_ua,adv_events,window_hit,discovered,mean_ms,p50_ms,p90_ms,p99_ms,"
+           "mc_discovered,mc_mean_ms,mc_p50_ms,mc_p90_ms,mc_p99_ms,front\n");
+}
+
+/**@brief One CSV row, latencies beyond the horizon are -1 */
+static void optPrint(tsOptConfig const *config, tsOptResult const *r)
+{
+    double const latencies[] = {r->mean, r->p50, r->p90, r->p99, r->mcMean, r->mcP50, r->mcP90, r->mcP99};
+
+    for (uint8_t p = 0; p < eOptParamCount; p++)
+    {
+        printf("%g,", config->values[p]);
+    }
+    printf("%.1f,%.1f,%.2f,%.4f,%.4f", r->slaveUa, r->masterUa, r->events, r->cycle, r->discovered);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        printf(",%.0f", (latencies[i] == OPT_NEVER) ? -1 : latencies[i]);
+    }
+    if (r->front)
+    {
+        printf(",%.4f", r->mcDiscovered);
+        for (uint8_t i = 4; i < 8; i++)
+        {
+            printf(",%.0f", (latencies[i] == OPT_NEVER) ? -1 : latencies[i]);
+        }
+    }
+    else
+    {
+        printf(",,,,,"); // Monte-Carlo runs on the front only
+    }
+    printf(",%u\n", r->front);
+}
+
+/**@brief Header overriding the parameters.h timings, TUNED_ENABLE 1 */
+static int optEmit(char const *path, tsOptConfig const *config, tsOptResult const *r, int argc, char **argv)
+{
+    FILE *file = fopen(path, "w");
+    time_t now = time(NULL);
+    char date[16];
+
+    if (file == NULL)
+    {
+        return -1;
+    }
+    strftime(date, sizeof(date), "%m/%d/%Y", localtime(&now));
+
+    fprintf(file, "/** @file       parameters_tuned.h\n"
+                  " *  @brief      Scan, advertising and sleep timings, written by host/paramopt.c\n"
+                  " *  @author     host/paramopt.c\n"
+                  " *  @date       %s\n"
+                  " *\n"
+                  " *  Built in with TUNED_ENABLE 1 in parameters.h. A configuration saved on the dongle\n"
+                  " *  (configstore.c) still wins, \"config defaults\" on the console takes these.\n"
+                  " *\n"
+                  " *  ",
+            date);
+    for (int i = 0; i < argc; i++)
+    {
+        fprintf(file, "%s%s", (i == 0) ? "./paramopt" : " ", (i == 0) ? "" : argv[i]);
+    }
+    fprintf(file, "\n"
+                  " *  Slave %.1f uA, master %.1f uA (%s model)\n"
+                  " *  Discovered within %g s: %.4f, Monte-Carlo %.4f (%u trials, drift %g ppm)\n"
+                  " *  Latency p50/p90/p99: %.0f/%.0f/%.0f ms, Monte-Carlo %.0f/%.0f/%.0f ms\n"
+                  " */\n"
+                  "#ifndef FILE_PARAMETERS_TUNED_H\n"
+                  "#define FILE_PARAMETERS_TUNED_H\n"
+                  "\n"
+                  "#define MIN_ADVERTISEMENT_INTERVAL                 %-5g // ms\n"
+                  "#define NUMBER_OF_ADVERTISEMENT_DURING_ADVERTISING %g\n"
+                  "#define SCAN_TIMEOUT                               %-5g // ms\n"
+                  "#define SCAN_DUTY                                  %-5g // %%\n"
+                  "#define SLEEP_IDLE_MODE                            %-5g // ms\n"
+                  "\n"
+                  "#endif // FILE_PARAMETERS_TUNED_H\n",
+            r->slaveUa, r->masterUa, OPT_BOARD, optHorizon, r->discovered, r->mcDiscovered, optTrials, optDrift,
+            r->p50, r->p90, r->p99, r->mcP50, r->mcP90, r->mcP99,
+            config->values[eOptParamInterval], config->values[eOptParamEvents], config->values[eOptParamScan],
+            config->values[eOptParamDuty], config->values[eOptParamSleep] - SLEEP_BLE_INIT);
+    return fclose(file);
+}
+
+/**@brief splitmix64 */
+static uint64_t optRandom(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/**@brief [0, 1) */
+static double optUniform(uint64_t *state)
+{
+    return (double)(optRandom(state) >> 11) / 9007199254740992.0;
+}
+
+/**@brief Slave current of result indexes ascending */
+static int optCompare(void const *a, void const *b)
+{
+    double x = optResults[*(uint32_t const *)a].slaveUa;
+    double y = optResults[*(uint32_t const *)b].slaveUa;
+
+    return (x > y) - (x < y);
+}
+
+static int optCompareLatency(void const *a, void const *b)
+{
+    double x = *(double const *)a;
+    double y = *(double const *)b;
+
+    return (x > y) - (x < y);
+}
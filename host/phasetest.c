@@ -0,0 +1,450 @@
+/** @file       phasetest.c
+ *  @brief      Host test of the phase engine transition tables, both roles
+ *  @author     Evren Kenanoglu
+ *  @date       4/27/2021
+ *
+ *  Walks the transition table of each role twice. First structurally: every row leaves and enters a
+ *  valid state, arms a valid timing, every state the table can enter has rows, the last row of a state
+ *  has no guard, and phaseEngineTableSizeGet() matches the rows. Then by running the engine against
+ *  recording hooks through a script of steps, checking the next state, the armed duration, the hooks
+ *  called in order, the detection guard, the scheduled scan guard (with and without its hook), cycle
+ *  counting and timingAdjust.
+ *
+ *  Build and run from the repository root, observer SoftDevices (master and slave tables) and
+ *  broadcaster only SoftDevices (S112, S113, caps.h):
+ *      gcc -O2 -Wall -I. -Ihost/stubs -o phasetest host/phasetest.c phaseengine.c && ./phasetest
+ *      gcc -O2 -Wall -DS112 -I. -Ihost/stubs -o phasetest host/phasetest.c phaseengine.c && ./phasetest
+ *
+ *  Prints every failed check, exits with 1 when any check failed.
+ */
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "phaseengine.h"
+
+/** CONSTANTS *****************************************************************/
+#define TEST_TRACE_SIZE 32
+#define TEST_ADJUST_MS  7 // Added by the adjusting hooks
+
+// Distinct timings, an armed duration tells which timing the row picked
+static const uint32_t testTimings[ePhaseTimingCount] =
+    {
+        [ePhaseTimingSwitch] = 11,
+        [ePhaseTimingInit]   = 22,
+        [ePhaseTimingScan]   = 33,
+        [ePhaseTimingAdv]    = 44,
+        [ePhaseTimingSleep]  = 55,
+};
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eScheduleNone = 0, // Hook present, no scan scheduled
+    eScheduleNext,     // Hook present, next scan scheduled
+    eScheduleNoHook,   // scanScheduled hook NULL
+} teTestSchedules;
+
+/**
+ * @brief One engine step and its expected outcome
+ *
+ * @details Hooks are traced as one character each: T timerStart, S scanStart, s scanStop, A advStart,
+ *          a advStop, Z sleepStart, z sleepStop, P phaseChanged.
+ */
+typedef struct
+{
+    uint8_t from;      /**< teModes, state before the step */
+    bool detected;     /**< Master reported during the state */
+    uint8_t schedule;  /**< teTestSchedules */
+    uint8_t to;        /**< teModes */
+    uint8_t timing;    /**< tePhaseTimings armed for the next state */
+    char const *trace; /**< Hooks called in order */
+    uint32_t cycles;   /**< Engine cycles after the step */
+} tsTestStep;
+
+typedef struct
+{
+    char trace[TEST_TRACE_SIZE];
+    uint8_t count;
+    uint8_t schedule;
+    uint8_t phaseFrom;
+    uint8_t phaseTo;
+    uint32_t timerDuration;
+    uint32_t sleepDuration;
+} tsTestContext;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void testTrace(void *context, char hook);
+static void testTimerStart(void *context, uint32_t duration);
+static void testScanStart(void *context);
+static void testScanStop(void *context);
+static void testAdvStart(void *context);
+static void testAdvStop(void *context);
+static void testSleepStart(void *context, uint32_t duration);
+static void testSleepStop(void *context);
+static void testPhaseChanged(void *context, uint8_t from, uint8_t to);
+static uint32_t testTimingAdjust(void *context, uint8_t state, uint32_t duration);
+static bool testScanScheduled(void *context);
+static void testCheck(bool condition, char const *role, char const *what, uint32_t step);
+static void testEngineInit(tsPhaseEngine *engine, uint8_t role, tsProgramParams *params, tsPhaseHooks const *hooks, tsTestContext *context);
+static void testTableWalk(uint8_t role, char const *name);
+static void testScriptRun(uint8_t role, char const *name, tsTestStep const *steps, uint32_t count);
+static void testAdjustRun(uint8_t role, char const *name);
+
+/** VARIABLES *****************************************************************/
+
+static const tsPhaseHooks testHooks =
+    {
+        .timerStart    = testTimerStart,
+        .scanStart     = testScanStart,
+        .scanStop      = testScanStop,
+        .advStart      = testAdvStart,
+        .advStop       = testAdvStop,
+        .sleepStart    = testSleepStart,
+        .sleepStop     = testSleepStop,
+        .phaseChanged  = testPhaseChanged,
+        .timingAdjust  = NULL,
+        .scanScheduled = testScanScheduled,
+};
+
+static const tsPhaseHooks testHooksNoSchedule =
+    {
+        .timerStart    = testTimerStart,
+        .scanStart     = testScanStart,
+        .scanStop      = testScanStop,
+        .advStart      = testAdvStart,
+        .advStop       = testAdvStop,
+        .sleepStart    = testSleepStart,
+        .sleepStop     = testSleepStop,
+        .phaseChanged  = testPhaseChanged,
+        .timingAdjust  = NULL,
+        .scanScheduled = NULL,
+};
+
+static const tsPhaseHooks testHooksAdjust =
+    {
+        .timerStart    = testTimerStart,
+        .scanStart     = testScanStart,
+        .scanStop      = testScanStop,
+        .advStart      = testAdvStart,
+        .advStop       = testAdvStop,
+        .sleepStart    = testSleepStart,
+        .sleepStop     = testSleepStop,
+        .phaseChanged  = testPhaseChanged,
+        .timingAdjust  = testTimingAdjust,
+        .scanScheduled = testScanScheduled,
+};
+
+#if SCANNING_ENABLE
+static const tsTestStep testScriptMaster[] =
+    {
+        //  from               detected  schedule        to                 timing             trace    cycles
+        {eModeFirstStart,  false, eScheduleNone,   eModeInitBle,     ePhaseTimingInit, "PT",   0},
+        {eModeInitBle,     false, eScheduleNone,   eModeScanning,    ePhaseTimingScan, "SPT",  1},
+        {eModeScanning,    false, eScheduleNone,   eModeAdvertising, ePhaseTimingAdv,  "sAPT", 1}, // Master advertises without detection
+        {eModeAdvertising, false, eScheduleNone,   eModeScanning,    ePhaseTimingScan, "aSPT", 2},
+        {eModeScanning,    true,  eScheduleNext,   eModeAdvertising, ePhaseTimingAdv,  "sAPT", 2}, // Guards are not used
+        {eModeAdvertising, false, eScheduleNext,   eModeScanning,    ePhaseTimingScan, "aSPT", 3},
+};
+
+static const tsTestStep testScriptSlave[] =
+    {
+        //  from               detected  schedule        to                 timing              trace    cycles
+        {eModeFirstStart,  false, eScheduleNone,   eModeInitBle,     ePhaseTimingInit,  "PT",   0},
+        {eModeInitBle,     false, eScheduleNone,   eModeScanning,    ePhaseTimingScan,  "SPT",  1},
+        {eModeScanning,    false, eScheduleNone,   eModeSleep,       ePhaseTimingSleep, "sZPT", 1},
+        {eModeSleep,       false, eScheduleNone,   eModeScanning,    ePhaseTimingScan,  "zSPT", 2},
+        {eModeScanning,    true,  eScheduleNone,   eModeAdvertising, ePhaseTimingAdv,   "sAPT", 2},
+        {eModeAdvertising, false, eScheduleNone,   eModeScanning,    ePhaseTimingScan,  "aSPT", 3},
+        {eModeScanning,    true,  eScheduleNone,   eModeAdvertising, ePhaseTimingAdv,   "sAPT", 3},
+        {eModeAdvertising, false, eScheduleNext,   eModeSleep,       ePhaseTimingSleep, "aZPT", 3}, // Sleep until the scheduled scan
+        {eModeSleep,       false, eScheduleNext,   eModeScanning,    ePhaseTimingScan,  "zSPT", 4},
+        {eModeScanning,    true,  eScheduleNoHook, eModeAdvertising, ePhaseTimingAdv,   "sAPT", 4},
+        {eModeAdvertising, false, eScheduleNoHook, eModeScanning,    ePhaseTimingScan,  "aSPT", 5}, // No hook, no scheduled scans
+        {eModeScanning,    false, eScheduleNext,   eModeSleep,       ePhaseTimingSleep, "sZPT", 5}, // Schedule does not replace detection
+};
+#else
+static const tsTestStep testScriptBroadcaster[] =
+    {
+        //  from               detected  schedule        to                 timing              trace    cycles
+        {eModeFirstStart,  false, eScheduleNone,   eModeInitBle,     ePhaseTimingInit,  "PT",   0},
+        {eModeInitBle,     false, eScheduleNone,   eModeAdvertising, ePhaseTimingAdv,   "APT",  1},
+        {eModeAdvertising, false, eScheduleNone,   eModeSleep,       ePhaseTimingSleep, "aZPT", 1},
+        {eModeSleep,       false, eScheduleNone,   eModeAdvertising, ePhaseTimingAdv,   "zAPT", 2},
+        {eModeAdvertising, true,  eScheduleNext,   eModeSleep,       ePhaseTimingSleep, "aZPT", 2}, // Guards are not used
+        {eModeSleep,       false, eScheduleNoHook, eModeAdvertising, ePhaseTimingAdv,   "zAPT", 3},
+};
+#endif
+
+static uint32_t testChecks   = 0;
+static uint32_t testFailures = 0;
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+int main(void)
+{
+#if SCANNING_ENABLE
+    testTableWalk(eRoleMaster, "master");
+    testTableWalk(eRoleSlave, "slave");
+    testScriptRun(eRoleMaster, "master", testScriptMaster, sizeof(testScriptMaster) / sizeof(testScriptMaster[0]));
+    testScriptRun(eRoleSlave, "slave", testScriptSlave, sizeof(testScriptSlave) / sizeof(testScriptSlave[0]));
+#else
+    testTableWalk(eRoleMaster, "master");
+    testTableWalk(eRoleSlave, "slave");
+    testScriptRun(eRoleMaster, "master", testScriptBroadcaster, sizeof(testScriptBroadcaster) / sizeof(testScriptBroadcaster[0]));
+    testScriptRun(eRoleSlave, "slave", testScriptBroadcaster, sizeof(testScriptBroadcaster) / sizeof(testScriptBroadcaster[0]));
+#endif
+    testAdjustRun(eRoleMaster, "master");
+    testAdjustRun(eRoleSlave, "slave");
+
+    printf("phasetest (%s tables): %u checks, %u failed, tables %u/%u bytes\n", SCANNING_ENABLE ? "observer" : "broadcaster",
+           testChecks, testFailures, phaseEngineTableSizeGet(eRoleMaster), phaseEngineTableSizeGet(eRoleSlave));
+    return testFailures != 0;
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+static void testTrace(void *context, char hook)
+{
+    tsTestContext *test = context;
+
+    if (test->count < TEST_TRACE_SIZE - 1)
+    {
+        test->trace[test->count++] = hook;
+        test->trace[test->count]   = '\0';
+    }
+}
+
+static void testTimerStart(void *context, uint32_t duration)
+{
+    ((tsTestContext *)context)->timerDuration = duration;
+    testTrace(context, 'T');
+}
+
+static void testScanStart(void *context)
+{
+    testTrace(context, 'S');
+}
+
+static void testScanStop(void *context)
+{
+    testTrace(context, 's');
+}
+
+static void testAdvStart(void *context)
+{
+    testTrace(context, 'A');
+}
+
+static void testAdvStop(void *context)
+{
+    testTrace(context, 'a');
+}
+
+static void testSleepStart(void *context, uint32_t duration)
+{
+    ((tsTestContext *)context)->sleepDuration = duration;
+    testTrace(context, 'Z');
+}
+
+static void testSleepStop(void *context)
+{
+    testTrace(context, 'z');
+}
+
+static void testPhaseChanged(void *context, uint8_t from, uint8_t to)
+{
+    tsTestContext *test = context;
+
+    test->phaseFrom = from;
+    test->phaseTo   = to;
+    testTrace(context, 'P');
+}
+
+static uint32_t testTimingAdjust(void *context, uint8_t state, uint32_t duration)
+{
+    return duration + TEST_ADJUST_MS;
+}
+
+static bool testScanScheduled(void *context)
+{
+    return ((tsTestContext *)context)->schedule == eScheduleNext;
+}
+
+static void testCheck(bool condition, char const *role, char const *what, uint32_t step)
+{
+    testChecks++;
+    if (!condition)
+    {
+        testFailures++;
+        printf("FAIL %s step %u: %s\n", role, step, what);
+    }
+}
+
+static void testEngineInit(tsPhaseEngine *engine, uint8_t role, tsProgramParams *params, tsPhaseHooks const *hooks, tsTestContext *context)
+{
+    memset(params, 0, sizeof(*params));
+    memset(context, 0, sizeof(*context));
+    params->programStatus         = eModeFirstStart;
+    params->deviceDetectionStatus = eDeviceNotDetected;
+
+    phaseEngineInit(engine, role, params, hooks, context);
+    memcpy(engine->timings, testTimings, sizeof(engine->timings));
+}
+
+/**
+ * @brief Structural checks of a role's table, no engine steps
+ */
+static void testTableWalk(uint8_t role, char const *name)
+{
+    tsPhaseEngine engine;
+    tsProgramParams params;
+    tsTestContext context;
+    bool leaves[eModeCount] = {false};
+    bool enters[eModeCount] = {false};
+
+    testEngineInit(&engine, role, &params, &testHooks, &context);
+
+    testCheck(engine.tableSize > 0, name, "table is empty", 0);
+    testCheck(phaseEngineTableSizeGet(role) == engine.tableSize * sizeof(tsPhaseTransition), name, "phaseEngineTableSizeGet does not match the rows", 0);
+
+    for (uint8_t i = 0; i < engine.tableSize; i++)
+    {
+        tsPhaseTransition const *row = &engine.table[i];
+        bool last                    = true;
+
+        testCheck(row->state < eModeCount, name, "row leaves an invalid state", i);
+        testCheck(row->nextState < eModeCount, name, "row enters an invalid state", i);
+        testCheck(row->timing < ePhaseTimingCount, name, "row arms an invalid timing", i);
+        testCheck(row->nextState != eModeFirstStart, name, "row enters eModeFirstStart", i);
+        if (row->state >= eModeCount || row->nextState >= eModeCount)
+        {
+            continue;
+        }
+        leaves[row->state]     = true;
+        enters[row->nextState] = true;
+
+        for (uint8_t j = i + 1; j < engine.tableSize; j++)
+        {
+            if (engine.table[j].state == row->state)
+            {
+                last = false;
+                break;
+            }
+        }
+        if (last)
+        {
+            testCheck(row->guard == NULL, name, "last row of a state has a guard, the engine can stall", i);
+        }
+        else
+        {
+            testCheck(row->guard != NULL, name, "unguarded row shadows the rows after it", i);
+        }
+    }
+
+    testCheck(leaves[eModeFirstStart], name, "no row leaves eModeFirstStart", 0);
+    for (uint8_t state = 0; state < eModeCount; state++)
+    {
+        if (enters[state])
+        {
+            testCheck(leaves[state], name, "table enters a state it never leaves", state);
+        }
+        if (leaves[state] && state != eModeFirstStart)
+        {
+            testCheck(enters[state], name, "table leaves a state it never enters", state);
+        }
+    }
+}
+
+/**
+ * @brief Runs the engine through a script, every step starts where the previous one ended
+ */
+static void testScriptRun(uint8_t role, char const *name, tsTestStep const *steps, uint32_t count)
+{
+    tsPhaseEngine engine;
+    tsProgramParams params;
+    tsTestContext context;
+
+    testEngineInit(&engine, role, &params, &testHooks, &context);
+
+    phaseEngineStart(&engine);
+    testCheck(strcmp(context.trace, "T") == 0 && context.timerDuration == testTimings[ePhaseTimingSwitch], name, "start does not arm the switch timing", 0);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        tsTestStep const *step = &steps[i];
+
+        testCheck(params.programStatus == step->from, name, "script is out of step with the engine", i);
+
+        context.count    = 0;
+        context.trace[0] = '\0';
+        context.schedule = step->schedule;
+        engine.hooks     = step->schedule == eScheduleNoHook ? &testHooksNoSchedule : &testHooks;
+        if (step->detected)
+        {
+            phaseEngineDeviceDetected(&engine);
+        }
+
+        phaseEngineStep(&engine);
+
+        testCheck(params.programStatus == step->to, name, "wrong next state", i);
+        testCheck(params.programCounter == testTimings[step->timing], name, "wrong timing armed", i);
+        testCheck(context.timerDuration == testTimings[step->timing], name, "timer not started with the armed timing", i);
+        testCheck(strcmp(context.trace, step->trace) == 0, name, "wrong hooks or hook order", i);
+        testCheck(context.phaseFrom == step->from && context.phaseTo == step->to, name, "phaseChanged reports other states", i);
+        testCheck(engine.transitions == i + 1, name, "transition not counted", i);
+        testCheck(engine.cycles == step->cycles, name, "wrong cycle count", i);
+        if (step->to == eModeSleep)
+        {
+            testCheck(context.sleepDuration == testTimings[step->timing], name, "sleepStart not given the armed timing", i);
+        }
+#if SCANNING_ENABLE
+        if (step->from == eModeScanning && step->to == eModeAdvertising)
+        {
+            testCheck(params.deviceDetectionStatus == eDeviceNotDetected, name, "detection not cleared for the next scan", i);
+        }
+        if (step->from == eModeScanning)
+        {
+            params.deviceDetectionStatus = eDeviceNotDetected; // Program clears it at scan start
+        }
+#endif
+    }
+}
+
+/**
+ * @brief timingAdjust result is armed and given to sleepStart
+ */
+static void testAdjustRun(uint8_t role, char const *name)
+{
+    tsPhaseEngine engine;
+    tsProgramParams params;
+    tsTestContext context;
+    uint32_t step = 0;
+
+    testEngineInit(&engine, role, &params, &testHooksAdjust, &context);
+
+    // Until the first sleep, undetected scans sleep on the slave and every table sleeps within a cycle or two
+    while (params.programStatus != eModeSleep && step < 2 * eModeCount)
+    {
+        uint8_t from = params.programStatus;
+
+        phaseEngineStep(&engine);
+        testCheck(params.programStatus != from, name, "adjusting hooks stall the engine", step);
+        testCheck(params.programCounter == context.timerDuration, name, "timer not started with the adjusted timing", step);
+        step++;
+    }
+
+#if SCANNING_ENABLE
+    if (role == eRoleMaster)
+    {
+        testCheck(params.programStatus != eModeSleep, name, "master table sleeps", step);
+        testCheck(params.programCounter == testTimings[ePhaseTimingScan] + TEST_ADJUST_MS || params.programCounter == testTimings[ePhaseTimingAdv] + TEST_ADJUST_MS,
+                  name, "adjusted timing not armed", step);
+        return;
+    }
+#endif
+    testCheck(params.programStatus == eModeSleep, name, "sleep not reached", step);
+    testCheck(params.programCounter == testTimings[ePhaseTimingSleep] + TEST_ADJUST_MS, name, "adjusted timing not armed", step);
+    testCheck(context.sleepDuration == params.programCounter, name, "sleepStart not given the adjusted timing", step);
+}
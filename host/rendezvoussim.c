@@ -0,0 +1,408 @@
+/** @file       rendezvoussim.c
+ *  @brief      Host simulation of one master and several slaves, blind scanning vs learned rendezvous
+ *              vs rendezvous on the master published schedule
+ *  @author     Evren Kenanoglu
+ *  @date       4/9/2021
+ *
+ *  Blind+sleep is the fair baseline: the slave sleeps after advertising as it does with rendezvous,
+ *  plain blind slaves keep scanning while the master is in range.
+ *
+ *  The firmware phase engine and rendezvous modules are run unchanged, bound to simulated timers
+ *  and radios. Every node has its own clock drift and boot time.
+ *
+ *  In schedule mode the master measures its own cycle and publishes it with every advertising event
+ *  (scan response, proto.c), slaves lock on the published period.
+ *
+ *  Build and run from the repository root:
+ *      gcc -O2 -Wall -I. -Ihost/stubs -o rendezvoussim host/rendezvoussim.c phaseengine.c rendezvous.c proto.c
+ *      ./rendezvoussim [slaves] [seconds] [seed]
+ */
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "phaseengine.h"
+#include "rendezvous.h"
+#include "proto.h"
+
+/** CONSTANTS *****************************************************************/
+#define SIM_SLAVES_MAX       64
+#define SIM_TIMER_LATENCY_US 200   // app_timer callback and transition processing
+#define SIM_SCAN_START_US    500   // Scan start to first RX
+#define SIM_ADV_START_US     1000  // Advertising start to first advertising event
+#define SIM_DRIFT_PPM        50    // Crystal tolerance, +/-
+#define SIM_BOOT_SPREAD_US   3000000
+#define SIM_LOSS_PERMILLE    50    // Advertising packets missed by a listening scanner
+#define SIM_NEVER            UINT64_MAX
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eSimModeBlind = 0,  // Firmware without rendezvous, slave scans again after advertising
+    eSimModeBlindSleep, // Blind scans, slave sleeps after advertising, same cycle as rendezvous
+    eSimModeRendezvous, // Learned rendezvous
+    eSimModeSchedule,   // Rendezvous on the period published by the master
+    eSimModeCount,
+} teSimModes;
+
+typedef struct
+{
+    tsPhaseEngine engine;
+    tsProgramParams params;
+    tsRendezvous rv;
+    uint8_t mode;
+    double drift;         // local = global * (1 + drift) + offset
+    uint32_t offset;      // us, local clocks start anywhere, also covers wrap
+    uint64_t timerAt;     // global us
+    uint8_t scanning;
+    uint8_t advertising;
+    uint8_t scanHit;
+    uint64_t scanStarted; // global us
+    uint64_t listenFrom;  // global us
+    uint64_t advNext;     // global us
+    uint64_t rxTime;      // us
+    uint32_t scans;
+    uint32_t scansHit;
+    uint64_t bootAt;      // global us
+    uint64_t lockedAt;    // global us, first lock
+    uint32_t scanLocal;   // Master: local time of the last scan start
+    tsProtoSchedule schedule;
+} tsSimNode;
+
+typedef struct
+{
+    double rxMsPerHour;
+    double rxMsPerHit;
+    double hitsPerHour;
+    double hitRatio;
+    double lockSeconds;
+    uint32_t fallbacks;
+    uint32_t locked;
+} tsSimResult;
+
+/** VARIABLES *****************************************************************/
+
+static tsSimNode simNodes[SIM_SLAVES_MAX + 1];
+static uint32_t simNodeCount;
+static uint64_t simNow;
+static uint32_t simSeed;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static uint32_t simRandom(void);
+static uint32_t simLocal(tsSimNode const *node, uint64_t global);
+static void simTimerStart(void *context, uint32_t duration);
+static void simScanStart(void *context);
+static void simScanStop(void *context);
+static void simAdvStart(void *context);
+static void simAdvStop(void *context);
+static uint32_t simTimingAdjust(void *context, uint8_t state, uint32_t duration);
+static bool simScanScheduled(void *context);
+static void simAdvEvent(tsSimNode *master);
+static void simRun(uint32_t slaves, uint32_t seconds, uint32_t seed, uint8_t mode, tsSimResult *result);
+
+static const tsPhaseHooks simHooks =
+    {
+        .timerStart = simTimerStart,
+        .scanStart  = simScanStart,
+        .scanStop   = simScanStop,
+        .advStart   = simAdvStart,
+        .advStop    = simAdvStop,
+};
+
+static const tsPhaseHooks simHooksScheduled =
+    {
+        .timerStart    = simTimerStart,
+        .scanStart     = simScanStart,
+        .scanStop      = simScanStop,
+        .advStart      = simAdvStart,
+        .advStop       = simAdvStop,
+        .timingAdjust  = simTimingAdjust,
+        .scanScheduled = simScanScheduled,
+};
+
+/** FUNCTIONS *****************************************************************/
+
+int main(int argc, char **argv)
+{
+    uint32_t slaves  = (argc > 1) ? (uint32_t)atoi(argv[1]) : 8;
+    uint32_t seconds = (argc > 2) ? (uint32_t)atoi(argv[2]) : 3600;
+    uint32_t seed    = (argc > 3) ? (uint32_t)atoi(argv[3]) : 1;
+    static const char *const names[eSimModeCount] = {"blind", "blind+sleep", "rendezvous", "schedule"};
+    tsSimResult results[eSimModeCount];
+
+    if (slaves == 0 || slaves > SIM_SLAVES_MAX)
+    {
+        fprintf(stderr, "slaves: 1..%d\n", SIM_SLAVES_MAX);
+        return 1;
+    }
+
+    printf("%u slaves, %u s, seed %u, master period %u ms, slave sleep %u ms\n",
+           slaves, seconds, seed, SCAN_TIMEOUT + ADVERTISEMENT_TIMEOUT, SLEEP_DURATION);
+    printf("%-12s %12s %9s %10s %11s %10s %8s %10s %7s\n", "mode", "rx ms/hour", "rx duty", "rx ms/hit", "hits/hour", "hit ratio", "lock s", "fallbacks", "locked");
+    for (uint8_t mode = 0; mode < eSimModeCount; mode++)
+    {
+        tsSimResult const *r = &results[mode];
+
+        simRun(slaves, seconds, seed, mode, &results[mode]);
+        printf("%-12s %12.0f %8.3f%% %10.1f %11.1f %10.3f",
+               names[mode], r->rxMsPerHour, r->rxMsPerHour / 36000, r->rxMsPerHit, r->hitsPerHour, r->hitRatio);
+        if (mode >= eSimModeRendezvous)
+        {
+            printf(" %8.1f %10u %4u/%-2u\n", r->lockSeconds, r->fallbacks, r->locked, slaves);
+        }
+        else
+        {
+            printf(" %8s %10s %7s\n", "-", "-", "-");
+        }
+    }
+    for (uint8_t mode = eSimModeRendezvous; mode < eSimModeCount; mode++)
+    {
+        printf("RX time reduction of %s vs blind+sleep: %.1fx per hour, %.1fx per hit\n", names[mode],
+               results[eSimModeBlindSleep].rxMsPerHour / results[mode].rxMsPerHour,
+               results[eSimModeBlindSleep].rxMsPerHit / results[mode].rxMsPerHit);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief One simulation run, node 0 is the master
+ */
+static void simRun(uint32_t slaves, uint32_t seconds, uint32_t seed, uint8_t mode, tsSimResult *result)
+{
+    tsRendezvousConfig config =
+        {
+            .period          = (SCAN_TIMEOUT + ADVERTISEMENT_TIMEOUT) * 1000,
+            .jitter          = RENDEZVOUS_JITTER_MS * 1000,
+            .guard           = RENDEZVOUS_GUARD_MS * 1000,
+            .periodTolerance = RENDEZVOUS_PERIOD_TOLERANCE_US,
+            .syncTolerance   = RENDEZVOUS_SYNC_TOLERANCE_US,
+            .maxMisses       = RENDEZVOUS_MAX_MISSES,
+        };
+    uint64_t end = (uint64_t)seconds * 1000000;
+
+    memset(simNodes, 0, sizeof(simNodes));
+    memset(result, 0, sizeof(*result));
+    simNodeCount = slaves + 1;
+    simSeed      = seed;
+    simNow       = 0;
+
+    for (uint32_t i = 0; i < simNodeCount; i++)
+    {
+        tsSimNode *node  = &simNodes[i];
+        uint8_t role     = (i == 0) ? eRoleMaster : eRoleSlave;
+        node->mode       = (role == eRoleSlave) ? mode : eSimModeBlind;
+        node->drift      = ((double)(simRandom() % (2 * SIM_DRIFT_PPM + 1)) - SIM_DRIFT_PPM) * 1e-6;
+        node->offset     = simRandom();
+        node->advNext    = SIM_NEVER;
+        node->lockedAt   = SIM_NEVER;
+        node->schedule.period = config.period;
+        node->schedule.slots.frameCycles = SLOT_FRAME_CYCLES; // protoScheduleDecode() drops a schedule without a frame
+        node->schedule.slots.count       = SLOT_COUNT;
+        node->schedule.slots.length      = SLOT_LENGTH_MS;
+        node->params.programStatus = eModeFirstStart;
+
+        rendezvousInit(&node->rv, &config);
+        phaseEngineInit(&node->engine, role, &node->params, (node->mode != eSimModeBlind) ? &simHooksScheduled : &simHooks, node);
+        phaseEngineStart(&node->engine);
+        node->timerAt += simRandom() % SIM_BOOT_SPREAD_US;
+        node->bootAt = node->timerAt;
+    }
+
+    while (simNow < end)
+    {
+        tsSimNode *next = &simNodes[0];
+        uint64_t at     = simNodes[0].advNext;
+
+        for (uint32_t i = 0; i < simNodeCount; i++)
+        {
+            if (simNodes[i].timerAt < at)
+            {
+                at   = simNodes[i].timerAt;
+                next = &simNodes[i];
+            }
+        }
+
+        simNow = at;
+        if (next == &simNodes[0] && at == simNodes[0].advNext)
+        {
+            simAdvEvent(next);
+        }
+        else
+        {
+            next->timerAt = SIM_NEVER;
+            phaseEngineStep(&next->engine);
+        }
+    }
+
+    for (uint32_t i = 1; i < simNodeCount; i++)
+    {
+        tsSimNode const *node = &simNodes[i];
+
+        result->rxMsPerHour += (double)node->rxTime / 1000 * 3600 / seconds / slaves;
+        result->rxMsPerHit += (node->scansHit ? (double)node->rxTime / 1000 / node->scansHit : 0) / slaves;
+        result->hitsPerHour += (double)node->scansHit * 3600 / seconds / slaves;
+        result->hitRatio += (node->scans ? (double)node->scansHit / node->scans : 0) / slaves;
+        result->fallbacks += node->rv.fallbacks;
+        result->locked += rendezvousLocked(&node->rv);
+        result->lockSeconds += (node->lockedAt != SIM_NEVER) ? (double)(node->lockedAt - node->bootAt) / 1e6 : 0;
+    }
+    for (uint32_t i = 1; i < simNodeCount; i++)
+    {
+        if (simNodes[i].lockedAt == SIM_NEVER)
+        {
+            result->lockSeconds = 0; // Not every slave locked
+            break;
+        }
+    }
+    result->lockSeconds /= slaves;
+}
+
+/**
+ * @brief Master advertising event, received by every slave that is listening
+ */
+static void simAdvEvent(tsSimNode *master)
+{
+    uint8_t payload[PROTO_SCHEDULE_SIZE];
+    uint8_t length = protoScheduleEncode(&master->schedule, payload);
+
+    for (uint32_t i = 1; i < simNodeCount; i++)
+    {
+        tsSimNode *slave = &simNodes[i];
+
+        if (!slave->scanning || simNow < slave->listenFrom || (simRandom() % 1000) < SIM_LOSS_PERMILLE)
+        {
+            continue;
+        }
+        slave->scanHit = 1;
+        if (slave->mode == eSimModeSchedule)
+        {
+            tsProtoSchedule schedule;
+
+            if (protoScheduleDecode(payload, length, &schedule))
+            {
+                rendezvousPeriodPublished(&slave->rv, schedule.period);
+            }
+        }
+        if (slave->mode >= eSimModeRendezvous)
+        {
+            rendezvousDetection(&slave->rv, simLocal(slave, simNow));
+        }
+        phaseEngineDeviceDetected(&slave->engine);
+    }
+
+    master->advNext = simNow + (uint64_t)(MIN_ADVERTISEMENT_INTERVAL * 1000 / (1 + master->drift)) + simRandom() % (RENDEZVOUS_JITTER_MS * 1000);
+}
+
+static void simTimerStart(void *context, uint32_t duration)
+{
+    tsSimNode *node = context;
+
+    node->timerAt = simNow + (uint64_t)(duration * 1000.0 / (1 + node->drift)) + SIM_TIMER_LATENCY_US;
+}
+
+static void simScanStart(void *context)
+{
+    tsSimNode *node = context;
+
+    node->scanning    = 1;
+    node->scanHit     = 0;
+    node->scanStarted = simNow;
+    node->listenFrom  = simNow + SIM_SCAN_START_US;
+    node->scans++;
+    if (node->mode >= eSimModeRendezvous)
+    {
+        rendezvousScanStart(&node->rv, simLocal(node, simNow));
+    }
+    if (node == &simNodes[0])
+    {
+        // programScheduleMeasure()
+        uint32_t now = simLocal(node, simNow);
+
+        if (node->scans > 1)
+        {
+            node->schedule.period += (int32_t)(now - node->scanLocal - node->schedule.period) / SCHEDULE_PERIOD_AVERAGING;
+        }
+        node->scanLocal = now;
+    }
+}
+
+static void simScanStop(void *context)
+{
+    tsSimNode *node = context;
+
+    node->scanning = 0;
+    node->rxTime += simNow - node->scanStarted;
+    node->scansHit += node->scanHit;
+    if (node->mode >= eSimModeRendezvous)
+    {
+        rendezvousScanEnd(&node->rv, simLocal(node, simNow));
+        if (node->lockedAt == SIM_NEVER && rendezvousLocked(&node->rv))
+        {
+            node->lockedAt = simNow;
+        }
+    }
+}
+
+static void simAdvStart(void *context)
+{
+    tsSimNode *node = context;
+
+    node->advertising = 1;
+    if (node == &simNodes[0])
+    {
+        node->advNext = simNow + SIM_ADV_START_US + simRandom() % (RENDEZVOUS_JITTER_MS * 1000);
+    }
+}
+
+static void simAdvStop(void *context)
+{
+    tsSimNode *node = context;
+
+    node->advertising = 0;
+    node->advNext     = SIM_NEVER;
+}
+
+/**@brief Same binding as programTimingAdjust() in main.c */
+static uint32_t simTimingAdjust(void *context, uint8_t state, uint32_t duration)
+{
+    tsSimNode *node = context;
+
+    if (node->mode < eSimModeRendezvous)
+    {
+        return duration;
+    }
+
+    switch (state)
+    {
+        case eModeScanning:
+            return rendezvousScanDurationGet(&node->rv, duration);
+        case eModeSleep:
+            return rendezvousSleepDurationGet(&node->rv, simLocal(node, simNow), duration);
+        default:
+            return duration;
+    }
+}
+
+static bool simScanScheduled(void *context)
+{
+    tsSimNode *node = context;
+
+    return (node->mode == eSimModeBlindSleep) || rendezvousLocked(&node->rv);
+}
+
+static uint32_t simLocal(tsSimNode const *node, uint64_t global)
+{
+    return (uint32_t)(uint64_t)(global * (1 + node->drift)) + node->offset;
+}
+
+/**@brief xorshift32 */
+static uint32_t simRandom(void)
+{
+    simSeed ^= simSeed << 13;
+    simSeed ^= simSeed >> 17;
+    simSeed ^= simSeed << 5;
+    return simSeed;
+}
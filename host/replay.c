@@ -0,0 +1,289 @@
+/** @file       replay.c
+ *  @brief      Host replay of a capture file (capture.h) through the advertising report path
+ *  @author     Evren Kenanoglu
+ *  @date       4/25/2021
+ *
+ *  The file is mapped and every record is rebuilt into a ble_gap_evt_adv_report_t and given to the
+ *  report path as the BLE_GAP_EVT_ADV_REPORT case of bleEventHandler() (main.c) does: advQueuePut()
+ *  and the scheduler drain, or the record pool in place when ADV_QUEUE_ENABLE is 0. bleEventHandler()
+ *  itself is bound to the SoftDevice and is not built here. app_timer_cnt_get() returns the ticks of
+ *  the record, records get their original timestamps.
+ *
+ *  The record handler applies the name and RSSI filter of advReportProcess() and hashes every parsed
+ *  field (FNV-1a). Hash and counters depend on the capture only, a parser or filter change that
+ *  changes them shows up by comparing two runs. The time of each report through the path is measured
+ *  on the monotonic clock.
+ *
+ *  Speed: 0 replays as fast as possible, 1 at the original pace, 10 ten times faster.
+ *
+ *  Build and run from the repository root:
+ *      gcc -O2 -Wall -Wno-format -DBOARD_PCA10059 -I. -Ihost/stubs -o replay host/replay.c capture.c advqueue.c recpool.c
+ *      ./replay capture.bin [speed] [filter name] [rssi filter]
+ */
+
+/** INCLUDES ******************************************************************/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "capture.h"
+#include "advqueue.h"
+#include "recpool.h"
+#include "cpumon.h"
+
+/** CONSTANTS *****************************************************************/
+#define REPLAY_SCHED_QUEUE_SIZE SCHED_QUEUE_SIZE
+#define REPLAY_FNV_OFFSET       2166136261u
+#define REPLAY_FNV_PRIME        16777619u
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Filter and result of the replay
+ *
+ */
+typedef struct
+{
+    char const *filterName;
+    int8_t rssiFilter;
+    uint32_t records;
+    uint32_t handled;    /**< Records that reached the handler */
+    uint32_t nameHits;   /**< Name filter passed */
+    uint32_t detections; /**< Name and RSSI filter passed */
+    uint32_t hash;
+} tsReplayState;
+
+/** VARIABLES *****************************************************************/
+
+static app_sched_event_handler_t replaySchedQueue[REPLAY_SCHED_QUEUE_SIZE];
+static uint32_t replaySchedCount;
+static uint32_t replayTicks;
+
+static tsReplayState replayState;
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+static uint32_t replayHash(uint32_t hash, void const *data, uint32_t size)
+{
+    uint8_t const *bytes = data;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * REPLAY_FNV_PRIME;
+    }
+    return hash;
+}
+
+/**@brief Record handler, the filter of advReportProcess() and the hash of the parsed fields */
+static void replayRecordHandler(tsAdvRecord const *record)
+{
+    uint8_t fields[] = {record->addrType, (uint8_t)record->rssi, record->primaryPhy, record->chIndex,
+                        record->connectable, record->nameOffset, record->nameLength, record->nameComplete,
+                        record->manufOffset, record->manufLength, record->len};
+
+    replayState.handled++;
+    replayState.hash = replayHash(replayState.hash, &record->timestamp, sizeof(record->timestamp));
+    replayState.hash = replayHash(replayState.hash, record->addr, sizeof(record->addr));
+    replayState.hash = replayHash(replayState.hash, fields, sizeof(fields));
+    replayState.hash = replayHash(replayState.hash, record->data, record->len);
+
+    if (record->nameComplete && record->nameLength == strlen(replayState.filterName) &&
+        memcmp(&record->data[record->nameOffset], replayState.filterName, record->nameLength) == 0)
+    {
+        replayState.nameHits++;
+        if (record->rssi > replayState.rssiFilter)
+        {
+            replayState.detections++;
+        }
+    }
+}
+
+/**@brief The BLE_GAP_EVT_ADV_REPORT case of bleEventHandler(), the queue is drained right after */
+static void replayEvent(ble_gap_evt_adv_report_t const *advReport)
+{
+#if ADV_QUEUE_ENABLE
+    advQueuePut(advReport);
+    app_sched_execute();
+#else
+    tsAdvRecord *record = recPoolAlloc();
+    if (record != NULL)
+    {
+        advRecordFill(record, advReport);
+        replayRecordHandler(record);
+        recPoolRelease(record);
+    }
+#endif
+}
+
+static uint64_t replayClockNs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/**@brief Waits up to start + ns on the monotonic clock */
+static void replayWait(uint64_t start, uint64_t ns)
+{
+    uint64_t until = start + ns;
+    struct timespec at = {.tv_sec = until / 1000000000u, .tv_nsec = until % 1000000000u};
+
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL);
+}
+
+static int replayCompare(void const *first, void const *second)
+{
+    uint32_t a = *(uint32_t const *)first;
+    uint32_t b = *(uint32_t const *)second;
+
+    return (a > b) - (a < b);
+}
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+ret_code_t app_sched_event_put(void const *p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+    if (replaySchedCount >= REPLAY_SCHED_QUEUE_SIZE)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    replaySchedQueue[replaySchedCount++] = handler;
+    return NRF_SUCCESS;
+}
+
+void app_sched_execute(void)
+{
+    for (uint32_t i = 0; i < replaySchedCount; i++)
+    {
+        replaySchedQueue[i](NULL, 0);
+    }
+    replaySchedCount = 0;
+}
+
+uint32_t app_timer_cnt_get(void)
+{
+    return replayTicks;
+}
+
+void cpuMonRecord(uint8_t site, uint32_t cycles)
+{
+}
+
+int main(int argc, char **argv)
+{
+    tsCaptureFileHeader const *header;
+    uint8_t const *map;
+    struct stat info;
+    double speed;
+    uint64_t sum = 0, start, offset, first = 0, last = 0;
+    uint32_t *times;
+    int fd;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s capture.bin [speed] [filter name] [rssi filter]\n", argv[0]);
+        return 2;
+    }
+    speed                  = (argc > 2) ? atof(argv[2]) : 0;
+    replayState.filterName = (argc > 3) ? argv[3] : FILTER_DEVICE_NAME;
+    replayState.rssiFilter = (argc > 4) ? (int8_t)atoi(argv[4]) : RSSI_FILTER_VALUE;
+    replayState.hash       = REPLAY_FNV_OFFSET;
+
+    fd = open(argv[1], O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(*header))
+    {
+        perror(argv[1]);
+        return 2;
+    }
+    map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        perror(argv[1]);
+        return 2;
+    }
+    header = (tsCaptureFileHeader const *)map;
+    if (header->magic != CAPTURE_FILE_MAGIC || header->version != CAPTURE_VERSION)
+    {
+        fprintf(stderr, "%s: not a capture file of version %u\n", argv[1], CAPTURE_VERSION);
+        return 2;
+    }
+
+    times = malloc(sizeof(*times) * (info.st_size / CAPTURE_FILE_RECORD_SIZE(0) + 1));
+    recPoolInit();
+    advQueueInit(replayRecordHandler);
+    start = replayClockNs();
+
+    for (offset = header->headerSize; offset + sizeof(tsCaptureFileRecord) <= (uint64_t)info.st_size;)
+    {
+        tsCaptureFileRecord const *record = (tsCaptureFileRecord const *)(map + offset);
+        ble_gap_evt_adv_report_t advReport;
+        uint64_t begin;
+
+        if (record->record.len > BLE_GAP_ADV_SET_DATA_SIZE_MAX ||
+            offset + CAPTURE_FILE_RECORD_SIZE(record->record.len) > (uint64_t)info.st_size)
+        {
+            break; // Torn record at the end
+        }
+        offset += CAPTURE_FILE_RECORD_SIZE(record->record.len);
+
+        if (replayState.records == 0)
+        {
+            first = record->time;
+        }
+        last = record->time;
+        if (speed > 0)
+        {
+            replayWait(start, (uint64_t)((record->time - first) * 1e9 / header->tickFrequency / speed));
+        }
+
+        captureRecordDecode(&record->record, &advReport);
+        replayTicks = record->record.ticks;
+
+        begin = replayClockNs();
+        replayEvent(&advReport);
+        times[replayState.records] = (uint32_t)(replayClockNs() - begin);
+        sum += times[replayState.records];
+        replayState.records++;
+    }
+
+    printf("REPLAYINFO,file=%s,records=%u,capture_s=%.3f,replay_s=%.3f,speed=%g\n",
+           argv[1],
+           replayState.records,
+           (double)(last - first) / header->tickFrequency,
+           (replayClockNs() - start) / 1e9,
+           speed);
+#if ADV_QUEUE_ENABLE
+    advQueueReport();
+#endif
+    recPoolReport();
+    printf("REPLAY,handled=%u,nameHits=%u,detections=%u,filter=%s,rssi=%d,hash=%08x\n",
+           replayState.handled,
+           replayState.nameHits,
+           replayState.detections,
+           replayState.filterName,
+           replayState.rssiFilter,
+           replayState.hash);
+
+    if (replayState.records != 0)
+    {
+        uint32_t count = replayState.records;
+
+        qsort(times, count, sizeof(*times), replayCompare);
+        printf("REPLAYTIME,unit=ns,min=%u,mean=%u,p50=%u,p99=%u,max=%u\n",
+               times[0],
+               (uint32_t)(sum / count),
+               times[count / 2],
+               times[(uint64_t)count * 99 / 100],
+               times[count - 1]);
+    }
+
+    free(times);
+    munmap((void *)map, info.st_size);
+    close(fd);
+    return 0;
+}
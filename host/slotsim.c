@@ -0,0 +1,247 @@
+/** @file       slotsim.c
+ *  @brief      Host simulation of slave responses to the master, unslotted burst vs slotted responses
+ *  @author     Evren Kenanoglu
+ *  @date       4/16/2021
+ *
+ *  Every slave hears the master in every cycle and answers in the master scan window. Unslotted
+ *  slaves advertise for ADVERTISEMENT_TIMEOUT right away, slotted slaves send one advertising event in
+ *  the slot given by slot.c for the slot map published in the master schedule (proto.c).
+ *
+ *  An advertising event is three PDUs on channels 37, 38 and 39 with the random advDelay. The master
+ *  scans one channel per scan interval. A PDU is lost when another PDU on the same channel overlaps
+ *  it (no capture), a response is delivered when the master receives at least one of its PDUs.
+ *
+ *  Build and run from the repository root:
+ *      gcc -O2 -Wall -I. -Ihost/stubs -o slotsim host/slotsim.c slot.c proto.c
+ *      ./slotsim [cycles] [seed]
+ */
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slot.h"
+#include "proto.h"
+
+/** CONSTANTS *****************************************************************/
+#define SIM_SLAVES_MAX       500
+#define SIM_PDU_US           352   // 31 byte payload at 1 Mbps
+#define SIM_CHANNEL_STEP_US  500   // PDU start to next channel PDU start in an event
+#define SIM_ADV_DELAY_US     10000 // advDelay 0-10 ms
+#define SIM_START_SPREAD_US  20000 // Unslotted: spread of the slave advertising starts (scan ends)
+#define SIM_REF_ERROR_US     500   // Slotted: error of the slave reference (master event timestamp)
+#define SIM_SCAN_INTERVAL_US 100000 // NRF_BLE_SCAN_SCAN_INTERVAL, window = interval
+#define SIM_SLOT_LOAD        8     // Sized frames: slaves per slot, advDelay spreads them in the slot
+#define SIM_PDUS_MAX         (SIM_SLAVES_MAX * 3 * (ADVERTISEMENT_TIMEOUT / MIN_ADVERTISEMENT_INTERVAL + 1))
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eSimSchemeBurst = 0, // Current firmware, every slave advertises right after detection
+    eSimSchemeSlotted,   // SLOT_FRAME_CYCLES
+    eSimSchemeSized,     // Frame sized to the population, SIM_SLOT_LOAD slaves per slot
+    eSimSchemeCount,
+} teSimSchemes;
+
+typedef struct
+{
+    uint64_t start;
+    uint16_t slave;
+    uint8_t channel;
+    uint8_t lost;
+} tsSimPdu;
+
+typedef struct
+{
+    uint32_t pdus;
+    uint32_t lost;
+    uint32_t delivered;
+    uint32_t heard;
+} tsSimResult;
+
+/** VARIABLES *****************************************************************/
+
+static tsSimPdu simPdus[SIM_PDUS_MAX];
+static uint32_t simPduCount;
+static uint8_t simAddr[SIM_SLAVES_MAX][SLOT_ADDR_LEN];
+static uint8_t simMasterAddr[SLOT_ADDR_LEN] = {0x10, 0x32, 0x54, 0x76, 0x98, 0xC0};
+static uint32_t simSeed;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static uint32_t simRandom(void);
+static void simEvent(uint16_t slave, uint64_t start);
+static int simPduCompare(void const *a, void const *b);
+static void simRun(uint32_t slaves, uint32_t cycles, uint8_t scheme, tsSimResult *result);
+
+/** FUNCTIONS *****************************************************************/
+
+int main(int argc, char **argv)
+{
+    static const uint32_t populations[] = {10, 20, 50, 100, 200, 500};
+    static const char *const names[eSimSchemeCount] = {"burst", "slotted", "sized"};
+    uint32_t cycles = (argc > 1) ? (uint32_t)atoi(argv[1]) : 300;
+    uint32_t seed   = (argc > 2) ? (uint32_t)atoi(argv[2]) : 1;
+    double seconds  = (double)cycles * (SCAN_TIMEOUT + ADVERTISEMENT_TIMEOUT) / 1000;
+
+    printf("%u cycles (%.0f s), seed %u, %u slots of %u ms, scan window %u ms\n",
+           cycles, seconds, seed, SLOT_COUNT, SLOT_LENGTH_MS, SCAN_TIMEOUT);
+    printf("%7s %-8s %6s %10s %10s %10s %12s %8s\n", "slaves", "scheme", "frame", "pdu/cycle", "collision", "resp/s", "per slave s", "heard");
+
+    for (uint32_t p = 0; p < sizeof(populations) / sizeof(populations[0]); p++)
+    {
+        for (uint8_t scheme = 0; scheme < eSimSchemeCount; scheme++)
+        {
+            uint32_t slaves = populations[p];
+            uint32_t frame  = (scheme == eSimSchemeBurst) ? 0 : (scheme == eSimSchemeSlotted) ? SLOT_FRAME_CYCLES : (slaves + SLOT_COUNT * SIM_SLOT_LOAD - 1) / (SLOT_COUNT * SIM_SLOT_LOAD);
+            tsSimResult result;
+
+            simSeed = seed;
+            simRun(slaves, cycles, scheme, &result);
+            printf("%7u %-8s %6u %10.1f %9.1f%% %10.1f %12.2f %4u/%-3u\n",
+                   slaves, names[scheme], frame,
+                   (double)result.pdus / cycles,
+                   result.pdus ? 100.0 * result.lost / result.pdus : 0,
+                   result.delivered / seconds,
+                   result.delivered ? seconds * slaves / result.delivered : 0,
+                   result.heard, slaves);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief One population and scheme, master cycle: advertising, then scanning
+ */
+static void simRun(uint32_t slaves, uint32_t cycles, uint8_t scheme, tsSimResult *result)
+{
+    static uint8_t heard[SIM_SLAVES_MAX];
+    static uint8_t delivered[SIM_SLAVES_MAX];
+    uint32_t period = (SCAN_TIMEOUT + ADVERTISEMENT_TIMEOUT) * 1000;
+    tsProtoSchedule schedule;
+
+    memset(result, 0, sizeof(*result));
+    memset(heard, 0, sizeof(heard));
+    memset(&schedule, 0, sizeof(schedule));
+    for (uint32_t i = 0; i < slaves; i++)
+    {
+        for (uint8_t b = 0; b < SLOT_ADDR_LEN; b++)
+        {
+            simAddr[i][b] = (b < 2) ? (uint8_t)(i >> (8 * b)) : (uint8_t)(0xA0 + b); // Sequential addresses
+        }
+    }
+
+    schedule.period            = period;
+    schedule.slots.count       = SLOT_COUNT;
+    schedule.slots.length      = SLOT_LENGTH_MS;
+    schedule.slots.offset      = SLOT_OFFSET_MS;
+    schedule.slots.frameCycles = (scheme == eSimSchemeSized) ? (uint8_t)((slaves + SLOT_COUNT * SIM_SLOT_LOAD - 1) / (SLOT_COUNT * SIM_SLOT_LOAD)) : SLOT_FRAME_CYCLES;
+
+    for (uint32_t cycle = 0; cycle < cycles; cycle++)
+    {
+        uint64_t cycleStart = (uint64_t)cycle * period;
+        uint64_t firstEvent = cycleStart + simRandom() % SIM_ADV_DELAY_US; // First master advertising event
+        uint64_t scanStart  = cycleStart + ADVERTISEMENT_TIMEOUT * 1000;
+        uint64_t scanEnd    = scanStart + SCAN_TIMEOUT * 1000;
+        uint8_t payload[PROTO_SCHEDULE_SIZE];
+        tsProtoSchedule received;
+
+        schedule.slots.framePosition = (uint8_t)(cycle % schedule.slots.frameCycles);
+        schedule.slots.seed          = slotSeedGet(simMasterAddr, cycle / schedule.slots.frameCycles);
+        protoScheduleDecode(payload, protoScheduleEncode(&schedule, payload), &received);
+
+        simPduCount = 0;
+        for (uint16_t i = 0; i < slaves; i++)
+        {
+            if (scheme == eSimSchemeBurst)
+            {
+                uint64_t start = scanStart + simRandom() % SIM_START_SPREAD_US;
+
+                for (uint32_t t = 0; t < ADVERTISEMENT_TIMEOUT * 1000; t += MIN_ADVERTISEMENT_INTERVAL * 1000)
+                {
+                    simEvent(i, start + t + simRandom() % SIM_ADV_DELAY_US);
+                }
+            }
+            else
+            {
+                uint32_t delay;
+
+                if (slotDelayGet(&received.slots, simAddr[i], &delay))
+                {
+                    simEvent(i, firstEvent + (uint64_t)delay * 1000 + simRandom() % SIM_REF_ERROR_US + simRandom() % SIM_ADV_DELAY_US);
+                }
+            }
+        }
+
+        // Same channel overlaps
+        qsort(simPdus, simPduCount, sizeof(tsSimPdu), simPduCompare);
+        for (uint32_t a = 0; a < simPduCount; a++)
+        {
+            for (uint32_t b = a + 1; b < simPduCount && simPdus[b].start < simPdus[a].start + SIM_PDU_US; b++)
+            {
+                if (simPdus[b].channel == simPdus[a].channel)
+                {
+                    simPdus[a].lost = 1;
+                    simPdus[b].lost = 1;
+                }
+            }
+        }
+
+        memset(delivered, 0, sizeof(delivered));
+        for (uint32_t a = 0; a < simPduCount; a++)
+        {
+            tsSimPdu const *pdu = &simPdus[a];
+            uint8_t listening   = (uint8_t)((pdu->start / SIM_SCAN_INTERVAL_US) % 3);
+
+            result->pdus++;
+            result->lost += pdu->lost;
+            if (!pdu->lost && pdu->start >= scanStart && pdu->start + SIM_PDU_US <= scanEnd && pdu->channel == listening &&
+                (pdu->start / SIM_SCAN_INTERVAL_US) == ((pdu->start + SIM_PDU_US) / SIM_SCAN_INTERVAL_US))
+            {
+                delivered[pdu->slave] = 1;
+            }
+        }
+        for (uint32_t i = 0; i < slaves; i++)
+        {
+            result->delivered += delivered[i];
+            heard[i] |= delivered[i];
+        }
+    }
+
+    for (uint32_t i = 0; i < slaves; i++)
+    {
+        result->heard += heard[i];
+    }
+}
+
+/**@brief One advertising event of a slave, channels 37, 38, 39 */
+static void simEvent(uint16_t slave, uint64_t start)
+{
+    for (uint8_t channel = 0; channel < 3; channel++)
+    {
+        tsSimPdu *pdu = &simPdus[simPduCount++];
+
+        pdu->start   = start + channel * SIM_CHANNEL_STEP_US;
+        pdu->slave   = slave;
+        pdu->channel = channel;
+        pdu->lost    = 0;
+    }
+}
+
+static int simPduCompare(void const *a, void const *b)
+{
+    uint64_t startA = ((tsSimPdu const *)a)->start;
+    uint64_t startB = ((tsSimPdu const *)b)->start;
+
+    return (startA > startB) - (startA < startB);
+}
+
+/**@brief xorshift32 */
+static uint32_t simRandom(void)
+{
+    simSeed ^= simSeed << 13;
+    simSeed ^= simSeed >> 17;
+    simSeed ^= simSeed << 5;
+    return simSeed;
+}
@@ -0,0 +1,18 @@
+/** @file       app_scheduler.h
+ *  @brief      Host build stand-in for the nRF5 SDK app_scheduler.h
+ *  @author     Evren Kenanoglu
+ *  @date       4/24/2021
+ */
+#ifndef FILE_HOST_APP_SCHEDULER_H
+#define FILE_HOST_APP_SCHEDULER_H
+
+#include <stdint.h>
+#include "nrf_soc.h"
+
+typedef void (*app_sched_event_handler_t)(void *p_event_data, uint16_t event_size);
+
+// Provided by the host program that uses them
+ret_code_t app_sched_event_put(void const *p_event_data, uint16_t event_size, app_sched_event_handler_t handler);
+void app_sched_execute(void);
+
+#endif // FILE_HOST_APP_SCHEDULER_H
@@ -0,0 +1,16 @@
+/** @file       app_timer.h
+ *  @brief      Host build stand-in for the nRF5 SDK app_timer.h, RTC frequency and the counter
+ *  @author     Evren Kenanoglu
+ *  @date       4/12/2021
+ */
+#ifndef FILE_HOST_APP_TIMER_H
+#define FILE_HOST_APP_TIMER_H
+
+#include <stdint.h>
+
+#define APP_TIMER_CLOCK_FREQ           32768
+#define APP_TIMER_CONFIG_RTC_FREQUENCY 1
+
+uint32_t app_timer_cnt_get(void); // Provided by the host program that uses it
+
+#endif // FILE_HOST_APP_TIMER_H
@@ -0,0 +1,25 @@
+/** @file       app_util_platform.h
+ *  @brief      Host build stand-in for the nRF5 SDK app_util_platform.h
+ *  @author     Evren Kenanoglu
+ *  @date       4/12/2021
+ */
+#ifndef FILE_HOST_APP_UTIL_PLATFORM_H
+#define FILE_HOST_APP_UTIL_PLATFORM_H
+
+#include <stdbool.h>
+#include "nrf_soc.h"
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define STATIC_ASSERT(expression) _Static_assert((expression), #expression)
+#define UNUSED_PARAMETER(x)       ((void)(x))
+
+#define CRITICAL_REGION_ENTER() // Host builds are single threaded where these are used
+#define CRITICAL_REGION_EXIT()
+
+#endif // FILE_HOST_APP_UTIL_PLATFORM_H
@@ -0,0 +1,59 @@
+/** @file       ble_gap.h
+ *  @brief      Host build stand-in for the SoftDevice ble_gap.h, advertising report and AD types
+ *  @author     Evren Kenanoglu
+ *  @date       4/24/2021
+ */
+#ifndef FILE_HOST_BLE_GAP_H
+#define FILE_HOST_BLE_GAP_H
+
+#include <stdint.h>
+#include "nrf_soc.h"
+
+#define BLE_GAP_ADDR_LEN              6
+#define BLE_GAP_ADV_SET_DATA_SIZE_MAX 31
+#define BLE_GAP_ADDR_TYPE_RANDOM_STATIC 0x01
+#define BLE_GAP_PHY_1MBPS             0x01
+
+#define BLE_GAP_AD_TYPE_FLAGS                        0x01
+#define BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME             0x08
+#define BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME          0x09
+#define BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA   0xFF
+
+typedef struct
+{
+    uint8_t *p_data;
+    uint16_t len;
+} ble_data_t;
+
+typedef struct
+{
+    uint8_t addr_id_peer : 1;
+    uint8_t addr_type : 7;
+    uint8_t addr[BLE_GAP_ADDR_LEN];
+} ble_gap_addr_t;
+
+typedef struct
+{
+    uint16_t connectable : 1;
+    uint16_t scannable : 1;
+    uint16_t directed : 1;
+    uint16_t scan_response : 1;
+    uint16_t extended_pdu : 1;
+    uint16_t status : 2;
+} ble_gap_adv_report_type_t;
+
+typedef struct
+{
+    ble_gap_adv_report_type_t type;
+    ble_gap_addr_t peer_addr;
+    ble_gap_addr_t direct_addr;
+    uint8_t primary_phy;
+    uint8_t secondary_phy;
+    int8_t tx_power;
+    int8_t rssi;
+    uint8_t ch_index;
+    uint8_t set_id;
+    ble_data_t data;
+} ble_gap_evt_adv_report_t;
+
+#endif // FILE_HOST_BLE_GAP_H
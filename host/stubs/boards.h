@@ -0,0 +1,12 @@
+/** @file       boards.h
+ *  @brief      Host build stand-in for the nRF5 SDK boards.h, parameters.h only needs the LED names
+ *  @author     Evren Kenanoglu
+ *  @date       4/9/2021
+ */
+#ifndef FILE_HOST_BOARDS_H
+#define FILE_HOST_BOARDS_H
+
+#define BSP_BOARD_LED_0 0
+#define BSP_BOARD_LED_1 1
+
+#endif // FILE_HOST_BOARDS_H
@@ -0,0 +1,46 @@
+/** @file       nrf.h
+ *  @brief      Host build stand-in for the nRF5 MDK nrf.h, DWT->CYCCNT counts ns of the monotonic clock
+ *  @author     Evren Kenanoglu
+ *  @date       4/24/2021
+ */
+#ifndef FILE_HOST_NRF_H
+#define FILE_HOST_NRF_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define BENCH_CLOCK_UNIT "ns"
+
+typedef struct
+{
+    uint32_t DEMCR;
+} tsHostCoreDebug;
+
+typedef struct
+{
+    uint32_t CTRL;
+    uint32_t CYCCNT;
+} tsHostDwt;
+
+static tsHostCoreDebug hostCoreDebug __attribute__((unused));
+static tsHostDwt hostDwt;
+
+/**@brief DWT registers with CYCCNT read at the time of the access */
+static inline tsHostDwt *hostDwtGet(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    hostDwt.CYCCNT = (uint32_t)((uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec);
+    return &hostDwt;
+}
+
+#define CoreDebug                  (&hostCoreDebug)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT                        (hostDwtGet())
+#define DWT_CTRL_CYCCNTENA_Msk     (1UL << 0)
+
+#define __CLZ(x) ((uint32_t)__builtin_clz(x))
+#define __DMB()  __sync_synchronize()
+
+#endif // FILE_HOST_NRF_H
@@ -0,0 +1,48 @@
+/** @file       nrf_balloc.h
+ *  @brief      Host build stand-in for the nRF5 SDK block allocator, a stack of free blocks
+ *  @author     Evren Kenanoglu
+ *  @date       4/24/2021
+ */
+#ifndef FILE_HOST_NRF_BALLOC_H
+#define FILE_HOST_NRF_BALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "nrf_soc.h"
+
+typedef struct
+{
+    uint8_t *blocks;
+    void **stack;
+    uint32_t *top;
+    uint32_t blockSize;
+    uint32_t count;
+} nrf_balloc_t;
+
+#define NRF_BALLOC_DEF(name, size, count)                                                      \
+    static uint32_t name##Blocks[(count)][((size) + 3) / 4];                                   \
+    static void *name##Stack[(count)];                                                         \
+    static uint32_t name##Top;                                                                 \
+    static nrf_balloc_t const name = {(uint8_t *)name##Blocks, name##Stack, &name##Top, ((size) + 3) / 4 * 4, (count)}
+
+static inline ret_code_t nrf_balloc_init(nrf_balloc_t const *pool)
+{
+    for (uint32_t i = 0; i < pool->count; i++)
+    {
+        pool->stack[i] = pool->blocks + i * pool->blockSize;
+    }
+    *pool->top = pool->count;
+    return NRF_SUCCESS;
+}
+
+static inline void *nrf_balloc_alloc(nrf_balloc_t const *pool)
+{
+    return (*pool->top == 0) ? NULL : pool->stack[--*pool->top];
+}
+
+static inline void nrf_balloc_free(nrf_balloc_t const *pool, void *block)
+{
+    pool->stack[(*pool->top)++] = block;
+}
+
+#endif // FILE_HOST_NRF_BALLOC_H
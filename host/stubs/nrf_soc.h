@@ -0,0 +1,16 @@
+/** @file       nrf_soc.h
+ *  @brief      Host build stand-in for the SoftDevice nrf_soc.h, ret_code_t and the error codes in use
+ *  @author     Evren Kenanoglu
+ *  @date       4/12/2021
+ */
+#ifndef FILE_HOST_NRF_SOC_H
+#define FILE_HOST_NRF_SOC_H
+
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS       0
+#define NRF_ERROR_NO_MEM  4
+
+#endif // FILE_HOST_NRF_SOC_H
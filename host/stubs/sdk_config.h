@@ -0,0 +1,13 @@
+/** @file       sdk_config.h
+ *  @brief      Host build stand-in for the pca10059 sdk_config.h with the harvest override, caps.h only needs the scan buffer and link counts
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ */
+#ifndef FILE_HOST_SDK_CONFIG_H
+#define FILE_HOST_SDK_CONFIG_H
+
+#define NRF_BLE_SCAN_BUFFER               31
+#define NRF_SDH_BLE_PERIPHERAL_LINK_COUNT 1
+#define NRF_SDH_BLE_CENTRAL_LINK_COUNT    8
+
+#endif // FILE_HOST_SDK_CONFIG_H
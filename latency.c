@@ -0,0 +1,234 @@
+/** @file       latency.c
+ *  @brief      End-to-end rendezvous latency, master pings, slave echoes, round trip histogram
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ *
+ *  Every master advertising phase carries a new ping: sequence and the master clock at its start.
+ *  A slave that detects the ping echoes it in its own advertising until the next one. The master
+ *  takes the round trip from the echo time and the sent time it kept for that sequence, so the
+ *  slave clock is never used and an echo of another master or of a previous session is recognized.
+ *  The round trip is the discovery latency: slave sleep and scan windows, the slave response and
+ *  the master scan window that catches it.
+ *
+ *  Each ping is counted once per slave, the slave echoes it in every advertising event until it
+ *  receives the next ping.
+ */
+#define FILE_LATENCY_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "latency.h"
+#include "nordic_common.h"
+
+/** CONSTANTS *****************************************************************/
+
+STATIC_ASSERT((LATENCY_SEQUENCE_WINDOW & (LATENCY_SEQUENCE_WINDOW - 1)) == 0);
+
+#define LATENCY_BUCKET_US (LATENCY_BUCKET_MS * 1000)
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static tsLatencyPeer *latencyPeerGet(tsLatency *latency, uint8_t const *addr);
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize a latency state
+ *
+ * @param latency State
+ * @param addr    Device address, the master tells its echoes apart by its first bytes
+ */
+void latencyInit(tsLatency *latency, uint8_t const *addr)
+{
+    memset(latency, 0, sizeof(*latency));
+    latency->origin = (uint16_t)(addr[0] | (addr[1] << 8));
+    latencyReset(latency);
+}
+
+/**
+ * @brief Function to get the ping of a new master advertising phase
+ *
+ * @param latency State
+ * @param now     Master clock, us
+ * @param ping    Ping to advertise
+ */
+void latencyPingNext(tsLatency *latency, uint32_t now, tsProtoProbe *ping)
+{
+    latency->sequence++;
+    latency->sent[latency->sequence & (LATENCY_SEQUENCE_WINDOW - 1)] = now;
+
+    ping->kind     = eProtoProbePing;
+    ping->sequence = latency->sequence;
+    ping->sent     = now;
+    ping->origin   = latency->origin;
+}
+
+/**
+ * @brief Function to take the round trip of an echo, master side
+ *
+ * @param latency State
+ * @param echo    Decoded echo
+ * @param addr    Slave address
+ * @param time    Master clock at reception of the echo, us
+ * @return true   round trip is counted
+ * @return false  echo is stale or this slave's echo of the ping is already counted
+ */
+bool latencyEchoReceived(tsLatency *latency, tsProtoProbe const *echo, uint8_t const *addr, uint32_t time)
+{
+    tsLatencyPeer *peer;
+    uint32_t roundTrip;
+    uint8_t bucket;
+
+    if (echo->kind != eProtoProbeEcho || echo->origin != latency->origin ||
+        (uint16_t)(latency->sequence - echo->sequence) >= LATENCY_SEQUENCE_WINDOW ||
+        latency->sent[echo->sequence & (LATENCY_SEQUENCE_WINDOW - 1)] != echo->sent)
+    {
+        latency->stale++;
+        return false;
+    }
+
+    peer = latencyPeerGet(latency, addr);
+    if (peer->valid && peer->sequence == echo->sequence)
+    {
+        return false;
+    }
+    peer->sequence = echo->sequence;
+    peer->valid    = true;
+
+    roundTrip = time - echo->sent;
+    bucket    = (uint8_t)MIN(roundTrip / LATENCY_BUCKET_US, LATENCY_BUCKET_COUNT - 1);
+    latency->histogram[bucket]++;
+    latency->count++;
+    latency->sum += roundTrip;
+    latency->min = MIN(latency->min, roundTrip);
+    latency->max = MAX(latency->max, roundTrip);
+    return true;
+}
+
+/**
+ * @brief Function to keep the last ping for the echo, slave side
+ *
+ * @param latency State
+ * @param ping    Decoded ping
+ * @param addr    Master address
+ */
+void latencyPingReceived(tsLatency *latency, tsProtoProbe const *ping, uint8_t const *addr)
+{
+    if (ping->kind != eProtoProbePing)
+    {
+        return;
+    }
+
+    latency->echo.kind     = eProtoProbeEcho;
+    latency->echo.sequence = ping->sequence;
+    latency->echo.sent     = ping->sent;
+    latency->echo.origin   = (uint16_t)(addr[0] | (addr[1] << 8));
+    latency->echoValid     = true;
+}
+
+/**
+ * @brief Function to get the echo to advertise, slave side
+ *
+ * @param latency State
+ * @param echo    Echo of the last ping
+ * @return true   a ping was received
+ */
+bool latencyEchoGet(tsLatency const *latency, tsProtoProbe *echo)
+{
+    *echo = latency->echo;
+    return latency->echoValid;
+}
+
+/**
+ * @brief Function to get a percentile of the round trips
+ *
+ * @param latency State
+ * @param percent 1-100
+ * @return uint32_t us, upper edge of the histogram bucket, the maximum for the open bucket, 0: no round trips
+ */
+uint32_t latencyPercentileGet(tsLatency const *latency, uint8_t percent)
+{
+    uint32_t rank = (uint32_t)(((uint64_t)latency->count * percent + 99) / 100);
+    uint32_t seen = 0;
+
+    if (latency->count == 0)
+    {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < LATENCY_BUCKET_COUNT - 1; i++)
+    {
+        seen += latency->histogram[i];
+        if (seen >= rank)
+        {
+            return MIN((uint32_t)(i + 1) * LATENCY_BUCKET_US, latency->max);
+        }
+    }
+    return latency->max;
+}
+
+/**@brief Function to clear the statistics, the pings in flight stay valid */
+void latencyReset(tsLatency *latency)
+{
+    memset(latency->histogram, 0, sizeof(latency->histogram));
+    latency->count = 0;
+    latency->min   = UINT32_MAX;
+    latency->max   = 0;
+    latency->sum   = 0;
+    latency->stale = 0;
+}
+
+/**@brief Function to print the statistics and the histogram on the debug console */
+void latencyReport(tsLatency const *latency)
+{
+    uint8_t last = LATENCY_BUCKET_COUNT;
+
+    printf("LATENCY,echoes=%lu,stale=%lu,min=%lu,p50=%lu,p90=%lu,p99=%lu,max=%lu,mean=%lu,unit=us\n\r",
+           (unsigned long)latency->count,
+           (unsigned long)latency->stale,
+           (unsigned long)((latency->count != 0) ? latency->min : 0),
+           (unsigned long)latencyPercentileGet(latency, 50),
+           (unsigned long)latencyPercentileGet(latency, 90),
+           (unsigned long)latencyPercentileGet(latency, 99),
+           (unsigned long)latency->max,
+           (unsigned long)((latency->count != 0) ? latency->sum / latency->count : 0));
+
+    while (last > 0 && latency->histogram[last - 1] == 0)
+    {
+        last--; // Empty buckets at the end are left out
+    }
+    printf("LATENCYHIST,bucket_ms=%u", LATENCY_BUCKET_MS);
+    for (uint8_t i = 0; i < last; i++)
+    {
+        printf(",%lu", (unsigned long)latency->histogram[i]);
+    }
+    printf("\n\r");
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief Peer entry of a slave, the oldest entry is taken over by a new slave */
+static tsLatencyPeer *latencyPeerGet(tsLatency *latency, uint8_t const *addr)
+{
+    tsLatencyPeer *peer;
+
+    for (uint8_t i = 0; i < LATENCY_PEERS_MAX; i++)
+    {
+        if (latency->peers[i].valid && memcmp(latency->peers[i].addr, addr, BLE_GAP_ADDR_LEN) == 0)
+        {
+            return &latency->peers[i];
+        }
+    }
+
+    peer = &latency->peers[latency->peerNext];
+    latency->peerNext = (uint8_t)((latency->peerNext + 1) % LATENCY_PEERS_MAX);
+    memcpy(peer->addr, addr, BLE_GAP_ADDR_LEN);
+    peer->valid = false;
+    return peer;
+}
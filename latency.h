@@ -0,0 +1,80 @@
+/** @file       latency.h
+ *  @brief      End-to-end rendezvous latency, master pings, slave echoes, round trip histogram
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ */
+#ifndef FILE_LATENCY_H
+#define FILE_LATENCY_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+#include "proto.h"
+#include "ble_gap.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Slave seen by the master, a ping is counted once per slave
+ *
+ */
+typedef struct
+{
+    uint8_t addr[BLE_GAP_ADDR_LEN];
+    uint16_t sequence; /**< Last ping echoed by this slave */
+    bool valid;
+} tsLatencyPeer;
+
+/**
+ * @brief Latency state, master side counts the round trips, slave side holds the echo
+ *
+ */
+typedef struct
+{
+    /** Master **/
+    uint16_t origin;                          /**< First address bytes, echoes of other masters are dropped */
+    uint16_t sequence;                        /**< Last ping */
+    uint32_t sent[LATENCY_SEQUENCE_WINDOW];   /**< us, ping time by sequence */
+    tsLatencyPeer peers[LATENCY_PEERS_MAX];
+    uint8_t peerNext;                         /**< Replaced next when a new slave shows up */
+
+    /** Slave **/
+    tsProtoProbe echo;
+    bool echoValid;
+
+    /** Statistics **/
+    uint32_t histogram[LATENCY_BUCKET_COUNT]; /**< LATENCY_BUCKET_MS wide, the last one is open */
+    uint32_t count;
+    uint32_t min;   /**< us */
+    uint32_t max;   /**< us */
+    uint64_t sum;   /**< us */
+    uint32_t stale; /**< Echoes of another master, a reset or an old ping */
+} tsLatency;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_LATENCY_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void latencyInit(tsLatency *latency, uint8_t const *addr);
+INTERFACE void latencyPingNext(tsLatency *latency, uint32_t now, tsProtoProbe *ping);
+INTERFACE bool latencyEchoReceived(tsLatency *latency, tsProtoProbe const *echo, uint8_t const *addr, uint32_t time);
+INTERFACE void latencyPingReceived(tsLatency *latency, tsProtoProbe const *ping, uint8_t const *addr);
+INTERFACE bool latencyEchoGet(tsLatency const *latency, tsProtoProbe *echo);
+INTERFACE uint32_t latencyPercentileGet(tsLatency const *latency, uint8_t percent);
+INTERFACE void latencyReset(tsLatency *latency);
+INTERFACE void latencyReport(tsLatency const *latency);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_LATENCY_H
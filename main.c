@@ -32,21 +32,48 @@
 
 #include "boardinit.h"
 #include "bleall.h"
+#include "energy.h"
+#include "cpumon.h"
+#include "deepsleep.h"
+#include "advqueue.h"
+#include "recpool.h"
+#include "phaseengine.h"
+#include "configstore.h"
+#include "bootprof.h"
+#include "rendezvous.h"
+#include "backoff.h"
+#include "proto.h"
+#include "slot.h"
+#include "stream.h"
+#include "harvest.h"
+#include "bench.h"
+#include "capture.h"
+#include "metrics.h"
+#include "cli.h"
+#include "latency.h"
+#include "tune.h"
+#include "sensor.h"
 
 #include "parameters.h"
 /** CONSTANTS *****************************************************************/
+#define PROGRAM_TICK_FREQUENCY (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
 /** MACROS ********************************************************************/
 
+#if SCANNING_ENABLE
 NRF_BLE_SCAN_DEF(bleScanModule); /**< Scanning Module instance. */
+#endif
 NRF_BLE_GATT_DEF(gattModule);    /**< GATT module instance. */
 
 /** VARIABLES *****************************************************************/
 
+#if SCANNING_ENABLE
 tsBleScanParams bleScanParams;
+#endif
 tsBleParams BLEParams;
 tsProgramParams programParams = {.programStatus  = eModeFirstStart,
                                  .programCounter = 0};
 
+#if SCANNING_ENABLE
 /**< Scan parameters requested for scanning */
 static ble_gap_scan_params_t const bleGapScanParams =
     {
@@ -57,6 +84,7 @@ static ble_gap_scan_params_t const bleGapScanParams =
         .timeout       = BLE_SCAN_DURATION,
         .scan_phys     = BLE_GAP_PHY_1MBPS,
 };
+#endif
 
 
 // Dummy packages for advertising
@@ -94,60 +122,304 @@ uint8_t dataPacketExpected[] =
 /** LOCAL FUNCTION DECLARATIONS ***********************************************/
 void assert_nrf_callback(uint16_t line_num, const uint8_t *p_file_name);
 static void bleEventHandler(ble_evt_t const *p_ble_evt, void *p_context); 
+#if SCANNING_ENABLE
+static void advReportProcess(tsAdvRecord const *record);
+static void deviceDetectionHandler(tsAdvRecord const *record);
+#endif
 static void idle_state_handle(void);
 static void createTimers();
 static void timerCBRefreshAdvData();
 static char compareArray(uint8_t *arrayFirst, uint8_t *arraySecond, uint8_t size);
-static void deviceDetectionHandler(void);
-
+static uint64_t programTicks(void);
+static uint32_t programTimeUs(void);
+#if SCANNING_ENABLE
+static uint32_t programTimestampUs(uint32_t ticks);
+#endif
+static void configApply(void);
+static void bleDeferredInit(void);
+static void bootFirstScanDone(void);
 
-#if MASTER_ENABLE
-APP_TIMER_DEF(timerProgramMaster);
-#else
-APP_TIMER_DEF(timerProgramSlave);
+static void tcbProgramHandler(void *p_context);
+static void programTimerStart(void *context, uint32_t duration);
+#if SCANNING_ENABLE
+static void programScanStart(void *context);
+static void programScanStop(void *context);
+#endif
+static void programAdvStart(void *context);
+static void programAdvStop(void *context);
+static void programSleepStart(void *context, uint32_t duration);
+static void programSleepStop(void *context);
+static void programPhaseChanged(void *context, uint8_t from, uint8_t to);
+#if RENDEZVOUS_ENABLE || BACKOFF_ENABLE || SLOT_ENABLE
+static uint32_t programTimingAdjust(void *context, uint8_t state, uint32_t duration);
+#endif
+#if RENDEZVOUS_ENABLE
+static bool programScanScheduled(void *context);
+#endif
+#if (BACKOFF_ENABLE && BACKOFF_KICK_BUTTON_ENABLE) || SCHEDULE_ENABLE
+static void programKick(void);
+static void bspEventHandler(bsp_event_t event);
 #endif
+#if SCHEDULE_ENABLE
+static void programScheduleMeasure(void);
+static void programScheduleParse(tsAdvRecord const *record);
+static void programScheduleReceived(tsProtoSchedule const *schedule);
+static void programCommandPost(uint8_t command);
+#endif
+static void programAdvertise(void);
+#if SLOT_ENABLE
+static bool programSlotPlan(void);
+static void tcbSlotHandler(void *p_context);
+#endif
+static void gattEventHandler(nrf_ble_gatt_t *gatt, nrf_ble_gatt_evt_t const *gattEvent);
+#if LATENCY_ENABLE
+static void programProbeParse(tsAdvRecord const *record);
+#endif
+#if SENSOR_ENABLE && SCANNING_ENABLE
+static void programSensorParse(tsAdvRecord const *record);
+#endif
+#if TUNE_ENABLE
+static void programTuneApply(void);
+#endif
+#if METRICS_ENABLE
+static uint32_t programUptimeMs(void);
+static void programMetricsSample(void);
+#endif
+#if BENCH_ENABLE
+static void programBenchRun(void);
+static void programBenchTimerStart(void *context, uint32_t duration);
+static void programBenchEventPrepare(void *context, uint8_t param);
+static bool programBenchEventRun(void *context, uint8_t param);
+static void programBenchAdvPrepare(void *context, uint8_t param);
+static bool programBenchAdvRun(void *context, uint8_t param);
+static void programBenchScanPrepare(void *context, uint8_t param);
+static bool programBenchScanRun(void *context, uint8_t param);
+static void programBenchPhasePrepare(void *context, uint8_t param);
+static bool programBenchPhaseRun(void *context, uint8_t param);
+#endif
+
+APP_TIMER_DEF(timerProgram);
 APP_TIMER_DEF(timerRefreshAdvDataBLE);
+#if SLOT_ENABLE
+APP_TIMER_DEF(timerSlot);
+#endif
 
+/**< Phase engine hooks, bound to SoftDevice and app_timer */
+static const tsPhaseHooks programHooks =
+    {
+        .timerStart   = programTimerStart,
+#if SCANNING_ENABLE
+        .scanStart    = programScanStart,
+        .scanStop     = programScanStop,
+#endif
+        .advStart     = programAdvStart,
+        .advStop      = programAdvStop,
+        .sleepStart   = programSleepStart,
+        .sleepStop    = programSleepStop,
+        .phaseChanged = programPhaseChanged,
+#if RENDEZVOUS_ENABLE || BACKOFF_ENABLE || SLOT_ENABLE
+        .timingAdjust  = programTimingAdjust,
+#endif
+#if RENDEZVOUS_ENABLE
+        .scanScheduled = programScanScheduled,
+#endif
+};
 
-static void tcbProgramMasterHandler();
-static void startTimers();
+tsPhaseEngine programEngine;
+tsRendezvous programRendezvous;
+tsBackoff programBackoff;
+tsProtoSchedule programSchedule; /**< Master: published schedule, slave: last received schedule */
+static uint8_t programScheduleBuffer[PROTO_SCHEDULE_SIZE];
+static uint8_t programCommandCycles = 0;
+static bool programScheduleFresh    = false; /**< Slave: master schedule received in the current scan */
+static uint8_t programAddr[BLE_GAP_ADDR_LEN];
+static uint32_t programDetectFirstUs = 0;     /**< Slave: earliest master report of the current scan */
+static bool programDetectSeen        = false;
+static uint32_t programScanStartUs   = 0;     /**< Start of the current scan, reports older than it are stale */
+#if SCHEDULE_ENABLE
+static uint8_t programMasterAddr[BLE_GAP_ADDR_LEN]; /**< Slave: filtered master, only its schedule is taken */
+static bool programMasterKnown = false;
+#endif
+static uint32_t programSlotDuration  = 0; /**< Slave: advertising phase with a response slot, ms, 0: unslotted */
+static uint32_t programSlotCycle     = 0; /**< Master: cycle counter for the slot frames */
+uint8_t programRole = PROGRAM_ROLE_DEFAULT;
+tsStream programStream;
+tsHarvest programHarvest;
+#if LATENCY_ENABLE
+tsLatency programLatency;
+static uint8_t programProbeBuffer[PROTO_PROBE_SIZE];
+#endif
+#if SENSOR_ENABLE
+static uint8_t programSensorBuffer[PROTO_SENSOR_SIZE];
+#endif
+#if TUNE_ENABLE
+tsTune programTune;
+#endif
 
 uint32_t counter = 0;
+static bool bootDeferredDone = false;
+
+#if CLI_ENABLE
+/**< Console hooks, called from main loop */
+static const tsCliHooks programCliHooks =
+    {
+        .configApply = configApply,
+#if METRICS_ENABLE
+        .uptimeMs    = programUptimeMs,
+#endif
+#if LATENCY_ENABLE
+        .latency     = &programLatency,
+#endif
+#if TUNE_ENABLE
+        .tune        = &programTune,
+#endif
+};
+#endif
+
+#if BENCH_ENABLE
+/**< Program hooks without the program timer and sleep, the benchmark steps the engine itself */
+static const tsPhaseHooks programBenchHooks =
+    {
+        .timerStart   = programBenchTimerStart,
+        .scanStart    = programScanStart,
+        .scanStop     = programScanStop,
+        .advStart     = programAdvStart,
+        .advStop      = programAdvStop,
+        .phaseChanged = programPhaseChanged,
+#if RENDEZVOUS_ENABLE || BACKOFF_ENABLE || SLOT_ENABLE
+        .timingAdjust  = programTimingAdjust,
+#endif
+#if RENDEZVOUS_ENABLE
+        .scanScheduled = programScanScheduled,
+#endif
+};
+
+static tsPhaseEngine programBenchEngine;
+static ble_evt_t programBenchEvent;
+static uint8_t programBenchPayload[BENCH_ADV_SIZE_MAX];
+
+/**< Kernels bound to the SoftDevice, target only (bench.c has the core kernels) */
+static const tsBenchKernel programBenchKernels[] =
+    {
+        //  name               run                   prepare                   context              first               last                step
+        {"bleEventHandler",  programBenchEventRun, programBenchEventPrepare, NULL,                BENCH_ADV_SIZE_MIN, BENCH_ADV_SIZE_MAX, BENCH_ADV_SIZE_STEP},
+        {"bleAdvUpdateData", programBenchAdvRun,   programBenchAdvPrepare,   NULL,                BENCH_ADV_SIZE_MIN, BENCH_ADV_SIZE_MAX, BENCH_ADV_SIZE_STEP},
+        {"bleScanStart",     programBenchScanRun,  programBenchScanPrepare,  NULL,                0,                  0,                  0},
+        {"phaseHandlers",    programBenchPhaseRun, programBenchPhasePrepare, &programBenchEngine, eModeScanning,      eModeAdvertising,   1},
+};
+#endif
 
 /**
  * @brief Function for application main entry.
  */
 int main(void)
 {
+#if BOOT_PROFILE_ENABLE
+    bootProfInit();
+#endif
+    configStoreLoad();
+    programRole = runtimeConfig.role;
+
+#if DEEP_SLEEP_ENABLE
+    bool warmBoot = (programRole == eRoleSlave) && deepSleepResume(&programParams);
+#endif
+    BOOT_PROF_MARK(eBootStageConfig);
+
     // Initialize.
     boardInit();
+#if (BACKOFF_ENABLE && BACKOFF_KICK_BUTTON_ENABLE) || SCHEDULE_ENABLE
+    buttons_init(bspEventHandler);
+#endif
+    BOOT_PROF_MARK(eBootStageBoard);
+#if CPU_MONITOR_LEVEL
+    cpuMonInit();
+#endif
     createTimers();
+    phaseEngineInit(&programEngine, programRole, &programParams, &programHooks, NULL);
+    configApply();
+#if BOOT_FAST_START
+    programEngine.timings[ePhaseTimingInit] = 0; // First scan right after the program timer is armed
+#endif
+#if SCANNING_ENABLE
+    APP_ERROR_CHECK(recPoolInit());
+#endif
+#if ADV_QUEUE_ENABLE
+    advQueueInit(advReportProcess);
+#endif
+#if CAPTURE_ENABLE
+    captureInit();
+#endif
+    BOOT_PROF_MARK(eBootStageEngine);
 
 #if BLE_ENABLE
     //BLEParams.bleEventHandler = bleEventHandler;
-    BLEParams.gatt           = &gattModule;
-    bleScanParams.scanModule = &bleScanModule;
-    bleScanParams.scanParam  = bleGapScanParams;
+    BLEParams.gatt             = &gattModule;
+    BLEParams.gattEventHandler = gattEventHandler;
+#if SCANNING_ENABLE
+    bleScanParams.scanModule   = &bleScanModule;
+#endif
 
     ble_params_init(&BLEParams);
     ble_stack_init(&BLEParams);
+    APP_ERROR_CHECK(configStoreInit());
+    {
+        ble_gap_addr_t addr;
+
+        APP_ERROR_CHECK(sd_ble_gap_addr_get(&addr));
+        memcpy(programAddr, addr.addr, sizeof(programAddr));
+    }
+#if METRICS_ENABLE
+    metricsInit(programRole, programAddr, programMetricsSample);
+#endif
+#if LATENCY_ENABLE
+    latencyInit(&programLatency, programAddr);
+#endif
+#if CLI_ENABLE
+    APP_ERROR_CHECK(cliInit(programRole, &programCliHooks));
+#endif
     NRF_SDH_BLE_OBSERVER(m_ble_observer, APP_BLE_OBSERVER_PRIO, bleEventHandler, NULL);
+    BOOT_PROF_MARK(eBootStageSoftDevice);
 
-    gap_params_init(DEVICE_NAME);
-    gattInit(&BLEParams);
+    gap_params_init((programRole == eRoleMaster) ? DEVICE_NAME_MASTER : DEVICE_NAME_SLAVE);
+    BOOT_PROF_MARK(eBootStageGap);
 
-#if ADVERTISEMENT_ENABLE
-    advertising_init(&BLEParams);
+#if !BOOT_FAST_START
+    bleDeferredInit();
 #endif
 
 #if SCANNING_ENABLE
     bleScanInit(&bleScanParams);
 #endif
+    BOOT_PROF_MARK(eBootStageScanInit);
+
+#if ENERGY_ACCOUNTING_ENABLE
+    APP_ERROR_CHECK(energyInit());
+#endif
+#if SENSOR_ENABLE
+    if (programRole == eRoleSlave)
+    {
+        APP_ERROR_CHECK(sensorInit());
+    }
+#endif
 
 #endif
-    startTimers();
+#if BENCH_ENABLE
+    programBenchRun(); // Benchmark build, the program is not started
+#else
+    phaseEngineStart(&programEngine);
+#endif
+    BOOT_PROF_MARK(eBootStageEngineStart);
 
     NRF_LOG_INFO("Program started.");
+    NRF_LOG_INFO("Capabilities: observer %d, extended adv %d, coded PHY %d, links %d/%d.", CAPS_OBSERVER, CAPS_EXTENDED_ADV,
+                 CAPS_CODED_PHY, CAPS_PERIPHERAL_LINKS, CAPS_CENTRAL_LINKS);
+    NRF_LOG_INFO("Configuration: %s", (configStoreStatsGet()->source == eConfigSourceFlash) ? "flash" : "defaults");
+#if DEEP_SLEEP_ENABLE
+    if (warmBoot)
+    {
+        NRF_LOG_INFO("Resumed from deep sleep.");
+    }
+#endif
     
     // Enter main loop. This is for power management. 
     for (;;)
@@ -209,351 +481,832 @@ static void timerCBRefreshAdvData()
 }
 
 
-#if MASTER_ENABLE
 /**
- * @brief Master Program Handler
+ * @brief Program Handler
  *      
- * @details Master program is always in a loop of scanning in duration of SCAN_TIMEOUT and advertising in duration of ADVERTISEMENT_TIMEOUT.
- * 
+ * @details Master and slave programs are driven by the phase engine transition tables (phaseengine.c),
+ *          this timer callback takes the next transition when the duration of the current phase is over.
  */
-static void tcbProgramMasterHandler()
+static void tcbProgramHandler(void *p_context)
+{
+    CPU_MON_START();
+    phaseEngineStep(&programEngine);
+    CPU_MON_STOP(eCpuSiteTimerProgram);
+}
+
+/**@brief Phase engine hook, arms the program timer */
+static void programTimerStart(void *context, uint32_t duration)
+{
+    uint32_t ticks = MAX(APP_TIMER_TICKS(duration), APP_TIMER_MIN_TIMEOUT_TICKS);
+
+    APP_ERROR_CHECK(app_timer_start(timerProgram, ticks, NULL));
+}
+
+#if SCANNING_ENABLE
+/**@brief Phase engine hook, starts scanning */
+static void programScanStart(void *context)
 {
     ret_code_t errCode;
-    ///> TX Power Lever Supported: -40dBm, -20dBm, -16dBm, -12dBm, -8dBm, -4dBm, 0dBm, +3dBm and +4dBm.
-    switch (programParams.programStatus)
+
+    if (!(BLEParams.bleAdvStatus == eBleScanning))
     {
-/****************************************************************************************************
-* 											    FIRST START
-*****************************************************************************************************/
-        case eModeFirstStart:
+        programScanStartUs     = programTimeUs(); // Before the first report can arrive
+        BLEParams.bleAdvStatus = eBleScanning;
+        errCode                = bleScanStart(&bleScanParams);
+        if (errCode != NRF_SUCCESS) // Not fatal, the phase runs without the radio, a scan without detections
         {
-            programParams.programStatus  = eModeScanning;
-            programParams.programCounter = 0;
-            app_timer_start(timerProgramMaster, APP_TIMER_TICKS(1000), NULL);
-#if JLINK_DEBUG_PRINT_ENABLE
-            printf("Program Started!\n");
-#endif
+            METRIC_INC(eMetricScanStartFailures);
+            NRF_LOG_INFO("Scan start failed, 0x%x.", errCode);
         }
-        break;
-/****************************************************************************************************
-* 											    FIRST START END
-*****************************************************************************************************/
-/****************************************************************************************************
-* 											    SLEEP
-*****************************************************************************************************/
-        case eModeSleep:
+        BOOT_PROF_MARK(eBootStageFirstScan);
+#if RENDEZVOUS_ENABLE
+        rendezvousScanStart(&programRendezvous, programTimeUs());
+#endif
+#if SCHEDULE_ENABLE
+        if (programRole == eRoleMaster)
         {
-            if(programParams.programCounter >= SLEEP_DURATION) // Sleeping Timeout... Mode Changing to Scanning Mode... 
-            {
-                programParams.programStatus = eModeScanning; // eModeScanning
-                programParams.programCounter = 0;
-                app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_TASK_SWITCH_MODE_INTERVAL), NULL);
-
-            }
-            else // Sleeping...
-            {
-                programParams.programCounter += TCB_PROGRAM_SLEEP_MODE_INTERVAL;
-                programParams.programStatus = eModeSleep;
-                app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_SLEEP_MODE_INTERVAL), NULL);                
-            }
+            programScheduleMeasure();
         }
-        break;
-/****************************************************************************************************
-* 											    SLEEP END
-*****************************************************************************************************/
-    
-/****************************************************************************************************
-* 											    SCANNING
-*****************************************************************************************************/
-        case eModeScanning:
-        {
-            if (programParams.programCounter >= SCAN_TIMEOUT) // Scanning Timeout... Mode Changing to Advertisement....
-            {
-                bleScanStop(&bleScanParams);
-
-                BLEParams.bleAdvStatus       = eBleIdle;
-                programParams.programCounter = 0;
-                programParams.programStatus  = eModeAdvertising;
-                app_timer_start(timerProgramMaster, APP_TIMER_TICKS(TCB_PROGRAM_TASK_SWITCH_MODE_INTERVAL), NULL);
+#endif
+        programScheduleFresh = false;
+        programDetectSeen    = false;
+#if DEEP_SLEEP_ENABLE
+        deepSleepScanStarted();
+#endif
+    }
+    BLEParams.bleAdvStatus = eBleScanning;
 
 #if JLINK_DEBUG_PRINT_ENABLE
-                printf("Scanning Timeout!\n");
+    printf("Scanning...\n");
 #endif
 
 #if LED_INDICATORS_ENABLE
-                bsp_board_led_off(SCANNING_LED);
+    bsp_board_led_on(SCANNING_LED);
 #endif
-            }
-            else // Scanning...
-            {
-                if (!(BLEParams.bleAdvStatus == eBleScanning))
-                {
-                    errCode = bleScanStart(&bleScanParams);
-                    APP_ERROR_CHECK(errCode);
-                }
-                BLEParams.bleAdvStatus = eBleScanning;
-                programParams.programCounter += TCB_PROGRAM_TASK_INTERVAL;
-                app_timer_start(timerProgramMaster, APP_TIMER_TICKS(TCB_PROGRAM_TASK_INTERVAL), NULL);
+}
 
-#if JLINK_DEBUG_PRINT_ENABLE
-                printf("Scanning...\n");
+/**@brief Phase engine hook, stops scanning */
+static void programScanStop(void *context)
+{
+    bleScanStop(&bleScanParams);
+    BLEParams.bleAdvStatus = eBleIdle;
+#if RENDEZVOUS_ENABLE
+    rendezvousScanEnd(&programRendezvous, programTimeUs());
 #endif
-
-#if LED_INDICATORS_ENABLE
-                bsp_board_led_on(SCANNING_LED);
+#if BACKOFF_ENABLE
+    backoffScanEnd(&programBackoff, programParams.deviceDetectionStatus == eDeviceDetected);
+#endif
+#if TUNE_ENABLE
+    if (programRole == eRoleSlave && tuneCycleEnd(&programTune, programParams.deviceDetectionStatus == eDeviceDetected))
+    {
+        programTuneApply(); // Before the engine arms the next phase
+    }
 #endif
-            }
-        }
-        break;
-/****************************************************************************************************
-* 											    SCANNING END
-*****************************************************************************************************/
 
-/****************************************************************************************************
-* 											    ADVERTISING
-*****************************************************************************************************/
-        case eModeAdvertising:
-        {
-            if (programParams.programCounter >= ADVERTISEMENT_TIMEOUT) // Advertising Timeout... Mode Changing to Scanning....
-            {
-                bleAdvertisingStop(&BLEParams);
-                BLEParams.bleAdvStatus       = eBleIdle;
-                programParams.programCounter = 0;
-                programParams.programStatus  = eModeScanning;
-                app_timer_start(timerProgramMaster, APP_TIMER_TICKS(TCB_PROGRAM_TASK_SWITCH_MODE_INTERVAL), NULL);
+    if (!bootDeferredDone)
+    {
+        bootFirstScanDone(); // Before advStart, advertising may not be initialized yet
+    }
 
 #if JLINK_DEBUG_PRINT_ENABLE
-                printf("Advertising Timeout!\n");
+    printf("Scanning Timeout!\n");
+#if ADV_QUEUE_ENABLE
+    advQueueReport();
 #endif
-
-#if LED_INDICATORS_ENABLE
-                bsp_board_led_off(ADVERTISEMENT_LED);
+    recPoolReport();
+#if CAPTURE_ENABLE
+    captureReport();
 #endif
-            }
-            else // Advertising...
-            {
-                errCode                = bleAdvUpdateData(&BLEParams, advertisingDataPacket2, sizeof(advertisingDataPacket2));
-                BLEParams.bleAdvStatus = eBleAdvertising;
-                programParams.programCounter += TCB_PROGRAM_TASK_INTERVAL;
-                app_timer_start(timerProgramMaster, APP_TIMER_TICKS(TCB_PROGRAM_TASK_INTERVAL), NULL);
-
-#if JLINK_DEBUG_PRINT_ENABLE
-                printf("Advertising...!\n");
+#if RENDEZVOUS_ENABLE
+    if (programRole == eRoleSlave && (programEngine.cycles % RENDEZVOUS_REPORT_INTERVAL_CYCLES) == 0)
+    {
+        rendezvousReport(&programRendezvous);
+    }
+#endif
+#if BACKOFF_ENABLE
+    if (programRole == eRoleSlave && programBackoff.misses > BACKOFF_THRESHOLD)
+    {
+        backoffReport(&programBackoff);
+    }
+#endif
+#if TUNE_ENABLE
+    if (programRole == eRoleSlave && (programEngine.cycles % TUNE_REPORT_INTERVAL_CYCLES) == 0)
+    {
+        tuneReport(&programTune);
+    }
+#endif
+#endif
+#if LATENCY_ENABLE && LATENCY_REPORT_INTERVAL_CYCLES
+    if (programRole == eRoleMaster && (programEngine.cycles % LATENCY_REPORT_INTERVAL_CYCLES) == 0)
+    {
+        latencyReport(&programLatency);
+    }
+#endif
+#if METRICS_ENABLE && METRICS_SNAPSHOT_INTERVAL_CYCLES
+    if ((programEngine.cycles % METRICS_SNAPSHOT_INTERVAL_CYCLES) == 0 && (!SCHEDULE_ENABLE || programRole == eRoleMaster))
+    {
+        metricsSnapshotPrint(programUptimeMs());
+#if SCHEDULE_ENABLE
+        programCommandPost(eProtoCmdMetrics); // Fleet snapshot, slaves print theirs when the command arrives
+#endif
+    }
 #endif
 
 #if LED_INDICATORS_ENABLE
-
-                bsp_board_led_on(ADVERTISEMENT_LED);
+    bsp_board_led_off(SCANNING_LED);
 #endif
-            }
-        }
-        break;
-/****************************************************************************************************
-* 											    ADVERTISING END
-*****************************************************************************************************/
-
-        default:
-            break;
-    }
 }
+#endif
 
-#else
-
-/**
- * @brief Slave Program Handler
- *      
- * @details Slave program starts with scanning mode in SCAN_TIMEOUT ms.
- *          If master device is detected in the environment program modes is changed to advertising(ADVERTISEMENT_TIMEOUT).
- *          if master device is not detected in the environment, program goes back to the sleep.(SLEEP_DURATION)
- *          After that program starts to scan again.
- * 
- * @warning FILTER_DEVICE_NAME_ENABLE has to be setted 1 for detecting master device.
- * 
- */
-static void tcbProgramSlaveHandler()
+/**@brief Phase engine hook, starts advertising with the current payload, slaves in their response slot */
+static void programAdvStart(void *context)
 {
-    ret_code_t errCode;
-    ///> TX Power Lever Supported: -40dBm, -20dBm, -16dBm, -12dBm, -8dBm, -4dBm, 0dBm, +3dBm and +4dBm.
-    switch (programParams.programStatus)
+#if SCHEDULE_ENABLE
+    if (programRole == eRoleMaster)
     {
-/****************************************************************************************************
-* 											    FIRST START
-*****************************************************************************************************/
-        case eModeFirstStart:
+        ret_code_t errCode;
+
+        if (programCommandCycles == 0)
         {
-            programParams.programStatus  = eModeScanning; // eModeScanning
-            programParams.programCounter = 0;
-            app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_INIT_DELAY), NULL);
-#if JLINK_DEBUG_PRINT_ENABLE
-            printf("Program Started!\n");
-#endif
+            programSchedule.command = eProtoCmdNone;
         }
-        break;
-
-/****************************************************************************************************
-* 											    FIRST START END
-*****************************************************************************************************/
-
-/****************************************************************************************************
-* 											    SLEEP
-*****************************************************************************************************/
-        case eModeSleep:
+        else
         {
-            if(programParams.programCounter >= SLEEP_DURATION) // Sleeping Timeout... Mode Changing to Scanning Mode... 
-            {
-                programParams.programStatus = eModeScanning; // eModeScanning
-                programParams.programCounter = 0;
-                app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_TASK_SWITCH_MODE_INTERVAL), NULL);
-
-            }
-            else // Sleeping...
-            {
-                programParams.programCounter += TCB_PROGRAM_SLEEP_MODE_INTERVAL;
-                programParams.programStatus = eModeSleep;
-                app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_SLEEP_MODE_INTERVAL), NULL);                
-            }
+            programCommandCycles--;
         }
-        break;
-/****************************************************************************************************
-* 											    SLEEP END
-*****************************************************************************************************/
-
-/****************************************************************************************************
-* 											    SCANNING
-*****************************************************************************************************/
-        case eModeScanning:
+#if SLOT_ENABLE
+        programSchedule.slots.framePosition = programSlotCycle % programSchedule.slots.frameCycles;
+        programSchedule.slots.seed          = slotSeedGet(programAddr, programSlotCycle / programSchedule.slots.frameCycles);
+        programSlotCycle++;
+#endif
+        errCode = bleAdvScanRspSet(&BLEParams, programScheduleBuffer, protoScheduleEncode(&programSchedule, programScheduleBuffer));
+        if (errCode != NRF_SUCCESS) // Not fatal, the previous schedule stays in the scan response
         {
-            if (programParams.programCounter >= SCAN_TIMEOUT) // Scanning Timeout... Mode Changing to Advertisement/Sleep....
-            {
-                bleScanStop(&bleScanParams);
+            METRIC_INC(eMetricAdvUpdateErrors);
+            NRF_LOG_INFO("Schedule update failed, 0x%x.", errCode);
+        }
+    }
+#endif
 
-                BLEParams.bleAdvStatus       = eBleIdle;
-                programParams.programCounter = 0;
+#if SLOT_ENABLE
+    if (programRole == eRoleSlave && programSlotPlan())
+    {
+        return; // Advertising starts in the response slot, tcbSlotHandler()
+    }
+#endif
+    programAdvertise();
+}
 
-                if(programParams.deviceDetectionStatus == eDeviceDetected) // if master device is detected in the environment during scanning...
-                {
-                    programParams.programStatus = eModeAdvertising;
-                    app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_TASK_SWITCH_MODE_INTERVAL), NULL);
-                    programParams.deviceDetectionStatus = eDeviceNotDetected; // Clear detection Status...
-                }
-                else // if master device is not detected in the environment during scanning...
-                {
-                    programParams.programStatus = eModeSleep; ///eModeSleep
-                    app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_TASK_SWITCH_MODE_INTERVAL), NULL);
-                }
+/**@brief Starts advertising with the current payload, sensor readings (slave), a latency ping (master) or echo (slave) when measuring */
+static void programAdvertise(void)
+{
+    ret_code_t errCode;
+    uint8_t *payload = advertisingDataPacket2;
+    uint8_t length   = sizeof(advertisingDataPacket2);
 
-#if JLINK_DEBUG_PRINT_ENABLE
-                printf("Scanning Timeout!\n");
+#if SENSOR_ENABLE
+    if (programRole == eRoleSlave)
+    {
+        payload = programSensorBuffer;
+        length  = sensorPayloadGet(programSensorBuffer); // Latest readings, packed for this advertising phase
+    }
 #endif
 
-#if LED_INDICATORS_ENABLE
-                bsp_board_led_off(SCANNING_LED);
+#if LATENCY_ENABLE
+    tsProtoProbe probe;
+
+    if (programRole == eRoleMaster)
+    {
+        latencyPingNext(&programLatency, programTimeUs(), &probe);
+        payload = programProbeBuffer;
+        length  = protoProbeEncode(&probe, programProbeBuffer);
+    }
+    else if (latencyEchoGet(&programLatency, &probe))
+    {
+        payload = programProbeBuffer;
+        length  = protoProbeEncode(&probe, programProbeBuffer);
+    }
 #endif
-            }
-            else // Scanning...
-            {
-                if (!(BLEParams.bleAdvStatus == eBleScanning))
-                {
-                    errCode = bleScanStart(&bleScanParams);
-                    APP_ERROR_CHECK(errCode);
-                }
-                BLEParams.bleAdvStatus = eBleScanning;
-                programParams.programCounter += TCB_PROGRAM_TASK_INTERVAL;
-                app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_TASK_INTERVAL), NULL);
+
+    errCode = bleAdvUpdateData(&BLEParams, payload, length);
+    if (errCode != NRF_SUCCESS) // Not fatal, this advertising phase is skipped, the engine goes on
+    {
+        METRIC_INC(eMetricAdvUpdateErrors);
+        NRF_LOG_INFO("Advertising update failed, 0x%x.", errCode);
+        return;
+    }
 
 #if JLINK_DEBUG_PRINT_ENABLE
-                printf("Scanning...\n");
+    printf("Advertising...!\n");
 #endif
 
 #if LED_INDICATORS_ENABLE
-                bsp_board_led_on(SCANNING_LED);
+    bsp_board_led_on(ADVERTISEMENT_LED);
 #endif
-            }
-        }
-        break;
-
-/****************************************************************************************************
-* 											    SCANNING END
-*****************************************************************************************************/
-
-/****************************************************************************************************
-* 											    ADVERTISING
-*****************************************************************************************************/
-        case eModeAdvertising:
-        {
-            if (programParams.programCounter >= ADVERTISEMENT_TIMEOUT) // Advertising Timeout... Mode Changing to Scanning....
-            {
-                bleAdvertisingStop(&BLEParams);
-                BLEParams.bleAdvStatus       = eBleIdle;
-                programParams.programCounter = 0;
-                programParams.programStatus  = eModeScanning; // eModeScanning
-                app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_TASK_SWITCH_MODE_INTERVAL), NULL);
+}
 
-#if JLINK_DEBUG_PRINT_ENABLE
-                printf("Advertising Timeout!\n");
+/**@brief Phase engine hook, stops advertising */
+static void programAdvStop(void *context)
+{
+#if SLOT_ENABLE
+    APP_ERROR_CHECK(app_timer_stop(timerSlot));
 #endif
-
-#if LED_INDICATORS_ENABLE
-                bsp_board_led_off(ADVERTISEMENT_LED);
+    bleAdvertisingStop(&BLEParams);
+    BLEParams.bleAdvStatus = eBleIdle;
+#if !SCANNING_ENABLE
+    if (!bootDeferredDone)
+    {
+        bootFirstScanDone(); // No scan phase, boot report after the first advertising phase
+    }
 #endif
-            }
-            else // Advertising...
-            {
-                errCode                = bleAdvUpdateData(&BLEParams, advertisingDataPacket2, sizeof(advertisingDataPacket2));
-                BLEParams.bleAdvStatus = eBleAdvertising;
-                programParams.programCounter += TCB_PROGRAM_TASK_INTERVAL;
-                app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_TASK_INTERVAL), NULL);
 
 #if JLINK_DEBUG_PRINT_ENABLE
-                printf("Advertising...!\n");
+    printf("Advertising Timeout!\n");
+#if SENSOR_ENABLE
+    if (programRole == eRoleSlave && (programEngine.cycles % SENSOR_REPORT_INTERVAL_CYCLES) == 0)
+    {
+        sensorReport();
+    }
+#endif
 #endif
 
 #if LED_INDICATORS_ENABLE
-
-                bsp_board_led_on(ADVERTISEMENT_LED);
+    bsp_board_led_off(ADVERTISEMENT_LED);
 #endif
-            }
-        }
-        break;
-/****************************************************************************************************
-* 											    ADVERTISING END 
-*****************************************************************************************************/
+}
 
-        default:
-            break;
+/**@brief Phase engine hook, long sleeps go to deep sleep */
+static void programSleepStart(void *context, uint32_t duration)
+{
+#if DEEP_SLEEP_ENABLE
+    if (duration >= DEEP_SLEEP_THRESHOLD_MS && !(STREAM_ENABLE && streamConnected(&programStream)) &&
+        !(HARVEST_ENABLE && harvestLinkCountGet(&programHarvest) != 0)) // System OFF drops the links
+    {
+        deepSleepEnter(&programParams, duration);
     }
+#endif
 }
 
+/**@brief Phase engine hook, sleep is over */
+static void programSleepStop(void *context)
+{
+#if DEEP_SLEEP_ENABLE
+    deepSleepExit();
 #endif
+}
 
-/**@brief Create App Timer Objects */
-void createTimers()
+/**@brief Phase engine hook, phase accounting */
+static void programPhaseChanged(void *context, uint8_t from, uint8_t to)
 {
-    ret_code_t errCode;
-//errCode = app_timer_create(&timerRefreshAdvDataBLE, APP_TIMER_MODE_REPEATED, timerCBRefreshAdvData);
-#if MASTER_ENABLE
-    errCode = app_timer_create(&timerProgramMaster, APP_TIMER_MODE_SINGLE_SHOT, tcbProgramMasterHandler);
-    NRF_LOG_INFO(" Program Started as Master!");
-#else
-    errCode = app_timer_create(&timerProgramSlave, APP_TIMER_MODE_SINGLE_SHOT, tcbProgramSlaveHandler);
-    NRF_LOG_INFO(" Program Started as Slave!");
-    APP_ERROR_CHECK(errCode);
+#if METRICS_ENABLE
+    static uint32_t phaseStartUs = 0;
+    uint32_t now                 = programTimeUs();
+
+    switch (from)
+    {
+        case eModeScanning:
+            METRIC_SET(eMetricScanUs, now - phaseStartUs);
+            break;
+        case eModeAdvertising:
+            METRIC_SET(eMetricAdvUs, now - phaseStartUs);
+            break;
+        case eModeSleep:
+            METRIC_SET(eMetricSleepUs, now - phaseStartUs);
+            break;
+        default:
+            break;
+    }
+    phaseStartUs = now;
+#endif
+#if ENERGY_ACCOUNTING_ENABLE
+    energyPhaseSet(to);
+#endif
+#if CPU_MONITOR_LEVEL
+    cpuMonPhaseSet(to);
+#endif
+}
+
+/**
+ * @brief Phase engine hook, slave scan and sleep durations
+ * 
+ * @details Advertising lasts up to the end of the response slot (slot.c). Sleep is stretched by the
+ *          backoff while the master is absent (backoff.c). Sleeps end right
+ *          before a predicted master advertising event and the following scan only covers that event
+ *          (rendezvous.c). Blind search uses the engine timings.
+ */
+#if RENDEZVOUS_ENABLE || BACKOFF_ENABLE || SLOT_ENABLE
+static uint32_t programTimingAdjust(void *context, uint8_t state, uint32_t duration)
+{
+    if (programRole != eRoleSlave)
+    {
+        return duration;
+    }
+
+    switch (state)
+    {
+        case eModeScanning:
+#if RENDEZVOUS_ENABLE
+            duration = rendezvousScanDurationGet(&programRendezvous, duration);
+#endif
+            break;
+        case eModeAdvertising:
+#if SLOT_ENABLE
+            duration = (programSlotDuration != 0) ? programSlotDuration : duration;
 #endif
+            break;
+        case eModeSleep:
+#if BACKOFF_ENABLE
+            duration = backoffSleepGet(&programBackoff);
+#endif
+#if RENDEZVOUS_ENABLE
+            duration = rendezvousSleepDurationGet(&programRendezvous, programTimeUs(), duration);
+#endif
+            break;
+        default:
+            break;
+    }
+    return duration;
 }
+#endif
 
+#if (BACKOFF_ENABLE && BACKOFF_KICK_BUTTON_ENABLE) || SCHEDULE_ENABLE
+/**
+ * @brief Fast re-acquire on an external event: backoff window and end of the current sleep
+ * 
+ * @details Runs in app_timer interrupt context (button debounce), same as the program timer.
+ */
+static void programKick(void)
+{
+#if BACKOFF_ENABLE
+    backoffKick(&programBackoff);
+    if (programRole == eRoleSlave && programParams.programStatus == eModeSleep)
+    {
+        APP_ERROR_CHECK(app_timer_stop(timerProgram));
+        programTimerStart(NULL, 0); // Sleep is over on the next tick
+    }
+#endif
+}
 
-/**@brief Starts App Timers*/
-void startTimers()
+/**@brief BSP events, button 0 starts a fast re-acquire window (slave) or sends a report command (master) */
+static void bspEventHandler(bsp_event_t event)
+{
+    switch (event)
+    {
+        case BSP_EVENT_KEY_0:
+            if (programRole == eRoleMaster)
+            {
+#if SCHEDULE_ENABLE
+                programCommandPost(eProtoCmdReport);
+#endif
+            }
+            else
+            {
+                programKick();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+#endif
+
+#if SCHEDULE_ENABLE
+/**
+ * @brief Master cycle measurement for the published schedule, called at every master scan start
+ * 
+ * @details The nominal cycle (scan + advertising timeout) misses timer latency and transition processing,
+ *          slaves lock on the measured one.
+ */
+static void programScheduleMeasure(void)
+{
+    static uint32_t lastStart = 0;
+    static bool started       = false;
+    uint32_t now              = programTimeUs();
+
+    if (started)
+    {
+        programSchedule.period += (int32_t)(now - lastStart - programSchedule.period) / SCHEDULE_PERIOD_AVERAGING;
+    }
+    started   = true;
+    lastStart = now;
+}
+
+/**
+ * @brief Master command for the slaves, carried in the schedule for SCHEDULE_COMMAND_CYCLES cycles
+ * 
+ * @param command teProtoCommands
+ */
+static void programCommandPost(uint8_t command)
+{
+    programSchedule.command = command;
+    programSchedule.sequence++;
+    programCommandCycles = SCHEDULE_COMMAND_CYCLES;
+}
+
+/**
+ * @brief Master schedule in the manufacturer specific data of an advertising report (master scan response)
+ *
+ * @details The scan response has no name, only the address of the master detected by the name filter is
+ *          taken.
+ */
+static void programScheduleParse(tsAdvRecord const *record)
+{
+    tsProtoSchedule schedule;
+    uint16_t offset = record->manufOffset;
+    uint16_t length = record->manufLength;
+
+    if (!programMasterKnown || memcmp(record->addr, programMasterAddr, BLE_GAP_ADDR_LEN) != 0)
+    {
+        return;
+    }
+    if (length <= 2 || (record->data[offset] | (record->data[offset + 1] << 8)) != APP_COMPANY_IDENTIFIER)
+    {
+        return;
+    }
+    if (protoScheduleDecode(&record->data[offset + 2], (uint8_t)(length - 2), &schedule))
+    {
+        programScheduleReceived(&schedule);
+    }
+}
+#endif
+
+#if LATENCY_ENABLE
+/**@brief Latency probe in the manufacturer specific data of an advertising report, pings for slaves, echoes for the master */
+static void programProbeParse(tsAdvRecord const *record)
+{
+    tsProtoProbe probe;
+    uint16_t offset = record->manufOffset;
+    uint16_t length = record->manufLength;
+
+    if (length <= 2 || (record->data[offset] | (record->data[offset + 1] << 8)) != APP_COMPANY_IDENTIFIER ||
+        !protoProbeDecode(&record->data[offset + 2], (uint8_t)(length - 2), &probe))
+    {
+        return;
+    }
+
+    if (programRole == eRoleSlave)
+    {
+        latencyPingReceived(&programLatency, &probe, record->addr);
+    }
+    else if (latencyEchoReceived(&programLatency, &probe, record->addr, programTimestampUs(record->timestamp)))
+    {
+        METRIC_INC(eMetricEchoes);
+    }
+}
+#endif
+
+#if SENSOR_ENABLE && SCANNING_ENABLE
+/**@brief Master, slave sensor readings in the manufacturer specific data of an advertising report */
+static void programSensorParse(tsAdvRecord const *record)
+{
+    tsProtoSensor sensor;
+    uint16_t offset = record->manufOffset;
+    uint16_t length = record->manufLength;
+
+    if (programRole != eRoleMaster || length <= 2 ||
+        (record->data[offset] | (record->data[offset + 1] << 8)) != APP_COMPANY_IDENTIFIER ||
+        !protoSensorDecode(&record->data[offset + 2], (uint8_t)(length - 2), &sensor))
+    {
+        return;
+    }
+
+#if JLINK_DEBUG_PRINT_ENABLE
+    printf("SENSOR_RX,addr=%02x%02x,reading=%u,previous=%u\n\r", record->addr[1], record->addr[0],
+           sensor.readings[0], sensor.readings[1]);
+#endif
+}
+#endif
+
+#if SCHEDULE_ENABLE
+/**
+ * @brief Slave, master schedule received
+ * 
+ * @details The published master cycle is handed to the rendezvous, the slot map is used for the response
+ *          of this cycle, commands are executed once per sequence. A schedule with a master cycle out of
+ *          the period tolerance is dropped.
+ */
+static void programScheduleReceived(tsProtoSchedule const *schedule)
+{
+#if RENDEZVOUS_ENABLE
+    if (!rendezvousPeriodPublished(&programRendezvous, schedule->period))
+    {
+        return;
+    }
+#endif
+    programSchedule.period = schedule->period;
+    programSchedule.slots  = schedule->slots;
+    programScheduleFresh   = true;
+
+    if (schedule->sequence == programSchedule.sequence)
+    {
+        return;
+    }
+    programSchedule.sequence = schedule->sequence;
+    programSchedule.command  = schedule->command;
+
+    switch (schedule->command)
+    {
+#if RENDEZVOUS_ENABLE
+        case eProtoCmdReport:
+            rendezvousReport(&programRendezvous);
+            break;
+
+        case eProtoCmdResync:
+            rendezvousReset(&programRendezvous);
+            break;
+#endif
+#if METRICS_ENABLE
+        case eProtoCmdMetrics:
+            metricsSnapshotPrint(programUptimeMs());
+            break;
+#endif
+
+        default:
+            break;
+    }
+}
+#endif
+
+#if SLOT_ENABLE
+/**
+ * @brief Slave, response slot of the current master cycle
+ * 
+ * @return true advertising is left to the slot timer, or skipped when the slot is in another cycle of the frame
+ * 
+ * @details Slots are counted from the earliest master report of the scan, with rendezvous windows that
+ *          is the first master advertising event. Without a slot map of this cycle the slave answers
+ *          right away as before.
+ */
+static bool programSlotPlan(void)
+{
+    uint32_t delay;
+    uint32_t elapsed;
+
+    programSlotDuration = 0;
+    if (!programScheduleFresh || !programDetectSeen || programSchedule.slots.count == 0)
+    {
+        return false;
+    }
+
+    if (!slotDelayGet(&programSchedule.slots, programAddr, &delay))
+    {
+        programSlotDuration = 1; // Not in this cycle, advertising phase is skipped
+        return true;
+    }
+
+    elapsed             = (programTimeUs() - programDetectFirstUs) / 1000;
+    delay               = (delay > elapsed) ? delay - elapsed : 0;
+    programSlotDuration = delay + programSchedule.slots.length; // One advertising event, interval > slot
+    if (delay == 0)
+    {
+        return false;
+    }
+
+    APP_ERROR_CHECK(app_timer_start(timerSlot, MAX(APP_TIMER_TICKS(delay), APP_TIMER_MIN_TIMEOUT_TICKS), NULL));
+    return true;
+}
+
+/**@brief Response slot of the slave starts */
+static void tcbSlotHandler(void *p_context)
+{
+    programAdvertise();
+}
+#endif
+
+/**@brief nrf_ble_gatt events, negotiated ATT MTU and data length of the streaming link */
+static void gattEventHandler(nrf_ble_gatt_t *gatt, nrf_ble_gatt_evt_t const *gattEvent)
+{
+#if STREAM_ENABLE
+    streamGattEventHandler(&programStream, gattEvent);
+#endif
+#if HARVEST_ENABLE
+    harvestGattEventHandler(&programHarvest, gattEvent);
+#endif
+}
+
+#if RENDEZVOUS_ENABLE
+/**@brief Phase engine hook, slave sleeps after advertising when the next scan is scheduled */
+static bool programScanScheduled(void *context)
+{
+    return programRole == eRoleSlave && rendezvousLocked(&programRendezvous);
+}
+#endif
+
+/**
+ * @brief Free running tick count, extended from the 24 bit app_timer counter
+ * 
+ * @details Has to be called at least once per RTC overflow (1024 s), every scan does.
+ */
+static uint64_t programTicks(void)
+{
+    static uint32_t lastTicks  = 0;
+    static uint64_t totalTicks = 0;
+    uint64_t total;
+
+    // Called from the app_timer interrupt and from the main loop
+    CRITICAL_REGION_ENTER();
+    uint32_t ticks = app_timer_cnt_get();
+    totalTicks += app_timer_cnt_diff_compute(ticks, lastTicks);
+    lastTicks = ticks;
+    total     = totalTicks;
+    CRITICAL_REGION_EXIT();
+
+    return total;
+}
+
+/**@brief Free running us clock for the rendezvous */
+static uint32_t programTimeUs(void)
+{
+    return (uint32_t)(programTicks() * 1000000 / PROGRAM_TICK_FREQUENCY);
+}
+
+#if SCANNING_ENABLE
+/**@brief app_timer timestamp (e.g. of an advertising report) on the programTimeUs() clock */
+static uint32_t programTimestampUs(uint32_t ticks)
+{
+    uint32_t now = programTimeUs();
+
+    return now - (uint32_t)((uint64_t)app_timer_cnt_diff_compute(app_timer_cnt_get(), ticks) * 1000000 / PROGRAM_TICK_FREQUENCY);
+}
+#endif
+
+/**
+ * @brief Runtime configuration (configstore) overrides the compiled phase timings, scan window and
+ *        advertising interval
+ *
+ * @details Also called by the console (cli.c) after a change, the rendezvous estimate and the backoff
+ *          restart with the new timings.
+ */
+static void configApply(void)
+{
+    programEngine.timings[ePhaseTimingScan]  = runtimeConfig.scanTimeout;
+    programEngine.timings[ePhaseTimingAdv]   = runtimeConfig.advTimeout;
+    programEngine.timings[ePhaseTimingSleep] = runtimeConfig.sleepDuration;
+    programSchedule.period                   = (runtimeConfig.scanTimeout + runtimeConfig.advTimeout) * 1000;
+    programSchedule.slots.frameCycles        = SLOT_FRAME_CYCLES;
+
+#if SLOT_ENABLE
+    programSchedule.slots.count  = SLOT_COUNT;
+    programSchedule.slots.length = SLOT_LENGTH_MS;
+    programSchedule.slots.offset = SLOT_OFFSET_MS;
+#endif
+
+#if BACKOFF_ENABLE
+    tsBackoffConfig backoffConfig =
+        {
+            .baseSleep  = runtimeConfig.sleepDuration,
+            .ceiling    = BACKOFF_CEILING_MS,
+            .multiplier = BACKOFF_MULTIPLIER_Q8,
+            .step       = BACKOFF_STEP_MS,
+            .threshold  = BACKOFF_THRESHOLD,
+            .kickSleep  = BACKOFF_KICK_SLEEP_MS,
+            .kickCycles = BACKOFF_KICK_CYCLES,
+        };
+    backoffInit(&programBackoff, &backoffConfig);
+#endif
+
+#if RENDEZVOUS_ENABLE
+    tsRendezvousConfig config =
+        {
+            .period          = (runtimeConfig.scanTimeout + runtimeConfig.advTimeout) * 1000, // Master cycle
+            .jitter          = RENDEZVOUS_JITTER_MS * 1000,
+            .guard           = RENDEZVOUS_GUARD_MS * 1000,
+            .periodTolerance = RENDEZVOUS_PERIOD_TOLERANCE_US,
+            .syncTolerance   = RENDEZVOUS_SYNC_TOLERANCE_US,
+            .maxMisses       = RENDEZVOUS_MAX_MISSES,
+        };
+    rendezvousInit(&programRendezvous, &config);
+#endif
+
+#if BLE_ENABLE
+#if SCANNING_ENABLE
+    bleScanParams.scanParam        = bleGapScanParams; // Applied by the next bleScanStart()
+    bleScanParams.scanParam.window = MAX(bleGapScanParams.interval * runtimeConfig.scanDuty / 100, BLE_GAP_SCAN_WINDOW_MIN);
+#endif
+#if ADVERTISEMENT_ENABLE
+    BLEParams.m_adv_params.interval = MSEC_TO_UNITS(runtimeConfig.minAdvInterval, UNIT_0_625_MS); // Applied by bleAdvUpdateData()
+#endif
+#endif
+
+#if TUNE_ENABLE
+    if (programRole == eRoleSlave)
+    {
+        tsTuneConfig tuneConfig =
+            {
+                .latency        = TUNE_LATENCY_MS,
+                .budget         = TUNE_BUDGET_UA,
+                .scanMin        = TUNE_SCAN_MIN_MS,
+                .scanMax        = TUNE_SCAN_MAX_MS,
+                .scanStep       = TUNE_SCAN_STEP_MS,
+                .dutyMin        = TUNE_DUTY_MIN,
+                .dutyMax        = TUNE_DUTY_MAX,
+                .dutyStep       = TUNE_DUTY_STEP,
+                .sleepMin       = TUNE_SLEEP_MIN_MS,
+                .sleepMax       = TUNE_SLEEP_MAX_MS,
+                .advIntervalMin = TUNE_ADV_INTERVAL_MIN_MS,
+                .advIntervalMax = TUNE_ADV_INTERVAL_MAX_MS,
+                .advPhase       = runtimeConfig.advTimeout,
+                .loadHigh       = TUNE_LOAD_HIGH,
+                .loadLow        = TUNE_LOAD_LOW,
+                .period         = TUNE_PERIOD_CYCLES,
+                .hysteresis     = TUNE_HYSTERESIS_PERCENT,
+                .absentMisses   = TUNE_ABSENT_MISSES,
+            };
+        tsTuneSettings tuneStart =
+            {
+                .scan        = runtimeConfig.scanTimeout,
+                .duty        = runtimeConfig.scanDuty,
+                .sleep       = runtimeConfig.sleepDuration,
+                .advInterval = runtimeConfig.minAdvInterval,
+            };
+
+        tuneInit(&programTune, &tuneConfig, &tuneStart);
+        programTuneApply(); // Configuration clamped to the tuner bounds
+    }
+#endif
+}
+
+#if TUNE_ENABLE
+/**@brief Slave tuner settings to the engine timings, backoff, scan window and advertising interval, used when next armed or started */
+static void programTuneApply(void)
+{
+    tsTuneSettings const *settings = &programTune.settings;
+
+    programEngine.timings[ePhaseTimingScan]  = settings->scan;
+    programEngine.timings[ePhaseTimingSleep] = settings->sleep;
+#if BACKOFF_ENABLE
+    backoffBaseSleepSet(&programBackoff, settings->sleep);
+#endif
+#if BLE_ENABLE
+    bleScanParams.scanParam.window = MAX(bleGapScanParams.interval * settings->duty / 100, BLE_GAP_SCAN_WINDOW_MIN);
+#if ADVERTISEMENT_ENABLE
+    BLEParams.m_adv_params.interval = MSEC_TO_UNITS(settings->advInterval, UNIT_0_625_MS);
+#endif
+#endif
+}
+#endif
+
+/**@brief GATT and advertising init, not needed for scanning */
+static void bleDeferredInit(void)
+{
+#if BLE_ENABLE
+    gattInit(&BLEParams);
+#if STREAM_ENABLE
+    APP_ERROR_CHECK(streamInit(&programStream));
+#endif
+#if HARVEST_ENABLE
+    APP_ERROR_CHECK(harvestInit(&programHarvest));
+#endif
+    BOOT_PROF_MARK(eBootStageGatt);
+
+#if ADVERTISEMENT_ENABLE
+    advertising_init(&BLEParams);
+    BLEParams.m_adv_params.interval = MSEC_TO_UNITS(runtimeConfig.minAdvInterval, UNIT_0_625_MS); // Applied by bleAdvUpdateData()
+#endif
+    BOOT_PROF_MARK(eBootStageAdvertising);
+#endif
+}
+
+/**
+ * @brief End of the first scan window, deferred init (BOOT_FAST_START) and boot report
+ * 
+ */
+static void bootFirstScanDone(void)
+{
+    bootDeferredDone = true;
+
+#if BOOT_FAST_START
+    boardInitDeferred();
+    bleDeferredInit();
+    BOOT_PROF_MARK(eBootStageDeferred);
+#endif
+
+#if BOOT_PROFILE_ENABLE && JLINK_DEBUG_PRINT_ENABLE
+    bootProfReport();
+#endif
+}
+
+/**@brief Create App Timer Objects */
+void createTimers()
 {
     ret_code_t errCode;
-    //errCode = app_timer_start(timerRefreshAdvDataBLE,   APP_TIMER_TICKS(ADVERTISEMENT_PACKET_UPDATE_INTERVAL), NULL);
-#if MASTER_ENABLE
-    errCode = app_timer_start(timerProgramMaster, APP_TIMER_TICKS(TCB_PROGRAM_TASK_INTERVAL), NULL);
-#else
-    errCode = app_timer_start(timerProgramSlave, APP_TIMER_TICKS(TCB_PROGRAM_TASK_INTERVAL), NULL);
+//errCode = app_timer_create(&timerRefreshAdvDataBLE, APP_TIMER_MODE_REPEATED, timerCBRefreshAdvData);
+    errCode = app_timer_create(&timerProgram, APP_TIMER_MODE_SINGLE_SHOT, tcbProgramHandler);
+    APP_ERROR_CHECK(errCode);
+#if SLOT_ENABLE
+    errCode = app_timer_create(&timerSlot, APP_TIMER_MODE_SINGLE_SHOT, tcbSlotHandler);
     APP_ERROR_CHECK(errCode);
-
 #endif
+
+    if (programRole == eRoleMaster)
+    {
+        NRF_LOG_INFO(" Program Started as Master! (%d bytes transition table)", phaseEngineTableSizeGet(programRole));
+    }
+    else
+    {
+        NRF_LOG_INFO(" Program Started as Slave! (%d bytes transition table)", phaseEngineTableSizeGet(programRole));
+    }
 }
 
 
@@ -563,192 +1316,335 @@ void startTimers()
  * @param p_ble_evt BLE Event Pointer 
  * @param p_context Context Pointer
  * 
- * @details In this function, all ble device in the environment are scanned and reported. 
- *          Also filtering with the device name and filtering with RSSI are available.
- *          
- *          After device detection, program calls deviceDetectionHandler() function.
+ * @details Runs in SoftDevice interrupt context. Advertising reports are only copied into the
+ *          advertising queue here, parsing, filtering and printing are done by advReportProcess()
+ *          in main loop context (ADV_QUEUE_ENABLE).
  */
 static void bleEventHandler(ble_evt_t const *p_ble_evt, void *p_context)
 {
-    ret_code_t err_code;
-    ble_gap_evt_t const *p_gap_evt = &p_ble_evt->evt.gap_evt;
+    CPU_MON_START();
 
     switch (p_ble_evt->header.evt_id)
     {
+#if SCANNING_ENABLE
         case BLE_GAP_EVT_ADV_REPORT:
         {
-            nrf_ble_scan_t *p_scan_data                  = (nrf_ble_scan_t *)p_context;
             ble_gap_evt_adv_report_t const *p_adv_report = &p_ble_evt->evt.gap_evt.params.adv_report;
 
-            //if(124==p_adv_report->peer_addr.addr[0])
+            METRIC_INC(eMetricReportsSeen);
+#if TUNE_ENABLE
+            tuneAdvReport(&programTune); // Channel load, every report before the queue and the filters
+#endif
+#if CAPTURE_ENABLE
+            capturePut(p_adv_report); // Raw, before the queue and the filters
+#endif
+#if ADV_QUEUE_ENABLE
+            if (!advQueuePut(p_adv_report))
             {
-                
-#if FILTER_DEVICE_NAME_ENABLE
+                METRIC_INC(eMetricRecordsDropped);
+            }
+#else
+            tsAdvRecord *record = recPoolAlloc();
+            if (record != NULL)
+            {
+                advRecordFill(record, p_adv_report);
+                advReportProcess(record);
+                recPoolRelease(record);
+            }
+            else
+            {
+                METRIC_INC(eMetricRecordsDropped);
+            }
+#endif
+        }
 
-                char *p_msg         = "Name: %s\n\r";
-                uint8_t *deviceName = ble_advdata_parse(p_gap_evt->params.adv_report.data.p_data, p_gap_evt->params.adv_report.data.len, BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME);
+        break;
+#endif
 
-                if (!strcmp(deviceName, FILTER_DEVICE_NAME))
+#if STREAM_ENABLE
+        case BLE_GAP_EVT_CONNECTED:
+            if (p_ble_evt->evt.gap_evt.params.connected.role == BLE_GAP_ROLE_PERIPH)
+            {
+                // Advertising set is stopped by the SoftDevice, the program keeps advertising non-connectable
+                bleAdvConnectableSet(&BLEParams, false);
+                if (BLEParams.bleAdvStatus == eBleAdvertising)
                 {
-                    // Name
-                    counter++;
-                    printf("%d\n\r", counter);
-                    if (NULL == deviceName)
-                    {
-                        char *p_msg = "Name: %s\n\r";
-
-                        deviceName = ble_advdata_parse(p_gap_evt->params.adv_report.data.p_data, p_gap_evt->params.adv_report.data.len, BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME);
-                    }
-                    if (NULL != deviceName)
-                    {
-                        printf(p_msg, deviceName);
-                    }
-                    else
-                    {
-                        printf("Name: No Name\n\r");
-                    }
-
-                    /// Address
-                    printf("Address: ");
-                    for (int i = 0; i < sizeof(p_adv_report->peer_addr.addr); i++)
-                    {
-                        if (i == sizeof(p_adv_report->peer_addr.addr) - 1)
-                        {
-                            printf("%02x", p_adv_report->peer_addr.addr[i]);
-                        }
-                        else
-                        {
-                            printf("%02x:", p_adv_report->peer_addr.addr[i]);
-                        }
-                    }
-                    printf("\n\r");
+                    BLEParams.bleAdvStatus = eBleIdle;
+                }
+                NRF_LOG_INFO("Stream peer connected.");
+            }
+            break;
 
-                    /// Manufacturer Data 
-                    p_msg                     = "Manufacturer Data : ";
-                    uint8_t *manufacturerData = ble_advdata_parse(p_adv_report->data.p_data, p_adv_report->data.len, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA);
-                    if (manufacturerData == NULL)
-                    {
-                    }
-                    else
-                    {
-                        printf(p_msg);
-                        for (int i = 0; i < sizeof(manufacturerData) + 1; i++)
-                        {
-                            if (i == sizeof(manufacturerData))
-                            {
-                                printf("%02x", manufacturerData[i]);
-                            }
-                            else
-                            {
-                                printf("%02x:", manufacturerData[i]);
-                            }
-                        }
-                        printf("\n\r");
-                    }
-                    
-                    /// RSSI POWER
-                    printf("RSSI: %d\n\r", p_adv_report->rssi);
+        case BLE_GAP_EVT_DISCONNECTED:
+            if (p_ble_evt->evt.gap_evt.conn_handle == programStream.connHandle)
+            {
+                bleAdvConnectableSet(&BLEParams, true);
+                NRF_LOG_INFO("Stream peer disconnected, reason 0x%02x.", p_ble_evt->evt.gap_evt.params.disconnected.reason);
+            }
+            break;
+#endif
 
-#if RSSI_FILTER_ENABLE
-                    if (p_adv_report->rssi > RSSI_FILTER_VALUE)
-                    {
-                        deviceDetectionHandler(); // Filtered Device Detected Handler
-                    }
-#else
-                    deviceDetectionHandler(); // Filtered Device Detected Handler
+        default:
+            break;
+    }
 
+#if STREAM_ENABLE
+    streamBleEventHandler(&programStream, p_ble_evt); // After the cases above, they need the handle of the link going down
+#endif
+#if HARVEST_ENABLE
+    harvestBleEventHandler(&programHarvest, p_ble_evt);
+    if ((p_ble_evt->header.evt_id == BLE_GAP_EVT_CONNECTED && p_ble_evt->evt.gap_evt.params.connected.role == BLE_GAP_ROLE_CENTRAL) ||
+        (p_ble_evt->header.evt_id == BLE_GAP_EVT_TIMEOUT && p_ble_evt->evt.gap_evt.params.timeout.src == BLE_GAP_TIMEOUT_SRC_CONN))
+    {
+        // Connection attempt stopped the scan, rest of the scan window
+        if (programParams.programStatus == eModeScanning && bleScanStart(&bleScanParams) != NRF_SUCCESS)
+        {
+            METRIC_INC(eMetricScanStartFailures);
+        }
+    }
 #endif
 
-                    // if(!compareArray(manufacturerData, dataPacketExpected, sizeof(manufacturerData + 1) ))
-                    // {
-                    //     // TO DO: Verifying... 
-                    // }
+    CPU_MON_STOP(eCpuSiteBleEvent);
+}
 
-                    //printf("data: ");
-                    //for (int i = 0; i < p_adv_report->data.len; i++)
-                    //{
-                    //
-                    //    printf("%02x:", p_adv_report->data.p_data[i]);
-                    //}
-                }
+#if SCANNING_ENABLE
+/**
+ * @brief Advertising report processing
+ * 
+ * @param record Advertising report record
+ * 
+ * @details In this function, all ble device in the environment are scanned and reported. 
+ *          Also filtering with the device name and filtering with RSSI are available.
+ *          
+ *          After device detection, program calls deviceDetectionHandler() function.
+ */
+static void advReportProcess(tsAdvRecord const *record)
+{
+    char const *deviceName          = (char const *)&record->data[record->nameOffset]; // Parsed once, advRecordFill()
+    uint8_t const *manufacturerData = &record->data[record->manufOffset];
 
-#else
-                char *p_msg         = "Name: %s\n\r";
-                uint8_t *deviceName = ble_advdata_parse(p_gap_evt->params.adv_report.data.p_data, p_gap_evt->params.adv_report.data.len, BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME);
+#if STREAM_ENABLE
+    streamRecordPut(&programStream, record); // Unfiltered, the peer does its own filtering
+#endif
+#if HARVEST_ENABLE
+    if (programRole == eRoleMaster)
+    {
+        harvestCandidate(&programHarvest, record);
+    }
+#endif
 
-                if (NULL == deviceName)
-                {
-                    char *p_msg = "Name: %s\n\r";
+#if SCHEDULE_ENABLE
+    if (programRole == eRoleSlave)
+    {
+        programScheduleParse(record); // Scan response of the master, no name
+    }
+#endif
+#if LATENCY_ENABLE
+    programProbeParse(record); // Advertising data, no name
+#endif
+#if SENSOR_ENABLE
+    programSensorParse(record); // Advertising data of the slaves
+#endif
 
-                    deviceName = ble_advdata_parse(p_gap_evt->params.adv_report.data.p_data, p_gap_evt->params.adv_report.data.len, BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME);
-                }
-                if (NULL != deviceName)
+    //if(124==record->addr[0])
+    {
+        
+#if FILTER_DEVICE_NAME_ENABLE
+
+        if (record->nameComplete && record->nameLength == strlen(runtimeConfig.filterName) &&
+            memcmp(deviceName, runtimeConfig.filterName, record->nameLength) == 0)
+        {
+            // Name
+            METRIC_INC(eMetricReportsFiltered);
+            counter++;
+            printf("%d\n\r", counter);
+            printf("Name: %.*s\n\r", record->nameLength, deviceName);
+
+            /// Address
+            printf("Address: ");
+            for (int i = 0; i < sizeof(record->addr); i++)
+            {
+                if (i == sizeof(record->addr) - 1)
                 {
-                    printf(p_msg, deviceName);
+                    printf("%02x", record->addr[i]);
                 }
                 else
                 {
-                    printf("Name: No Name\n\r");
+                    printf("%02x:", record->addr[i]);
                 }
+            }
+            printf("\n\r");
 
-                /// Address
-                printf("Address: ");
-                for (int i = 0; i < sizeof(p_adv_report->peer_addr.addr); i++)
+            /// Manufacturer Data 
+            if (record->manufLength != 0)
+            {
+                printf("Manufacturer Data : ");
+                for (int i = 0; i < record->manufLength; i++)
                 {
-                    printf("%02x:", p_adv_report->peer_addr.addr[i]);
+                    if (i == record->manufLength - 1)
+                    {
+                        printf("%02x", manufacturerData[i]);
+                    }
+                    else
+                    {
+                        printf("%02x:", manufacturerData[i]);
+                    }
                 }
                 printf("\n\r");
+            }
+            
+            /// RSSI POWER
+            printf("RSSI: %d\n\r", record->rssi);
+
+#if RSSI_FILTER_ENABLE
+            if (record->rssi > runtimeConfig.rssiFilter)
+            {
+                deviceDetectionHandler(record); // Filtered Device Detected Handler
+            }
+#else
+            deviceDetectionHandler(record); // Filtered Device Detected Handler
+
+#endif
+
+            // if(!compareArray(manufacturerData, dataPacketExpected, sizeof(manufacturerData + 1) ))
+            // {
+            //     // TO DO: Verifying... 
+            // }
+        }
+
+#else
+        if (record->nameLength != 0)
+        {
+            printf("Name: %.*s\n\r", record->nameLength, deviceName);
+        }
+        else
+        {
+            printf("Name: No Name\n\r");
+        }
 
-                p_msg                     = "Manufacturer Data : ";
-                uint8_t *manufacturerData = ble_advdata_parse(p_adv_report->data.p_data, p_adv_report->data.len, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA);
-                if (manufacturerData == NULL)
+        /// Address
+        printf("Address: ");
+        for (int i = 0; i < sizeof(record->addr); i++)
+        {
+            printf("%02x:", record->addr[i]);
+        }
+        printf("\n\r");
+
+        if (record->manufLength != 0)
+        {
+            printf("Manufacturer Data : ");
+            for (int i = 0; i < record->manufLength; i++)
+            {
+                if (i == record->manufLength - 1)
                 {
+                    printf("%02x", manufacturerData[i]);
                 }
                 else
                 {
-                    printf(p_msg);
-                    for (int i = 0; i < sizeof(manufacturerData) + 1; i++)
-                    {
-                        if (i == sizeof(manufacturerData))
-                        {
-                            printf("%02x", manufacturerData[i]);
-                        }
-                        else
-                        {
-                            printf("%02x:", manufacturerData[i]);
-                        }
-                    }
-                    printf("\n\r");
+                    printf("%02x:", manufacturerData[i]);
                 }
-
-                counter++;
-
-                //printf("data: ");
-                //for (int i = 0; i < p_adv_report->data.len; i++)
-                //{
-                //
-                //    printf("%02x:", p_adv_report->data.p_data[i]);
-                //}
-
-                printf("\n\r");
-#endif
             }
-
-            
+            printf("\n\r");
         }
 
-        break;
+        counter++;
+
+        printf("\n\r");
+#endif
     }
 }
+
 /**
  * @brief Handler after detection master device in the environment
  * 
+ * @param record  Advertising report of the filtered master
  */
-static void deviceDetectionHandler(void)
+static void deviceDetectionHandler(tsAdvRecord const *record)
 {
-    programParams.deviceDetectionStatus = eDeviceDetected;
+    uint32_t time = programTimestampUs(record->timestamp);
+
+    // Drained after the scan stopped, or received in an earlier scan: its scan->adv guard already ran
+    if (BLEParams.bleAdvStatus != eBleScanning || (int32_t)(time - programScanStartUs) < 0)
+    {
+        return;
+    }
+
+    METRIC_INC(eMetricDetections);
+    if (!programDetectSeen || (int32_t)(time - programDetectFirstUs) < 0)
+    {
+        programDetectFirstUs = time;
+    }
+    programDetectSeen = true;
+#if SCHEDULE_ENABLE
+    memcpy(programMasterAddr, record->addr, BLE_GAP_ADDR_LEN);
+    programMasterKnown = true;
+#endif
+
+    phaseEngineDeviceDetected(&programEngine);
+#if RENDEZVOUS_ENABLE
+    rendezvousDetection(&programRendezvous, time);
+#endif
+}
+#endif
+
+#if METRICS_ENABLE
+/**@brief Time since boot, snapshot frames, wraps after 49 days */
+static uint32_t programUptimeMs(void)
+{
+    return (uint32_t)(programTicks() * 1000 / PROGRAM_TICK_FREQUENCY);
 }
 
+/**@brief Gauges read at the snapshot only, nothing to update on the hot path */
+static void programMetricsSample(void)
+{
+#if ADV_QUEUE_ENABLE
+    tsAdvQueueParams const *queue = advQueueStatsGet();
+
+    METRIC_SET(eMetricQueueDepth, queue->head - queue->tail);
+    METRIC_SET(eMetricQueueHighWater, queue->highWater);
+#endif
+#if SCANNING_ENABLE
+    METRIC_SET(eMetricPoolInUse, recPoolStatsGet()->inUse);
+#endif
+    METRIC_SET(eMetricCycles, programEngine.cycles);
+#if LATENCY_ENABLE
+    METRIC_SET(eMetricLatencyP50Us, latencyPercentileGet(&programLatency, 50));
+    METRIC_SET(eMetricLatencyP90Us, latencyPercentileGet(&programLatency, 90));
+#endif
+#if ENERGY_ACCOUNTING_ENABLE
+    {
+        // First metric of each phase, radio, cpu, sleep and charge follow in that order
+        static const struct
+        {
+            uint8_t phase;
+            uint8_t metric;
+        } energyMetrics[] = {
+            {eModeScanning,    eMetricScanRadioMs},
+            {eModeAdvertising, eMetricAdvRadioMs},
+            {eModeSleep,       eMetricSleepRadioMs},
+        };
+        uint32_t charge = 0;
+
+        for (uint8_t i = 0; i < ARRAY_SIZE(energyMetrics); i++)
+        {
+            tsEnergyTotals totals;
+
+            energyPhaseTotalsGet(energyMetrics[i].phase, &totals);
+            METRIC_SET(energyMetrics[i].metric, totals.radioMs);
+            METRIC_SET(energyMetrics[i].metric + 1, totals.cpuMs);
+            METRIC_SET(energyMetrics[i].metric + 2, totals.sleepMs);
+            METRIC_SET(energyMetrics[i].metric + 3, totals.chargeUc);
+        }
+        for (uint8_t phase = 0; phase < eModeCount; phase++)
+        {
+            charge += (uint32_t)energyPhaseChargeGet(phase);
+        }
+        METRIC_SET(eMetricChargeUc, charge);
+    }
+#endif
+}
+#endif
+
 /**@brief Callback function for asserts in the SoftDevice.
  *
  * @details This function will be called in case of an assert in the SoftDevice.
@@ -771,12 +1667,148 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t *p_file_name)
  */
 static void idle_state_handle(void)
 {
-    if (NRF_LOG_PROCESS() == false)
+    bool logPending;
+
+    app_sched_execute();
+#if CLI_ENABLE
+    cliProcess();
+#endif
+#if DEEP_SLEEP_ENABLE
+    deepSleepProcess(); // System OFF or System ON deep sleep requested by the sleep phase
+#endif
+
+    CPU_MON_START();
+#if DEEP_SLEEP_ENABLE
+    logPending = !deepSleepLogHeld() && NRF_LOG_PROCESS(); // Log UART is off in a System ON deep sleep
+#else
+    logPending = NRF_LOG_PROCESS();
+#endif
+    CPU_MON_STOP(eCpuSiteMainLoop);
+
+    if (logPending == false)
     {
+#if ENERGY_ACCOUNTING_ENABLE
+        energySleepEnter();
         nrf_pwr_mgmt_run();
+        energySleepExit();
+#else
+        nrf_pwr_mgmt_run();
+#endif
     }
 }
 
+#if BENCH_ENABLE
+/**
+ * @brief Benchmark build, core kernels (bench.c) and the kernels bound to the SoftDevice
+ *
+ * @details Runs once after init, the program timer is never started. Radio is idle afterwards.
+ */
+static void programBenchRun(void)
+{
+    tsBenchKernel const *kernels;
+    uint8_t count;
+
+#if BOOT_FAST_START
+    boardInitDeferred();
+    bleDeferredInit(); // There is no first scan to wait for
+#endif
+    phaseEngineInit(&programBenchEngine, programRole, &programParams, &programBenchHooks, NULL);
+
+    benchInit(1);
+    kernels = benchCoreKernelsGet(&count);
+    benchRun(kernels, count);
+    benchRun(programBenchKernels, sizeof(programBenchKernels) / sizeof(programBenchKernels[0]));
+
+    programBenchScanPrepare(NULL, 0);
+    programBenchAdvPrepare(NULL, 0);
+    printf("BENCHDONE\n\r");
+}
+
+/**@brief Phase engine hook of the benchmark, the engine is stepped by the kernel */
+static void programBenchTimerStart(void *context, uint32_t duration)
+{
+}
+
+/**@brief Records of the last sample are processed, canned report of param bytes */
+static void programBenchEventPrepare(void *context, uint8_t param)
+{
+    app_sched_execute();
+
+    programBenchEvent.header.evt_id        = BLE_GAP_EVT_ADV_REPORT;
+    programBenchEvent.header.evt_len       = sizeof(programBenchEvent);
+    programBenchEvent.evt.gap_evt.conn_handle = BLE_CONN_HANDLE_INVALID;
+    benchAdvReportGet(param, &programBenchEvent.evt.gap_evt.params.adv_report);
+}
+
+/**@brief SoftDevice observer with an advertising report, queued or processed in place (ADV_QUEUE_ENABLE) */
+static bool programBenchEventRun(void *context, uint8_t param)
+{
+    bleEventHandler(&programBenchEvent, NULL);
+    return true;
+}
+
+/**@brief Radio idle, bleAdvUpdateData() starts advertising from idle */
+static void programBenchAdvPrepare(void *context, uint8_t param)
+{
+    if (BLEParams.bleAdvStatus == eBleAdvertising)
+    {
+        bleAdvertisingStop(&BLEParams);
+    }
+    else if (BLEParams.bleAdvStatus == eBleScanning)
+    {
+        bleScanStop(&bleScanParams);
+    }
+    BLEParams.bleAdvStatus = eBleIdle;
+}
+
+/**@brief Advertising data with param bytes of manufacturer data, sizes next to the device name that do not fit fail */
+static bool programBenchAdvRun(void *context, uint8_t param)
+{
+    return bleAdvUpdateData(&BLEParams, programBenchPayload, param) == NRF_SUCCESS;
+}
+
+static void programBenchScanPrepare(void *context, uint8_t param)
+{
+    bleScanStop(&bleScanParams);
+}
+
+static bool programBenchScanRun(void *context, uint8_t param)
+{
+    return bleScanStart(&bleScanParams) == NRF_SUCCESS;
+}
+
+/**
+ * @brief Engine stepped up to the state of the parameter, the slave sees the master
+ *
+ * @details The transitions on the way run the program hooks, so the radio is in the state the
+ *          program would leave it in.
+ */
+static void programBenchPhasePrepare(void *context, uint8_t param)
+{
+    tsPhaseEngine *engine = (tsPhaseEngine *)context;
+
+    for (uint8_t i = 0; i < eModeCount && engine->params->programStatus != param; i++)
+    {
+        engine->params->deviceDetectionStatus = eDeviceDetected;
+        phaseEngineStep(engine);
+    }
+    engine->params->deviceDetectionStatus = eDeviceDetected;
+}
+
+/**@brief One transition with the program hooks, scan/advertising start and stop included */
+static bool programBenchPhaseRun(void *context, uint8_t param)
+{
+    tsPhaseEngine *engine = (tsPhaseEngine *)context;
+
+    if (engine->params->programStatus != param)
+    {
+        return false; // State not reachable for this role
+    }
+    phaseEngineStep(engine);
+    return true;
+}
+#endif
+
 char compareArray(uint8_t *arrayFirst, uint8_t *arraySecond, uint8_t size)
 {
     if (arrayFirst == NULL || arraySecond == NULL)
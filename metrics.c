@@ -0,0 +1,170 @@
+/** @file       metrics.c
+ *  @brief      Runtime metrics registry, named counters and gauges, binary snapshot frame
+ *  @author     Evren Kenanoglu
+ *  @date       4/25/2021
+ *
+ *  Values are one statically allocated word each, updated in place with METRIC_INC()/METRIC_SET() from
+ *  any context (one LDREX/STREX add or store). Gauges that are only worth reading at a snapshot are set
+ *  by the sample hook of the program. The snapshot frame has the values only, the names are printed
+ *  once at init ("METRICSINFO") so the collector can map the columns.
+ */
+#define FILE_METRICS_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "metrics.h"
+#include "nordic_common.h"
+#include "crc32.h"
+#include "app_util_platform.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+static const tsMetricInfo metricsInfo[] =
+    {
+        {"reportsSeen",       eMetricKindCounter},
+        {"reportsFiltered",   eMetricKindCounter},
+        {"detections",        eMetricKindCounter},
+        {"recordsDropped",    eMetricKindCounter},
+        {"scanStartFailures", eMetricKindCounter},
+        {"advUpdateErrors",   eMetricKindCounter},
+        {"scanUs",            eMetricKindGauge},
+        {"advUs",             eMetricKindGauge},
+        {"sleepUs",           eMetricKindGauge},
+        {"queueDepth",        eMetricKindGauge},
+        {"queueHighWater",    eMetricKindGauge},
+        {"poolInUse",         eMetricKindGauge},
+        {"cycles",            eMetricKindGauge},
+        {"echoes",            eMetricKindCounter},
+        {"latencyP50Us",      eMetricKindGauge},
+        {"latencyP90Us",      eMetricKindGauge},
+        {"scanRadioMs",       eMetricKindGauge},
+        {"scanCpuMs",         eMetricKindGauge},
+        {"scanSleepMs",       eMetricKindGauge},
+        {"scanChargeUc",      eMetricKindGauge},
+        {"advRadioMs",        eMetricKindGauge},
+        {"advCpuMs",          eMetricKindGauge},
+        {"advSleepMs",        eMetricKindGauge},
+        {"advChargeUc",       eMetricKindGauge},
+        {"sleepRadioMs",      eMetricKindGauge},
+        {"sleepCpuMs",        eMetricKindGauge},
+        {"sleepSleepMs",      eMetricKindGauge},
+        {"sleepChargeUc",     eMetricKindGauge},
+        {"chargeUc",          eMetricKindGauge},
+};
+
+STATIC_ASSERT(ARRAY_SIZE(metricsInfo) == eMetricCount);
+
+static uint8_t metricsRole;
+static uint8_t metricsAddr[BLE_GAP_ADDR_LEN];
+static uint16_t metricsSequence;
+static tpfMetricsSample metricsSample;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void metricsPut32(uint8_t *buffer, uint32_t value);
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize the registry, prints the metric names
+ *
+ * @param role   teRoles, carried in the frame
+ * @param addr   Device address, identifies the dongle in the frame
+ * @param sample Sets the sampled gauges before a snapshot, NULL: none
+ */
+void metricsInit(uint8_t role, uint8_t const *addr, tpfMetricsSample sample)
+{
+    metricsRole   = role;
+    metricsSample = sample;
+    memcpy(metricsAddr, addr, sizeof(metricsAddr));
+
+    printf("METRICSINFO,%u", METRICS_VERSION);
+    for (uint8_t i = 0; i < eMetricCount; i++)
+    {
+        printf(",%s:%c", metricsInfo[i].name, (metricsInfo[i].kind == eMetricKindCounter) ? 'c' : 'g');
+    }
+    printf("\n\r");
+}
+
+/**
+ * @brief Function to get the metric names and kinds
+ *
+ * @param count Number of metrics
+ * @return tsMetricInfo const* Table in teMetricIds order
+ */
+tsMetricInfo const *metricsInfoGet(uint8_t *count)
+{
+    *count = eMetricCount;
+    return metricsInfo;
+}
+
+/**@brief Function to update the sampled gauges, called by every snapshot */
+void metricsRefresh(void)
+{
+    if (metricsSample != NULL)
+    {
+        metricsSample();
+    }
+}
+
+/**
+ * @brief Function to encode a snapshot frame of all metrics
+ *
+ * @param buffer   METRICS_FRAME_SIZE bytes
+ * @param uptimeMs Time of the snapshot
+ * @return uint16_t Frame size
+ */
+uint16_t metricsSnapshot(uint8_t *buffer, uint32_t uptimeMs)
+{
+    uint16_t size = METRICS_FRAME_HEADER_SIZE;
+
+    metricsRefresh();
+
+    buffer[0] = METRICS_FRAME_MAGIC;
+    buffer[1] = METRICS_VERSION;
+    buffer[2] = eMetricCount;
+    buffer[3] = metricsRole;
+    memcpy(&buffer[4], metricsAddr, sizeof(metricsAddr));
+    buffer[10] = (uint8_t)metricsSequence;
+    buffer[11] = (uint8_t)(metricsSequence >> 8);
+    metricsPut32(&buffer[12], uptimeMs);
+    metricsSequence++;
+
+    for (uint8_t i = 0; i < eMetricCount; i++)
+    {
+        metricsPut32(&buffer[size], metricsValues[i]);
+        size += sizeof(uint32_t);
+    }
+    metricsPut32(&buffer[size], crc32_compute(buffer, size, NULL));
+    return size + sizeof(uint32_t);
+}
+
+/**@brief Function to print a snapshot frame on the debug console, "METRICS,<hex>" */
+void metricsSnapshotPrint(uint32_t uptimeMs)
+{
+    uint8_t frame[METRICS_FRAME_SIZE];
+    uint16_t size = metricsSnapshot(frame, uptimeMs);
+
+    printf("METRICS,");
+    for (uint16_t i = 0; i < size; i++)
+    {
+        printf("%02x", frame[i]);
+    }
+    printf("\n\r");
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+static void metricsPut32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+    buffer[2] = (uint8_t)(value >> 16);
+    buffer[3] = (uint8_t)(value >> 24);
+}
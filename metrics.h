@@ -0,0 +1,114 @@
+/** @file       metrics.h
+ *  @brief      Runtime metrics registry, named counters and gauges, binary snapshot frame
+ *  @author     Evren Kenanoglu
+ *  @date       4/25/2021
+ */
+#ifndef FILE_METRICS_H
+#define FILE_METRICS_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+#include "nrf_atomic.h"
+#include "ble_gap.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define METRICS_VERSION     1
+#define METRICS_FRAME_MAGIC 0x4D // 'M'
+
+/** Snapshot frame, little endian: magic, version, count, role, addr (6), sequence (2), uptime ms (4),
+ *  count values (4 each, teMetricIds order), CRC32 of all bytes before it (4) **/
+#define METRICS_FRAME_HEADER_SIZE 16
+#define METRICS_FRAME_SIZE        (METRICS_FRAME_HEADER_SIZE + eMetricCount * sizeof(uint32_t) + sizeof(uint32_t))
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Metrics, the order is the order of the values in the snapshot frame, new ones go to the end
+ *
+ */
+typedef enum
+{
+    eMetricReportsSeen = 0,   // Counter, advertising reports from the SoftDevice
+    eMetricReportsFiltered,   // Counter, reports that passed the name filter
+    eMetricDetections,        // Counter, reports that passed the name and RSSI filters
+    eMetricRecordsDropped,    // Counter, reports lost to a full queue or an empty record pool
+    eMetricScanStartFailures, // Counter
+    eMetricAdvUpdateErrors,   // Counter, bleAdvUpdateData() and scan response updates
+    eMetricScanUs,            // Gauge, last scan phase
+    eMetricAdvUs,             // Gauge, last advertising phase
+    eMetricSleepUs,           // Gauge, last sleep phase
+    eMetricQueueDepth,        // Gauge, records waiting for the main loop at the snapshot
+    eMetricQueueHighWater,    // Gauge
+    eMetricPoolInUse,         // Gauge, record pool blocks at the snapshot
+    eMetricCycles,            // Gauge, phase engine cycles
+    eMetricEchoes,            // Counter, master: latency echoes counted (latency.c)
+    eMetricLatencyP50Us,      // Gauge, master: round trip median
+    eMetricLatencyP90Us,      // Gauge
+    eMetricScanRadioMs,       // Gauge, energy accounting totals since boot (energy.c)
+    eMetricScanCpuMs,         // Gauge
+    eMetricScanSleepMs,       // Gauge
+    eMetricScanChargeUc,      // Gauge, estimated from the current model
+    eMetricAdvRadioMs,        // Gauge
+    eMetricAdvCpuMs,          // Gauge
+    eMetricAdvSleepMs,        // Gauge
+    eMetricAdvChargeUc,       // Gauge
+    eMetricSleepRadioMs,      // Gauge, radio of the stream and harvest links while sleeping
+    eMetricSleepCpuMs,        // Gauge
+    eMetricSleepSleepMs,      // Gauge
+    eMetricSleepChargeUc,     // Gauge
+    eMetricChargeUc,          // Gauge, all phases
+    eMetricCount,
+} teMetricIds;
+
+typedef enum
+{
+    eMetricKindCounter = 0, // Only goes up, wraps at 2^32
+    eMetricKindGauge,       // Last value
+} teMetricKinds;
+
+/**
+ * @brief Name and kind of a metric, the snapshot frame carries values only
+ *
+ */
+typedef struct
+{
+    char const *name;
+    uint8_t kind; /**< teMetricKinds */
+} tsMetricInfo;
+
+typedef void (*tpfMetricsSample)(void); // Sets the sampled gauges, called before every snapshot
+
+/** MACROS ********************************************************************/
+
+#if METRICS_ENABLE
+#define METRIC_INC(id)        nrf_atomic_u32_add(&metricsValues[(id)], 1)
+#define METRIC_SET(id, value) nrf_atomic_u32_store(&metricsValues[(id)], (value))
+#else
+#define METRIC_INC(id)
+#define METRIC_SET(id, value)
+#endif
+
+#ifndef FILE_METRICS_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+INTERFACE nrf_atomic_u32_t metricsValues[eMetricCount];
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void metricsInit(uint8_t role, uint8_t const *addr, tpfMetricsSample sample);
+INTERFACE tsMetricInfo const *metricsInfoGet(uint8_t *count);
+INTERFACE void metricsRefresh(void);
+INTERFACE uint16_t metricsSnapshot(uint8_t *buffer, uint32_t uptimeMs);
+INTERFACE void metricsSnapshotPrint(uint32_t uptimeMs);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_METRICS_H
@@ -9,17 +9,17 @@
 /** INCLUDES ******************************************************************/
 #include <stdint.h>
 #include <boards.h>
+#include "caps.h"
 /** CONSTANTS *****************************************************************/
 
 /** Enable/Disable Modules**/
-#define MASTER_ENABLE 0
+#define MASTER_ENABLE 0 // Default role, role is selected at runtime (programRole)
 #define SLAVE_ENABLE  (!MASTER_ENABLE)
 
-#if MASTER_ENABLE
-#define DEVICE_NAME "NORDIC_EVREN_MASTER"
-#else
-#define DEVICE_NAME "NORDIC_EVREN_SLAVE"
-#endif
+#define PROGRAM_ROLE_DEFAULT (MASTER_ENABLE ? eRoleMaster : eRoleSlave)
+
+#define DEVICE_NAME_MASTER "NORDIC_EVREN_MASTER"
+#define DEVICE_NAME_SLAVE  "NORDIC_EVREN_SLAVE"
 
 /** Filtering Parameters **/
 #define FILTER_DEVICE_NAME_ENABLE 1
@@ -30,34 +30,270 @@
 
 #define BLE_ENABLE 1
 #define ADVERTISEMENT_ENABLE 1
-#define SCANNING_ENABLE 1
+#define SCANNING_ENABLE CAPS_OBSERVER // Broadcaster only SoftDevices (S112): advertising and sleep
 
 #define JLINK_DEBUG_PRINT_ENABLE 1
 
+/** Energy Accounting **/
+#define ENERGY_ACCOUNTING_ENABLE      1
+#define ENERGY_REPORT_INTERVAL_CYCLES 10 // scan cycles between energy reports
+
+/** Scheduler **/
+#define ADV_QUEUE_ENABLE          1  // 0: adv reports are processed in SoftDevice interrupt
+#define SCHED_MAX_EVENT_DATA_SIZE 8  // bytes
+#define SCHED_QUEUE_SIZE          10 // events
+
+/** CPU Monitor **/
+#define CPU_MONITOR_LEVEL                  2  // 0: off, 1: counters only (production), 2: histograms
+#define CPU_MONITOR_REPORT_INTERVAL_CYCLES 10 // scan cycles between cpu reports
+
+/** Benchmark **/
+#ifndef BENCH_ENABLE
+#define BENCH_ENABLE 0 // 1: hot path benchmarks instead of the program (bench.c), set by the SES "Benchmark" configuration
+#endif
+#define BENCH_ITERATIONS 256 // Samples per kernel and parameter
+
+/** Scan Capture **/
+#define CAPTURE_ENABLE      0    // Raw adv reports as CAP lines on the debug console (capture.c), host/capconv.c writes the file
+#define CAPTURE_BUFFER_SIZE 2048 // bytes, power of 2, reports waiting for the console
+
+/** Metrics **/
+#define METRICS_ENABLE                   1  // Counters and gauges, snapshot frames as METRICS lines (metrics.c)
+#define METRICS_SNAPSHOT_INTERVAL_CYCLES 10 // Master snapshot and fleet snapshot command, 0: no periodic snapshots
+
+/** Console **/
+#define CLI_ENABLE         1 // nrf_cli console for live tuning and stats (cli.c), processed from main loop
+#define CLI_TRANSPORT_RTT  0
+#define CLI_TRANSPORT_CDC  1 // USB CDC ACM, needs the USBD peripheral (nRF52840)
+#if CAPS_USB
+#define CLI_TRANSPORT      CLI_TRANSPORT_CDC
+#else
+#define CLI_TRANSPORT      CLI_TRANSPORT_RTT // No USB, RTT through the debugger
+#endif
+#define CLI_LOG_QUEUE_SIZE 4 // NRF_CLI_DEF, the console is not a log backend
+
+/** Latency Measurement **/
+#define LATENCY_ENABLE                 0   // Master pings in its advertising, slaves echo them, master histograms the round trip (latency.c)
+#define LATENCY_BUCKET_MS              100 // Histogram bucket width
+#define LATENCY_BUCKET_COUNT           64  // The last bucket collects everything above
+#define LATENCY_SEQUENCE_WINDOW        32  // Pings an echo is accepted for, power of 2
+#define LATENCY_PEERS_MAX              8   // Slaves tracked to count every ping once per slave
+#define LATENCY_REPORT_INTERVAL_CYCLES 10  // Master LATENCY lines, 0: no periodic report
+
+/** Boot **/
+#define BOOT_PROFILE_ENABLE 1 // Init stage timestamps, reported after the first scan
+#define BOOT_FAST_START     0 // 1: no init delay, log backends/LEDs/GATT/advertising init after the first scan window
+
 /** LED Definitions **/
 #define LED_INDICATORS_ENABLE 1
 
 #define ADVERTISEMENT_LED   BSP_BOARD_LED_0
 #define SCANNING_LED        BSP_BOARD_LED_1
 
+/** Tuned Timings **/
+#ifndef TUNED_ENABLE
+#define TUNED_ENABLE 0 // 1: scan, advertising and sleep timings of parameters_tuned.h, written by host/paramopt.c
+#endif
+#if TUNED_ENABLE
+#include "parameters_tuned.h"
+#endif
 
 /** Advertisement Constants **/
 #define ADVERTISEMENT_PACKET_UPDATE_INTERVAL       5000 // ms
+#ifndef MIN_ADVERTISEMENT_INTERVAL
 #define MIN_ADVERTISEMENT_INTERVAL                 100  // ms
+#endif
+#ifndef NUMBER_OF_ADVERTISEMENT_DURING_ADVERTISING
 #define NUMBER_OF_ADVERTISEMENT_DURING_ADVERTISING 2
+#endif
 #define ADVERTISEMENT_TIMEOUT                      (MIN_ADVERTISEMENT_INTERVAL * NUMBER_OF_ADVERTISEMENT_DURING_ADVERTISING) // ms
 
 
 /** Scanning Constants **/
 #define BLE_SCAN_DURATION_MS 50000                       // ms
 #define BLE_SCAN_DURATION    (BLE_SCAN_DURATION_MS / 10) /**< Duration of the scanning in units of 10 milliseconds. */
+#ifndef SCAN_TIMEOUT
 #define SCAN_TIMEOUT         200                         //ms
+#endif
+#ifndef SCAN_DUTY
+#define SCAN_DUTY            100                         // %, scan window of the scan interval (NRF_BLE_SCAN_SCAN_INTERVAL)
+#endif
 
 /** Sleeping Constants **/
-#define SLEEP_IDLE_MODE 2000 // ms
+#ifndef SLEEP_IDLE_MODE
+#define SLEEP_IDLE_MODE 2000 // ms, host/paramopt.c: 2000 puts the slave cycle off the master cycle, 2200 would lock both
+#endif
 #define SLEEP_BLE_INIT  0 // ms
 #define SLEEP_DURATION (SLEEP_IDLE_MODE + SLEEP_BLE_INIT)
 
+/** Rendezvous (slave) **/
+#define RENDEZVOUS_ENABLE              1    // Scan windows on the learned master schedule
+#define RENDEZVOUS_JITTER_MS           10   // Random advertising delay of the master (advDelay 0-10 ms)
+#define RENDEZVOUS_GUARD_MS            2    // Timer and scan start latency, both sides of a window
+#define RENDEZVOUS_PERIOD_TOLERANCE_US 2000 // Initial uncertainty of the master period, per period
+#define RENDEZVOUS_MAX_MISSES          3    // Missed windows in a row before blind search
+#define RENDEZVOUS_REPORT_INTERVAL_CYCLES 10 // scan cycles between rendezvous reports
+#define RENDEZVOUS_SYNC_TOLERANCE_US   300  // Initial uncertainty with a published master period (2 x 50 ppm + latency)
+
+/** Master Schedule **/
+#define SCHEDULE_ENABLE             1 // Master publishes its cycle and commands in the scan response (proto.c)
+#define SCHEDULE_PERIOD_AVERAGING   8 // Master cycle measurement, 1/n of every new cycle
+#define SCHEDULE_COMMAND_CYCLES     5 // Master cycles a command is repeated
+
+/** Slotted Responses **/
+#define SLOT_ENABLE       1                     // Slaves answer in the slot of the master slot map (slot.c)
+#define SLOT_COUNT        16                    // Slots per master cycle
+#define SLOT_LENGTH_MS    12                    // One advertising event: advDelay 0-10 ms + 3 channels
+#define SLOT_OFFSET_MS    ADVERTISEMENT_TIMEOUT // First master advertising event to the first slot, master scan start
+#define SLOT_FRAME_CYCLES 1                     // Master cycles per frame, about slaves / (8 * SLOT_COUNT), see host/slotsim.c
+
+#if SLOT_ENABLE && (SLOT_COUNT * SLOT_LENGTH_MS > SCAN_TIMEOUT)
+#error "Slots do not fit in the master scan window"
+#endif
+#if SLOT_ENABLE && !SCHEDULE_ENABLE
+#error "The slot map is carried in the master schedule"
+#endif
+
+/** Backoff (slave) **/
+#define BACKOFF_ENABLE             1
+#define BACKOFF_THRESHOLD          3     // Scans without the master before the sleep grows
+#define BACKOFF_MULTIPLIER_Q8      512   // Sleep x2 per miss (256: linear with BACKOFF_STEP_MS)
+#define BACKOFF_STEP_MS            0     // ms added per miss
+#define BACKOFF_CEILING_MS         60000 // ms
+#define BACKOFF_KICK_SLEEP_MS      500   // ms, sleep in a fast re-acquire window
+#define BACKOFF_KICK_CYCLES        20    // scan cycles of a fast re-acquire window
+#define BACKOFF_KICK_BUTTON_ENABLE 1     // Button 0 starts a fast re-acquire window
+
+/** Autotuner (slave) **/
+#define TUNE_ENABLE                 0     // Scan, sleep and advertising interval follow the detections and the channel load (tune.c)
+#define TUNE_LATENCY_MS             5000  // Target discovery latency
+#define TUNE_BUDGET_UA              300   // Highest estimated average current
+#define TUNE_SCAN_MIN_MS            50
+#define TUNE_SCAN_MAX_MS            1000
+#define TUNE_SCAN_STEP_MS           50
+#define TUNE_DUTY_MIN               25    // %
+#define TUNE_DUTY_MAX               100   // %
+#define TUNE_DUTY_STEP              25    // %
+#define TUNE_SLEEP_MIN_MS           250
+#define TUNE_SLEEP_MAX_MS           10000
+#define TUNE_ADV_INTERVAL_MIN_MS    20
+#define TUNE_ADV_INTERVAL_MAX_MS    500
+#define TUNE_LOAD_HIGH              200   // Reports per second of listening, crowded: longer advertising interval
+#define TUNE_LOAD_LOW               50    // Reports per second of listening, quiet: shorter advertising interval
+#define TUNE_PERIOD_CYCLES          8     // Scan cycles between two steps, the detection ratio settles in between
+#define TUNE_HYSTERESIS_PERCENT     25    // Latency below the target before energy is saved again
+#define TUNE_ABSENT_MISSES          8     // Miss streak taken as the master away, no steps
+#define TUNE_REPORT_INTERVAL_CYCLES 10    // scan cycles between tuner reports
+
+/** GATT Streaming **/
+#define STREAM_ENABLE              0    // Connectable advertising, scan records as notifications (stream.c)
+#define STREAM_MIN_CONN_INTERVAL   6    // 1.25 ms units, 7.5 ms
+#define STREAM_MAX_CONN_INTERVAL   12   // 1.25 ms units, 15 ms (iOS minimum)
+#define STREAM_CONN_SUP_TIMEOUT    400  // 10 ms units, 4 s
+#define STREAM_HVN_QUEUE_SIZE      8    // Notifications queued in the SoftDevice
+#define STREAM_BUFFER_SIZE         2048 // bytes, records waiting for notification, power of 2
+#define STREAM_REPORT_INTERVAL_MS  1000 // ms, throughput window
+
+/** Harvesting (master) **/
+#define HARVEST_ENABLE             0    // Master connects to the slave stream services as central (harvest.c)
+#define HARVEST_LINK_COUNT         CAPS_CENTRAL_LINKS // Central links, NRF_SDH_BLE_CENTRAL_LINK_COUNT in sdk_config.h (harvest override)
+#define HARVEST_CONNECT_TIMEOUT_MS 1000 // ms, connection attempt
+#define HARVEST_RSSI_MIN           (-80) // dBm, weaker slaves are not connected
+#define HARVEST_BULK_TEST          0    // 1: slaves send filler notifications, aggregate throughput test
+#define HARVEST_REPORT_INTERVAL_MS 1000 // ms, throughput window
+
+#if HARVEST_ENABLE && !STREAM_ENABLE
+#error "Harvesting needs the stream service on the slaves"
+#endif
+
+/** L2CAP Bulk Channel **/
+#define COC_ENABLE     0      // Stream records over an L2CAP connection-oriented channel, harvest links open it (coc.c)
+#define COC_PSM        0x0081 // LE PSM, dynamic range 0x0080-0x00FF
+#define COC_SDU_SIZE   (5 * COC_MPS - 2) // bytes, largest SDU, sent in place from the stream buffer, 5 full PDUs with the SDU length
+#define COC_MPS        247    // bytes, one PDU in a 251 byte LL payload
+#define COC_RX_CREDITS 16     // PDUs the peer can send ahead, one SDU is 5 PDUs
+#define COC_RX_BUFFERS 2      // SDU buffers lent to the SoftDevice
+#define COC_TX_QUEUE   3      // SDUs queued in the SoftDevice, more than the PDUs of one event, see host/harvestsim.c
+
+#if COC_ENABLE && !STREAM_ENABLE
+#error "The bulk channel carries the stream records"
+#endif
+
+/** Deep Sleep **/
+// Limits: the RTC cannot wake the chip from System OFF, DEEP_SLEEP_WAKE_RTC stays in System ON with the
+// log UART and the USB console powered down (the port leaves the host) and the log held for the sleep.
+// DEEP_SLEEP_WAKE_LPCOMP ignores the sleep duration, the slave stays off until an upward crossing on the
+// LPCOMP input. Its warm boot is a reset with the program state in retained RAM (.non_init, not zeroed by
+// the startup code), board and SoftDevice init run again.
+#define DEEP_SLEEP_WAKE_RTC    0 // System ON, RTC only, single timer for the whole sleep, UART and USB down
+#define DEEP_SLEEP_WAKE_LPCOMP 1 // System OFF, LPCOMP wake (external event), warm boot into scanning
+
+#define DEEP_SLEEP_ENABLE       0
+#define DEEP_SLEEP_THRESHOLD_MS 5000 // ms, sleeps at least this long use deep sleep
+#define DEEP_SLEEP_WAKE_SOURCE  DEEP_SLEEP_WAKE_RTC
+#define DEEP_SLEEP_LPCOMP_INPUT 2 // AIN2
+
+/** Sensor Sampling (slave) **/
+#define SENSOR_TRIGGER_PPI      0 // RTC2 compare starts the conversions through PPI, one wake up per buffer
+#define SENSOR_TRIGGER_SOFTWARE 1 // app_timer callback starts every conversion, two wake ups per sample
+#define SENSOR_INPUT_VDD        8 // SENSOR_INPUT: 0..7 AIN0..AIN7, 8 supply voltage
+
+#define SENSOR_ENABLE                 0    // SAADC readings in the slave advertising payload (sensor.c)
+#define SENSOR_TRIGGER                SENSOR_TRIGGER_PPI // Boot trigger, "sensor ppi|software" switches it
+#define SENSOR_INPUT                  SENSOR_INPUT_VDD
+#define SENSOR_PERIOD_MS              100  // ms between samples
+#define SENSOR_OVERSAMPLE             3    // log2, conversions the SAADC averages into one sample (burst)
+#define SENSOR_DECIMATION             16   // Samples averaged into one reading, one EasyDMA buffer
+#define SENSOR_ACQ_US                 10   // Acquisition time: 3, 5, 10, 15, 20 or 40 us
+#define SENSOR_PPI_CHANNEL            0    // First of 3 PPI channels, channels of the application (nrf_soc.h)
+#define SENSOR_REPORT_INTERVAL_CYCLES 10   // cycles between sensor reports
+
+#if SENSOR_ENABLE && (SENSOR_OVERSAMPLE > 8 || SENSOR_INPUT > SENSOR_INPUT_VDD)
+#error "SAADC oversampling is 2^0..2^8, inputs are AIN0..AIN7 and VDD"
+#endif
+
+/** Capability Limits **/
+#if !CAPS_OBSERVER // No advertising reports: everything fed by the scan is compiled out
+#undef ADV_QUEUE_ENABLE
+#define ADV_QUEUE_ENABLE 0
+#undef CAPTURE_ENABLE
+#define CAPTURE_ENABLE 0
+#undef LATENCY_ENABLE
+#define LATENCY_ENABLE 0
+#undef RENDEZVOUS_ENABLE
+#define RENDEZVOUS_ENABLE 0
+#undef SCHEDULE_ENABLE
+#define SCHEDULE_ENABLE 0
+#undef SLOT_ENABLE
+#define SLOT_ENABLE 0
+#undef BACKOFF_ENABLE
+#define BACKOFF_ENABLE 0
+#undef TUNE_ENABLE
+#define TUNE_ENABLE 0
+#undef STREAM_ENABLE
+#define STREAM_ENABLE 0 // Streams scan records
+#undef COC_ENABLE
+#define COC_ENABLE 0
+#undef BOOT_FAST_START
+#define BOOT_FAST_START 0 // Deferred init waits for the first scan window
+#undef BENCH_ENABLE
+#define BENCH_ENABLE 0 // Kernels of the scan path
+#endif
+#if !CAPS_RTC2 // No free RTC for the PPI trigger
+#undef SENSOR_TRIGGER
+#define SENSOR_TRIGGER SENSOR_TRIGGER_SOFTWARE
+#endif
+#if !CAPS_CENTRAL
+#undef HARVEST_ENABLE
+#define HARVEST_ENABLE 0
+#endif
+#if STREAM_ENABLE && (CAPS_PERIPHERAL_LINKS == 0)
+#error "Streaming needs a peripheral link, NRF_SDH_BLE_PERIPHERAL_LINK_COUNT in sdk_config.h"
+#endif
+#if HARVEST_ENABLE && (CAPS_CENTRAL_LINKS == 0)
+#error "Harvesting needs central links, the harvest override of NRF_SDH_BLE_CENTRAL_LINK_COUNT in sdk_config.h"
+#endif
+
 /** Tasks Constants **/
 #define TCB_PROGRAM_INIT_DELAY                1000 //ms
 #define TCB_PROGRAM_TASK_INTERVAL             100  //ms
@@ -75,6 +311,7 @@ typedef enum
     eModeInitBle,
     eModeScanning,
     eModeAdvertising,
+    eModeCount,
 } teModes;
 
 typedef enum
@@ -0,0 +1,264 @@
+/** @file       phaseengine.c
+ *  @brief      Table driven phase engine for master and slave programs
+ *  @author     Evren Kenanoglu
+ *  @date       4/2/2021
+ */
+#define FILE_PHASEENGINE_C
+
+/** INCLUDES ******************************************************************/
+#include <stddef.h>
+#include "phaseengine.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+#define PHASE_TABLE_ROWS(table) (sizeof(table) / sizeof((table)[0]))
+
+#if SCANNING_ENABLE
+#define PHASE_CYCLE_STATE eModeScanning // A cycle starts with the scan
+#else
+#define PHASE_CYCLE_STATE eModeAdvertising
+#endif
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+#if SCANNING_ENABLE
+static bool guardDeviceDetected(tsPhaseEngine const *engine);
+static bool guardScanScheduled(tsPhaseEngine const *engine);
+static void actionScanStart(tsPhaseEngine *engine);
+static void actionScanToAdv(tsPhaseEngine *engine);
+static void actionScanToSleep(tsPhaseEngine *engine);
+static void actionSleepToScan(tsPhaseEngine *engine);
+static void actionAdvToScan(tsPhaseEngine *engine);
+#else
+static void actionAdvStart(tsPhaseEngine *engine);
+#endif
+static void actionAdvToSleep(tsPhaseEngine *engine);
+
+/** VARIABLES *****************************************************************/
+
+#if SCANNING_ENABLE
+/**
+ * @brief Master program: scanning in SCAN_TIMEOUT and advertising in ADVERTISEMENT_TIMEOUT, forever.
+ */
+static const tsPhaseTransition phaseTableMaster[] =
+    {
+        //  state            guard  action           timing             nextState
+        {eModeFirstStart,  NULL, NULL,            ePhaseTimingInit, eModeInitBle},
+        {eModeInitBle,     NULL, actionScanStart, ePhaseTimingScan, eModeScanning},
+        {eModeScanning,    NULL, actionScanToAdv, ePhaseTimingAdv,  eModeAdvertising},
+        {eModeAdvertising, NULL, actionAdvToScan, ePhaseTimingScan, eModeScanning},
+};
+
+/**
+ * @brief Slave program: scanning in SCAN_TIMEOUT, if master device is detected advertising in
+ *        ADVERTISEMENT_TIMEOUT, otherwise sleeping in SLEEP_DURATION. Then scanning again.
+ *        When the next scan is scheduled (rendezvous), advertising is followed by sleep until that scan.
+ */
+static const tsPhaseTransition phaseTableSlave[] =
+    {
+        //  state            guard                action             timing              nextState
+        {eModeFirstStart,  NULL,                NULL,              ePhaseTimingInit,  eModeInitBle},
+        {eModeInitBle,     NULL,                actionScanStart,   ePhaseTimingScan,  eModeScanning},
+        {eModeScanning,    guardDeviceDetected, actionScanToAdv,   ePhaseTimingAdv,   eModeAdvertising},
+        {eModeScanning,    NULL,                actionScanToSleep, ePhaseTimingSleep, eModeSleep},
+        {eModeSleep,       NULL,                actionSleepToScan, ePhaseTimingScan,  eModeScanning},
+        {eModeAdvertising, guardScanScheduled,  actionAdvToSleep,  ePhaseTimingSleep, eModeSleep},
+        {eModeAdvertising, NULL,                actionAdvToScan,   ePhaseTimingScan,  eModeScanning},
+};
+#else
+/**
+ * @brief Broadcaster program, SoftDevice without the observer role (caps.h): advertising in
+ *        ADVERTISEMENT_TIMEOUT and sleeping in SLEEP_DURATION, forever. Scan hooks are never called.
+ */
+static const tsPhaseTransition phaseTableBroadcaster[] =
+    {
+        //  state            guard  action            timing             nextState
+        {eModeFirstStart,  NULL, NULL,             ePhaseTimingInit,  eModeInitBle},
+        {eModeInitBle,     NULL, actionAdvStart,   ePhaseTimingAdv,   eModeAdvertising},
+        {eModeAdvertising, NULL, actionAdvToSleep, ePhaseTimingSleep, eModeSleep},
+        {eModeSleep,       NULL, actionAdvStart,   ePhaseTimingAdv,   eModeAdvertising},
+};
+#endif
+
+static const struct
+{
+    tsPhaseTransition const *table;
+    uint8_t rows;
+} phaseTables[eRoleCount] =
+    {
+#if SCANNING_ENABLE
+        [eRoleMaster] = {phaseTableMaster, PHASE_TABLE_ROWS(phaseTableMaster)},
+        [eRoleSlave]  = {phaseTableSlave, PHASE_TABLE_ROWS(phaseTableSlave)},
+#else
+        [eRoleMaster] = {phaseTableBroadcaster, PHASE_TABLE_ROWS(phaseTableBroadcaster)}, // Both roles only advertise
+        [eRoleSlave]  = {phaseTableBroadcaster, PHASE_TABLE_ROWS(phaseTableBroadcaster)},
+#endif
+};
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize a phase engine instance
+ *
+ * @param engine    Engine instance
+ * @param role      Program role (teRoles)
+ * @param params    Program parameters, kept outside of the engine so they can be retained/restored
+ * @param hooks     Platform hooks
+ * @param context   Passed to every hook
+ *
+ * @details Timings are set to the compiled defaults and can be changed in engine->timings at any time,
+ *          a new value is used the next time that timing is armed.
+ */
+void phaseEngineInit(tsPhaseEngine *engine, uint8_t role, tsProgramParams *params, tsPhaseHooks const *hooks, void *context)
+{
+    engine->params      = params;
+    engine->role        = role;
+    engine->table       = phaseTables[role].table;
+    engine->tableSize   = phaseTables[role].rows;
+    engine->hooks       = hooks;
+    engine->context     = context;
+    engine->transitions = 0;
+    engine->cycles      = 0;
+
+    engine->timings[ePhaseTimingSwitch] = TCB_PROGRAM_TASK_SWITCH_MODE_INTERVAL;
+    engine->timings[ePhaseTimingInit]   = TCB_PROGRAM_INIT_DELAY;
+    engine->timings[ePhaseTimingScan]   = SCAN_TIMEOUT;
+    engine->timings[ePhaseTimingAdv]    = ADVERTISEMENT_TIMEOUT;
+    engine->timings[ePhaseTimingSleep]  = SLEEP_DURATION;
+}
+
+/**
+ * @brief Function to start the engine from its current state
+ *
+ * @details eModeFirstStart is a cold start. A state restored by deep sleep (eModeSleep) continues
+ *          with its next transition.
+ */
+void phaseEngineStart(tsPhaseEngine *engine)
+{
+    engine->hooks->timerStart(engine->context, engine->timings[ePhaseTimingSwitch]);
+}
+
+/**
+ * @brief Function to take the next transition, called when the armed duration of a state is over
+ *
+ * @param engine Engine instance
+ */
+void phaseEngineStep(tsPhaseEngine *engine)
+{
+    uint8_t from = engine->params->programStatus;
+
+    for (uint8_t i = 0; i < engine->tableSize; i++)
+    {
+        tsPhaseTransition const *row = &engine->table[i];
+
+        if (row->state != from || (row->guard != NULL && !row->guard(engine)))
+        {
+            continue;
+        }
+
+        if (from == eModeSleep && engine->hooks->sleepStop != NULL)
+        {
+            engine->hooks->sleepStop(engine->context);
+        }
+        if (row->action != NULL)
+        {
+            row->action(engine);
+        }
+
+        engine->params->programStatus  = row->nextState;
+        engine->params->programCounter = engine->timings[row->timing];
+        if (engine->hooks->timingAdjust != NULL)
+        {
+            engine->params->programCounter = engine->hooks->timingAdjust(engine->context, row->nextState, engine->params->programCounter);
+        }
+        if (row->nextState == eModeSleep && engine->hooks->sleepStart != NULL)
+        {
+            engine->hooks->sleepStart(engine->context, engine->params->programCounter); // Armed duration, after adjustment
+        }
+        engine->transitions++;
+        if (row->nextState == PHASE_CYCLE_STATE)
+        {
+            engine->cycles++;
+        }
+
+        if (engine->hooks->phaseChanged != NULL)
+        {
+            engine->hooks->phaseChanged(engine->context, from, row->nextState);
+        }
+        engine->hooks->timerStart(engine->context, engine->params->programCounter);
+        return;
+    }
+}
+
+/**
+ * @brief Function to be called when master device is detected in the environment
+ */
+void phaseEngineDeviceDetected(tsPhaseEngine *engine)
+{
+    engine->params->deviceDetectionStatus = eDeviceDetected;
+}
+
+/**
+ * @brief Function to get flash size of a role's transition table
+ *
+ * @param role      Program role (teRoles)
+ * @return uint32_t table size in bytes
+ */
+uint32_t phaseEngineTableSizeGet(uint8_t role)
+{
+    return phaseTables[role].rows * sizeof(tsPhaseTransition);
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+#if SCANNING_ENABLE
+static bool guardDeviceDetected(tsPhaseEngine const *engine)
+{
+    return engine->params->deviceDetectionStatus == eDeviceDetected;
+}
+
+static bool guardScanScheduled(tsPhaseEngine const *engine)
+{
+    return engine->hooks->scanScheduled != NULL && engine->hooks->scanScheduled(engine->context);
+}
+
+static void actionScanStart(tsPhaseEngine *engine)
+{
+    engine->hooks->scanStart(engine->context);
+}
+
+static void actionScanToAdv(tsPhaseEngine *engine)
+{
+    engine->hooks->scanStop(engine->context);
+    engine->params->deviceDetectionStatus = eDeviceNotDetected; // Clear detection Status...
+    engine->hooks->advStart(engine->context);
+}
+
+static void actionScanToSleep(tsPhaseEngine *engine)
+{
+    engine->hooks->scanStop(engine->context);
+}
+
+static void actionSleepToScan(tsPhaseEngine *engine)
+{
+    engine->hooks->scanStart(engine->context);
+}
+
+static void actionAdvToScan(tsPhaseEngine *engine)
+{
+    engine->hooks->advStop(engine->context);
+    engine->hooks->scanStart(engine->context);
+}
+#else
+static void actionAdvStart(tsPhaseEngine *engine)
+{
+    engine->hooks->advStart(engine->context);
+}
+#endif
+
+static void actionAdvToSleep(tsPhaseEngine *engine)
+{
+    engine->hooks->advStop(engine->context);
+}
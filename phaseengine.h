@@ -0,0 +1,118 @@
+/** @file       phaseengine.h
+ *  @brief      Table driven phase engine for master and slave programs
+ *  @author     Evren Kenanoglu
+ *  @date       4/2/2021
+ */
+#ifndef FILE_PHASEENGINE_H
+#define FILE_PHASEENGINE_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Program roles, selected at runtime
+ *
+ */
+typedef enum
+{
+    eRoleMaster = 0,
+    eRoleSlave,
+    eRoleCount,
+} teRoles;
+
+/**
+ * @brief Durations a transition can arm for its next state, values are kept in the engine
+ *
+ */
+typedef enum
+{
+    ePhaseTimingSwitch = 0, // TCB_PROGRAM_TASK_SWITCH_MODE_INTERVAL
+    ePhaseTimingInit,       // TCB_PROGRAM_INIT_DELAY
+    ePhaseTimingScan,       // SCAN_TIMEOUT
+    ePhaseTimingAdv,        // ADVERTISEMENT_TIMEOUT
+    ePhaseTimingSleep,      // SLEEP_DURATION
+    ePhaseTimingCount,
+} tePhaseTimings;
+
+typedef struct tsPhaseEngine tsPhaseEngine;
+
+typedef bool (*tpfPhaseGuard)(tsPhaseEngine const *engine);
+typedef void (*tpfPhaseAction)(tsPhaseEngine *engine);
+
+/**
+ * @brief One row of a transition table, tables are const and stay in flash
+ *
+ * @details When the time of a state is over, rows of that state are evaluated in table order and
+ *          the first row whose guard passes is taken.
+ */
+typedef struct
+{
+    uint8_t state;         /**< State the transition leaves (teModes) */
+    tpfPhaseGuard guard;   /**< NULL: always taken */
+    tpfPhaseAction action; /**< Executed on transition, NULL: no action */
+    uint8_t timing;        /**< Duration of the next state (tePhaseTimings) */
+    uint8_t nextState;     /**< teModes */
+} tsPhaseTransition;
+
+/**
+ * @brief Platform hooks, bound to SoftDevice/app_timer on target and to a simulator on host
+ *
+ */
+typedef struct
+{
+    void (*timerStart)(void *context, uint32_t duration); // ms
+    void (*scanStart)(void *context);
+    void (*scanStop)(void *context);
+    void (*advStart)(void *context);
+    void (*advStop)(void *context);
+    void (*sleepStart)(void *context, uint32_t duration); // ms
+    void (*sleepStop)(void *context);
+    void (*phaseChanged)(void *context, uint8_t from, uint8_t to);
+    uint32_t (*timingAdjust)(void *context, uint8_t state, uint32_t duration); // ms, NULL: engine timings are armed as they are
+    bool (*scanScheduled)(void *context);                                      // NULL: no scheduled scans, slave scans after advertising
+} tsPhaseHooks;
+
+/**
+ * @brief Phase engine instance
+ *
+ */
+struct tsPhaseEngine
+{
+    tsProgramParams *params; /**< programStatus, programCounter (armed duration), deviceDetectionStatus */
+    uint8_t role;
+    uint8_t tableSize;
+    tsPhaseTransition const *table;
+    tsPhaseHooks const *hooks;
+    void *context;
+    uint32_t timings[ePhaseTimingCount]; // ms
+    uint32_t transitions;
+    uint32_t cycles; /**< Started scan phases, advertising phases without scanning (caps.h) */
+};
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_PHASEENGINE_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void phaseEngineInit(tsPhaseEngine *engine, uint8_t role, tsProgramParams *params, tsPhaseHooks const *hooks, void *context);
+INTERFACE void phaseEngineStart(tsPhaseEngine *engine);
+INTERFACE void phaseEngineStep(tsPhaseEngine *engine);
+INTERFACE void phaseEngineDeviceDetected(tsPhaseEngine *engine);
+INTERFACE uint32_t phaseEngineTableSizeGet(uint8_t role);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_PHASEENGINE_H
@@ -0,0 +1,168 @@
+/** @file       proto.c
+ *  @brief      Master schedule payload, master cycle and commands for the slaves, latency probes, sensor readings
+ *  @author     Evren Kenanoglu
+ *  @date       4/14/2021
+ */
+#define FILE_PROTO_C
+
+/** INCLUDES ******************************************************************/
+#include "proto.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+
+/** VARIABLES *****************************************************************/
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to encode a master schedule
+ *
+ * @param schedule  Schedule to encode
+ * @param buffer    At least PROTO_SCHEDULE_SIZE bytes
+ * @return uint8_t encoded length
+ */
+uint8_t protoScheduleEncode(tsProtoSchedule const *schedule, uint8_t *buffer)
+{
+    buffer[0] = PROTO_MAGIC;
+    buffer[1] = PROTO_VERSION;
+    buffer[2] = schedule->command;
+    buffer[3] = (uint8_t)schedule->sequence;
+    buffer[4] = (uint8_t)(schedule->sequence >> 8);
+    buffer[5] = (uint8_t)schedule->period;
+    buffer[6] = (uint8_t)(schedule->period >> 8);
+    buffer[7] = (uint8_t)(schedule->period >> 16);
+    buffer[8] = (uint8_t)(schedule->period >> 24);
+
+    buffer[9]  = (uint8_t)schedule->slots.seed;
+    buffer[10] = (uint8_t)(schedule->slots.seed >> 8);
+    buffer[11] = (uint8_t)schedule->slots.offset;
+    buffer[12] = (uint8_t)(schedule->slots.offset >> 8);
+    buffer[13] = schedule->slots.count;
+    buffer[14] = schedule->slots.length;
+    buffer[15] = schedule->slots.frameCycles;
+    buffer[16] = schedule->slots.framePosition;
+
+    return PROTO_SCHEDULE_SIZE;
+}
+
+/**
+ * @brief Function to decode a master schedule
+ *
+ * @param data      Manufacturer specific data after the company identifier
+ * @param length    Length of data
+ * @return true     data is a master schedule of this version
+ */
+bool protoScheduleDecode(uint8_t const *data, uint8_t length, tsProtoSchedule *schedule)
+{
+    if (length < PROTO_SCHEDULE_SIZE || data[0] != PROTO_MAGIC || data[1] != PROTO_VERSION)
+    {
+        return false;
+    }
+
+    schedule->command  = data[2];
+    schedule->sequence = (uint16_t)(data[3] | (data[4] << 8));
+    schedule->period   = (uint32_t)data[5] | ((uint32_t)data[6] << 8) | ((uint32_t)data[7] << 16) | ((uint32_t)data[8] << 24);
+
+    schedule->slots.seed          = (uint16_t)(data[9] | (data[10] << 8));
+    schedule->slots.offset        = (uint16_t)(data[11] | (data[12] << 8));
+    schedule->slots.count         = data[13];
+    schedule->slots.length        = data[14];
+    schedule->slots.frameCycles   = data[15];
+    schedule->slots.framePosition = data[16];
+
+    return schedule->period != 0 && schedule->slots.frameCycles != 0 && schedule->slots.framePosition < schedule->slots.frameCycles;
+}
+
+/**
+ * @brief Function to encode a latency probe
+ *
+ * @param probe     Probe to encode
+ * @param buffer    At least PROTO_PROBE_SIZE bytes
+ * @return uint8_t encoded length
+ */
+uint8_t protoProbeEncode(tsProtoProbe const *probe, uint8_t *buffer)
+{
+    buffer[0]  = PROTO_PROBE_MAGIC;
+    buffer[1]  = PROTO_VERSION;
+    buffer[2]  = probe->kind;
+    buffer[3]  = (uint8_t)probe->sequence;
+    buffer[4]  = (uint8_t)(probe->sequence >> 8);
+    buffer[5]  = (uint8_t)probe->sent;
+    buffer[6]  = (uint8_t)(probe->sent >> 8);
+    buffer[7]  = (uint8_t)(probe->sent >> 16);
+    buffer[8]  = (uint8_t)(probe->sent >> 24);
+    buffer[9]  = (uint8_t)probe->origin;
+    buffer[10] = (uint8_t)(probe->origin >> 8);
+
+    return PROTO_PROBE_SIZE;
+}
+
+/**
+ * @brief Function to decode a latency probe
+ *
+ * @param data      Manufacturer specific data after the company identifier
+ * @param length    Length of data
+ * @return true     data is a latency probe of this version
+ */
+bool protoProbeDecode(uint8_t const *data, uint8_t length, tsProtoProbe *probe)
+{
+    if (length < PROTO_PROBE_SIZE || data[0] != PROTO_PROBE_MAGIC || data[1] != PROTO_VERSION)
+    {
+        return false;
+    }
+
+    probe->kind     = data[2];
+    probe->sequence = (uint16_t)(data[3] | (data[4] << 8));
+    probe->sent     = (uint32_t)data[5] | ((uint32_t)data[6] << 8) | ((uint32_t)data[7] << 16) | ((uint32_t)data[8] << 24);
+    probe->origin   = (uint16_t)(data[9] | (data[10] << 8));
+
+    return probe->kind == eProtoProbePing || probe->kind == eProtoProbeEcho;
+}
+
+/**
+ * @brief Function to encode the slave sensor readings
+ *
+ * @param sensor    Readings to encode, 12 bit
+ * @param buffer    At least PROTO_SENSOR_SIZE bytes
+ * @return uint8_t encoded length
+ */
+uint8_t protoSensorEncode(tsProtoSensor const *sensor, uint8_t *buffer)
+{
+    uint16_t first  = sensor->readings[0] & PROTO_SENSOR_NONE;
+    uint16_t second = sensor->readings[1] & PROTO_SENSOR_NONE;
+
+    buffer[0] = PROTO_SENSOR_MAGIC;
+    buffer[1] = (uint8_t)first;
+    buffer[2] = (uint8_t)((first >> 8) | (second << 4));
+    buffer[3] = (uint8_t)(second >> 4);
+
+    return PROTO_SENSOR_SIZE;
+}
+
+/**
+ * @brief Function to decode the slave sensor readings
+ *
+ * @param data      Manufacturer specific data after the company identifier
+ * @param length    Length of data
+ * @return true     data is a sensor frame
+ */
+bool protoSensorDecode(uint8_t const *data, uint8_t length, tsProtoSensor *sensor)
+{
+    if (length < PROTO_SENSOR_SIZE || data[0] != PROTO_SENSOR_MAGIC)
+    {
+        return false;
+    }
+
+    sensor->readings[0] = (uint16_t)(data[1] | ((data[2] & 0x0F) << 8));
+    sensor->readings[1] = (uint16_t)((data[2] >> 4) | (data[3] << 4));
+
+    return true;
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
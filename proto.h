@@ -0,0 +1,117 @@
+/** @file       proto.h
+ *  @brief      Master schedule payload, master cycle and commands for the slaves, latency probes, sensor readings
+ *  @author     Evren Kenanoglu
+ *  @date       4/14/2021
+ */
+#ifndef FILE_PROTO_H
+#define FILE_PROTO_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define PROTO_MAGIC         0xE5 // First byte after the company identifier
+#define PROTO_VERSION       2
+#define PROTO_SCHEDULE_SIZE 17 // Encoded schedule, bytes
+#define PROTO_PROBE_MAGIC   0xE6 // First byte of a latency probe after the company identifier
+#define PROTO_PROBE_SIZE    11   // Encoded probe, bytes
+#define PROTO_SENSOR_MAGIC  0xE7 // First byte of the slave sensor readings after the company identifier
+#define PROTO_SENSOR_SLOTS  2    // Readings per frame, newest first
+#define PROTO_SENSOR_SIZE   4    // Encoded readings, bytes, what the slave name leaves in the advertising data
+#define PROTO_SENSOR_NONE   0xFFF // Empty slot, readings are 12 bit
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eProtoCmdNone = 0,
+    eProtoCmdReport, // Slaves print their rendezvous state
+    eProtoCmdResync, // Slaves drop the schedule estimate and search again
+    eProtoCmdMetrics, // Slaves print a metrics snapshot (metrics.c)
+    eProtoCmdCount,
+} teProtoCommands;
+
+typedef enum
+{
+    eProtoProbePing = 0, // Master advertising
+    eProtoProbeEcho,     // Slave advertising, the last ping it received
+} teProtoProbeKinds;
+
+/**
+ * @brief Response slot map of a master cycle (slot.c), count 0: slaves respond unslotted
+ *
+ */
+typedef struct
+{
+    uint16_t seed;         /**< Slot assignment seed, new for every frame */
+    uint16_t offset;       /**< ms from the first master advertising event to the first slot */
+    uint8_t count;         /**< Slots per master cycle */
+    uint8_t length;        /**< Slot length, ms */
+    uint8_t frameCycles;   /**< Master cycles per frame, every slave responds once per frame */
+    uint8_t framePosition; /**< Cycle of the frame this schedule is sent in */
+} tsProtoSlots;
+
+/**
+ * @brief Master schedule, carried in the manufacturer specific data of the master scan response
+ *
+ * @details Encoding, little endian: magic, version, command, sequence (2), period (4),
+ *          slot seed (2), slot offset (2), slot count, slot length, frame cycles, frame position
+ */
+typedef struct
+{
+    uint8_t command;   /**< teProtoCommands */
+    uint16_t sequence; /**< Command counter, a command is executed once per sequence */
+    uint32_t period;   /**< Master cycle measured by the master, us */
+    tsProtoSlots slots;
+} tsProtoSchedule;
+
+/**
+ * @brief Latency probe (latency.c), carried in the manufacturer specific data of the advertising data
+ *
+ * @details Encoding, little endian: magic, version, kind, sequence (2), sent (4), origin (2).
+ *          The slave copies sequence and sent of a ping into its echo, only the master clock is used.
+ */
+typedef struct
+{
+    uint8_t kind;      /**< teProtoProbeKinds */
+    uint16_t sequence; /**< Ping counter of the master */
+    uint32_t sent;     /**< Master clock at the start of the advertising phase, us */
+    uint16_t origin;   /**< Echo: first address bytes of the master that sent the ping */
+} tsProtoProbe;
+
+/**
+ * @brief Slave sensor readings (sensor.c), carried in the manufacturer specific data of the advertising data
+ *
+ * @details Encoding: magic, then the 12 bit readings packed little endian, two readings in three bytes.
+ *          No version byte, the full slave name leaves 4 bytes of the 31 byte advertising data.
+ */
+typedef struct
+{
+    uint16_t readings[PROTO_SENSOR_SLOTS]; /**< SAADC codes, newest first, PROTO_SENSOR_NONE: no reading yet */
+} tsProtoSensor;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_PROTO_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE uint8_t protoScheduleEncode(tsProtoSchedule const *schedule, uint8_t *buffer);
+INTERFACE bool protoScheduleDecode(uint8_t const *data, uint8_t length, tsProtoSchedule *schedule);
+INTERFACE uint8_t protoProbeEncode(tsProtoProbe const *probe, uint8_t *buffer);
+INTERFACE bool protoProbeDecode(uint8_t const *data, uint8_t length, tsProtoProbe *probe);
+INTERFACE uint8_t protoSensorEncode(tsProtoSensor const *sensor, uint8_t *buffer);
+INTERFACE bool protoSensorDecode(uint8_t const *data, uint8_t length, tsProtoSensor *sensor);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_PROTO_H
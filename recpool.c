@@ -0,0 +1,95 @@
+/** @file       recpool.c
+ *  @brief      Advertising record pool, fixed blocks passed through the queue to the report stages
+ *  @author     Evren Kenanoglu
+ *  @date       4/23/2021
+ *
+ *  A report is copied once, into a block of this pool (advRecordFill). The block goes through the
+ *  queue and the stages as a const pointer and is released when the handler returns. A stage that
+ *  needs the data later copies it (stream ring, capture buffer), no block outlives its queue slot.
+ *  Allocation runs in SoftDevice interrupt, releases in main loop, counters are in critical regions.
+ */
+#define FILE_RECPOOL_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "recpool.h"
+#include "nrf_balloc.h"
+#include "app_util_platform.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+NRF_BALLOC_DEF(recPool, sizeof(tsAdvRecord), RECPOOL_SIZE);
+
+static tsRecPoolStats recPoolStats;
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**@brief Function to initialize the pool, before the first scan */
+ret_code_t recPoolInit(void)
+{
+    memset(&recPoolStats, 0, sizeof(recPoolStats));
+    return nrf_balloc_init(&recPool);
+}
+
+/**
+ * @brief Function to take a free block
+ *
+ * @return tsAdvRecord* Record, NULL: pool is empty
+ */
+tsAdvRecord *recPoolAlloc(void)
+{
+    tsAdvRecord *record = (tsAdvRecord *)nrf_balloc_alloc(&recPool);
+
+    CRITICAL_REGION_ENTER();
+    if (record == NULL)
+    {
+        recPoolStats.failures++;
+    }
+    else
+    {
+        recPoolStats.allocs++;
+        recPoolStats.inUse++;
+        recPoolStats.highWater = MAX(recPoolStats.highWater, recPoolStats.inUse);
+    }
+    CRITICAL_REGION_EXIT();
+
+    return record;
+}
+
+/**@brief Function to give a block back, after the record is processed */
+void recPoolRelease(tsAdvRecord *record)
+{
+    CRITICAL_REGION_ENTER();
+    recPoolStats.inUse--;
+    CRITICAL_REGION_EXIT();
+
+    nrf_balloc_free(&recPool, record);
+}
+
+/**@brief Function to get pool counters */
+tsRecPoolStats const *recPoolStatsGet(void)
+{
+    return &recPoolStats;
+}
+
+/**@brief Function to print pool counters */
+void recPoolReport(void)
+{
+    printf("RECPOOL allocs=%lu failures=%lu inUse=%u highWater=%u/%u\n\r",
+           recPoolStats.allocs,
+           recPoolStats.failures,
+           recPoolStats.inUse,
+           recPoolStats.highWater,
+           RECPOOL_SIZE);
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
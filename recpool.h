@@ -0,0 +1,51 @@
+/** @file       recpool.h
+ *  @brief      Advertising record pool, fixed blocks passed through the queue to the report stages
+ *  @author     Evren Kenanoglu
+ *  @date       4/23/2021
+ */
+#ifndef FILE_RECPOOL_H
+#define FILE_RECPOOL_H
+
+/** INCLUDES ******************************************************************/
+#include "parameters.h"
+#include "advqueue.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define RECPOOL_SIZE ADV_QUEUE_DEPTH // One block per queued record, the stages do not keep records
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Pool counters
+ *
+ */
+typedef struct
+{
+    uint32_t allocs;
+    uint32_t failures;  /**< Pool empty, report dropped */
+    uint8_t inUse;
+    uint8_t highWater;
+} tsRecPoolStats;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_RECPOOL_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE ret_code_t recPoolInit(void);
+INTERFACE tsAdvRecord *recPoolAlloc(void);
+INTERFACE void recPoolRelease(tsAdvRecord *record);
+INTERFACE tsRecPoolStats const *recPoolStatsGet(void);
+INTERFACE void recPoolReport(void);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_RECPOOL_H
@@ -0,0 +1,295 @@
+/** @file       rendezvous.c
+ *  @brief      Learned rendezvous, slave predicts the advertising schedule of the master
+ *  @author     Evren Kenanoglu
+ *  @date       4/9/2021
+ */
+#define FILE_RENDEZVOUS_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "rendezvous.h"
+
+/** CONSTANTS *****************************************************************/
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+#define RENDEZVOUS_US_TO_MS_CEIL(us) (((us) + 999) / 1000)
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void rendezvousTrack(tsRendezvous *rv, uint32_t time);
+static uint32_t rendezvousEventGet(tsRendezvous const *rv, int32_t n);
+static uint32_t rendezvousHalfWindowGet(tsRendezvous const *rv, int32_t n);
+
+/** VARIABLES *****************************************************************/
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize a rendezvous instance, starts in blind search
+ *
+ * @param rv        Rendezvous instance
+ * @param config    Configuration, copied
+ */
+void rendezvousInit(tsRendezvous *rv, tsRendezvousConfig const *config)
+{
+    memset(rv, 0, sizeof(*rv));
+    rv->config = *config;
+    if (rv->config.period > RENDEZVOUS_PERIOD_MAX_US)
+    {
+        rv->config.period = RENDEZVOUS_PERIOD_MAX_US; // Q24.8 period, configSanitize() keeps the cycle below it
+    }
+    rv->nominal = rv->config.period;
+    rv->state   = eRendezvousSearch;
+}
+
+/**
+ * @brief Function to drop the master schedule estimate and go back to blind search, keeps configuration
+ *        and statistics
+ */
+void rendezvousReset(tsRendezvous *rv)
+{
+    rv->state       = eRendezvousSearch;
+    rv->misses      = 0;
+    rv->windowArmed = 0;
+}
+
+/**
+ * @brief Function to be called with the master cycle published in the master schedule
+ *
+ * @param period Master cycle measured by the master, us
+ * @return true     period is taken, false: more than the period tolerance away from the nominal one
+ *
+ * @details The published period replaces the nominal one. A tracking estimate is re-seeded when the
+ *          master cycle changes, the tracker then only learns the clock drift between the two nodes.
+ */
+bool rendezvousPeriodPublished(tsRendezvous *rv, uint32_t period)
+{
+    if (period > RENDEZVOUS_PERIOD_MAX_US || period + rv->config.periodTolerance < rv->nominal ||
+        period > rv->nominal + rv->config.periodTolerance)
+    {
+        return false;
+    }
+    if (rv->published && period == rv->config.period)
+    {
+        return true;
+    }
+
+    rv->config.period = period;
+    rv->published     = 1;
+    if (rv->state == eRendezvousTracking)
+    {
+        rv->period      = period << RENDEZVOUS_PERIOD_FRACTION_BITS;
+        rv->uncertainty = rv->config.syncTolerance;
+    }
+    return true;
+}
+
+/**
+ * @brief Function to be called when a scan is started
+ *
+ * @param now Local time, us
+ */
+void rendezvousScanStart(tsRendezvous *rv, uint32_t now)
+{
+    rv->scanStart   = now;
+    rv->scanHit     = 0;
+    rv->scanWindow  = rv->windowArmed;
+    rv->windowArmed = 0;
+
+    rv->scans++;
+    if (rv->scanWindow)
+    {
+        rv->windows++;
+    }
+}
+
+/**
+ * @brief Function to be called for every master detection, only the earliest one of a scan is used
+ *
+ * @param time Local time of reception, us
+ */
+void rendezvousDetection(tsRendezvous *rv, uint32_t time)
+{
+    if (!rv->scanHit || (int32_t)(time - rv->scanFirst) < 0)
+    {
+        rv->scanFirst = time;
+    }
+    rv->scanHit = 1;
+}
+
+/**
+ * @brief Function to be called when a scan is stopped, updates the master schedule estimate
+ *
+ * @param now Local time, us
+ */
+void rendezvousScanEnd(tsRendezvous *rv, uint32_t now)
+{
+    rv->rxTime += now - rv->scanStart;
+
+    if (rv->scanHit)
+    {
+        if (rv->state == eRendezvousSearch)
+        {
+            rv->anchor      = rv->scanFirst;
+            rv->period      = rv->config.period << RENDEZVOUS_PERIOD_FRACTION_BITS;
+            rv->uncertainty = rv->published ? rv->config.syncTolerance : rv->config.periodTolerance;
+            rv->state       = eRendezvousTracking;
+        }
+        else
+        {
+            rendezvousTrack(rv, rv->scanFirst);
+        }
+
+        if (rv->scanWindow)
+        {
+            rv->hits++;
+        }
+        rv->misses = 0;
+        return;
+    }
+
+    if (rv->state == eRendezvousTracking && rv->scanWindow)
+    {
+        rv->misses++;
+        rv->uncertainty *= 2;
+        if (rv->misses >= rv->config.maxMisses)
+        {
+            rv->state = eRendezvousSearch; // Master is gone or the estimate is lost
+            rv->fallbacks++;
+        }
+    }
+}
+
+/**
+ * @brief Function to check if scans are scheduled on the master schedule
+ */
+bool rendezvousLocked(tsRendezvous const *rv)
+{
+    return rv->state == eRendezvousTracking;
+}
+
+/**
+ * @brief Function to get the sleep duration up to the next scheduled window
+ *
+ * @param now       Local time, us
+ * @param minSleep  Nominal sleep duration, ms
+ * @return uint32_t sleep duration in ms, minSleep while searching
+ *
+ * @details The window is placed on the first predicted master event that is at least minSleep away,
+ *          so the slave keeps its sleep ratio. The window widens with the number of periods since
+ *          the last hit. A window as wide as the period is no better than a blind scan, the estimate
+ *          falls back to blind search then. That also bounds the search for the event, the window start
+ *          moves by more than half a period per event while the window is narrower.
+ */
+uint32_t rendezvousSleepDurationGet(tsRendezvous *rv, uint32_t now, uint32_t minSleep)
+{
+    uint32_t earliest = now + minSleep * 1000;
+    uint32_t start;
+    int32_t n;
+
+    if (rv->state != eRendezvousTracking)
+    {
+        rv->windowArmed = 0;
+        return minSleep;
+    }
+
+    n = (int32_t)(((int64_t)(int32_t)(earliest - rv->anchor) << RENDEZVOUS_PERIOD_FRACTION_BITS) / rv->period);
+    for (n = (n > 1) ? n - 1 : 1;; n++)
+    {
+        if (2 * (uint64_t)rendezvousHalfWindowGet(rv, n) >= (rv->period >> RENDEZVOUS_PERIOD_FRACTION_BITS))
+        {
+            rv->state       = eRendezvousSearch;
+            rv->windowArmed = 0;
+            rv->fallbacks++;
+            return minSleep;
+        }
+        start = rendezvousEventGet(rv, n) - rendezvousHalfWindowGet(rv, n);
+        if ((int32_t)(start - earliest) >= 0)
+        {
+            break;
+        }
+    }
+
+    rv->window      = 2 * rendezvousHalfWindowGet(rv, n);
+    rv->windowArmed = 1;
+    return (start - now) / 1000; // Rounded down, the window is extended by the rest
+}
+
+/**
+ * @brief Function to get the duration of the current scan, to be called after rendezvousScanStart()
+ *
+ * @param blindScan Scan duration while searching, ms
+ * @return uint32_t scan duration in ms
+ */
+uint32_t rendezvousScanDurationGet(tsRendezvous *rv, uint32_t blindScan)
+{
+    if (!rv->scanWindow)
+    {
+        return blindScan;
+    }
+    return RENDEZVOUS_US_TO_MS_CEIL(rv->window) + 1; // +1: sleep rounding
+}
+
+/**@brief Function to print the estimate and scan statistics */
+void rendezvousReport(tsRendezvous const *rv)
+{
+    uint32_t periodUs = rv->period >> RENDEZVOUS_PERIOD_FRACTION_BITS;
+
+    printf("RENDEZVOUS %s period=%lu us window=%lu us scans=%lu windows=%lu hits=%lu fallbacks=%lu rx=%lu ms\n\r",
+           (rv->state == eRendezvousTracking) ? "tracking" : "search",
+           (unsigned long)periodUs,
+           (unsigned long)rv->window,
+           (unsigned long)rv->scans,
+           (unsigned long)rv->windows,
+           (unsigned long)rv->hits,
+           (unsigned long)rv->fallbacks,
+           (unsigned long)(rv->rxTime / 1000));
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**
+ * @brief Alpha-beta update of anchor (1/4) and period (1/8) with an observed master event
+ */
+static void rendezvousTrack(tsRendezvous *rv, uint32_t time)
+{
+    int64_t elapsed = (int64_t)(int32_t)(time - rv->anchor) << RENDEZVOUS_PERIOD_FRACTION_BITS;
+    int64_t half    = rv->period / 2;
+    int32_t n       = (int32_t)((elapsed >= 0 ? elapsed + half : elapsed - half) / (int64_t)rv->period);
+    uint32_t event  = rendezvousEventGet(rv, n);
+    int32_t error   = (int32_t)(time - event);
+
+    if (error > (int32_t)(rv->period >> (RENDEZVOUS_PERIOD_FRACTION_BITS + 2)) ||
+        -error > (int32_t)(rv->period >> (RENDEZVOUS_PERIOD_FRACTION_BITS + 2)))
+    {
+        // Not the tracked event (e.g. the next advertising event of the same master window), restart on it
+        rv->anchor      = time;
+        rv->uncertainty = rv->published ? rv->config.syncTolerance : rv->config.periodTolerance;
+        return;
+    }
+
+    if (n != 0)
+    {
+        rv->period += (int32_t)(((int64_t)error << RENDEZVOUS_PERIOD_FRACTION_BITS) / (8 * n));
+    }
+    rv->anchor      = event + error / 4;
+    rv->uncertainty = (rv->uncertainty / 2 > RENDEZVOUS_UNCERTAINTY_MIN_US) ? rv->uncertainty / 2 : RENDEZVOUS_UNCERTAINTY_MIN_US;
+}
+
+/**
+ * @brief Predicted time of the n-th master event after the anchor
+ */
+static uint32_t rendezvousEventGet(tsRendezvous const *rv, int32_t n)
+{
+    return rv->anchor + (uint32_t)(((int64_t)n * rv->period) >> RENDEZVOUS_PERIOD_FRACTION_BITS);
+}
+
+/**
+ * @brief Half window for the n-th master event: event spread, guard and accumulated period uncertainty
+ */
+static uint32_t rendezvousHalfWindowGet(tsRendezvous const *rv, int32_t n)
+{
+    return rv->config.jitter / 2 + rv->config.guard + (uint32_t)n * rv->uncertainty;
+}
@@ -0,0 +1,96 @@
+/** @file       rendezvous.h
+ *  @brief      Learned rendezvous, slave predicts the advertising schedule of the master
+ *  @author     Evren Kenanoglu
+ *  @date       4/9/2021
+ */
+#ifndef FILE_RENDEZVOUS_H
+#define FILE_RENDEZVOUS_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define RENDEZVOUS_PERIOD_FRACTION_BITS 8   // Period is kept in 1/256 us
+#define RENDEZVOUS_UNCERTAINTY_MIN_US   100 // Floor of the per period uncertainty (clock drift, timer latency)
+#define RENDEZVOUS_PERIOD_MAX_US        (UINT32_MAX >> RENDEZVOUS_PERIOD_FRACTION_BITS) // Largest period in 1/256 us
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eRendezvousSearch = 0, // Blind scans with the engine timings
+    eRendezvousTracking,   // Short scans centred on the predicted master advertising event
+} teRendezvousStates;
+
+/**
+ * @brief Rendezvous configuration, all times in us
+ *
+ */
+typedef struct
+{
+    uint32_t period;          /**< Nominal master cycle, scan + advertising timeout */
+    uint32_t jitter;          /**< Random advertising delay of the master, spread of the observed events */
+    uint32_t guard;           /**< Added on both sides of a window for timer and scan start latency */
+    uint32_t periodTolerance; /**< Initial uncertainty of the period, per period */
+    uint32_t syncTolerance;   /**< Initial uncertainty with a period published by the master, per period */
+    uint8_t maxMisses;        /**< Missed windows in a row before blind search */
+} tsRendezvousConfig;
+
+/**
+ * @brief Rendezvous state, times are in us of a free running local clock, compared wrap safe
+ *
+ */
+typedef struct
+{
+    tsRendezvousConfig config;
+    uint8_t state;       /**< teRendezvousStates */
+    uint8_t misses;      /**< Missed windows in a row */
+    uint8_t windowArmed; /**< Next scan is a scheduled window */
+    uint8_t scanWindow;  /**< Current scan is a scheduled window */
+    uint8_t scanHit;     /**< Master detected in the current scan */
+    uint8_t published;   /**< Period is published by the master (proto.c schedule) */
+    uint32_t nominal;     /**< Configured master cycle, published periods are checked against it */
+    uint32_t scanStart;
+    uint32_t scanFirst;   /**< Earliest detection in the current scan */
+    uint32_t anchor;      /**< Estimated time of a master advertising event */
+    uint32_t period;      /**< Estimated master period, 1/256 us */
+    uint32_t uncertainty; /**< Period uncertainty, per period */
+    uint32_t window;      /**< Length of the armed window */
+
+    /** Statistics **/
+    uint32_t scans;
+    uint32_t windows;
+    uint32_t hits;
+    uint32_t fallbacks;
+    uint64_t rxTime; /**< Total scan time */
+} tsRendezvous;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_RENDEZVOUS_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void rendezvousInit(tsRendezvous *rv, tsRendezvousConfig const *config);
+INTERFACE void rendezvousReset(tsRendezvous *rv);
+INTERFACE bool rendezvousPeriodPublished(tsRendezvous *rv, uint32_t period);
+INTERFACE void rendezvousScanStart(tsRendezvous *rv, uint32_t now);
+INTERFACE void rendezvousDetection(tsRendezvous *rv, uint32_t time);
+INTERFACE void rendezvousScanEnd(tsRendezvous *rv, uint32_t now);
+INTERFACE bool rendezvousLocked(tsRendezvous const *rv);
+INTERFACE uint32_t rendezvousSleepDurationGet(tsRendezvous *rv, uint32_t now, uint32_t minSleep);
+INTERFACE uint32_t rendezvousScanDurationGet(tsRendezvous *rv, uint32_t blindScan);
+INTERFACE void rendezvousReport(tsRendezvous const *rv);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_RENDEZVOUS_H
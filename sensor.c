@@ -0,0 +1,471 @@
+/** @file       sensor.c
+ *  @brief      SAADC sampling pipeline, decimated readings for the slave advertising payload
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ *
+ *  PPI trigger: RTC2 compare starts every sample through PPI, the SAADC oversamples in burst and
+ *  writes the result into one of two EasyDMA buffers. The END event restarts the SAADC on the other
+ *  buffer through PPI, the CPU only wakes up for a full buffer and averages it into one reading.
+ *  The STARTED event of that restart hands the next buffer over, it is mostly taken in the same wake up.
+ *  The SoftDevice only gives the application plain PPI channels (no fork), RTC2 is cleared by a
+ *  second channel on the same compare event.
+ *  Software trigger: an app_timer callback starts every sample, the END interrupt averages and
+ *  restarts, two wake ups per sample. Kept for comparison and for the chips without RTC2.
+ *
+ *  Both keep their wake ups and CPU cycles apart, "sensor" in the console and the SENSOR lines
+ *  give the charge of one sample with the current model of energy.h. The readings are packed into
+ *  the advertising data right before each advertising phase (sensorPayloadGet()).
+ *  The pipeline runs in System ON only, a System OFF deep sleep restarts it at the warm boot.
+ *  Nothing waits on the SAADC: calibration, stop and start complete in the SAADC interrupt.
+ */
+#define FILE_SENSOR_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "sensor.h"
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nordic_common.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "energy.h"
+
+/** CONSTANTS *****************************************************************/
+#define SENSOR_CORE_CLOCK_MHZ 64    // Cycle counter
+#define SENSOR_RTC_FREQUENCY  32768 // Hz, RTC2 without prescaler
+#define SENSOR_CONVERSION_US  2     // Conversion after the acquisition
+#define SENSOR_SAMPLE_US      ((SENSOR_ACQ_US + SENSOR_CONVERSION_US) << SENSOR_OVERSAMPLE) // SAADC busy for one sample
+#define SENSOR_READING_MAX    (PROTO_SENSOR_NONE - 1)
+
+#define SENSOR_PPI_SAMPLE  (SENSOR_PPI_CHANNEL)     // RTC2 COMPARE[0] -> SAADC SAMPLE
+#define SENSOR_PPI_PERIOD  (SENSOR_PPI_CHANNEL + 1) // RTC2 COMPARE[0] -> RTC2 CLEAR
+#define SENSOR_PPI_RESTART (SENSOR_PPI_CHANNEL + 2) // SAADC END -> SAADC START, next buffer
+#define SENSOR_PPI_MASK    ((1UL << SENSOR_PPI_SAMPLE) | (1UL << SENSOR_PPI_PERIOD) | (1UL << SENSOR_PPI_RESTART))
+
+#if SENSOR_ACQ_US == 3
+#define SENSOR_TACQ SAADC_CH_CONFIG_TACQ_3us
+#elif SENSOR_ACQ_US == 5
+#define SENSOR_TACQ SAADC_CH_CONFIG_TACQ_5us
+#elif SENSOR_ACQ_US == 10
+#define SENSOR_TACQ SAADC_CH_CONFIG_TACQ_10us
+#elif SENSOR_ACQ_US == 15
+#define SENSOR_TACQ SAADC_CH_CONFIG_TACQ_15us
+#elif SENSOR_ACQ_US == 20
+#define SENSOR_TACQ SAADC_CH_CONFIG_TACQ_20us
+#elif SENSOR_ACQ_US == 40
+#define SENSOR_TACQ SAADC_CH_CONFIG_TACQ_40us
+#else
+#error "SENSOR_ACQ_US is 3, 5, 10, 15, 20 or 40"
+#endif
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+static tsSensorParams sensorParams;
+
+static const char *const sensorTriggerNames[eSensorTriggerCount] =
+    {
+        "ppi",
+        "software",
+};
+
+APP_TIMER_DEF(sensorTimer);
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static ret_code_t sensorTriggerStop(void);
+#if SENSOR_ENABLE
+static ret_code_t sensorStart(void);
+static void sensorReadingPut(uint32_t sum, uint16_t count);
+#endif
+static void tcbSensorSample(void *p_context);
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize the SAADC, RTC2 and the PPI channels and start sampling
+ *
+ * @details The offset calibration is started here, the SAADC interrupt starts the trigger once it is
+ *          done. Has to be called after the SoftDevice is enabled.
+ *
+ * @return ret_code_t returns error code
+ */
+ret_code_t sensorInit(void)
+{
+    ret_code_t errCode;
+
+    memset(&sensorParams, 0, sizeof(sensorParams));
+    for (uint8_t i = 0; i < PROTO_SENSOR_SLOTS; i++)
+    {
+        sensorParams.readings[i] = PROTO_SENSOR_NONE;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Cost of the pipeline, the CPU monitor may be off
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    errCode = app_timer_create(&sensorTimer, APP_TIMER_MODE_REPEATED, tcbSensorSample);
+    VERIFY_SUCCESS(errCode);
+
+    NRF_SAADC->RESOLUTION   = SAADC_RESOLUTION_VAL_12bit;
+    NRF_SAADC->OVERSAMPLE   = SENSOR_OVERSAMPLE;
+    NRF_SAADC->CH[0].PSELP  = SAADC_CH_PSELP_PSELP_AnalogInput0 + SENSOR_INPUT; // VDD follows AIN7
+    NRF_SAADC->CH[0].PSELN  = SAADC_CH_PSELN_PSELN_NC;
+    NRF_SAADC->CH[0].CONFIG = (SAADC_CH_CONFIG_GAIN_Gain1_6 << SAADC_CH_CONFIG_GAIN_Pos) |        // 0..3.6 V
+                              (SAADC_CH_CONFIG_REFSEL_Internal << SAADC_CH_CONFIG_REFSEL_Pos) |
+                              (SENSOR_TACQ << SAADC_CH_CONFIG_TACQ_Pos) |
+                              (SAADC_CH_CONFIG_MODE_SE << SAADC_CH_CONFIG_MODE_Pos) |
+                              (SAADC_CH_CONFIG_BURST_Enabled << SAADC_CH_CONFIG_BURST_Pos); // One SAMPLE, all conversions
+    NRF_SAADC->INTENCLR     = 0xFFFFFFFF;
+    NRF_SAADC->INTENSET     = SAADC_INTENSET_END_Msk | SAADC_INTENSET_CALIBRATEDONE_Msk | SAADC_INTENSET_STOPPED_Msk;
+    NRF_SAADC->ENABLE       = SAADC_ENABLE_ENABLE_Enabled << SAADC_ENABLE_ENABLE_Pos;
+
+    errCode = sd_nvic_SetPriority(SAADC_IRQn, APP_IRQ_PRIORITY_LOW); // Same level as app_timer, no preemption between the two
+    VERIFY_SUCCESS(errCode);
+
+    errCode = sd_nvic_ClearPendingIRQ(SAADC_IRQn);
+    VERIFY_SUCCESS(errCode);
+
+    errCode = sd_nvic_EnableIRQ(SAADC_IRQn);
+    VERIFY_SUCCESS(errCode);
+
+#if CAPS_RTC2
+    NRF_RTC2->PRESCALER = 0;
+    NRF_RTC2->CC[0]     = (uint32_t)(((uint64_t)SENSOR_PERIOD_MS * SENSOR_RTC_FREQUENCY) / 1000);
+    NRF_RTC2->EVTENSET  = RTC_EVTEN_COMPARE0_Msk; // Routed to PPI, no interrupt
+
+    errCode = sd_ppi_channel_assign(SENSOR_PPI_SAMPLE, &NRF_RTC2->EVENTS_COMPARE[0], &NRF_SAADC->TASKS_SAMPLE);
+    VERIFY_SUCCESS(errCode);
+
+    errCode = sd_ppi_channel_assign(SENSOR_PPI_PERIOD, &NRF_RTC2->EVENTS_COMPARE[0], &NRF_RTC2->TASKS_CLEAR);
+    VERIFY_SUCCESS(errCode);
+
+    errCode = sd_ppi_channel_assign(SENSOR_PPI_RESTART, &NRF_SAADC->EVENTS_END, &NRF_SAADC->TASKS_START);
+    VERIFY_SUCCESS(errCode);
+#endif
+
+    sensorParams.trigger = SENSOR_TRIGGER;
+    sensorParams.state   = eSensorStateCalibrating;
+
+    NRF_SAADC->EVENTS_CALIBRATEDONE  = 0;
+    NRF_SAADC->TASKS_CALIBRATEOFFSET = 1; // A few ms, once at boot
+    return NRF_SUCCESS;
+}
+
+/**
+ * @brief Function to switch the trigger of the samples
+ *
+ * @details The reading in progress is dropped, the readings of the payload and the statistics are kept.
+ *          The SAADC is stopped here, the new trigger starts in the STOPPED interrupt.
+ *
+ * @param trigger   teSensorTriggers
+ * @return ret_code_t returns error code, NRF_ERROR_NOT_SUPPORTED: PPI trigger on a chip without RTC2
+ */
+ret_code_t sensorTriggerSet(uint8_t trigger)
+{
+    ret_code_t errCode = NRF_SUCCESS;
+
+    if (trigger >= eSensorTriggerCount)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (!CAPS_RTC2 && trigger == eSensorTriggerPpi)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+
+    CRITICAL_REGION_ENTER(); // The SAADC interrupt starts with the trigger it finds
+    if (sensorParams.state == eSensorStateRunning)
+    {
+        errCode               = sensorTriggerStop();
+        sensorParams.state    = eSensorStateStopping;
+        NRF_SAADC->TASKS_STOP = 1; // A conversion in progress is finished first
+    }
+    sensorParams.trigger = trigger;
+    CRITICAL_REGION_EXIT();
+
+    return errCode;
+}
+
+/**
+ * @brief Function to encode the latest readings for the advertising data
+ *
+ * @param buffer    At least PROTO_SENSOR_SIZE bytes
+ * @return uint8_t encoded length
+ */
+uint8_t sensorPayloadGet(uint8_t *buffer)
+{
+    tsProtoSensor sensor;
+
+    CRITICAL_REGION_ENTER();
+    memcpy(sensor.readings, sensorParams.readings, sizeof(sensor.readings));
+    CRITICAL_REGION_EXIT();
+
+    return protoSensorEncode(&sensor, buffer);
+}
+
+/**@brief Function to clear the statistics of both triggers */
+void sensorStatsReset(void)
+{
+    CRITICAL_REGION_ENTER();
+    memset(sensorParams.stats, 0, sizeof(sensorParams.stats));
+    CRITICAL_REGION_EXIT();
+}
+
+/**
+ * @brief Function to get the pipeline state
+ *
+ * @return tsSensorParams const* pipeline state
+ */
+tsSensorParams const *sensorStatsGet(void)
+{
+    return &sensorParams;
+}
+
+/**
+ * @brief Function to get the name of a trigger, as the console takes it
+ *
+ * @param trigger   teSensorTriggers
+ * @return char const* name
+ */
+char const *sensorTriggerNameGet(uint8_t trigger)
+{
+    return (trigger < eSensorTriggerCount) ? sensorTriggerNames[trigger] : "unknown";
+}
+
+/**
+ * @brief Function to estimate the charge of one sample with a trigger
+ *
+ * @details CPU time of the pipeline plus a wake up overhead per interrupt at the CPU current,
+ *          conversions at the SAADC current. The SAADC part is the same for both triggers.
+ *
+ * @param trigger   teSensorTriggers
+ * @return uint32_t pC per sample, 0 without samples
+ */
+uint32_t sensorChargeGet(uint8_t trigger)
+{
+    tsSensorStats stats;
+    uint64_t charge;
+
+    if (trigger >= eSensorTriggerCount)
+    {
+        return 0;
+    }
+
+    CRITICAL_REGION_ENTER();
+    stats = sensorParams.stats[trigger];
+    CRITICAL_REGION_EXIT();
+
+    if (stats.samples == 0)
+    {
+        return 0;
+    }
+
+    charge = stats.cpuCycles * ENERGY_CURRENT_CPU_UA / SENSOR_CORE_CLOCK_MHZ + // uA x us = pC
+             (uint64_t)stats.wakeups * ENERGY_WAKEUP_US * ENERGY_CURRENT_CPU_UA +
+             (uint64_t)stats.samples * SENSOR_SAMPLE_US * ENERGY_CURRENT_SAADC_UA;
+
+    return (uint32_t)(charge / stats.samples);
+}
+
+/**@brief Function to print the pipeline cost of the triggers that ran, SENSOR lines */
+void sensorReport(void)
+{
+    for (uint8_t trigger = 0; trigger < eSensorTriggerCount; trigger++)
+    {
+        tsSensorStats const *stats = &sensorParams.stats[trigger];
+
+        if (stats->samples == 0)
+        {
+            continue;
+        }
+
+        printf("SENSOR,trigger=%s,samples=%lu,readings=%lu,wakeups=%lu,wakeups_per_k=%lu,cycles_per_sample=%lu,pc_per_sample=%lu,reading=%u\n\r",
+               sensorTriggerNames[trigger],
+               (unsigned long)stats->samples,
+               (unsigned long)stats->readings,
+               (unsigned long)stats->wakeups,
+               (unsigned long)(((uint64_t)stats->wakeups * 1000) / stats->samples),
+               (unsigned long)(stats->cpuCycles / stats->samples),
+               (unsigned long)sensorChargeGet(trigger),
+               sensorParams.readings[0]);
+    }
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief Stops the trigger, the SAADC runs until its STOP task */
+static ret_code_t sensorTriggerStop(void)
+{
+    ret_code_t errCode = NRF_SUCCESS;
+
+    if (sensorParams.trigger == eSensorTriggerPpi)
+    {
+#if CAPS_RTC2
+        NRF_RTC2->TASKS_STOP = 1;
+        errCode = sd_ppi_channel_enable_clr(SENSOR_PPI_MASK);
+#endif
+    }
+    else
+    {
+        errCode = app_timer_stop(sensorTimer);
+    }
+
+    return errCode;
+}
+
+/**@brief Software trigger, one sample per period */
+static void tcbSensorSample(void *p_context)
+{
+    uint32_t startCycles = DWT->CYCCNT;
+    tsSensorStats *stats = &sensorParams.stats[eSensorTriggerSoftware];
+
+    if (sensorParams.state != eSensorStateRunning)
+    {
+        return; // Expired while the trigger was switched
+    }
+    NRF_SAADC->TASKS_SAMPLE = 1;
+
+    stats->wakeups++;
+    stats->cpuCycles += DWT->CYCCNT - startCycles;
+}
+
+#if SENSOR_ENABLE // The vector table would keep the pipeline in the image
+/**@brief Starts the SAADC on the first buffer, then the trigger, SAADC stopped */
+static ret_code_t sensorStart(void)
+{
+    ret_code_t errCode = NRF_SUCCESS;
+
+    sensorParams.bufferFilling = 0;
+    sensorParams.sum           = 0;
+    sensorParams.count         = 0;
+
+    NRF_SAADC->RESULT.PTR    = (uint32_t)sensorParams.buffer[0];
+    NRF_SAADC->RESULT.MAXCNT = (sensorParams.trigger == eSensorTriggerPpi) ? SENSOR_DECIMATION : 1;
+
+    if (sensorParams.trigger == eSensorTriggerPpi)
+    {
+#if CAPS_RTC2
+        NRF_SAADC->INTENSET    = SAADC_INTENSET_STARTED_Msk; // Next buffer, once the running one is taken
+        NRF_SAADC->TASKS_START = 1;
+
+        NRF_RTC2->TASKS_CLEAR       = 1;
+        NRF_RTC2->EVENTS_COMPARE[0] = 0;
+        errCode = sd_ppi_channel_enable_set(SENSOR_PPI_MASK);
+        VERIFY_SUCCESS(errCode);
+        NRF_RTC2->TASKS_START = 1;
+#endif
+    }
+    else
+    {
+        NRF_SAADC->INTENCLR    = SAADC_INTENCLR_STARTED_Msk; // Same buffer for every sample
+        NRF_SAADC->TASKS_START = 1;
+
+        errCode = app_timer_start(sensorTimer, APP_TIMER_TICKS(SENSOR_PERIOD_MS), NULL);
+        VERIFY_SUCCESS(errCode);
+    }
+
+    sensorParams.state = eSensorStateRunning;
+    return errCode;
+}
+
+/**@brief Decimation, average of count samples as the newest reading */
+static void sensorReadingPut(uint32_t sum, uint16_t count)
+{
+    for (uint8_t i = PROTO_SENSOR_SLOTS - 1; i > 0; i--)
+    {
+        sensorParams.readings[i] = sensorParams.readings[i - 1];
+    }
+    sensorParams.readings[0] = (uint16_t)MIN((sum + count / 2) / count, SENSOR_READING_MAX);
+    sensorParams.stats[sensorParams.trigger].readings++;
+}
+
+/**
+ * @brief SAADC interrupt, calibration done, stopped, a buffer is full or the next one started
+ *
+ * @details Calibration done: the SAADC is stopped, calibration leaves it started.
+ *          Stopped: the trigger in sensorParams starts.
+ *          PPI trigger: the END event has already restarted the SAADC on the other buffer through PPI,
+ *          the full one is averaged into a reading. The STARTED event of that restart hands the full
+ *          buffer back for the START after the next END.
+ *          Software trigger: one sample, restarted here.
+ */
+void SAADC_IRQHandler(void)
+{
+    uint32_t startCycles = DWT->CYCCNT;
+    tsSensorStats *stats = &sensorParams.stats[sensorParams.trigger];
+    bool started;
+    bool end;
+
+    if (NRF_SAADC->EVENTS_CALIBRATEDONE != 0)
+    {
+        NRF_SAADC->EVENTS_CALIBRATEDONE = 0;
+        sensorParams.state              = eSensorStateStopping;
+        NRF_SAADC->TASKS_STOP           = 1;
+    }
+    if (NRF_SAADC->EVENTS_STOPPED != 0)
+    {
+        NRF_SAADC->EVENTS_STOPPED = 0;
+        NRF_SAADC->EVENTS_STARTED = 0;
+        NRF_SAADC->EVENTS_END     = 0;
+        APP_ERROR_CHECK(sensorStart());
+        return;
+    }
+    if (sensorParams.state != eSensorStateRunning)
+    {
+        NRF_SAADC->EVENTS_STARTED = 0; // Conversion cut by the stop
+        NRF_SAADC->EVENTS_END     = 0;
+        return;
+    }
+
+    // STARTED first: a STARTED seen here always has its END seen too, the END is handled first
+    started = (sensorParams.trigger == eSensorTriggerPpi) && (NRF_SAADC->EVENTS_STARTED != 0);
+    end     = (NRF_SAADC->EVENTS_END != 0);
+    if (!started && !end)
+    {
+        return;
+    }
+
+    if (end)
+    {
+        NRF_SAADC->EVENTS_END = 0;
+
+        if (sensorParams.trigger == eSensorTriggerPpi)
+        {
+            int16_t const *full = sensorParams.buffer[sensorParams.bufferFilling];
+            uint32_t sum        = 0;
+
+            sensorParams.bufferFilling ^= 1;
+            for (uint16_t i = 0; i < SENSOR_DECIMATION; i++)
+            {
+                sum += (uint32_t)MAX(full[i], 0); // Single ended, a few codes below 0 V
+            }
+            stats->samples += SENSOR_DECIMATION;
+            sensorReadingPut(sum, SENSOR_DECIMATION);
+        }
+        else
+        {
+            sensorParams.sum += (uint32_t)MAX(sensorParams.buffer[0][0], 0);
+            NRF_SAADC->TASKS_START = 1; // Same buffer for the next sample
+
+            stats->samples++;
+            if (++sensorParams.count == SENSOR_DECIMATION)
+            {
+                sensorReadingPut(sensorParams.sum, SENSOR_DECIMATION);
+                sensorParams.sum   = 0;
+                sensorParams.count = 0;
+            }
+        }
+    }
+    if (started)
+    {
+        NRF_SAADC->EVENTS_STARTED = 0;
+        NRF_SAADC->RESULT.PTR     = (uint32_t)sensorParams.buffer[sensorParams.bufferFilling ^ 1]; // Running pointer taken
+    }
+
+    stats->wakeups++;
+    stats->cpuCycles += DWT->CYCCNT - startCycles;
+}
+#endif
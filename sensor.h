@@ -0,0 +1,92 @@
+/** @file       sensor.h
+ *  @brief      SAADC sampling pipeline, decimated readings for the slave advertising payload
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ */
+#ifndef FILE_SENSOR_H
+#define FILE_SENSOR_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+#include "app_util.h"
+#include "sdk_errors.h"
+#include "proto.h"
+
+/** CONSTANTS *****************************************************************/
+
+// Flags, full slave name, manufacturer specific data header and company identifier, then the readings
+#if SENSOR_ENABLE
+STATIC_ASSERT(3 + 2 + (sizeof(DEVICE_NAME_SLAVE) - 1) + 2 + 2 + PROTO_SENSOR_SIZE <= 31);
+#endif
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eSensorTriggerPpi      = SENSOR_TRIGGER_PPI,
+    eSensorTriggerSoftware = SENSOR_TRIGGER_SOFTWARE,
+    eSensorTriggerCount,
+} teSensorTriggers;
+
+typedef enum
+{
+    eSensorStateIdle,
+    eSensorStateCalibrating, /**< Offset calibration, then stopped */
+    eSensorStateStopping,    /**< The STOPPED interrupt starts the trigger */
+    eSensorStateRunning,
+} teSensorStates;
+
+/**
+ * @brief Cost of the pipeline with one trigger, counted while it runs
+ *
+ */
+typedef struct
+{
+    uint32_t samples;   /**< SAADC samples, 2^SENSOR_OVERSAMPLE conversions each */
+    uint32_t readings;  /**< Decimated readings */
+    uint32_t wakeups;   /**< Pipeline interrupts and timer callbacks */
+    uint64_t cpuCycles; /**< CPU cycles spent in them */
+} tsSensorStats;
+
+/**
+ * @brief Sampling pipeline state
+ *
+ */
+typedef struct
+{
+    tsSensorStats stats[eSensorTriggerCount];
+    uint8_t trigger;                       /**< teSensorTriggers */
+    uint8_t state;                         /**< teSensorStates */
+    int16_t buffer[2][SENSOR_DECIMATION];  /**< EasyDMA buffers, one is converted while the other is averaged */
+    uint8_t bufferFilling;                 /**< Buffer the SAADC is writing */
+    uint32_t sum;                          /**< Software trigger: samples of the current reading */
+    uint16_t count;
+    uint16_t readings[PROTO_SENSOR_SLOTS]; /**< Newest first */
+} tsSensorParams;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_SENSOR_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE ret_code_t sensorInit(void);
+INTERFACE ret_code_t sensorTriggerSet(uint8_t trigger);
+INTERFACE uint8_t sensorPayloadGet(uint8_t *buffer);
+INTERFACE void sensorStatsReset(void);
+INTERFACE tsSensorParams const *sensorStatsGet(void);
+INTERFACE char const *sensorTriggerNameGet(uint8_t trigger);
+INTERFACE uint32_t sensorChargeGet(uint8_t trigger);
+INTERFACE void sensorReport(void);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_SENSOR_H
@@ -0,0 +1,93 @@
+/** @file       slot.c
+ *  @brief      Slotted slave responses, response slot from the slave address and the master slot map
+ *  @author     Evren Kenanoglu
+ *  @date       4/16/2021
+ */
+#define FILE_SLOT_C
+
+/** INCLUDES ******************************************************************/
+#include "slot.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define SLOT_FNV_OFFSET 2166136261u
+#define SLOT_FNV_PRIME  16777619u
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+
+/** VARIABLES *****************************************************************/
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to hash a device address with a seed, FNV-1a with a final avalanche
+ *
+ * @param addr  SLOT_ADDR_LEN bytes
+ * @param seed  Slot map seed
+ * @return uint32_t hash
+ */
+uint32_t slotHash(uint8_t const *addr, uint16_t seed)
+{
+    uint32_t hash = SLOT_FNV_OFFSET;
+
+    hash = (hash ^ (uint8_t)seed) * SLOT_FNV_PRIME;
+    hash = (hash ^ (uint8_t)(seed >> 8)) * SLOT_FNV_PRIME;
+    for (uint8_t i = 0; i < SLOT_ADDR_LEN; i++)
+    {
+        hash = (hash ^ addr[i]) * SLOT_FNV_PRIME;
+    }
+
+    // Consecutive addresses only differ in the last byte
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bu;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+/**
+ * @brief Function to get the response slot of a slave in the current master cycle
+ *
+ * @param slots Slot map of the master cycle
+ * @param addr  Slave address
+ * @param delay Start of the slot, ms from the first master advertising event
+ * @return true the slave responds in this cycle
+ *
+ * @details Every slave gets one of count * frameCycles slots of a frame, the map changes with the
+ *          seed so colliding slaves are separated in the next frame.
+ */
+bool slotDelayGet(tsProtoSlots const *slots, uint8_t const *addr, uint32_t *delay)
+{
+    uint32_t slot;
+
+    if (slots->count == 0 || slots->frameCycles == 0)
+    {
+        return false;
+    }
+
+    slot = slotHash(addr, slots->seed) % ((uint32_t)slots->count * slots->frameCycles);
+    if (slot / slots->count != slots->framePosition)
+    {
+        return false;
+    }
+
+    *delay = slots->offset + (slot % slots->count) * slots->length;
+    return true;
+}
+
+/**
+ * @brief Function to get the slot map seed of a frame, master side
+ *
+ * @param addr  Master address
+ * @param frame Frame counter
+ */
+uint16_t slotSeedGet(uint8_t const *addr, uint32_t frame)
+{
+    return (uint16_t)(slotHash(addr, (uint16_t)frame) ^ (frame >> 16));
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
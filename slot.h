@@ -0,0 +1,39 @@
+/** @file       slot.h
+ *  @brief      Slotted slave responses, response slot from the slave address and the master slot map
+ *  @author     Evren Kenanoglu
+ *  @date       4/16/2021
+ */
+#ifndef FILE_SLOT_H
+#define FILE_SLOT_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+#include "proto.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define SLOT_ADDR_LEN 6 // BLE_GAP_ADDR_LEN
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_SLOT_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE uint32_t slotHash(uint8_t const *addr, uint16_t seed);
+INTERFACE bool slotDelayGet(tsProtoSlots const *slots, uint8_t const *addr, uint32_t *delay);
+INTERFACE uint16_t slotSeedGet(uint8_t const *addr, uint32_t frame);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_SLOT_H
@@ -0,0 +1,595 @@
+/** @file       stream.c
+ *  @brief      GATT streaming service, scan records as notifications to a connected phone or gateway
+ *  @author     Evren Kenanoglu
+ *  @date       4/20/2021
+ */
+#define FILE_STREAM_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "stream.h"
+#include "ble_srv_common.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define STREAM_TICK_FREQUENCY (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void streamPump(tsStream *stream);
+static void streamTxComplete(tsStream *stream, uint8_t count);
+static void streamStatsUpdate(tsStream *stream);
+static void streamLinkRequest(tsStream *stream);
+static void streamDisconnected(tsStream *stream);
+static void streamWindowUpdate(tsStream *stream);
+static bool streamActive(tsStream const *stream);
+#if COC_ENABLE
+static void streamSduPump(tsStream *stream);
+static void streamSduDone(void *context, uint16_t connHandle, uint16_t length);
+static void streamChannelChanged(void *context, uint16_t connHandle, bool open);
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to register the streaming service
+ *
+ * @param stream    Stream instance
+ * @return ret_code_t SoftDevice error
+ *
+ * @details Has to be called after the SoftDevice is enabled.
+ */
+ret_code_t streamInit(tsStream *stream)
+{
+    ret_code_t errCode;
+    ble_uuid128_t base = {STREAM_UUID_BASE};
+    ble_uuid_t uuid;
+    ble_add_char_params_t charParams;
+
+    memset(stream, 0, sizeof(*stream));
+    stream->connHandle = BLE_CONN_HANDLE_INVALID;
+    stream->payloadMax = BLE_GATT_ATT_MTU_DEFAULT - 3;
+#if COC_ENABLE
+    tsCocHandlers const handlers = {.txDone = streamSduDone, .stateChanged = streamChannelChanged, .context = stream};
+
+    cocInit(&stream->coc, &handlers);
+#endif
+
+    errCode = sd_ble_uuid_vs_add(&base, &stream->uuidType);
+    VERIFY_SUCCESS(errCode);
+
+    uuid.type = stream->uuidType;
+    uuid.uuid = STREAM_UUID_SERVICE;
+    errCode   = sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &uuid, &stream->serviceHandle);
+    VERIFY_SUCCESS(errCode);
+
+    // Records, notify only
+    memset(&charParams, 0, sizeof(charParams));
+    charParams.uuid              = STREAM_UUID_RECORDS;
+    charParams.uuid_type         = stream->uuidType;
+    charParams.max_len           = STREAM_PAYLOAD_MAX;
+    charParams.is_var_len        = true;
+    charParams.char_props.notify = 1;
+    charParams.cccd_write_access = SEC_OPEN;
+    errCode                      = characteristic_add(stream->serviceHandle, &charParams, &stream->recordsHandles);
+    VERIFY_SUCCESS(errCode);
+
+    // Control, teStreamModes
+    memset(&charParams, 0, sizeof(charParams));
+    charParams.uuid                     = STREAM_UUID_CONTROL;
+    charParams.uuid_type                = stream->uuidType;
+    charParams.max_len                  = 1;
+    charParams.init_len                 = 1;
+    charParams.char_props.write         = 1;
+    charParams.char_props.write_wo_resp = 1;
+    charParams.write_access             = SEC_OPEN;
+    errCode                             = characteristic_add(stream->serviceHandle, &charParams, &stream->controlHandles);
+    VERIFY_SUCCESS(errCode);
+
+    // Stats, tsStreamStats little endian
+    memset(&charParams, 0, sizeof(charParams));
+    charParams.uuid            = STREAM_UUID_STATS;
+    charParams.uuid_type       = stream->uuidType;
+    charParams.max_len         = STREAM_STATS_SIZE;
+    charParams.init_len        = STREAM_STATS_SIZE;
+    charParams.char_props.read = 1;
+    charParams.read_access     = SEC_OPEN;
+    errCode                    = characteristic_add(stream->serviceHandle, &charParams, &stream->statsHandles);
+    VERIFY_SUCCESS(errCode);
+
+    return errCode;
+}
+
+/**
+ * @brief Function to handle the BLE events of the streaming link
+ *
+ * @param stream    Stream instance
+ * @param bleEvent  SoftDevice event
+ *
+ * @details Runs in SoftDevice interrupt context. MTU and data length are negotiated by nrf_ble_gatt
+ *          (streamGattEventHandler), PHY and connection interval are requested here.
+ */
+void streamBleEventHandler(tsStream *stream, ble_evt_t const *bleEvent)
+{
+#if COC_ENABLE
+    if (bleEvent->evt.l2cap_evt.conn_handle == stream->connHandle) // Same place in GAP and L2CAP events
+    {
+        cocBleEventHandler(&stream->coc, bleEvent);
+    }
+#endif
+
+    switch (bleEvent->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            if (bleEvent->evt.gap_evt.params.connected.role == BLE_GAP_ROLE_PERIPH)
+            {
+                stream->connHandle         = bleEvent->evt.gap_evt.conn_handle;
+                stream->stats.connInterval = bleEvent->evt.gap_evt.params.connected.conn_params.max_conn_interval;
+                stream->stats.phy          = BLE_GAP_PHY_1MBPS;
+                stream->stats.dataLength   = BLE_GAP_DATA_LENGTH_DEFAULT;
+                stream->stats.attMtu       = BLE_GATT_ATT_MTU_DEFAULT;
+                streamLinkRequest(stream);
+            }
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            if (bleEvent->evt.gap_evt.conn_handle == stream->connHandle)
+            {
+                streamDisconnected(stream);
+            }
+            break;
+
+        case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
+        {
+            ble_gap_phys_t const phys = {.tx_phys = BLE_GAP_PHY_AUTO, .rx_phys = BLE_GAP_PHY_AUTO};
+
+            APP_ERROR_CHECK(sd_ble_gap_phy_update(bleEvent->evt.gap_evt.conn_handle, &phys));
+        }
+        break;
+
+        case BLE_GAP_EVT_PHY_UPDATE:
+            if (bleEvent->evt.gap_evt.params.phy_update.status == BLE_HCI_STATUS_CODE_SUCCESS &&
+                bleEvent->evt.gap_evt.conn_handle == stream->connHandle) // Not a harvest link of the master
+            {
+                stream->stats.phy = bleEvent->evt.gap_evt.params.phy_update.tx_phy;
+            }
+            break;
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+            if (bleEvent->evt.gap_evt.conn_handle != stream->connHandle)
+            {
+                break;
+            }
+            stream->stats.connInterval = bleEvent->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval;
+            break;
+
+        case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
+            APP_ERROR_CHECK(sd_ble_gap_sec_params_reply(bleEvent->evt.gap_evt.conn_handle, BLE_GAP_SEC_STATUS_PAIRING_NOT_SUPP, NULL, NULL));
+            break;
+
+        case BLE_GATTS_EVT_SYS_ATTR_MISSING:
+            APP_ERROR_CHECK(sd_ble_gatts_sys_attr_set(bleEvent->evt.gatts_evt.conn_handle, NULL, 0, 0));
+            break;
+
+        case BLE_GATTS_EVT_WRITE:
+        {
+            ble_gatts_evt_write_t const *write = &bleEvent->evt.gatts_evt.params.write;
+
+            if (write->handle == stream->recordsHandles.cccd_handle && write->len == 2)
+            {
+                stream->notifyEnabled = ble_srv_is_notification_enabled(write->data);
+                stream->windowStart   = app_timer_cnt_get();
+                stream->windowBytes   = 0;
+                streamPump(stream);
+            }
+            else if (write->handle == stream->controlHandles.value_handle && write->len == 1)
+            {
+                stream->mode = (write->data[0] == eStreamModeBulk) ? eStreamModeBulk : eStreamModeRecords;
+                streamPump(stream);
+            }
+        }
+        break;
+
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+            if (bleEvent->evt.gatts_evt.conn_handle == stream->connHandle)
+            {
+                streamTxComplete(stream, bleEvent->evt.gatts_evt.params.hvn_tx_complete.count);
+                streamPump(stream);
+            }
+            break;
+
+        case BLE_GATTC_EVT_TIMEOUT:
+        case BLE_GATTS_EVT_TIMEOUT:
+            if (bleEvent->evt.gattc_evt.conn_handle == stream->connHandle)
+            {
+                sd_ble_gap_disconnect(stream->connHandle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Function to handle nrf_ble_gatt events, ATT MTU and data length of the link
+ *
+ * @param stream    Stream instance
+ * @param gattEvent nrf_ble_gatt event
+ */
+void streamGattEventHandler(tsStream *stream, nrf_ble_gatt_evt_t const *gattEvent)
+{
+    if (gattEvent->conn_handle != stream->connHandle)
+    {
+        return;
+    }
+
+    switch (gattEvent->evt_id)
+    {
+        case NRF_BLE_GATT_EVT_ATT_MTU_UPDATED:
+            stream->stats.attMtu = gattEvent->params.att_mtu_effective;
+            stream->payloadMax   = MIN(gattEvent->params.att_mtu_effective - 3, STREAM_PAYLOAD_MAX);
+            break;
+
+        case NRF_BLE_GATT_EVT_DATA_LENGTH_UPDATED:
+            stream->stats.dataLength = gattEvent->params.data_length;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Function to queue a scan record for the connected peer
+ *
+ * @param stream    Stream instance
+ * @param record    Advertising record
+ *
+ * @details Records are written whole or dropped, the peer splits the stream on the length bytes.
+ */
+void streamRecordPut(tsStream *stream, tsAdvRecord const *record)
+{
+    uint32_t size = STREAM_RECORD_HEADER_SIZE + record->len;
+    uint32_t head = stream->head;
+    uint8_t header[STREAM_RECORD_HEADER_SIZE];
+
+    if (!streamActive(stream) || stream->mode != eStreamModeRecords)
+    {
+        return;
+    }
+    if (STREAM_BUFFER_SIZE - (head - stream->tail) < size)
+    {
+        stream->dropped++;
+        return;
+    }
+
+    header[0] = record->len;
+    memcpy(&header[1], record->addr, BLE_GAP_ADDR_LEN);
+    header[1 + BLE_GAP_ADDR_LEN] = (uint8_t)record->rssi;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        stream->buffer[(head + i) & (STREAM_BUFFER_SIZE - 1)] = (i < STREAM_RECORD_HEADER_SIZE) ? header[i] : record->data[i - STREAM_RECORD_HEADER_SIZE];
+    }
+    stream->head = head + size;
+    stream->records++;
+
+    streamPump(stream);
+}
+
+/**@brief Function to check if a peer is connected to the streaming service */
+bool streamConnected(tsStream const *stream)
+{
+    return stream->connHandle != BLE_CONN_HANDLE_INVALID;
+}
+
+/**@brief Function to get the transport of the records, "l2cap" or "gatt" */
+char const *streamTransportGet(tsStream const *stream)
+{
+#if COC_ENABLE
+    if (cocIsOpen(&stream->coc))
+    {
+        return "l2cap";
+    }
+#endif
+    return "gatt";
+}
+
+/**
+ * @brief Function to print the link parameters and the throughput of the last window
+ *
+ * @param stream    Stream instance
+ */
+void streamReport(tsStream const *stream)
+{
+    printf("STREAM %s %u kbit/s mtu=%u dl=%u phy=%u ci=%u.%02u ms records=%lu dropped=%lu sent=%lu bytes\n\r",
+           streamTransportGet(stream), stream->stats.kbps, stream->stats.attMtu, stream->stats.dataLength, stream->stats.phy,
+           stream->stats.connInterval * 125 / 100, stream->stats.connInterval * 125 % 100,
+           stream->records, stream->dropped, (uint32_t)stream->bytesSent);
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**
+ * @brief Fills the notification queue of the SoftDevice
+ *
+ * @details Called from the SoftDevice interrupt (tx complete) and from the record producer, the
+ *          critical region keeps the tail and the length FIFO consistent.
+ */
+static void streamPump(tsStream *stream)
+{
+    uint8_t packet[STREAM_PAYLOAD_MAX];
+    ble_gatts_hvx_params_t hvx;
+    uint32_t errCode;
+
+#if COC_ENABLE
+    if (cocIsOpen(&stream->coc))
+    {
+        streamSduPump(stream);
+        return;
+    }
+#endif
+    if (!stream->notifyEnabled || stream->connHandle == BLE_CONN_HANDLE_INVALID)
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    for (;;)
+    {
+        uint32_t tail       = stream->tail;
+        uint32_t available  = stream->head - tail;
+        uint16_t length;
+
+        if (stream->lengthsHead - stream->lengthsTail >= STREAM_LENGTHS_DEPTH)
+        {
+            break;
+        }
+
+        if (stream->mode == eStreamModeBulk)
+        {
+            length = stream->payloadMax;
+            memset(packet, (uint8_t)stream->bulkSequence, length);
+            uint32_big_encode(stream->bulkSequence, packet);
+        }
+        else
+        {
+            if (available == 0)
+            {
+                break;
+            }
+            length = (uint16_t)MIN(available, stream->payloadMax);
+            for (uint16_t i = 0; i < length; i++)
+            {
+                packet[i] = stream->buffer[(tail + i) & (STREAM_BUFFER_SIZE - 1)];
+            }
+        }
+
+        memset(&hvx, 0, sizeof(hvx));
+        hvx.handle = stream->recordsHandles.value_handle;
+        hvx.type   = BLE_GATT_HVX_NOTIFICATION;
+        hvx.p_len  = &length;
+        hvx.p_data = packet;
+
+        errCode = sd_ble_gatts_hvx(stream->connHandle, &hvx);
+        if (errCode != NRF_SUCCESS)
+        {
+            break; // NRF_ERROR_RESOURCES: queue full, next tx complete. Others: link is going down
+        }
+
+        if (stream->mode == eStreamModeBulk)
+        {
+            stream->bulkSequence++;
+        }
+        else
+        {
+            stream->tail = tail + length;
+        }
+        stream->lengths[stream->lengthsHead++ & (STREAM_LENGTHS_DEPTH - 1)] = length;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+/**@brief Notifications on air, throughput window */
+static void streamTxComplete(tsStream *stream, uint8_t count)
+{
+    CRITICAL_REGION_ENTER();
+    while (count-- > 0 && stream->lengthsTail != stream->lengthsHead)
+    {
+        uint16_t length = stream->lengths[stream->lengthsTail++ & (STREAM_LENGTHS_DEPTH - 1)];
+
+        stream->windowBytes += length;
+        stream->bytesSent += length;
+    }
+    CRITICAL_REGION_EXIT();
+
+    streamWindowUpdate(stream);
+}
+
+/**@brief End of the throughput window, stats characteristic and report */
+static void streamWindowUpdate(tsStream *stream)
+{
+    uint32_t elapsed = app_timer_cnt_diff_compute(app_timer_cnt_get(), stream->windowStart);
+
+    if (elapsed >= APP_TIMER_TICKS(STREAM_REPORT_INTERVAL_MS))
+    {
+        // ATT payload bits per ms
+        stream->stats.kbps  = (uint16_t)((uint64_t)stream->windowBytes * 8 * STREAM_TICK_FREQUENCY / 1000 / elapsed);
+        stream->windowStart = app_timer_cnt_get();
+        stream->windowBytes = 0;
+        streamStatsUpdate(stream);
+#if JLINK_DEBUG_PRINT_ENABLE
+        streamReport(stream);
+#endif
+    }
+}
+
+/**@brief Stats characteristic value */
+static void streamStatsUpdate(tsStream *stream)
+{
+    uint8_t value[STREAM_STATS_SIZE];
+    ble_gatts_value_t gattsValue;
+
+    uint16_encode(stream->stats.kbps, &value[0]);
+    uint16_encode(stream->stats.attMtu, &value[2]);
+    value[4] = stream->stats.dataLength;
+    value[5] = stream->stats.phy;
+    uint16_encode(stream->stats.connInterval, &value[6]);
+
+    memset(&gattsValue, 0, sizeof(gattsValue));
+    gattsValue.len     = sizeof(value);
+    gattsValue.p_value = value;
+    sd_ble_gatts_value_set(stream->connHandle, stream->statsHandles.value_handle, &gattsValue);
+}
+
+/**
+ * @brief 2M PHY and a short connection interval, asked right after the connection
+ *
+ * @details The central has the last word on both, achieved values end up in the stats.
+ */
+static void streamLinkRequest(tsStream *stream)
+{
+    ble_gap_phys_t const phys = {.tx_phys = BLE_GAP_PHY_2MBPS, .rx_phys = BLE_GAP_PHY_2MBPS};
+    ble_gap_conn_params_t const connParams =
+        {
+            .min_conn_interval = STREAM_MIN_CONN_INTERVAL,
+            .max_conn_interval = STREAM_MAX_CONN_INTERVAL,
+            .slave_latency     = 0,
+            .conn_sup_timeout  = STREAM_CONN_SUP_TIMEOUT,
+        };
+
+    sd_ble_gap_phy_update(stream->connHandle, &phys);              // Busy: the central started a PHY procedure first
+    sd_ble_gap_conn_param_update(stream->connHandle, &connParams); // Busy with a central procedure: keep what we got
+}
+
+/**@brief Link is gone, pending records are dropped */
+static void streamDisconnected(tsStream *stream)
+{
+    CRITICAL_REGION_ENTER();
+    stream->connHandle    = BLE_CONN_HANDLE_INVALID;
+    stream->notifyEnabled = 0;
+    stream->mode          = eStreamModeRecords;
+    stream->payloadMax    = BLE_GATT_ATT_MTU_DEFAULT - 3;
+    stream->tail          = stream->head;
+    stream->lengthsTail   = stream->lengthsHead;
+#if COC_ENABLE
+    stream->sduHead    = stream->head;
+    stream->sduFillers = 0;
+#endif
+    CRITICAL_REGION_EXIT();
+}
+
+/**@brief Records are taken by notifications or by the bulk channel */
+static bool streamActive(tsStream const *stream)
+{
+#if COC_ENABLE
+    if (cocIsOpen(&stream->coc))
+    {
+        return true;
+    }
+#endif
+    return stream->notifyEnabled;
+}
+
+#if COC_ENABLE
+/**
+ * @brief Hands contiguous parts of the record buffer to the channel
+ *
+ * @details No copy, the SoftDevice reads the buffer until the SDU is acknowledged, the tail stays in
+ *          front of it so streamRecordPut() does not overwrite it. Bulk mode sends the buffer itself
+ *          as filler.
+ */
+static void streamSduPump(tsStream *stream)
+{
+    uint16_t sduMax = cocSduMaxGet(&stream->coc);
+
+    CRITICAL_REGION_ENTER();
+    for (;;)
+    {
+        uint32_t offset;
+        uint32_t length;
+
+        if (stream->mode == eStreamModeBulk)
+        {
+            offset = 0;
+            length = MIN(STREAM_BUFFER_SIZE, sduMax);
+        }
+        else
+        {
+            uint32_t available = stream->head - stream->sduHead;
+
+            if (available == 0)
+            {
+                break;
+            }
+            offset = stream->sduHead & (STREAM_BUFFER_SIZE - 1);
+            length = MIN(MIN(available, STREAM_BUFFER_SIZE - offset), sduMax); // Up to the end of the buffer
+        }
+
+        if (cocSend(&stream->coc, &stream->buffer[offset], (uint16_t)length) != NRF_SUCCESS)
+        {
+            break; // NRF_ERROR_RESOURCES: tx queue full, next tx done
+        }
+
+        if (stream->mode == eStreamModeBulk)
+        {
+            stream->bulkSequence++;
+            stream->sduFillers++;
+        }
+        else
+        {
+            stream->sduHead += length;
+        }
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+/**@brief SDU acknowledged, its part of the buffer is free */
+static void streamSduDone(void *context, uint16_t connHandle, uint16_t length)
+{
+    tsStream *stream = (tsStream *)context;
+
+    CRITICAL_REGION_ENTER();
+    if (stream->sduFillers > 0)
+    {
+        stream->sduFillers--; // SDUs complete in order, fillers queued before the mode change go first
+    }
+    else
+    {
+        stream->tail += length;
+    }
+    stream->windowBytes += length;
+    stream->bytesSent += length;
+    CRITICAL_REGION_EXIT();
+
+    streamWindowUpdate(stream);
+    streamPump(stream);
+}
+
+/**@brief Channel opened by the central or released, notifications carry on from the tail */
+static void streamChannelChanged(void *context, uint16_t connHandle, bool open)
+{
+    tsStream *stream = (tsStream *)context;
+
+    CRITICAL_REGION_ENTER();
+    stream->sduHead    = stream->tail; // Open: first byte not notified, released: SDUs not acknowledged go again
+    stream->sduFillers = 0;
+    if (open)
+    {
+        stream->windowStart = app_timer_cnt_get();
+        stream->windowBytes = 0;
+    }
+    CRITICAL_REGION_EXIT();
+
+    streamPump(stream);
+}
+#endif
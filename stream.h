@@ -0,0 +1,120 @@
+/** @file       stream.h
+ *  @brief      GATT streaming service, scan records as notifications to a connected phone or gateway
+ *  @author     Evren Kenanoglu
+ *  @date       4/20/2021
+ */
+#ifndef FILE_STREAM_H
+#define FILE_STREAM_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+#include "ble.h"
+#include "ble_gatts.h"
+#include "nrf_ble_gatt.h"
+#include "advqueue.h"
+#include "coc.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define STREAM_UUID_BASE                                  \
+    {                                                     \
+        0x3E, 0x1A, 0x5C, 0x7B, 0x90, 0x2D, 0x4F, 0x61,   \
+        0xA8, 0x17, 0xE3, 0x55, 0x00, 0x00, 0x9E, 0xD5    \
+    }                               /**< 128 bit base, bytes 12-13 are the 16 bit UUIDs below */
+#define STREAM_UUID_SERVICE 0x1400
+#define STREAM_UUID_RECORDS 0x1401  /**< Notify: record stream, [len][addr 6][rssi][adv data len] */
+#define STREAM_UUID_CONTROL 0x1402  /**< Write: teStreamModes */
+#define STREAM_UUID_STATS   0x1403  /**< Read: tsStreamStats */
+
+#define STREAM_RECORD_HEADER_SIZE (1 + BLE_GAP_ADDR_LEN + 1)
+#define STREAM_PAYLOAD_MAX        (NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3) // ATT notification header
+#define STREAM_LENGTHS_DEPTH      16                                  // Notifications in flight, >= hvn queue, power of 2
+#define STREAM_STATS_SIZE         8
+
+STATIC_ASSERT((STREAM_BUFFER_SIZE & (STREAM_BUFFER_SIZE - 1)) == 0);
+STATIC_ASSERT(STREAM_LENGTHS_DEPTH >= STREAM_HVN_QUEUE_SIZE);
+
+/** TYPEDEFS ******************************************************************/
+
+typedef enum
+{
+    eStreamModeRecords = 0, // Scan records as they are received
+    eStreamModeBulk,        // Filler notifications back to back, link throughput test
+} teStreamModes;
+
+/**
+ * @brief Link and throughput, value of the stats characteristic
+ *
+ */
+typedef struct
+{
+    uint16_t kbps;         /**< Last report window */
+    uint16_t attMtu;
+    uint8_t dataLength;    /**< LL payload, octets */
+    uint8_t phy;           /**< BLE_GAP_PHY_* */
+    uint16_t connInterval; /**< 1.25 ms units */
+} tsStreamStats;
+
+/**
+ * @brief Service handles, connection and record buffer
+ *
+ */
+typedef struct
+{
+    uint8_t uuidType;
+    uint16_t serviceHandle;
+    ble_gatts_char_handles_t recordsHandles;
+    ble_gatts_char_handles_t controlHandles;
+    ble_gatts_char_handles_t statsHandles;
+
+    uint16_t connHandle;
+    uint8_t notifyEnabled;
+    uint8_t mode;          /**< teStreamModes */
+    uint16_t payloadMax;   /**< ATT MTU - 3 */
+    tsStreamStats stats;
+
+    uint8_t buffer[STREAM_BUFFER_SIZE]; /**< Whole records only, the framing survives notification boundaries */
+    volatile uint32_t head;             /**< Written by streamRecordPut() only */
+    uint32_t tail;
+    uint16_t lengths[STREAM_LENGTHS_DEPTH]; /**< Sizes of the notifications in flight */
+    uint32_t lengthsHead;
+    uint32_t lengthsTail;
+    uint32_t bulkSequence;
+#if COC_ENABLE
+    tsCoc coc;             /**< Replaces notifications while it is open */
+    uint32_t sduHead;      /**< Next byte handed to the channel, tail moves when the SDU is acknowledged */
+    uint8_t sduFillers;    /**< Bulk SDUs in flight, they do not move the tail */
+#endif
+
+    uint32_t windowStart; /**< app_timer ticks */
+    uint32_t windowBytes;
+    uint32_t records;
+    uint32_t dropped;     /**< Buffer full */
+    uint64_t bytesSent;
+} tsStream;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_STREAM_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE ret_code_t streamInit(tsStream *stream);
+INTERFACE void streamBleEventHandler(tsStream *stream, ble_evt_t const *bleEvent);
+INTERFACE void streamGattEventHandler(tsStream *stream, nrf_ble_gatt_evt_t const *gattEvent);
+INTERFACE void streamRecordPut(tsStream *stream, tsAdvRecord const *record);
+INTERFACE bool streamConnected(tsStream const *stream);
+INTERFACE char const *streamTransportGet(tsStream const *stream);
+INTERFACE void streamReport(tsStream const *stream);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_STREAM_H
@@ -0,0 +1,255 @@
+/** @file       tune.c
+ *  @brief      Closed loop tuner of the slave scan, sleep and advertising timings
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ *
+ *  Once per slave cycle (scan end) the tuner takes the detection result and the advertising reports
+ *  of the scan. Every config.period cycles it makes one step toward the target discovery latency at
+ *  the lowest current:
+ *      - latency estimate: cycle / detections per scan, the scans until a detection are geometric
+ *      - current estimate: energy.h current model of the settings
+ *      - over the budget or well below the target latency: save, a shorter listening window first
+ *        (duty, then scan), a longer sleep last
+ *      - above the target latency: spend, a shorter sleep first, a longer listening window last
+ *      - crowded channel (reports per second of listening): longer advertising interval, fewer
+ *        events of this slave on the air; quiet channel: back toward the shortest interval
+ *
+ *  A short listening window with a short sleep reaches a latency for less charge than a long window
+ *  with a long sleep, as long as the window holds a master advertising event often enough, which is
+ *  what the measured detection ratio tells. A miss streak beyond config.absentMisses is the master
+ *  being away, not a bad setting: the streak is taken back out of the ratio and no step is made,
+ *  backoff.c handles the absence. Integer arithmetic only, Q8 moving averages (1/8 per cycle).
+ */
+#define FILE_TUNE_C
+
+/** INCLUDES ******************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "tune.h"
+#include "energy.h"
+#include "nordic_common.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define TUNE_ONE          (1 << TUNE_Q)
+#define TUNE_AVERAGE_BITS 3    // Moving averages take 1/8 of every new cycle
+#define TUNE_PDU_US       352  // 31 byte payload at 1 Mbps
+#define TUNE_TX_RAMP_US   140  // Radio ramp up per PDU
+#define TUNE_WAKE_US      1000 // CPU time per transition, two per cycle
+#define TUNE_LOAD_MAX     100000 // Reports per second, far beyond a busy channel
+
+/** TYPEDEFS ******************************************************************/
+
+/** MACROS ********************************************************************/
+
+/** VARIABLES *****************************************************************/
+
+/** LOCAL FUNCTION DECLARATIONS ***********************************************/
+static void tuneSpend(tsTuneConfig const *config, tsTuneSettings *next);
+static void tuneSave(tsTuneConfig const *config, tsTuneSettings *next);
+static uint32_t tuneListenGet(tsTuneSettings const *settings);
+
+/** INTERFACE FUNCTION DEFINITIONS ********************************************/
+
+/**
+ * @brief Function to initialize a tuner
+ *
+ * @param tune   Tuner instance
+ * @param config Target and bounds, copied
+ * @param start  Settings to start from, clamped to the bounds
+ */
+void tuneInit(tsTune *tune, tsTuneConfig const *config, tsTuneSettings const *start)
+{
+    memset(tune, 0, sizeof(*tune));
+    tune->config = *config;
+
+    tune->settings.scan        = MIN(MAX(start->scan, config->scanMin), config->scanMax);
+    tune->settings.duty        = MIN(MAX(start->duty, config->dutyMin), config->dutyMax);
+    tune->settings.sleep       = MIN(MAX(start->sleep, config->sleepMin), config->sleepMax);
+    tune->settings.advInterval = MIN(MAX(start->advInterval, config->advIntervalMin), config->advIntervalMax);
+
+    tune->success       = TUNE_ONE; // Settings are taken as good until the scans tell otherwise
+    tune->successStreak = TUNE_ONE;
+}
+
+/**@brief Function to count an advertising report, SoftDevice interrupt context */
+void tuneAdvReport(tsTune *tune)
+{
+    tune->reports++;
+}
+
+/**
+ * @brief Function to be called at the end of every slave scan
+ *
+ * @param tune     Tuner instance
+ * @param detected Master was detected in the scan
+ * @return true    tune->settings changed, to be applied
+ */
+bool tuneCycleEnd(tsTune *tune, bool detected)
+{
+    tsTuneConfig const *config = &tune->config;
+    tsTuneSettings next        = tune->settings;
+    uint32_t reports           = tune->reports;
+    uint64_t rate              = ((uint64_t)(reports - tune->reportsLast) * 1000 << TUNE_Q) / tuneListenGet(&tune->settings);
+    uint32_t latency;
+
+    rate = MIN(rate, (uint64_t)TUNE_LOAD_MAX << TUNE_Q); // Keeps the average in int32_t
+    tune->reportsLast = reports;
+    tune->load        = (uint32_t)((int32_t)tune->load + (((int32_t)rate - (int32_t)tune->load) >> TUNE_AVERAGE_BITS));
+
+    if (detected)
+    {
+        tune->misses  = 0;
+        tune->success = (uint16_t)(tune->success + ((TUNE_ONE - tune->success) >> TUNE_AVERAGE_BITS));
+    }
+    else
+    {
+        if (tune->misses == 0)
+        {
+            tune->successStreak = tune->success;
+        }
+        tune->misses = (tune->misses < UINT16_MAX) ? tune->misses + 1 : tune->misses;
+        tune->success = (tune->misses > config->absentMisses) ? tune->successStreak
+                                                              : (uint16_t)(tune->success - (tune->success >> TUNE_AVERAGE_BITS));
+    }
+
+    if (++tune->cycles < config->period)
+    {
+        return false;
+    }
+    tune->cycles = 0;
+    if (tune->misses > config->absentMisses)
+    {
+        tune->holds++;
+        return false;
+    }
+
+    if (tune->load > ((uint32_t)config->loadHigh << TUNE_Q))
+    {
+        next.advInterval = (uint16_t)MIN(next.advInterval + next.advInterval / 4, config->advIntervalMax);
+    }
+    else if (tune->load < ((uint32_t)config->loadLow << TUNE_Q))
+    {
+        next.advInterval = (uint16_t)MAX(next.advInterval - next.advInterval / 5, config->advIntervalMin);
+    }
+
+    latency = tuneLatencyGet(tune);
+    if (tuneCurrentGet(tune, &tune->settings) > config->budget ||
+        (uint64_t)latency * 100 < (uint64_t)config->latency * (100 - config->hysteresis))
+    {
+        tuneSave(config, &next);
+        tune->saves++;
+    }
+    else if (latency > config->latency)
+    {
+        tsTuneSettings spend = next;
+
+        tuneSpend(config, &spend);
+        if (tuneCurrentGet(tune, &spend) <= config->budget)
+        {
+            next = spend;
+            tune->spends++;
+        }
+    }
+
+    if (memcmp(&next, &tune->settings, sizeof(next)) == 0)
+    {
+        return false;
+    }
+    tune->settings = next;
+    return true;
+}
+
+/**
+ * @brief Function to get the estimated discovery latency of the current settings
+ *
+ * @return uint32_t ms, cycle over the detections per scan
+ */
+uint32_t tuneLatencyGet(tsTune const *tune)
+{
+    uint32_t cycle = tune->settings.scan + tune->settings.sleep;
+
+    return (uint32_t)MIN(((uint64_t)cycle << TUNE_Q) / MAX(tune->success, 1), UINT32_MAX);
+}
+
+/**
+ * @brief Function to get the estimated average current of a setting
+ *
+ * @param tune     Tuner instance, detection ratio and advertising phase
+ * @param settings Settings to estimate
+ * @return uint32_t uA, energy.h current model
+ */
+uint32_t tuneCurrentGet(tsTune const *tune, tsTuneSettings const *settings)
+{
+    uint32_t listen = tuneListenGet(settings);
+    uint32_t adv    = (tune->config.advPhase * tune->success) >> TUNE_Q; // ms per cycle
+    uint32_t events = MAX(tune->config.advPhase / MAX(settings->advInterval, 1), 1);
+    uint32_t cycle  = settings->scan + settings->sleep + adv;
+    uint64_t charge; // uA * ms
+
+    charge = (uint64_t)listen * ENERGY_CURRENT_RADIO_RX_UA;
+    charge += (uint64_t)(cycle - listen) * ENERGY_CURRENT_SLEEP_UA;
+    charge += (uint64_t)2 * TUNE_WAKE_US * ENERGY_CURRENT_CPU_UA / 1000;
+    charge += (((uint64_t)events * 3 * (TUNE_PDU_US + TUNE_TX_RAMP_US) * ENERGY_CURRENT_RADIO_TX_UA / 1000) * tune->success) >> TUNE_Q;
+
+    return (uint32_t)(charge / MAX(cycle, 1));
+}
+
+/**@brief Function to print the tuner state on the debug console */
+void tuneReport(tsTune const *tune)
+{
+    printf("TUNE,success=%lu,latency=%lu,current=%lu,load=%lu,scan=%lu,duty=%u,sleep=%lu,adv=%u,spends=%lu,saves=%lu,holds=%lu\n\r",
+           (unsigned long)((tune->success * 100) >> TUNE_Q),
+           (unsigned long)tuneLatencyGet(tune),
+           (unsigned long)tuneCurrentGet(tune, &tune->settings),
+           (unsigned long)(tune->load >> TUNE_Q),
+           (unsigned long)tune->settings.scan,
+           tune->settings.duty,
+           (unsigned long)tune->settings.sleep,
+           tune->settings.advInterval,
+           (unsigned long)tune->spends,
+           (unsigned long)tune->saves,
+           (unsigned long)tune->holds);
+}
+
+/** LOCAL FUNCTION DEFINITIONS ************************************************/
+
+/**@brief Shorter latency: shorter sleep first, then a longer listening window */
+static void tuneSpend(tsTuneConfig const *config, tsTuneSettings *next)
+{
+    if (next->sleep > config->sleepMin)
+    {
+        next->sleep = MAX(next->sleep - next->sleep / 4, config->sleepMin);
+    }
+    else if (next->duty < config->dutyMax)
+    {
+        next->duty = (uint8_t)MIN(next->duty + config->dutyStep, config->dutyMax);
+    }
+    else if (next->scan < config->scanMax)
+    {
+        next->scan = MIN(next->scan + config->scanStep, config->scanMax);
+    }
+}
+
+/**@brief Lower current: shorter listening window first, then a longer sleep */
+static void tuneSave(tsTuneConfig const *config, tsTuneSettings *next)
+{
+    if (next->duty > config->dutyMin)
+    {
+        next->duty = (uint8_t)MAX(next->duty - config->dutyStep, config->dutyMin);
+    }
+    else if (next->scan > config->scanMin)
+    {
+        next->scan = (next->scan > config->scanMin + config->scanStep) ? next->scan - config->scanStep : config->scanMin;
+    }
+    else if (next->sleep < config->sleepMax)
+    {
+        next->sleep = MIN(next->sleep + MAX(next->sleep / 4, 1), config->sleepMax);
+    }
+}
+
+/**@brief Listening time of a scan, ms, at least 1 */
+static uint32_t tuneListenGet(tsTuneSettings const *settings)
+{
+    return MAX(settings->scan * settings->duty / 100, 1);
+}
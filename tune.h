@@ -0,0 +1,101 @@
+/** @file       tune.h
+ *  @brief      Closed loop tuner of the slave scan, sleep and advertising timings
+ *  @author     Evren Kenanoglu
+ *  @date       4/26/2021
+ */
+#ifndef FILE_TUNE_H
+#define FILE_TUNE_H
+
+/** INCLUDES ******************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "parameters.h"
+
+/** CONSTANTS *****************************************************************/
+
+#define TUNE_Q 8 // Fraction bits of the success ratio and of the channel load
+
+/** TYPEDEFS ******************************************************************/
+
+/**
+ * @brief Tuner target and bounds of every setting
+ *
+ */
+typedef struct
+{
+    uint32_t latency;        /**< ms, target discovery latency */
+    uint32_t budget;         /**< uA, highest estimated average current */
+    uint32_t scanMin;        /**< ms */
+    uint32_t scanMax;        /**< ms */
+    uint32_t scanStep;       /**< ms */
+    uint8_t dutyMin;         /**< % */
+    uint8_t dutyMax;         /**< % */
+    uint8_t dutyStep;        /**< % */
+    uint32_t sleepMin;       /**< ms */
+    uint32_t sleepMax;       /**< ms */
+    uint16_t advIntervalMin; /**< ms */
+    uint16_t advIntervalMax; /**< ms */
+    uint32_t advPhase;       /**< ms, advertising phase after a detection, for the current estimate */
+    uint16_t loadHigh;       /**< Reports per second of listening, crowded channel */
+    uint16_t loadLow;        /**< Reports per second of listening, quiet channel */
+    uint8_t period;          /**< Cycles between two steps */
+    uint8_t hysteresis;      /**< %, below the target latency before energy is saved again */
+    uint8_t absentMisses;    /**< Misses in a row after which the master is taken as absent */
+} tsTuneConfig;
+
+/**
+ * @brief Settings the tuner drives, applied by the program
+ *
+ */
+typedef struct
+{
+    uint32_t scan;        /**< ms, scan phase */
+    uint8_t duty;         /**< %, scan window of the scan interval */
+    uint32_t sleep;       /**< ms, sleep phase, backoff base */
+    uint16_t advInterval; /**< ms */
+} tsTuneSettings;
+
+/**
+ * @brief Tuner state
+ *
+ */
+typedef struct
+{
+    tsTuneConfig config;
+    tsTuneSettings settings;
+    uint16_t success;           /**< Detections per scan, Q8 moving average */
+    uint16_t successStreak;     /**< Success before the current miss streak */
+    uint32_t load;              /**< Reports per second of listening, Q8 moving average */
+    uint16_t misses;            /**< Scans without the master in a row */
+    uint8_t cycles;             /**< Cycles since the last step */
+    volatile uint32_t reports;  /**< Advertising reports, SoftDevice interrupt */
+    uint32_t reportsLast;       /**< Reports at the last cycle end */
+
+    /** Statistics **/
+    uint32_t spends; /**< Steps toward a shorter latency */
+    uint32_t saves;  /**< Steps toward a lower current */
+    uint32_t holds;  /**< Steps skipped while the master is absent */
+} tsTune;
+
+/** MACROS ********************************************************************/
+
+#ifndef FILE_TUNE_C
+#define INTERFACE extern
+#else
+#define INTERFACE
+#endif
+
+/** VARIABLES *****************************************************************/
+
+/** FUNCTIONS *****************************************************************/
+
+INTERFACE void tuneInit(tsTune *tune, tsTuneConfig const *config, tsTuneSettings const *start);
+INTERFACE void tuneAdvReport(tsTune *tune);
+INTERFACE bool tuneCycleEnd(tsTune *tune, bool detected);
+INTERFACE uint32_t tuneLatencyGet(tsTune const *tune);
+INTERFACE uint32_t tuneCurrentGet(tsTune const *tune, tsTuneSettings const *settings);
+INTERFACE void tuneReport(tsTune const *tune);
+
+#undef INTERFACE // Should not let this roam free
+
+#endif // FILE_TUNE_H